@@ -0,0 +1,141 @@
+#ifndef _C4_OPT_BM_COMMON_HPP_
+#define _C4_OPT_BM_COMMON_HPP_
+
+/** @file bm_common.hpp generators of usages and command lines shared
+ * by the benchmarks */
+
+#include <c4/opt/opt.hpp>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace c4 {
+namespace opt {
+namespace bm {
+
+typedef enum : uint32_t {
+    FORM_SHORT  = 1u << 0,  ///< -x, -x val
+    FORM_LONG   = 1u << 1,  ///< --name, --name=val
+    FORM_ABBREV = 1u << 2,  ///< --na (needs a parser with min_abbr_len=2)
+    FORM_POSN   = 1u << 3,  ///< positional arguments mixed with the options
+    FORM_MIXED  = FORM_SHORT|FORM_LONG,
+} Form_e;
+
+/** a checker which does some real work: the argument must be a number
+ * within a range */
+inline option::ArgStatus bm_number(option::Option const& o, bool)
+{
+    if( ! o.arg || ! o.arg[0])
+        return option::ARG_ILLEGAL;
+    char *end = nullptr;
+    double d = strtod(o.arg, &end);
+    return (*end == 0 && d >= -1e9 && d <= 1e9) ? option::ARG_OK : option::ARG_ILLEGAL;
+}
+
+/** A generated usage with num_options options. Option i (its index,
+ * starting at 1) is --o<i>-long-option, with a short option for the
+ * first 52. The odd options take no argument; the even ones take one,
+ * checked with the given checker. Index 0 is the unknown option. */
+struct Usage
+{
+    std::vector<std::string> shortopts;
+    std::vector<std::string> longopts;
+    std::vector<option::Descriptor> desc;
+
+    explicit Usage(size_t num_options, option::CheckArg arg_checker=c4::opt::required)
+    {
+        static const char letters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+        shortopts.reserve(num_options);
+        longopts.reserve(num_options);
+        desc.reserve(num_options + 2);
+        desc.push_back({0, 0, "", "", c4::opt::unknown, "USAGE: bm [options]\n\nOptions:"});
+        for(size_t i = 1; i <= num_options; ++i)
+        {
+            shortopts.emplace_back(i <= 52 ? std::string(1, letters[i - 1]) : std::string());
+            longopts.emplace_back("o" + std::to_string(i) + "-long-option");
+            bool has_arg = (i % 2) == 0;
+            desc.push_back({(unsigned)i, 0, shortopts.back().c_str(), longopts.back().c_str(),
+                            has_arg ? arg_checker : c4::opt::none,
+                            has_arg ? "  --oN-long-option=<val>  \tAn option with an argument, which is described with a few more words than needed." : "  --oN-long-option  \tAn option."});
+        }
+        desc.push_back({0, 0, 0, 0, 0, 0});
+    }
+
+    option::Descriptor const* usage() const { return desc.data(); }
+    size_t size() const { return desc.size(); }
+    size_t num_options() const { return desc.size() - 2; }
+    static bool has_arg(size_t i) { return (i % 2) == 0; }
+};
+
+
+/** A generated command line with num_tokens tokens, naming the options
+ * of a Usage in the given forms. The tokens are kept in a single
+ * buffer, and argv ends with a null. */
+struct CommandLine
+{
+    std::string chars;
+    std::vector<const char*> argv;
+
+    CommandLine() = default;
+    CommandLine(Usage const& u, size_t num_tokens, uint32_t forms=FORM_MIXED, uint64_t seed=0x9e3779b97f4a7c15ull)
+    {
+        std::vector<size_t> offsets;
+        offsets.reserve(num_tokens);
+        auto push = [&](std::string const& tok){ offsets.push_back(chars.size()); chars.append(tok); chars.push_back('\0'); };
+        const uint32_t opt_forms = forms & (FORM_SHORT|FORM_LONG|FORM_ABBREV);
+        const size_t num_opts = u.num_options();
+        while(offsets.size() < num_tokens)
+        {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull; // LCG
+            uint32_t r = (uint32_t)(seed >> 33);
+            if((forms & FORM_POSN) && (r & 1u))
+            {
+                push("file" + std::to_string(r % 1000u) + ".txt");
+                continue;
+            }
+            size_t i = 1 + (r >> 1) % num_opts;
+            uint32_t form;
+            do {
+                form = 1u << ((r >> 8) % 3u);
+                r = r * 1103515245u + 12345u;
+            } while( ! (form & opt_forms));
+            if(form == FORM_SHORT && u.shortopts[i - 1].empty())
+                form = FORM_LONG;
+            bool room = offsets.size() + 2 <= num_tokens;
+            bool arg = Usage::has_arg(i);
+            if(arg && form == FORM_SHORT && ! room)
+                form = FORM_LONG;
+            std::string val = std::to_string(r % 100000u);
+            switch(form)
+            {
+            case FORM_SHORT:
+                push("-" + u.shortopts[i - 1]);
+                if(arg)
+                    push(val);
+                break;
+            case FORM_LONG:
+                push("--" + u.longopts[i - 1] + (arg ? "=" + val : std::string()));
+                break;
+            default: // abbreviated: --o<i>-l
+                push("--o" + std::to_string(i) + "-l" + (arg ? "=" + val : std::string()));
+                break;
+            }
+        }
+        argv.reserve(offsets.size() + 1);
+        for(size_t off : offsets)
+            argv.push_back(chars.data() + off);
+        argv.push_back(nullptr);
+    }
+
+    int argc() const { return (int)argv.size() - 1; }
+    size_t num_tokens() const { return argv.size() - 1; }
+    /** a mutable copy of argv, for the parsers which permute it */
+    std::vector<const char*> copy() const { return argv; }
+};
+
+} // namespace bm
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_BM_COMMON_HPP_ */
@@ -0,0 +1,161 @@
+/** @file bm_complete.cpp latency of shell completion, from a cold
+ * start to the candidates written out:
+ *
+ *   - index: building the CompletionIndex of a usage, 10 to 10k options
+ *   - query: completing one word with an index already built
+ *   - cold: what `prog --complete` does after the process started:
+ *     build the index, complete the word and format the output
+ *   - process: the whole round trip seen by the shell: spawn this
+ *     program with --complete, and read its output until it exits
+ *
+ * The process benchmark runs this same executable as the completer, so
+ * its startup cost is that of a small program linked with c4opt:
+ *
+ *   c4opt-bm-complete <num_options> --complete[=<shell>] <words>...
+ */
+
+#include "bm_common.hpp"
+#include <c4/opt/complete.hpp>
+#include <benchmark/benchmark.h>
+#include <stdlib.h>
+#include <map>
+#include <memory>
+
+#ifdef C4_UNIX
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace c4 {
+namespace opt {
+namespace bm {
+namespace {
+
+const char *self_path = nullptr;
+
+Usage const& usage_for(size_t num_options)
+{
+    static std::map<size_t, std::unique_ptr<Usage>> cache;
+    auto &u = cache[num_options];
+    if( ! u)
+        u.reset(new Usage(num_options));
+    return *u;
+}
+
+/** a word with a single candidate, and one with about a tenth of the
+ * options as candidates */
+const char *const words_one[] = {"--o7-l"};
+const char *const words_many[] = {"--o1"};
+
+void index(benchmark::State &st)
+{
+    Usage const& u = usage_for((size_t)st.range(0));
+    for(auto _ : st)
+    {
+        CompletionIndex ix(u.usage());
+        benchmark::DoNotOptimize(ix.table().words);
+    }
+    st.counters["descriptors"] = (double)u.num_options();
+}
+
+void query(benchmark::State &st, const char *const* words)
+{
+    Usage const& u = usage_for((size_t)st.range(0));
+    CompletionIndex ix(u.usage());
+    std::string buf(1 << 20, '\0');
+    size_t len = 0;
+    for(auto _ : st)
+    {
+        len = complete(substr(&buf[0], buf.size()), ix, SHELL_FISH, 1, (const char**)words);
+        benchmark::DoNotOptimize(buf.data());
+    }
+    st.counters["bytes"] = (double)len;
+}
+
+void cold(benchmark::State &st, const char *const* words)
+{
+    Usage const& u = usage_for((size_t)st.range(0));
+    std::string buf(1 << 20, '\0');
+    size_t len = 0;
+    for(auto _ : st)
+    {
+        CompletionIndex ix(u.usage());
+        len = complete(substr(&buf[0], buf.size()), ix, SHELL_FISH, 1, (const char**)words);
+        benchmark::DoNotOptimize(buf.data());
+    }
+    st.counters["bytes"] = (double)len;
+}
+
+BENCHMARK(index)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kNanosecond);
+BENCHMARK_CAPTURE(query, one, words_one)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kNanosecond);
+BENCHMARK_CAPTURE(query, many, words_many)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kNanosecond);
+BENCHMARK_CAPTURE(cold, one, words_one)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kNanosecond);
+BENCHMARK_CAPTURE(cold, many, words_many)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kNanosecond);
+
+
+#ifdef C4_UNIX
+void process(benchmark::State &st, const char *const* words)
+{
+    std::string num = std::to_string(st.range(0));
+    const char *argv[] = {self_path, num.c_str(), "--complete=fish", words[0], nullptr};
+    char buf[65536];
+    size_t len = 0;
+    for(auto _ : st)
+    {
+        int fds[2];
+        if(pipe(fds) != 0)
+        {
+            st.SkipWithError("pipe() failed");
+            break;
+        }
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            dup2(fds[1], 1);
+            close(fds[0]);
+            close(fds[1]);
+            execv(self_path, (char *const*)argv);
+            _exit(127);
+        }
+        close(fds[1]);
+        len = 0;
+        for(ssize_t ret; (ret = read(fds[0], buf, sizeof(buf))) > 0; )
+            len += (size_t)ret;
+        close(fds[0]);
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if( ! WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            st.SkipWithError("the completer failed");
+            break;
+        }
+    }
+    st.counters["bytes"] = (double)len;
+}
+
+BENCHMARK_CAPTURE(process, one, words_one)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(process, many, words_many)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kMicrosecond);
+#endif
+
+} // anon
+} // namespace bm
+} // namespace opt
+} // namespace c4
+
+
+int main(int argc, char *argv[])
+{
+    // the completer run by the process benchmark
+    if(argc > 2 && strncmp(argv[2], "--complete", 10) == 0)
+    {
+        c4::opt::bm::Usage u((size_t)strtoull(argv[1], nullptr, 10));
+        return c4::opt::complete_main(u.usage(), argc - 1, (const char**)argv + 1) ? 0 : 1;
+    }
+    c4::opt::bm::self_path = argv[0];
+    benchmark::Initialize(&argc, argv);
+    if(benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,244 @@
+/** @file bm_libc.cpp c4opt against the parsers in glibc: getopt_long()
+ * and argp. The struct option[] and optstring for getopt_long() and
+ * the struct argp_option[] for argp are generated from the same
+ * Descriptor table (see bm_libc_parsers.hpp), and the three parsers
+ * are given the same command lines. Besides the time, each benchmark
+ * reports the allocations and the peak of the allocated bytes during
+ * one parse, obtained by wrapping malloc() and friends.
+ *
+ * The command lines have no positional arguments, except for the
+ * _gnu variants, where half the tokens are positional arguments mixed
+ * with the options. getopt_long() and argp permute argv, so every
+ * parser gets a fresh copy of argv for each parse; this copy is
+ * included in the times.
+ *
+ * usage: c4opt-bm-libc [google benchmark flags]
+ */
+
+#include "bm_common.hpp"
+#include "bm_libc_parsers.hpp"
+#include <c4/opt/compact.hpp>
+#include <c4/opt/spec.hpp>
+#include <benchmark/benchmark.h>
+#include <errno.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <memory>
+#include <tuple>
+
+//-----------------------------------------------------------------------------
+// allocation counting. glibc lets the program interpose malloc(); the
+// replacements forward to the glibc implementation.
+
+extern "C" {
+void *__libc_malloc(size_t);
+void *__libc_calloc(size_t, size_t);
+void *__libc_realloc(void*, size_t);
+void *__libc_memalign(size_t, size_t);
+void  __libc_free(void*);
+}
+
+namespace {
+struct AllocStats
+{
+    bool   enabled;
+    size_t num_allocs;
+    size_t curr;
+    size_t peak;
+    void reset() { num_allocs = 0; curr = 0; peak = 0; }
+    void add(void *p)
+    {
+        if( ! enabled || ! p)
+            return;
+        ++num_allocs;
+        curr += malloc_usable_size(p);
+        if(curr > peak)
+            peak = curr;
+    }
+    void remove(void *p)
+    {
+        if( ! enabled || ! p)
+            return;
+        size_t sz = malloc_usable_size(p);
+        curr = sz < curr ? curr - sz : 0;
+    }
+};
+AllocStats g_allocs = {};
+} // anon
+
+extern "C" {
+void *malloc(size_t sz) { void *p = __libc_malloc(sz); g_allocs.add(p); return p; }
+void *calloc(size_t n, size_t sz) { void *p = __libc_calloc(n, sz); g_allocs.add(p); return p; }
+void *realloc(void *ptr, size_t sz)
+{
+    g_allocs.remove(ptr);
+    void *p = __libc_realloc(ptr, sz);
+    g_allocs.add(p);
+    return p;
+}
+void free(void *ptr) { g_allocs.remove(ptr); __libc_free(ptr); }
+void *aligned_alloc(size_t alignment, size_t sz) { void *p = __libc_memalign(alignment, sz); g_allocs.add(p); return p; }
+void *memalign(size_t alignment, size_t sz) { void *p = __libc_memalign(alignment, sz); g_allocs.add(p); return p; }
+int posix_memalign(void **ptr, size_t alignment, size_t sz)
+{
+    void *p = __libc_memalign(alignment, sz);
+    if( ! p)
+        return ENOMEM;
+    g_allocs.add(p);
+    *ptr = p;
+    return 0;
+}
+} // extern "C"
+
+
+namespace c4 {
+namespace opt {
+namespace bm {
+namespace {
+
+//-----------------------------------------------------------------------------
+// the specs for getopt_long() and argp, generated from a usage
+
+/** the options of a usage, as given to the glibc parsers */
+std::vector<LibcOption> libc_options(option::Descriptor const* usage)
+{
+    std::vector<LibcOption> opts;
+    for(unsigned i = 0; usage[i].shortopt != nullptr; ++i)
+    {
+        option::Descriptor const& d = usage[i];
+        if( ! d.shortopt[0] && ! d.longopt[0])
+            continue; // the unknown option
+        LibcArg_e arg = LIBC_ARG_REQUIRED;
+        if(d.check_arg == c4::opt::none || d.check_arg == option::Arg::None)
+            arg = LIBC_ARG_NONE;
+        else if(d.check_arg == c4::opt::optional || d.check_arg == option::Arg::Optional)
+            arg = LIBC_ARG_OPTIONAL;
+        opts.push_back({d.shortopt, d.longopt, arg, d.help});
+    }
+    return opts;
+}
+
+//-----------------------------------------------------------------------------
+
+Usage const& usage_for(size_t num_options)
+{
+    static std::map<size_t, std::unique_ptr<Usage>> cache;
+    auto &u = cache[num_options];
+    if( ! u)
+        u.reset(new Usage(num_options));
+    return *u;
+}
+
+/** the command line, preceded by the program name, which getopt_long()
+ * and argp skip */
+struct ProgramArgs
+{
+    CommandLine cl;
+    std::vector<char*> argv;
+    std::vector<char*> work;
+    ProgramArgs(Usage const& u, size_t num_tokens, uint32_t forms) : cl(u, num_tokens, forms)
+    {
+        static char program[] = "bm";
+        argv.push_back(program);
+        for(const char *a : cl.argv)
+            argv.push_back(const_cast<char*>(a));
+        work = argv;
+    }
+    /** a fresh copy of argv, with the program name */
+    char** fresh()
+    {
+        memcpy(work.data(), argv.data(), argv.size() * sizeof(char*));
+        return work.data();
+    }
+    /** the number of tokens, without the program name */
+    int argc() const { return cl.argc(); }
+};
+
+ProgramArgs& args_for(Usage const& u, size_t num_tokens, uint32_t forms)
+{
+    static std::map<std::tuple<Usage const*, size_t, uint32_t>, std::unique_ptr<ProgramArgs>> cache;
+    auto &a = cache[std::make_tuple(&u, num_tokens, forms)];
+    if( ! a)
+        a.reset(new ProgramArgs(u, num_tokens, forms));
+    return *a;
+}
+
+typedef enum { IMPL_C4OPT, IMPL_C4OPT_COMPACT, IMPL_GETOPT, IMPL_ARGP } Impl_e;
+
+/** parse once with the given implementation.
+ * @return the number of options, or -1 on error */
+long parse_once(Impl_e impl, bool gnu, Spec const& spec, GetoptParser const& gp, ArgpParser const& ap, ProgramArgs &a)
+{
+    char **argv = a.fresh();
+    switch(impl)
+    {
+    case IMPL_C4OPT:
+    {
+        ParseError err;
+        Parser p = make_parser(spec, a.argc(), const_cast<const char**>(argv + 1), &err);
+        return err ? -1 : (long)p.parser.optionsCount();
+    }
+    case IMPL_C4OPT_COMPACT:
+    {
+        ParseError err;
+        CompactParser p(spec, a.argc(), const_cast<const char**>(argv + 1), gnu ? PARSE_GNU : PARSE_POSIX, &err);
+        return err ? -1 : (long)p.num_occurrences();
+    }
+    case IMPL_GETOPT:
+        return gp.parse(a.argc() + 1, argv, gnu);
+    case IMPL_ARGP:
+        return ap.parse(a.argc() + 1, argv, gnu);
+    }
+    return -1;
+}
+
+void compare(benchmark::State &st, Impl_e impl, bool gnu)
+{
+    Usage const& u = usage_for((size_t)st.range(1));
+    ProgramArgs &a = args_for(u, (size_t)st.range(0), gnu ? FORM_MIXED|FORM_POSN : FORM_MIXED);
+    RuntimeSpec rs(u.usage());
+    std::vector<LibcOption> opts = libc_options(u.usage());
+    GetoptParser gp(opts.data(), opts.size());
+    ArgpParser ap(opts.data(), opts.size());
+    // one parse to get the allocations, and to check the result
+    g_allocs.reset();
+    g_allocs.enabled = true;
+    long count = parse_once(impl, gnu, rs.spec(), gp, ap, a);
+    g_allocs.enabled = false;
+    if(count < 0)
+    {
+        st.SkipWithError("parse error");
+        return;
+    }
+    const size_t num_allocs = g_allocs.num_allocs, peak = g_allocs.peak;
+    for(auto _ : st)
+        benchmark::DoNotOptimize(parse_once(impl, gnu, rs.spec(), gp, ap, a));
+    st.counters["tokens/s"] = benchmark::Counter((double)a.cl.num_tokens(), benchmark::Counter::kIsIterationInvariantRate);
+    st.counters["options"] = (double)count;
+    st.counters["allocs"] = (double)num_allocs;
+    st.counters["peak_bytes"] = (double)peak;
+}
+
+#define C4OPT_BM_COMPARE(impl, gnu, name)                                \
+    BENCHMARK_CAPTURE(compare, name, impl, gnu)                         \
+        ->ArgNames({"tokens", "descriptors"})                           \
+        ->ArgsProduct({{10, 100, 1000, 10000, 100000}, {8}})            \
+        ->ArgsProduct({{1000}, {10, 100, 1000}})                        \
+        ->Unit(benchmark::kNanosecond)
+
+C4OPT_BM_COMPARE(IMPL_C4OPT, false, c4opt);
+C4OPT_BM_COMPARE(IMPL_C4OPT_COMPACT, false, c4opt_compact);
+C4OPT_BM_COMPARE(IMPL_GETOPT, false, getopt_long);
+C4OPT_BM_COMPARE(IMPL_ARGP, false, argp);
+C4OPT_BM_COMPARE(IMPL_C4OPT_COMPACT, true, c4opt_compact_gnu);
+C4OPT_BM_COMPARE(IMPL_GETOPT, true, getopt_long_gnu);
+C4OPT_BM_COMPARE(IMPL_ARGP, true, argp_gnu);
+
+} // anon
+} // namespace bm
+} // namespace opt
+} // namespace c4
+
+BENCHMARK_MAIN();
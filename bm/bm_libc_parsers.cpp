@@ -0,0 +1,116 @@
+#include "bm_libc_parsers.hpp"
+#include <argp.h>
+#include <getopt.h>
+#include <string.h>
+
+namespace c4 {
+namespace opt {
+namespace bm {
+
+GetoptParser::GetoptParser(LibcOption const* opts, size_t num_opts)
+    : m_optstring("+:"), // POSIX mode; report missing arguments with ':'
+      m_longopts(new struct ::option[num_opts + 1])
+{
+    struct ::option *longopts = (struct ::option*) m_longopts;
+    size_t num_long = 0;
+    for(size_t i = 0; i < num_opts; ++i)
+    {
+        LibcOption const& o = opts[i];
+        for(const char *c = o.shortopts; *c; ++c)
+        {
+            m_optstring += *c;
+            if(o.arg != LIBC_ARG_NONE)
+                m_optstring += o.arg == LIBC_ARG_OPTIONAL ? "::" : ":";
+        }
+        if(o.longopt[0])
+            longopts[num_long++] = {o.longopt, o.arg == LIBC_ARG_NONE ? no_argument : (o.arg == LIBC_ARG_OPTIONAL ? optional_argument : required_argument), nullptr, int(256 + i)};
+    }
+    longopts[num_long] = {nullptr, 0, nullptr, 0};
+}
+
+GetoptParser::~GetoptParser()
+{
+    delete[] (struct ::option*) m_longopts;
+}
+
+long GetoptParser::parse(int argc, char **argv, bool gnu) const
+{
+    optind = 0; // reinitialize getopt
+    opterr = 0;
+    const char *optstring = m_optstring.c_str() + (gnu ? 1 : 0); // without '+'
+    long count = 0;
+    int c;
+    while((c = getopt_long(argc, argv, optstring, (struct ::option const*) m_longopts, nullptr)) != -1)
+    {
+        if(c == '?' || c == ':')
+            return -1;
+        ++count;
+    }
+    return count;
+}
+
+
+//-----------------------------------------------------------------------------
+
+namespace {
+struct ArgpInput
+{
+    long num_options;
+    long num_posn;
+};
+error_t argp_parse_opt(int key, char *, struct argp_state *state)
+{
+    ArgpInput *in = (ArgpInput*) state->input;
+    if(key == ARGP_KEY_ARG)
+        ++in->num_posn;
+    else if(key > 0 && key < 0x1000000)
+        ++in->num_options;
+    else
+        return ARGP_ERR_UNKNOWN;
+    return 0;
+}
+} // anon
+
+ArgpParser::ArgpParser(LibcOption const* opts, size_t num_opts)
+    : m_options(nullptr),
+      m_argp(new struct argp)
+{
+    size_t num_entries = 1;
+    for(size_t i = 0; i < num_opts; ++i)
+        num_entries += opts[i].shortopts[0] ? strlen(opts[i].shortopts) : 1u;
+    m_options = new struct argp_option[num_entries];
+    size_t pos = 0;
+    for(size_t i = 0; i < num_opts; ++i)
+    {
+        LibcOption const& o = opts[i];
+        int key = o.shortopts[0] ? (unsigned char)o.shortopts[0] : int(256 + i);
+        m_options[pos++] = {o.longopt[0] ? o.longopt : nullptr, key, o.arg == LIBC_ARG_NONE ? nullptr : "VAL",
+                            o.arg == LIBC_ARG_OPTIONAL ? OPTION_ARG_OPTIONAL : 0, o.help, 0};
+        // the other short options are aliases
+        for(const char *c = o.shortopts[0] ? o.shortopts + 1 : o.shortopts; *c; ++c)
+            m_options[pos++] = {nullptr, (unsigned char)*c, nullptr, OPTION_ALIAS, nullptr, 0};
+    }
+    m_options[pos] = {nullptr, 0, nullptr, 0, nullptr, 0};
+    memset(m_argp, 0, sizeof(*m_argp));
+    m_argp->options = m_options;
+    m_argp->parser = &argp_parse_opt;
+}
+
+ArgpParser::~ArgpParser()
+{
+    delete[] m_options;
+    delete m_argp;
+}
+
+long ArgpParser::parse(int argc, char **argv, bool gnu) const
+{
+    ArgpInput in = {0, 0};
+    unsigned flags = ARGP_SILENT | (gnu ? 0u : (unsigned)ARGP_IN_ORDER);
+    if(argp_parse(m_argp, argc, argv, flags, nullptr, &in) != 0)
+        return -1;
+    return in.num_options;
+}
+
+} // namespace bm
+} // namespace opt
+} // namespace c4
@@ -0,0 +1,71 @@
+#ifndef _C4_OPT_BM_LIBC_PARSERS_HPP_
+#define _C4_OPT_BM_LIBC_PARSERS_HPP_
+
+/** @file bm_libc_parsers.hpp getopt_long() and argp, set up from the
+ * options of a c4opt usage. This is kept apart from the c4opt headers
+ * because <getopt.h> declares a global struct option, which clashes
+ * with the option namespace of the descriptors. */
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+struct argp;
+struct argp_option;
+
+namespace c4 {
+namespace opt {
+namespace bm {
+
+typedef enum { LIBC_ARG_NONE, LIBC_ARG_OPTIONAL, LIBC_ARG_REQUIRED } LibcArg_e;
+
+/** an option, as described by a Descriptor */
+struct LibcOption
+{
+    const char *shortopts;  ///< the short option characters; may be empty
+    const char *longopt;    ///< the long option; may be empty
+    LibcArg_e   arg;
+    const char *help;
+};
+
+/** getopt_long(), with the optstring and struct option[] generated
+ * from the options. Long options are given a value of 256 + their
+ * position in the options. */
+class GetoptParser
+{
+public:
+    GetoptParser(LibcOption const* opts, size_t num_opts);
+    ~GetoptParser();
+    GetoptParser(GetoptParser const&) = delete;
+    GetoptParser& operator= (GetoptParser const&) = delete;
+    /** parse argv, which starts with the program name, and is permuted
+     * in GNU mode. @return the number of options, or -1 on error */
+    long parse(int argc, char **argv, bool gnu) const;
+private:
+    std::string m_optstring;
+    void *m_longopts;  ///< the struct option[], which cannot be named here
+};
+
+/** argp_parse(), with the struct argp_option[] generated from the
+ * options. Options without a short option are given a key of 256 +
+ * their position in the options. */
+class ArgpParser
+{
+public:
+    ArgpParser(LibcOption const* opts, size_t num_opts);
+    ~ArgpParser();
+    ArgpParser(ArgpParser const&) = delete;
+    ArgpParser& operator= (ArgpParser const&) = delete;
+    /** parse argv, which starts with the program name, and is permuted
+     * in GNU mode. @return the number of options, or -1 on error */
+    long parse(int argc, char **argv, bool gnu) const;
+private:
+    struct argp_option *m_options;
+    struct argp *m_argp;
+};
+
+} // namespace bm
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_BM_LIBC_PARSERS_HPP_ */
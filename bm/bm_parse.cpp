@@ -0,0 +1,352 @@
+/** @file bm_parse.cpp throughput and latency of the parsers, along
+ * each dimension of the parse:
+ *
+ *   - argv_length: the number of tokens, 10 to 10M
+ *   - table_size: the number of descriptors, 10 to 10k, with and
+ *     without the lookup tables of a compiled spec
+ *   - forms: short, long and abbreviated options
+ *   - mode: POSIX vs GNU, ie positional arguments mixed with the options
+ *   - checker: the cost of the argument checkers
+ *   - iterate: count() and opts(i) on the results
+ *   - help: rendering the help, first and cached
+ *
+ * Each benchmark reports the time per parse (in ns), and the
+ * tokens/s. Along argv_length, table_size, mode and help, the times
+ * are also fitted to a complexity (the BigO and RMS rows); the tests
+ * in test_complexity.cpp check the growth of the operation counts,
+ * which unlike the times do not depend on the machine. This uses
+ * google benchmark, so the usual flags apply, eg for JSON output, to
+ * track regressions:
+ *
+ *   c4opt-bm-parse --benchmark_format=json --benchmark_out=parse.json
+ *   c4opt-bm-parse --benchmark_filter=argv_length
+ */
+
+#include "bm_common.hpp"
+#include <c4/opt/compact.hpp>
+#include <c4/opt/help.hpp>
+#include <c4/opt/spec.hpp>
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <tuple>
+
+namespace c4 {
+namespace opt {
+namespace bm {
+namespace {
+
+/** the usages and command lines are generated once for each size */
+Usage const& usage_for(size_t num_options, option::CheckArg checker=c4::opt::required)
+{
+    static std::map<std::pair<size_t, option::CheckArg>, std::unique_ptr<Usage>> cache;
+    auto &u = cache[{num_options, checker}];
+    if( ! u)
+        u.reset(new Usage(num_options, checker));
+    return *u;
+}
+
+CommandLine const& cmdline_for(Usage const& u, size_t num_tokens, uint32_t forms)
+{
+    static std::map<std::tuple<Usage const*, size_t, uint32_t>, std::unique_ptr<CommandLine>> cache;
+    auto &cl = cache[std::make_tuple(&u, num_tokens, forms)];
+    if( ! cl)
+        cl.reset(new CommandLine(u, num_tokens, forms));
+    return *cl;
+}
+
+void report(benchmark::State &st, size_t num_tokens)
+{
+    st.counters["tokens/s"] = benchmark::Counter((double)num_tokens, benchmark::Counter::kIsIterationInvariantRate);
+    st.counters["tokens"] = (double)num_tokens;
+}
+
+void check(benchmark::State &st, ParseError const& err)
+{
+    if(err)
+        st.SkipWithError("parse error");
+}
+
+
+//-----------------------------------------------------------------------------
+// argv length
+
+void argv_length_parser(benchmark::State &st)
+{
+    Usage const& u = usage_for(8);
+    CommandLine const& cl = cmdline_for(u, (size_t)st.range(0), FORM_MIXED);
+    ParseError err;
+    for(auto _ : st)
+    {
+        Parser p = make_parser(u.usage(), u.size(), cl.argc(), const_cast<const char**>(cl.argv.data()), &err);
+        benchmark::DoNotOptimize(p.options);
+    }
+    check(st, err);
+    report(st, cl.num_tokens());
+    st.SetComplexityN(st.range(0));
+}
+
+void argv_length_spec(benchmark::State &st)
+{
+    Usage const& u = usage_for(8);
+    CommandLine const& cl = cmdline_for(u, (size_t)st.range(0), FORM_MIXED);
+    RuntimeSpec rs(u.usage());
+    ParseError err;
+    for(auto _ : st)
+    {
+        Parser p = make_parser(rs.spec(), cl.argc(), const_cast<const char**>(cl.argv.data()), &err);
+        benchmark::DoNotOptimize(p.options);
+    }
+    check(st, err);
+    report(st, cl.num_tokens());
+    st.SetComplexityN(st.range(0));
+}
+
+void argv_length_compact(benchmark::State &st)
+{
+    Usage const& u = usage_for(8);
+    CommandLine const& cl = cmdline_for(u, (size_t)st.range(0), FORM_MIXED);
+    RuntimeSpec rs(u.usage());
+    ParseError err;
+    for(auto _ : st)
+    {
+        CompactParser p(rs.spec(), cl.argc(), cl.argv.data(), PARSE_POSIX, &err);
+        benchmark::DoNotOptimize(p.occurrences());
+    }
+    check(st, err);
+    report(st, cl.num_tokens());
+    st.SetComplexityN(st.range(0));
+}
+
+BENCHMARK(argv_length_parser)->RangeMultiplier(10)->Range(10, 10000000)->Unit(benchmark::kNanosecond)->Complexity();
+BENCHMARK(argv_length_spec)->RangeMultiplier(10)->Range(10, 10000000)->Unit(benchmark::kNanosecond)->Complexity();
+BENCHMARK(argv_length_compact)->RangeMultiplier(10)->Range(10, 10000000)->Unit(benchmark::kNanosecond)->Complexity();
+
+
+//-----------------------------------------------------------------------------
+// descriptor table size
+
+void table_size_usage(benchmark::State &st)
+{
+    Usage const& u = usage_for((size_t)st.range(0));
+    CommandLine const& cl = cmdline_for(u, 1000, FORM_LONG);
+    ParseError err;
+    for(auto _ : st)
+    {
+        Parser p = make_parser(u.usage(), u.size(), cl.argc(), const_cast<const char**>(cl.argv.data()), &err);
+        benchmark::DoNotOptimize(p.options);
+    }
+    check(st, err);
+    report(st, cl.num_tokens());
+    st.SetComplexityN(st.range(0));
+}
+
+void table_size_spec(benchmark::State &st)
+{
+    Usage const& u = usage_for((size_t)st.range(0));
+    CommandLine const& cl = cmdline_for(u, 1000, FORM_LONG);
+    RuntimeSpec rs(u.usage());
+    ParseError err;
+    for(auto _ : st)
+    {
+        Parser p = make_parser(rs.spec(), cl.argc(), const_cast<const char**>(cl.argv.data()), &err);
+        benchmark::DoNotOptimize(p.options);
+    }
+    check(st, err);
+    report(st, cl.num_tokens());
+    st.SetComplexityN(st.range(0));
+}
+
+/** the cost of compiling the spec, to be paid once per table */
+void table_size_compile(benchmark::State &st)
+{
+    Usage const& u = usage_for((size_t)st.range(0));
+    for(auto _ : st)
+    {
+        RuntimeSpec rs(u.usage());
+        benchmark::DoNotOptimize(rs.spec().index.longopt);
+    }
+    st.SetComplexityN(st.range(0));
+}
+
+BENCHMARK(table_size_usage)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kNanosecond)->Complexity();
+BENCHMARK(table_size_spec)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kNanosecond)->Complexity();
+BENCHMARK(table_size_compile)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kNanosecond)->Complexity();
+
+
+//-----------------------------------------------------------------------------
+// short/long/abbreviated options. Abbreviations are matched only by
+// the underlying parser, with min_abbr_len, so all the forms use it.
+
+void forms(benchmark::State &st, uint32_t forms)
+{
+    Usage const& u = usage_for(32);
+    CommandLine const& cl = cmdline_for(u, 1000, forms);
+    option::Stats stats(u.usage(), cl.argc(), const_cast<const char**>(cl.argv.data()), /*min_abbr_len*/2);
+    std::vector<option::Option> options(stats.options_max), buffer(stats.buffer_max);
+    for(auto _ : st)
+    {
+        // the parser appends after the options already in the buffer
+        std::fill(options.begin(), options.end(), option::Option());
+        std::fill(buffer.begin(), buffer.end(), option::Option());
+        option::Parser p(/*gnu*/false, u.usage(), cl.argc(), const_cast<const char**>(cl.argv.data()), options.data(), buffer.data(), /*min_abbr_len*/2);
+        if(p.error())
+            st.SkipWithError("parse error");
+        benchmark::DoNotOptimize(p.optionsCount());
+    }
+    report(st, cl.num_tokens());
+}
+
+BENCHMARK_CAPTURE(forms, short, FORM_SHORT)->Unit(benchmark::kNanosecond);
+BENCHMARK_CAPTURE(forms, long, FORM_LONG)->Unit(benchmark::kNanosecond);
+BENCHMARK_CAPTURE(forms, abbrev, FORM_ABBREV)->Unit(benchmark::kNanosecond);
+BENCHMARK_CAPTURE(forms, mixed, FORM_SHORT|FORM_LONG|FORM_ABBREV)->Unit(benchmark::kNanosecond);
+
+
+//-----------------------------------------------------------------------------
+// POSIX vs GNU. In GNU mode, half the tokens are positional arguments
+// mixed with the options; in POSIX mode there are none.
+
+void mode_compact(benchmark::State &st, ParseMode_e mode)
+{
+    Usage const& u = usage_for(8);
+    CommandLine const& cl = cmdline_for(u, (size_t)st.range(0), mode == PARSE_GNU ? FORM_MIXED|FORM_POSN : FORM_MIXED);
+    RuntimeSpec rs(u.usage());
+    ParseError err;
+    for(auto _ : st)
+    {
+        CompactParser p(rs.spec(), cl.argc(), cl.argv.data(), mode, &err);
+        benchmark::DoNotOptimize(p.occurrences());
+    }
+    check(st, err);
+    report(st, cl.num_tokens());
+    st.SetComplexityN(st.range(0));
+}
+
+/** the underlying parser permutes argv in GNU mode, so each parse
+ * gets a fresh copy; the copy is done in both modes */
+void mode_permuting(benchmark::State &st, bool gnu)
+{
+    Usage const& u = usage_for(8);
+    CommandLine const& cl = cmdline_for(u, (size_t)st.range(0), gnu ? FORM_MIXED|FORM_POSN : FORM_MIXED);
+    RuntimeSpec rs(u.usage());
+    option::Stats stats(gnu, u.usage(), cl.argc(), const_cast<const char**>(cl.argv.data()));
+    std::vector<option::Option> options(stats.options_max), buffer(stats.buffer_max);
+    std::vector<const char*> argv(cl.argv.size());
+    for(auto _ : st)
+    {
+        memcpy(argv.data(), cl.argv.data(), argv.size() * sizeof(const char*));
+        std::fill(options.begin(), options.end(), option::Option());
+        std::fill(buffer.begin(), buffer.end(), option::Option());
+        option::Parser p(gnu, u.usage(), cl.argc(), argv.data(), options.data(), buffer.data(), 0, false, -1, &rs.spec().index, false);
+        if(p.error())
+            st.SkipWithError("parse error");
+        benchmark::DoNotOptimize(p.optionsCount());
+    }
+    report(st, cl.num_tokens());
+    st.SetComplexityN(st.range(0));
+}
+
+BENCHMARK_CAPTURE(mode_compact, posix, PARSE_POSIX)->RangeMultiplier(10)->Range(100, 100000)->Unit(benchmark::kNanosecond)->Complexity();
+BENCHMARK_CAPTURE(mode_compact, gnu, PARSE_GNU)->RangeMultiplier(10)->Range(100, 100000)->Unit(benchmark::kNanosecond)->Complexity();
+BENCHMARK_CAPTURE(mode_permuting, posix, false)->RangeMultiplier(10)->Range(100, 100000)->Unit(benchmark::kNanosecond)->Complexity();
+BENCHMARK_CAPTURE(mode_permuting, gnu, true)->RangeMultiplier(10)->Range(100, 100000)->Unit(benchmark::kNanosecond)->Complexity();
+
+
+//-----------------------------------------------------------------------------
+// checker cost. Half the options take an argument, which goes through
+// the checker.
+
+void checker(benchmark::State &st, option::CheckArg chk)
+{
+    Usage const& u = usage_for(32, chk);
+    CommandLine const& cl = cmdline_for(u, 1000, FORM_LONG);
+    RuntimeSpec rs(u.usage());
+    ParseError err;
+    for(auto _ : st)
+    {
+        Parser p = make_parser(rs.spec(), cl.argc(), const_cast<const char**>(cl.argv.data()), &err);
+        benchmark::DoNotOptimize(p.options);
+    }
+    check(st, err);
+    report(st, cl.num_tokens());
+}
+
+BENCHMARK_CAPTURE(checker, optional, c4::opt::optional)->Unit(benchmark::kNanosecond);
+BENCHMARK_CAPTURE(checker, required, c4::opt::required)->Unit(benchmark::kNanosecond);
+BENCHMARK_CAPTURE(checker, integer, c4::opt::integer)->Unit(benchmark::kNanosecond);
+BENCHMARK_CAPTURE(checker, number, bm_number)->Unit(benchmark::kNanosecond);
+
+
+//-----------------------------------------------------------------------------
+// iterating the results
+
+void iterate_count(benchmark::State &st)
+{
+    Usage const& u = usage_for(32);
+    CommandLine const& cl = cmdline_for(u, (size_t)st.range(0), FORM_MIXED);
+    Parser p = make_parser(u.usage(), u.size(), cl.argc(), const_cast<const char**>(cl.argv.data()));
+    for(auto _ : st)
+    {
+        int total = 0;
+        for(size_t i = 0; i <= u.num_options(); ++i)
+            total += p[(int)i].count();
+        benchmark::DoNotOptimize(total);
+    }
+    report(st, cl.num_tokens());
+}
+
+void iterate_opts(benchmark::State &st)
+{
+    Usage const& u = usage_for(32);
+    CommandLine const& cl = cmdline_for(u, (size_t)st.range(0), FORM_MIXED);
+    Parser p = make_parser(u.usage(), u.size(), cl.argc(), const_cast<const char**>(cl.argv.data()));
+    for(auto _ : st)
+    {
+        size_t total = 0;
+        for(size_t i = 0; i <= u.num_options(); ++i)
+            for(option::Option const& o : p.opts((int)i))
+                total += (size_t)o.namelen;
+        benchmark::DoNotOptimize(total);
+    }
+    report(st, cl.num_tokens());
+}
+
+BENCHMARK(iterate_count)->RangeMultiplier(10)->Range(100, 100000)->Unit(benchmark::kNanosecond);
+BENCHMARK(iterate_opts)->RangeMultiplier(10)->Range(100, 100000)->Unit(benchmark::kNanosecond);
+
+
+//-----------------------------------------------------------------------------
+// help rendering
+
+void help_first(benchmark::State &st)
+{
+    Usage const& u = usage_for((size_t)st.range(0));
+    for(auto _ : st)
+    {
+        clear_help_cache();
+        benchmark::DoNotOptimize(help_text(u.usage(), 80).str);
+    }
+    st.counters["descriptors"] = (double)u.num_options();
+    st.SetComplexityN(st.range(0));
+}
+
+void help_cached(benchmark::State &st)
+{
+    Usage const& u = usage_for((size_t)st.range(0));
+    help_text(u.usage(), 80);
+    for(auto _ : st)
+        benchmark::DoNotOptimize(help_text(u.usage(), 80).str);
+    st.counters["descriptors"] = (double)u.num_options();
+}
+
+BENCHMARK(help_first)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kNanosecond)->Complexity();
+BENCHMARK(help_cached)->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kNanosecond);
+
+} // anon
+} // namespace bm
+} // namespace opt
+} // namespace c4
+
+BENCHMARK_MAIN();
@@ -0,0 +1,390 @@
+/** @file bm_replay.cpp replay recorded command lines through
+ * c4::opt::make_parser(), to measure the shapes found in production
+ * rather than generated ones.
+ *
+ * usage: c4opt-replay [-n <repeat>] [-k <slowest>] [-f nul|len] -s <spec-file> <corpus>... [-s <spec-file> <corpus>...]
+ *
+ * Each corpus file is parsed with the spec given before it. The spec
+ * files have the format of c4opt-specgen (see tools/specgen.cpp); the
+ * checkers must be among the c4::opt checkers. The corpus formats are:
+ *
+ * - nul (the default): the file is one command line, with each token
+ *   terminated by a NUL, as in /proc/<pid>/cmdline. So the dumps can
+ *   be given directly, eg `c4opt-replay -s app.spec /proc/[0-9]*\/cmdline`.
+ * - len: the file has any number of command lines. Each is written as
+ *   `<num_tokens>:` followed by each token as `<len>:<bytes>`, eg
+ *   `3:3:app2:-v4:file`. Whitespace between command lines is ignored.
+ *
+ * In both formats, the first token of a command line is the program
+ * name, which is not given to the parser.
+ *
+ * Each command line is parsed repeat times (default 101), and its time
+ * is the median of those. The command lines are grouped by shape: the
+ * dominant kind of token (options, positional arguments, options
+ * repeated many times, or long values) and the number of tokens. The
+ * percentiles of the time per token are reported for each shape,
+ * followed by the slowest command lines. */
+
+#include "spec_file.hpp"
+#include <c4/opt/help.hpp>
+#include <c4/opt/opt.hpp>
+#include <c4/opt/spec.hpp>
+#include <c4/opt/tokenizer.hpp>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+using namespace c4::opt::tools;
+
+typedef enum {
+    UNKNOWN,
+    HELP,
+    REPEAT,
+    SLOWEST,
+    FORMAT,
+    SPEC,
+} ReplayIndex_e;
+const option::Descriptor replay_usage[] =
+{
+    {UNKNOWN, 0, ""  , ""       , c4::opt::unknown , "USAGE: c4opt-replay [options] -s <spec-file> <corpus>... [-s <spec-file> <corpus>...]\n\nOptions:" },
+    {HELP   , 0, "h" , "help"   , c4::opt::none    , "  -h, --help  \tPrint usage and exit." },
+    {REPEAT , 0, "n" , "repeat" , c4::opt::integer , "  -n <num>, --repeat=<num>  \tParse each command line this many times. Default: 101." },
+    {SLOWEST, 0, "k" , "slowest", c4::opt::integer , "  -k <num>, --slowest=<num>  \tReport this many of the slowest command lines. Default: 10." },
+    {FORMAT , 0, "f" , "format" , c4::opt::required, "  -f <fmt>, --format=<fmt>  \tThe format of the corpus files which follow: nul (default) or len." },
+    {SPEC   , 0, "s" , "spec"   , c4::opt::required, "  -s <file>, --spec=<file>  \tThe spec for the corpus files which follow." },
+    {0,0,0,0,0,0}
+};
+
+
+//-----------------------------------------------------------------------------
+
+/** a spec file, loaded to be used at runtime */
+struct LoadedSpec
+{
+    std::string name;
+    SpecFile file;
+    std::vector<option::Descriptor> usage;
+    std::unique_ptr<c4::opt::RuntimeSpec> rt;
+};
+
+option::CheckArg runtime_checker(std::string const& name)
+{
+    static const struct { const char *name; option::CheckArg fn; } checkers[] = {
+        {"c4::opt::unknown" , c4::opt::unknown},
+        {"c4::opt::none"    , c4::opt::none},
+        {"c4::opt::optional", c4::opt::optional},
+        {"c4::opt::required", c4::opt::required},
+        {"c4::opt::nonempty", c4::opt::nonempty},
+        {"c4::opt::integer" , c4::opt::integer},
+    };
+    for(auto const& c : checkers)
+        if(name == c.name)
+            return c.fn;
+    return nullptr;
+}
+
+std::unique_ptr<LoadedSpec> load_spec(const char *filename)
+{
+    std::unique_ptr<LoadedSpec> ls(new LoadedSpec);
+    ls->name = filename;
+    ls->file = read_spec(filename);
+    // the indices, as assigned by c4opt-specgen
+    std::vector<std::string> names;
+    for(Entry const& e : ls->file.entries)
+    {
+        unsigned idx = 0;
+        while(idx < names.size() && names[idx] != e.index)
+            ++idx;
+        if(idx == names.size())
+            names.push_back(e.index);
+        option::CheckArg check = runtime_checker(e.check);
+        if( ! check)
+            fail(filename, 0, ("checker not available at runtime: " + e.check).c_str());
+        ls->usage.push_back(option::Descriptor{idx, (int)strtol(e.type.c_str(), nullptr, 0),
+                                               e.shortopt.c_str(), e.longopt.c_str(), check,
+                                               e.has_help ? e.help.c_str() : nullptr});
+    }
+    ls->usage.push_back(option::Descriptor{0, 0, 0, 0, 0, 0});
+    ls->rt.reset(new c4::opt::RuntimeSpec(ls->usage.data()));
+    return ls;
+}
+
+
+//-----------------------------------------------------------------------------
+
+/** a recorded command line, without the program name */
+struct Record
+{
+    LoadedSpec const* spec;
+    std::string origin;
+    std::vector<std::string> tokens;
+    // the results
+    std::string shape;
+    size_t bytes;
+    bool failed;
+    double ns;  ///< the median time of a parse
+    double ns_per_token() const { return tokens.empty() ? ns : ns / (double)tokens.size(); }
+};
+
+bool read_file(const char *filename, std::string *contents)
+{
+    FILE *f = fopen(filename, "rb");
+    if( ! f)
+        return false;
+    char buf[4096];
+    size_t n;
+    contents->clear();
+    while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        contents->append(buf, n);
+    fclose(f);
+    return true;
+}
+
+void add_record(LoadedSpec const* spec, std::string origin, std::vector<std::string> tokens, std::vector<Record> *records)
+{
+    if(tokens.empty())
+        return; // eg the cmdline of a kernel thread
+    tokens.erase(tokens.begin()); // the program name
+    records->push_back(Record{spec, std::move(origin), std::move(tokens), {}, 0, false, 0.});
+}
+
+void read_nul(LoadedSpec const* spec, const char *filename, std::string const& contents, std::vector<Record> *records)
+{
+    std::vector<std::string> tokens;
+    for(size_t pos = 0; pos < contents.size(); )
+    {
+        size_t end = contents.find('\0', pos);
+        if(end == std::string::npos)
+            end = contents.size(); // the last NUL is missing
+        tokens.emplace_back(contents, pos, end - pos);
+        pos = end + 1;
+    }
+    add_record(spec, filename, std::move(tokens), records);
+}
+
+void read_len(LoadedSpec const* spec, const char *filename, std::string const& contents, std::vector<Record> *records)
+{
+    const char *s = contents.c_str(), *e = s + contents.size();
+    auto number = [&](int line) -> size_t {
+        if(s == e || *s < '0' || *s > '9')
+            fail(filename, line, "expected a number");
+        size_t n = 0;
+        while(s < e && *s >= '0' && *s <= '9')
+            n = 10 * n + (size_t)(*s++ - '0');
+        if(s == e || *s != ':')
+            fail(filename, line, "expected ':' after a number");
+        ++s;
+        return n;
+    };
+    for(int rec = 1; ; ++rec)
+    {
+        while(s < e && (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n'))
+            ++s;
+        if(s == e)
+            break;
+        // report the index of the command line in place of the line
+        size_t num_tokens = number(rec);
+        std::vector<std::string> tokens;
+        for(size_t i = 0; i < num_tokens; ++i)
+        {
+            size_t len = number(rec);
+            if(len > (size_t)(e - s))
+                fail(filename, rec, "token extends past the end of the file");
+            tokens.emplace_back(s, len);
+            s += len;
+        }
+        add_record(spec, std::string(filename) + ":" + std::to_string(rec), std::move(tokens), records);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+const char* size_class(size_t num_tokens)
+{
+    if(num_tokens <= 8)    return "1-8";
+    if(num_tokens <= 64)   return "9-64";
+    if(num_tokens <= 512)  return "65-512";
+    if(num_tokens <= 4096) return "513-4096";
+    return ">4096";
+}
+
+/** parse the record once, to check it and to find its shape */
+void classify(Record *r, std::vector<const char*> const& argv)
+{
+    c4::opt::ParseError err;
+    c4::opt::Parser p = c4::opt::make_parser(r->spec->rt->spec(), (int)r->tokens.size(), const_cast<const char**>(argv.data()), &err);
+    r->failed = (bool)err;
+    size_t max_len = 0;
+    r->bytes = 0;
+    for(std::string const& t : r->tokens)
+    {
+        r->bytes += t.size();
+        max_len = std::max(max_len, t.size());
+    }
+    const size_t num_opts = (size_t)p.parser.optionsCount();
+    const size_t num_posn = (size_t)p.parser.nonOptionsCount();
+    size_t most_repeated = 0;
+    for(option::Option const& o : p.opts())
+        most_repeated = std::max(most_repeated, (size_t)o.count());
+    const char *kind = "options";
+    if(max_len >= 1024 || (r->tokens.size() && r->bytes / r->tokens.size() >= 64))
+        kind = "long-values";
+    else if(most_repeated >= 8 && 2 * most_repeated >= num_opts)
+        kind = "repeated";
+    else if(num_posn > num_opts)
+        kind = "positional";
+    r->shape = std::string(kind) + "/" + size_class(r->tokens.size());
+}
+
+void measure(Record *r, size_t repeat)
+{
+    std::vector<const char*> argv;
+    argv.reserve(r->tokens.size() + 1);
+    for(std::string const& t : r->tokens)
+        argv.push_back(t.c_str());
+    argv.push_back(nullptr);
+    classify(r, argv);
+    auto sample = [&](size_t batch){
+        auto start = std::chrono::steady_clock::now();
+        for(size_t i = 0; i < batch; ++i)
+        {
+            c4::opt::ParseError err;
+            c4::opt::Parser p = c4::opt::make_parser(r->spec->rt->spec(), (int)r->tokens.size(), argv.data(), &err);
+            (void)p;
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (double)batch;
+    };
+    // the short command lines are parsed in batches, so that each
+    // sample is well above the resolution of the clock
+    double estimate = std::max(1., sample(1));
+    size_t batch = (size_t)std::min(1000., std::max(1., 2000. / estimate));
+    std::vector<double> times(repeat);
+    for(double &t : times)
+        t = sample(batch);
+    std::nth_element(times.begin(), times.begin() + (ptrdiff_t)(repeat / 2), times.end());
+    r->ns = times[repeat / 2];
+}
+
+double percentile(std::vector<double> const& sorted, double p)
+{
+    size_t i = (size_t)(p * (double)(sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+void report(std::vector<Record> const& records, size_t num_slowest)
+{
+    std::map<std::string, std::vector<Record const*>> shapes;
+    size_t num_failed = 0;
+    for(Record const& r : records)
+    {
+        shapes[r.shape].push_back(&r);
+        num_failed += r.failed;
+    }
+    printf("%zu command lines, %zu with parse errors\n\n", records.size(), num_failed);
+    printf("percentiles of the time per token (ns), for each shape:\n");
+    printf("%-22s %8s %10s %10s %10s %10s %12s\n", "shape", "count", "p50", "p90", "p99", "max", "Mtokens/s");
+    for(auto const& s : shapes)
+    {
+        std::vector<double> per_token;
+        double ns = 0, tokens = 0;
+        for(Record const* r : s.second)
+        {
+            per_token.push_back(r->ns_per_token());
+            ns += r->ns;
+            tokens += (double)r->tokens.size();
+        }
+        std::sort(per_token.begin(), per_token.end());
+        printf("%-22s %8zu %10.2f %10.2f %10.2f %10.2f %12.1f\n", s.first.c_str(), s.second.size(),
+               percentile(per_token, 0.5), percentile(per_token, 0.9), percentile(per_token, 0.99), per_token.back(),
+               ns > 0 ? 1e3 * tokens / ns : 0.);
+    }
+    // the slowest for their size
+    std::vector<Record const*> slowest;
+    for(Record const& r : records)
+        slowest.push_back(&r);
+    num_slowest = std::min(num_slowest, slowest.size());
+    std::partial_sort(slowest.begin(), slowest.begin() + (ptrdiff_t)num_slowest, slowest.end(),
+                      [](Record const* l, Record const* r){ return l->ns_per_token() > r->ns_per_token(); });
+    printf("\nslowest command lines:\n");
+    printf("%10s %12s %8s %10s  %-22s %s\n", "ns/token", "ns", "tokens", "bytes", "shape", "origin");
+    for(size_t i = 0; i < num_slowest; ++i)
+    {
+        Record const& r = *slowest[i];
+        printf("%10.2f %12.0f %8zu %10zu  %-22s %s%s\n", r.ns_per_token(), r.ns, r.tokens.size(), r.bytes,
+               r.shape.c_str(), r.origin.c_str(), r.failed ? " (parse error)" : "");
+    }
+}
+
+} // anon
+
+
+int main(int argc, const char *argv[])
+{
+    c4::opt::RuntimeSpec rs(replay_usage);
+    c4::opt::Tokenizer tk(rs.spec(), argc - 1, argv + 1, c4::opt::PARSE_GNU);
+    std::vector<std::unique_ptr<LoadedSpec>> specs;
+    std::vector<Record> records;
+    size_t repeat = 101, num_slowest = 10;
+    bool len_format = false;
+    std::string contents;
+    for(c4::opt::Token const& t : tk)
+    {
+        if(t.kind == c4::opt::TOKEN_POSITIONAL)
+        {
+            if(specs.empty())
+                fail(t.arg, 0, "no spec was given for this corpus file");
+            if( ! read_file(t.arg, &contents))
+                fail(t.arg, 0, "could not open file");
+            if(len_format)
+                read_len(specs.back().get(), t.arg, contents, &records);
+            else
+                read_nul(specs.back().get(), t.arg, contents, &records);
+            continue;
+        }
+        switch(t.option.index())
+        {
+        case HELP:
+            c4::opt::print_help(replay_usage);
+            return 0;
+        case REPEAT:
+            repeat = (size_t)std::max(1l, atol(t.option.arg));
+            break;
+        case SLOWEST:
+            num_slowest = (size_t)std::max(0l, atol(t.option.arg));
+            break;
+        case FORMAT:
+            if(strcmp(t.option.arg, "nul") != 0 && strcmp(t.option.arg, "len") != 0)
+                fail(t.option.arg, 0, "unknown corpus format: must be nul or len");
+            len_format = (t.option.arg[0] == 'l');
+            break;
+        case SPEC:
+            specs.push_back(load_spec(t.option.arg));
+            break;
+        }
+    }
+    if(tk.error())
+    {
+        char buf[256];
+        c4::opt::format_error(buf, tk.error(), replay_usage, argc - 1, argv + 1);
+        fprintf(stderr, "error: %s\n", buf);
+        return 1;
+    }
+    if(records.empty())
+    {
+        c4::opt::print_help(replay_usage);
+        return 1;
+    }
+    for(Record &r : records)
+        measure(&r, repeat);
+    report(records, num_slowest);
+    return 0;
+}
@@ -0,0 +1,136 @@
+/** @file bm_rss.cpp report the peak resident memory used to parse
+ * command lines of increasing length, with Parser and CompactParser.
+ *
+ * usage: c4opt-bm-rss [max_tokens=4194304]
+ *
+ * Each measurement is done in a fresh child process, because the peak
+ * RSS of a process never decreases. The reported delta is the growth of
+ * the peak RSS during the parse, ie it excludes the argv strings. */
+
+#include <c4/opt/compact.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifdef C4_UNIX
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+typedef enum {
+    UNKNOWN,
+    LEVEL,
+    NAME,
+    VERBOSE,
+} RssIndex_e;
+const option::Descriptor rss_usage[] =
+{
+    {UNKNOWN, 0, ""  , ""       , c4::opt::unknown , "USAGE: bm [options]\n\nOptions:" },
+    {LEVEL  , 0, "l" , "level"  , c4::opt::integer , "  -l <val>, --level=<val>  \tSet the level." },
+    {NAME   , 0, "n" , "name"   , c4::opt::required, "  -n <val>, --name=<val>  \tSet the name." },
+    {VERBOSE, 0, "v" , "verbose", c4::opt::none    , "  -v, --verbose  \tBe verbose." },
+    {0,0,0,0,0,0}
+};
+
+/** a command line with num_tokens tokens, mixing the option forms */
+struct CommandLine
+{
+    std::string chars;
+    std::vector<const char*> argv;
+    explicit CommandLine(size_t num_tokens)
+    {
+        static const char *const forms[] = {"-v", "--level=123", "-l", "45", "--name=foo", "-vvn", "bar"};
+        for(size_t i = 0; i < num_tokens; ++i)
+        {
+            const char *tok = forms[i % C4_COUNTOF(forms)];
+            if(i + 1 == num_tokens && tok[0] == '-' && tok[1] != '-' && tok[strlen(tok) - 1] != 'v')
+                tok = "-v"; // do not end with an option missing its argument
+            chars.append(tok);
+            chars.push_back('\0');
+        }
+        // no temporary buffers: freed memory would hide the growth of the peak RSS
+        argv.reserve(num_tokens + 1);
+        for(size_t off = 0; off < chars.size(); off += strlen(chars.data() + off) + 1)
+            argv.push_back(chars.data() + off);
+        argv.push_back(nullptr);
+    }
+    int argc() const { return (int)argv.size() - 1; }
+};
+
+#ifdef C4_UNIX
+long peak_rss_kb()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    #ifdef __APPLE__
+    return ru.ru_maxrss / 1024; // bytes
+    #else
+    return ru.ru_maxrss; // kilobytes
+    #endif
+}
+
+void measure(const char *mode, size_t num_tokens)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        CommandLine cl(num_tokens);
+        long before = peak_rss_kb();
+        size_t count = 0;
+        if(mode[0] == 'p')
+        {
+            c4::opt::Parser p(rss_usage, C4_COUNTOF(rss_usage), cl.argc(), cl.argv.data());
+            count = (size_t)p.parser.optionsCount();
+        }
+        else
+        {
+            c4::opt::CompactParser p(rss_usage, C4_COUNTOF(rss_usage), cl.argc(), cl.argv.data());
+            count = p.num_occurrences();
+        }
+        long after = peak_rss_kb();
+        double per_occ = count ? 1024. * double(after - before) / double(count) : 0.;
+        printf("%-8s %10zu %10zu %12ld %12ld %12ld %10.1f\n", mode, num_tokens, count, before, after, after - before, per_occ);
+        fflush(stdout);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+}
+#endif
+
+} // anon
+
+int main(int argc, const char *argv[])
+{
+    size_t max_tokens = size_t(1) << 22;
+    if(argc > 1)
+    {
+        char *end = nullptr;
+        max_tokens = (size_t)strtoull(argv[1], &end, 10);
+        if(end == argv[1] || *end != 0 || max_tokens < 1024)
+        {
+            fprintf(stderr, "usage: %s [max_tokens=4194304], with max_tokens >= 1024\n", argv[0]);
+            return 1;
+        }
+    }
+    #ifdef C4_UNIX
+    printf("%-8s %10s %10s %12s %12s %12s %10s\n", "mode", "tokens", "options", "rss_before", "rss_after", "rss_delta", "B/option");
+    printf("%-8s %10s %10s %12s %12s %12s %10s\n", "", "", "", "(KiB)", "(KiB)", "(KiB)", "");
+    for(size_t n = 1024; n <= max_tokens; n *= 2)
+    {
+        measure("parser", n);
+        measure("compact", n);
+    }
+    return 0;
+    #else
+    (void)max_tokens;
+    fprintf(stderr, "peak RSS measurement is only implemented for POSIX platforms\n");
+    return 0;
+    #endif
+}
@@ -0,0 +1,159 @@
+#include "c4/opt/arena.hpp"
+#include <c4/error.hpp>
+#include <stdint.h>
+#include <string.h>
+#include <new>
+
+namespace c4 {
+namespace opt {
+
+namespace {
+C4_ALWAYS_INLINE char* _align_up(char *p, size_t alignment)
+{
+    return (char*) (((uintptr_t)p + (alignment - 1u)) & ~(uintptr_t)(alignment - 1u));
+}
+} // anon
+
+
+MemoryResourceArena::MemoryResourceArena(size_t block_size, MemoryResource *upstream)
+    : m_head(nullptr), m_curr(nullptr), m_pos(nullptr), m_block_size(block_size), m_upstream(upstream)
+{
+    name = "c4opt_arena";
+}
+
+MemoryResourceArena::MemoryResourceArena(substr buf, MemoryResource *upstream, size_t block_size)
+    : MemoryResourceArena(block_size, upstream)
+{
+    char *b = _align_up(buf.str, alignof(Block));
+    if(buf.str == nullptr || b + sizeof(Block) > buf.str + buf.len)
+        return;
+    m_head = new (b) Block{nullptr, (size_t)(buf.str + buf.len - b), false};
+    reset();
+}
+
+MemoryResourceArena::~MemoryResourceArena()
+{
+    release();
+}
+
+void MemoryResourceArena::release()
+{
+    Block **prev = &m_head;
+    while(*prev)
+    {
+        Block *b = *prev;
+        if(b->owned)
+        {
+            *prev = b->next;
+            m_upstream->deallocate(b, b->size, alignof(max_align_t));
+        }
+        else
+        {
+            prev = &b->next;
+        }
+    }
+    reset();
+}
+
+size_t MemoryResourceArena::used() const
+{
+    size_t sz = 0;
+    for(Block *b = m_head; b && b != m_curr; b = b->next)
+        sz += b->size - sizeof(Block);
+    if(m_curr)
+        sz += (size_t)(m_pos - m_curr->begin());
+    return sz;
+}
+
+size_t MemoryResourceArena::capacity() const
+{
+    size_t sz = 0;
+    for(Block *b = m_head; b; b = b->next)
+        sz += b->size - sizeof(Block);
+    return sz;
+}
+
+size_t MemoryResourceArena::num_blocks() const
+{
+    size_t num = 0;
+    for(Block *b = m_head; b; b = b->next)
+        num += b->owned;
+    return num;
+}
+
+MemoryResourceArena::Block* MemoryResourceArena::_next_block(size_t sz, size_t alignment)
+{
+    // first try the blocks kept from before the last reset
+    for(Block *b = m_curr ? m_curr->next : m_head; b; b = b->next)
+    {
+        char *p = _align_up(b->begin(), alignment);
+        if(p + sz <= b->end())
+            return b;
+    }
+    if( ! m_upstream)
+        return nullptr;
+    size_t size = sizeof(Block) + sz + alignment;
+    if(size < m_block_size)
+        size = m_block_size;
+    Block *b = new (m_upstream->allocate(size, alignof(max_align_t))) Block{nullptr, size, true};
+    // insert it after the current block, to keep the blocks which
+    // follow it for later
+    if(m_curr)
+    {
+        b->next = m_curr->next;
+        m_curr->next = b;
+    }
+    else
+    {
+        b->next = m_head;
+        m_head = b;
+    }
+    return b;
+}
+
+void* MemoryResourceArena::do_allocate(size_t sz, size_t alignment, void* /*hint*/)
+{
+    if(m_curr)
+    {
+        char *p = _align_up(m_pos, alignment);
+        if(p + sz <= m_curr->end())
+        {
+            m_pos = p + sz;
+            return p;
+        }
+    }
+    Block *b = _next_block(sz, alignment);
+    if( ! b)
+        return nullptr;
+    m_curr = b;
+    char *p = _align_up(b->begin(), alignment);
+    m_pos = p + sz;
+    return p;
+}
+
+void MemoryResourceArena::do_deallocate(void* ptr, size_t sz, size_t /*alignment*/)
+{
+    // only the most recent allocation can be given back
+    if(m_curr && (char*)ptr + sz == m_pos && (char*)ptr >= m_curr->begin())
+        m_pos = (char*)ptr;
+}
+
+void* MemoryResourceArena::do_reallocate(void* ptr, size_t oldsz, size_t newsz, size_t alignment)
+{
+    if(ptr == nullptr)
+        return do_allocate(newsz, alignment, nullptr);
+    char *p = (char*)ptr;
+    // grow or shrink the most recent allocation in place
+    if(m_curr && p + oldsz == m_pos && p >= m_curr->begin() && p + newsz <= m_curr->end())
+    {
+        m_pos = p + newsz;
+        return p;
+    }
+    void *mem = do_allocate(newsz, alignment, nullptr);
+    if(mem)
+        memcpy(mem, ptr, oldsz < newsz ? oldsz : newsz);
+    return mem;
+}
+
+} // namespace opt
+} // namespace c4
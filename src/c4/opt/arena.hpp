@@ -0,0 +1,105 @@
+#ifndef _C4_OPT_ARENA_HPP_
+#define _C4_OPT_ARENA_HPP_
+
+#include <c4/memory_resource.hpp>
+#include <c4/substr.hpp>
+
+/** @file arena.hpp a bump allocator, to release everything allocated
+ * by a parse at once */
+
+namespace c4 {
+namespace opt {
+
+/** A memory resource which hands out memory by bumping a pointer
+ * through a list of blocks, and releases all of it at once with
+ * reset(). Deallocating is a no-op, except for the most recent
+ * allocation, which is rolled back; reallocating the most recent
+ * allocation grows it in place when there is room.
+ *
+ * Every class in c4opt takes its memory from a MemoryResource, so
+ * passing an arena to the parsers (and to RuntimeSpec) puts all their
+ * memory in the arena:
+ *
+ * @code
+ * c4::opt::MemoryResourceArena arena; // eg, one per request
+ * {
+ *     auto p = c4::opt::make_parser(usage, argc, argv, &arena);
+ *     ...
+ * }
+ * arena.reset();
+ * @endcode
+ *
+ * Blocks are obtained from the upstream resource as needed, and kept
+ * across resets, so that an arena which is reused does not allocate
+ * once it has grown to the size of its workload. An arena is not
+ * thread-safe: use one per thread. */
+class MemoryResourceArena : public MemoryResource
+{
+public:
+
+    /** @param block_size the minimum size of the blocks obtained from upstream
+     * @param upstream where to get the blocks from. If null, allocations which do not fit fail. */
+    explicit MemoryResourceArena(size_t block_size=4096, MemoryResource *upstream=get_memory_resource());
+    /** use the given buffer before getting any blocks from upstream.
+     * The buffer must outlive the arena. */
+    explicit MemoryResourceArena(substr buf, MemoryResource *upstream=get_memory_resource(), size_t block_size=4096);
+    ~MemoryResourceArena() override;
+
+    MemoryResourceArena(MemoryResourceArena const&) = delete;
+    MemoryResourceArena& operator= (MemoryResourceArena const&) = delete;
+    MemoryResourceArena(MemoryResourceArena &&) = delete;
+    MemoryResourceArena& operator= (MemoryResourceArena &&) = delete;
+
+public:
+
+    /** release everything allocated from the arena. The blocks are kept. */
+    void reset()
+    {
+        m_curr = m_head;
+        m_pos = m_curr ? m_curr->begin() : nullptr;
+    }
+
+    /** return the blocks obtained from upstream. Everything allocated
+     * from the arena is released. */
+    void release();
+
+    /** the number of bytes handed out since the last reset, including padding */
+    size_t used() const;
+    /** the total size of the blocks */
+    size_t capacity() const;
+    /** the number of blocks obtained from upstream */
+    size_t num_blocks() const;
+
+protected:
+
+    void* do_allocate(size_t sz, size_t alignment, void* hint) override;
+    void* do_reallocate(void* ptr, size_t oldsz, size_t newsz, size_t alignment) override;
+    void  do_deallocate(void* ptr, size_t sz, size_t alignment) override;
+
+private:
+
+    struct Block
+    {
+        Block *next;
+        size_t size;   ///< the size of the block, including this header
+        bool   owned;  ///< whether the block was obtained from upstream
+        char *begin() { return reinterpret_cast<char*>(this + 1); }
+        char *end() { return reinterpret_cast<char*>(this) + size; }
+    };
+
+    Block *_next_block(size_t sz, size_t alignment);
+
+private:
+
+    Block *m_head;
+    Block *m_curr;
+    char  *m_pos;    ///< the first free byte in m_curr
+    size_t m_block_size;
+    MemoryResource *m_upstream;
+
+};
+
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_ARENA_HPP_ */
@@ -0,0 +1,68 @@
+#include "c4/opt/bind.hpp"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace c4 {
+namespace opt {
+namespace detail {
+
+bool bind_parse_bool(const char *str, bool *v)
+{
+    static const char *const truthy[] = {"1", "true", "yes", "on"};
+    static const char *const falsy[] = {"0", "false", "no", "off"};
+    for(const char *s : truthy)
+    {
+        if(strcmp(str, s) == 0)
+            return (*v = true);
+    }
+    for(const char *s : falsy)
+    {
+        if(strcmp(str, s) == 0)
+            return (*v = false, true);
+    }
+    return false;
+}
+
+bool bind_parse_int(const char *str, long long min, long long max, long long *v)
+{
+    char *end = nullptr;
+    errno = 0;
+    long long val = strtoll(str, &end, 10);
+    if(end == str || *end != 0 || errno == ERANGE || val < min || val > max)
+        return false;
+    *v = val;
+    return true;
+}
+
+bool bind_parse_uint(const char *str, unsigned long long max, unsigned long long *v)
+{
+    char *end = nullptr;
+    errno = 0;
+    if(*str == '-')
+        return false;
+    unsigned long long val = strtoull(str, &end, 10);
+    if(end == str || *end != 0 || errno == ERANGE || val > max)
+        return false;
+    *v = val;
+    return true;
+}
+
+bool bind_parse_float(const char *str, double *v)
+{
+    char *end = nullptr;
+    double val = strtod(str, &end);
+    if(end == str || *end != 0)
+        return false;
+    *v = val;
+    return true;
+}
+
+void bind_report_bad_value(option::Option const& o)
+{
+    fprintf(stderr, "Option '%.*s' has an invalid value: '%s'\n", o.namelen, o.name, o.arg ? o.arg : "");
+}
+
+} // namespace detail
+} // namespace opt
+} // namespace c4
@@ -0,0 +1,253 @@
+#ifndef _C4_OPT_BIND_HPP_
+#define _C4_OPT_BIND_HPP_
+
+#include "c4/opt/opt.hpp"
+#include <limits>
+#include <type_traits>
+
+/** @file bind.hpp declare options as the fields of a struct, and parse
+ * the values directly into the struct */
+
+namespace c4 {
+namespace opt {
+
+/** the result of Binding::parse() */
+struct BindResult
+{
+    bool ok;                ///< false if there was an unknown option or an illegal value
+    int num_posn;           ///< number of positional arguments
+    const char **posn;      ///< the positional arguments (pointing into argv)
+
+    explicit operator bool() const { return ok; }
+};
+
+namespace detail {
+
+bool bind_parse_bool(const char *str, bool *v);
+bool bind_parse_int(const char *str, long long min, long long max, long long *v);
+bool bind_parse_uint(const char *str, unsigned long long max, unsigned long long *v);
+bool bind_parse_float(const char *str, double *v);
+void bind_report_bad_value(option::Option const& o);
+
+template<size_t ...Is> struct bind_seq {};
+template<size_t N, size_t ...Is> struct bind_make_seq : bind_make_seq<N-1, N-1, Is...> {};
+template<size_t ...Is> struct bind_make_seq<0, Is...> { using type = bind_seq<Is...>; };
+
+} // namespace detail
+
+
+/** Converts an option value and writes it to a field of type T.
+ * Specialize this to support other field types. The provided
+ * conversions are:
+ *   - bool: set to true when the option has no value; otherwise the
+ *     value must be one of 1/0, true/false, yes/no or on/off
+ *   - integral types: the value is parsed, and must fit in the type.
+ *     When the option has no value, the field is incremented,
+ *     so that eg -vvv gives 3.
+ *   - floating point types: the value is parsed
+ *   - const char*: points at the value in argv
+ *   - csubstr: views the value in argv
+ * Options with multiple occurrences are written multiple times, so the
+ * last one wins. */
+template<class T, class=void>
+struct FieldConverter;
+
+template<>
+struct FieldConverter<bool>
+{
+    static bool set(bool *field, const char *arg)
+    {
+        if( ! arg)
+            return (*field = true);
+        return detail::bind_parse_bool(arg, field);
+    }
+};
+
+template<class T>
+struct FieldConverter<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type>
+{
+    static bool set(T *field, const char *arg)
+    {
+        long long v;
+        if( ! arg)
+            return (++*field, true);
+        if( ! detail::bind_parse_int(arg, (long long)std::numeric_limits<T>::min(), (long long)std::numeric_limits<T>::max(), &v))
+            return false;
+        *field = (T)v;
+        return true;
+    }
+};
+
+template<class T>
+struct FieldConverter<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value && ! std::is_same<T, bool>::value>::type>
+{
+    static bool set(T *field, const char *arg)
+    {
+        unsigned long long v;
+        if( ! arg)
+            return (++*field, true);
+        if( ! detail::bind_parse_uint(arg, (unsigned long long)std::numeric_limits<T>::max(), &v))
+            return false;
+        *field = (T)v;
+        return true;
+    }
+};
+
+template<class T>
+struct FieldConverter<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+{
+    static bool set(T *field, const char *arg)
+    {
+        double v;
+        if( ! arg || ! detail::bind_parse_float(arg, &v))
+            return false;
+        *field = (T)v;
+        return true;
+    }
+};
+
+template<>
+struct FieldConverter<const char*>
+{
+    static bool set(const char **field, const char *arg)
+    {
+        *field = arg;
+        return true;
+    }
+};
+
+template<>
+struct FieldConverter<csubstr>
+{
+    static bool set(csubstr *field, const char *arg)
+    {
+        *field = arg ? csubstr(arg, strlen(arg)) : csubstr();
+        return true;
+    }
+};
+
+
+/** a struct field declared as an option. Use C4OPT_FIELD() to create. */
+template<class T>
+struct Field
+{
+    using setter_type = bool (*)(T *obj, option::Option const& o);
+    const char *shortopt;
+    const char *longopt;
+    option::CheckArg check_arg;
+    const char *help;
+    setter_type setter;
+};
+
+namespace detail {
+template<class T, class M, M T::*member>
+bool bind_set(T *obj, option::Option const& o)
+{
+    if(FieldConverter<M>::set(&(obj->*member), o.arg))
+        return true;
+    bind_report_bad_value(o);
+    return false;
+}
+} // namespace detail
+
+template<class T, class M, M T::*member>
+Field<T> field(const char *shortopt, const char *longopt, option::CheckArg check_arg, const char *help)
+{
+    return Field<T>{shortopt, longopt, check_arg, help, &detail::bind_set<T, M, member>};
+}
+
+/** declare a field of struct T as an option:
+ * @code
+ * C4OPT_FIELD(Config, level, "l", "level", c4::opt::integer, "  -l <val>, --level=<val>  \tSet the level.")
+ * @endcode */
+#define C4OPT_FIELD(T, member, shortopt, longopt, check_arg, help) \
+    ::c4::opt::field<T, decltype(T::member), &T::member>(shortopt, longopt, check_arg, help)
+
+
+/** The options of a struct T: holds the Descriptor array generated for
+ * the fields, and parses values directly into the fields of a T object,
+ * without storing any Option. Use bind() to create.
+ *
+ * The descriptor indices are 1 + the position of the field in the
+ * bind() call; index 0 is the dummy descriptor for unknown options,
+ * which is an error.
+ *
+ * @code
+ * struct Config { bool verbose; int level; const char *name; };
+ * static const auto config_opts = c4::opt::bind<Config>(
+ *     "USAGE: app [options]\n\nOptions:",
+ *     C4OPT_FIELD(Config, verbose, "v", "verbose", c4::opt::none, "  -v, --verbose  \tBe verbose."),
+ *     C4OPT_FIELD(Config, level, "l", "level", c4::opt::integer, "  -l <val>, --level=<val>  \tSet the level."),
+ *     C4OPT_FIELD(Config, name, "n", "name", c4::opt::nonempty, "  -n <val>, --name=<val>  \tSet the name."));
+ * Config cfg = {};
+ * if( ! config_opts.parse(&cfg, argc, argv))
+ *     config_opts.help();
+ * @endcode */
+template<class T, size_t N>
+struct Binding
+{
+    option::Descriptor usage[N + 2];
+    typename Field<T>::setter_type setters[N + 2];
+
+    template<size_t ...Is>
+    Binding(const char *header, Field<T> const (&fields)[N], detail::bind_seq<Is...>)
+        :
+        usage{
+            {0, 0, "", "", c4::opt::unknown, header},
+            {unsigned(Is + 1), 0, fields[Is].shortopt, fields[Is].longopt, fields[Is].check_arg, fields[Is].help}...,
+            {0, 0, 0, 0, 0, 0}
+        },
+        setters{nullptr, fields[Is].setter..., nullptr}
+    {
+    }
+
+    size_t num_usage_entries() const { return N + 2; }
+
+    /** parse the arguments, writing the values into the fields of obj.
+     * Fields for options which are not given are left untouched.
+     * @param gnu whether to accept options after positional arguments
+     * (the arguments are then permuted as in option::Parser::parse()) */
+    BindResult parse(T *obj, int argc, const char **argv, bool gnu=false) const
+    {
+        struct SetAction : public option::Parser::Action
+        {
+            Binding const* b;
+            T *obj;
+            BindResult *res;
+            SetAction(Binding const* b_, T *obj_, BindResult *res_) : b(b_), obj(obj_), res(res_) {}
+            bool perform(option::Option &o) override
+            {
+                return b->setters[o.desc - b->usage](obj, o);
+            }
+            bool finished(int numargs, const char **args) override
+            {
+                res->num_posn = numargs;
+                res->posn = args;
+                return true;
+            }
+        };
+        BindResult res = {false, 0, nullptr};
+        SetAction action(this, obj, &res);
+        res.ok = option::Parser::workhorse(gnu, usage, argc, argv, action, /*single_minus_longopt*/false, /*print_errors*/true, /*min_abbr_len*/0);
+        return res;
+    }
+
+    /** print the usage help */
+    void help(int width=80, FILE *stream=stdout) const
+    {
+        print_help(usage, width, stream);
+    }
+};
+
+/** bind options to the fields of struct T. @see Binding */
+template<class T, class ...Fields>
+Binding<T, sizeof...(Fields)> bind(const char *header, Fields const& ...fields)
+{
+    Field<T> const f[] = {fields...};
+    return Binding<T, sizeof...(Fields)>(header, f, typename detail::bind_make_seq<sizeof...(Fields)>::type{});
+}
+
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_BIND_HPP_ */
@@ -0,0 +1,316 @@
+#include "c4/opt/command.hpp"
+#include "c4/opt/suggest.hpp"
+#include <algorithm>
+#include <new>
+#include <string.h>
+
+namespace c4 {
+namespace opt {
+
+namespace {
+/** the usage of the commands without options: any option is unknown */
+const option::Descriptor no_options[] = {{0, 0, "", "", c4::opt::unknown, nullptr}, {0, 0, 0, 0, 0, 0}};
+
+/** CommandTrie::find() by a scan of the commands, for the commands
+ * given without a trie: building one in each parse would cost more
+ * than the scan, for the single name looked up at each level */
+int32_t _find_command(Command const* commands, csubstr name, size_t min_abbr_len)
+{
+    if( ! commands || ! name.len)
+        return CommandTrie::npos;
+    const bool abbr = min_abbr_len && name.len >= min_abbr_len;
+    int32_t prefixed = CommandTrie::npos;
+    for(int32_t i = 0; commands[i].name != nullptr; ++i)
+    {
+        const char *cname = commands[i].name;
+        if(strncmp(cname, name.str, name.len) != 0)
+            continue;
+        if(cname[name.len] == '\0')
+            return i;
+        if(abbr)
+            prefixed = prefixed == CommandTrie::npos ? i : (int32_t)CommandTrie::ambiguous;
+    }
+    return prefixed;
+}
+} // anon
+
+size_t num_subcommands(Command const& cmd)
+{
+    size_t n = 0;
+    if(cmd.subcommands)
+        while(cmd.subcommands[n].name != nullptr)
+            ++n;
+    return n;
+}
+
+void print_subcommands(Command const& cmd, FILE *stream)
+{
+    const size_t n = num_subcommands(cmd);
+    int width = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        int len = (int)strlen(cmd.subcommands[i].name);
+        width = len > width ? len : width;
+    }
+    for(size_t i = 0; i < n; ++i)
+    {
+        Command const& sub = cmd.subcommands[i];
+        if(sub.help)
+            fprintf(stream, "  %-*s  %s\n", width, sub.name, sub.help);
+        else
+            fprintf(stream, "  %s\n", sub.name);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+CommandTrie::CommandTrie(Command const* commands, MemoryResource *mr)
+    : m_commands(commands), m_num_commands(0), m_nodes(nullptr), m_num_nodes(0), m_sorted(nullptr), m_size(0), m_mr(mr)
+{
+    size_t max_nodes = 1;
+    if(commands)
+        for( ; commands[m_num_commands].name != nullptr; ++m_num_commands)
+            max_nodes += strlen(commands[m_num_commands].name);
+    // one node per character at most, plus the root
+    m_size = max_nodes * sizeof(Node) + m_num_commands * sizeof(uint32_t);
+    m_nodes = (Node*) m_mr->allocate(m_size, alignof(Node));
+    m_sorted = (uint32_t*) (m_nodes + max_nodes);
+    for(size_t i = 0; i < m_num_commands; ++i)
+        m_sorted[i] = (uint32_t)i;
+    std::sort(m_sorted, m_sorted + m_num_commands, [commands](uint32_t a, uint32_t b){
+        int cmp = strcmp(commands[a].name, commands[b].name);
+        return cmp < 0 || (cmp == 0 && a < b);
+    });
+    m_nodes[0] = Node{0, 0, 0, (uint32_t)m_num_commands, -1, '\0'};
+    m_num_nodes = 1;
+    // depth first, allocating the children of each node together. The
+    // names ending at a node sort before those continuing below it.
+    struct Builder
+    {
+        CommandTrie *t;
+        void build(uint32_t node, size_t depth)
+        {
+            Node *nodes = t->m_nodes;
+            uint32_t lo = nodes[node].lo;
+            const uint32_t hi = nodes[node].hi;
+            for( ; lo < hi && t->m_commands[t->m_sorted[lo]].name[depth] == '\0'; ++lo)
+                if(nodes[node].command < 0)
+                    nodes[node].command = (int32_t)t->m_sorted[lo];
+            const uint32_t first = (uint32_t)t->m_num_nodes;
+            nodes[node].first_child = first;
+            for(uint32_t i = lo; i < hi; )
+            {
+                const char c = t->m_commands[t->m_sorted[i]].name[depth];
+                uint32_t j = i + 1;
+                while(j < hi && t->m_commands[t->m_sorted[j]].name[depth] == c)
+                    ++j;
+                nodes[t->m_num_nodes++] = Node{0, 0, i, j, -1, c};
+                i = j;
+            }
+            nodes[node].num_children = (uint32_t)t->m_num_nodes - first;
+            for(uint32_t k = first, e = (uint32_t)t->m_num_nodes; k < e; ++k)
+                build(k, depth + 1);
+        }
+    };
+    Builder{this}.build(0, 0);
+}
+
+CommandTrie::CommandTrie(CommandTrie &&that)
+    : m_commands(that.m_commands), m_num_commands(that.m_num_commands), m_nodes(that.m_nodes), m_num_nodes(that.m_num_nodes), m_sorted(that.m_sorted), m_size(that.m_size), m_mr(that.m_mr)
+{
+    that.m_nodes = nullptr;
+    that.m_sorted = nullptr;
+    that.m_num_nodes = 0;
+    that.m_num_commands = 0;
+    that.m_size = 0;
+}
+
+CommandTrie::~CommandTrie()
+{
+    if(m_nodes)
+    {
+        m_mr->deallocate(m_nodes, m_size, alignof(Node));
+        m_nodes = nullptr;
+        m_sorted = nullptr;
+    }
+}
+
+int32_t CommandTrie::find(csubstr name, size_t min_abbr_len) const
+{
+    if( ! m_num_nodes)
+        return npos;
+    Node const* node = m_nodes;
+    for(size_t i = 0; i < name.len; ++i)
+    {
+        Node const* child = m_nodes + node->first_child;
+        Node const* end = child + node->num_children;
+        while(child < end && child->c != name.str[i])
+            ++child;
+        if(child == end)
+            return npos;
+        node = child;
+    }
+    if(node->command >= 0)
+        return node->command;
+    if(min_abbr_len == 0 || name.len < min_abbr_len || node->hi == node->lo)
+        return npos;
+    return node->hi - node->lo == 1 ? (int32_t)m_sorted[node->lo] : (int32_t)ambiguous;
+}
+
+
+//-----------------------------------------------------------------------------
+
+CommandParser::CommandParser(Command const& root, int argc, const char *const *argv, ParseError *err, MemoryResource *mr)
+    : m_levels(nullptr), m_num_levels(0), m_cap_levels(0), m_mr(mr)
+{
+    _parse(root, argc, argv, CommandRules{}, err);
+}
+
+CommandParser::CommandParser(Command const& root, int argc, const char *const *argv, CommandRules const& rules, ParseError *err, MemoryResource *mr)
+    : m_levels(nullptr), m_num_levels(0), m_cap_levels(0), m_mr(mr)
+{
+    _parse(root, argc, argv, rules, err);
+}
+
+CommandParser::CommandParser(CommandParser &&that)
+    : m_levels(that.m_levels), m_num_levels(that.m_num_levels), m_cap_levels(that.m_cap_levels), m_mr(that.m_mr)
+{
+    that.m_levels = nullptr;
+    that.m_num_levels = 0;
+    that.m_cap_levels = 0;
+}
+
+CommandParser::~CommandParser()
+{
+    _destroy();
+}
+
+void CommandParser::_destroy()
+{
+    for(size_t i = 0; i < m_num_levels; ++i)
+    {
+        Level &lv = m_levels[i];
+        RuntimeSpec *rt = lv.rt;
+        // the parser refers to the tables of the spec
+        lv.~Level();
+        if(rt)
+        {
+            rt->~RuntimeSpec();
+            m_mr->deallocate(rt, sizeof(RuntimeSpec), alignof(RuntimeSpec));
+        }
+    }
+    if(m_levels)
+        m_mr->deallocate(m_levels, m_cap_levels * sizeof(Level), alignof(Level));
+    m_levels = nullptr;
+    m_num_levels = 0;
+    m_cap_levels = 0;
+}
+
+void CommandParser::_parse(Command const& root, int argc, const char *const *argv, CommandRules const& rules, ParseError *err)
+{
+    if(err)
+        *err = {PARSE_OK, -1, 0, -1};
+    Command const* cmd = &root;
+    int argi = 0;
+    while(_push(*cmd, argi, argc, argv, rules, err))
+    {
+        // the first positional argument names the next command
+        CompactParser const& p = m_levels[m_num_levels - 1].parser;
+        if( ! cmd->subcommands || ! p.num_posn())
+            return;
+        const int name_argi = argi + (int)p.posn_indices()[0];
+        const csubstr name = to_csubstr(argv[name_argi]);
+        int32_t found;
+        if(cmd->trie)
+        {
+            C4_CHECK_MSG(cmd->trie->commands() == cmd->subcommands, "the trie of command '%s' is not that of its subcommands", cmd->name);
+            found = cmd->trie->find(name, rules.min_abbr_len);
+        }
+        else
+        {
+            found = _find_command(cmd->subcommands, name, rules.min_abbr_len);
+        }
+        if(found < 0)
+        {
+            ParseError e = {found == CommandTrie::ambiguous ? (uint32_t)PARSE_AMBIGUOUS_COMMAND : (uint32_t)PARSE_UNKNOWN_COMMAND, name_argi, 0, -1};
+            if(err)
+            {
+                *err = e;
+                return;
+            }
+            char buf[256];
+            detail::format_error(substr(buf, sizeof(buf)), e, p.usage(), name);
+            fprintf(stderr, "%s\n", buf);
+            help();
+            C4_ERROR("parser error");
+        }
+        cmd = &cmd->subcommands[found];
+        argi = name_argi + 1;
+    }
+}
+
+bool CommandParser::_push(Command const& cmd, int argi, int argc, const char *const *argv, CommandRules const& rules, ParseError *err)
+{
+    if(m_num_levels == m_cap_levels)
+    {
+        // the path is rarely deeper than a few levels
+        size_t cap = m_cap_levels ? 2 * m_cap_levels : 4;
+        Level *levels = (Level*) m_mr->allocate(cap * sizeof(Level), alignof(Level));
+        for(size_t i = 0; i < m_num_levels; ++i)
+        {
+            Level &prev = m_levels[i];
+            new (levels + i) Level{prev.command, prev.argi, prev.rt, std::move(prev.parser)};
+            prev.~Level();
+        }
+        if(m_levels)
+            m_mr->deallocate(m_levels, m_cap_levels * sizeof(Level), alignof(Level));
+        m_levels = levels;
+        m_cap_levels = cap;
+    }
+    // compile the spec only now that the command is selected
+    RuntimeSpec *rt = nullptr;
+    Spec const* spec = cmd.spec;
+    if( ! spec)
+    {
+        void *mem = m_mr->allocate(sizeof(RuntimeSpec), alignof(RuntimeSpec));
+        rt = new (mem) RuntimeSpec(cmd.usage ? cmd.usage : no_options, m_mr);
+        spec = &rt->spec();
+    }
+    const ParseMode_e mode = cmd.subcommands ? PARSE_POSIX : rules.mode;
+    ParseError lerr;
+    new (m_levels + m_num_levels) Level{&cmd, argi, rt, CompactParser(*spec, argc - argi, argv + argi, mode, &lerr, m_mr)};
+    ++m_num_levels;
+    if( ! lerr)
+        return true;
+    if(lerr.argi >= 0)
+        lerr.argi += argi;
+    if(err)
+    {
+        *err = lerr;
+        return false;
+    }
+    char buf[256];
+    format_error(substr(buf, sizeof(buf)), lerr, spec->usage(), argc, const_cast<const char**>(argv));
+    fprintf(stderr, "%s\n", buf);
+    if(lerr.argi >= 0 && lerr.argi < argc)
+        detail::print_suggestions(lerr, spec->usage(), to_csubstr(argv[lerr.argi]));
+    help();
+    C4_ERROR("parser error");
+    return false;
+}
+
+void CommandParser::help() const
+{
+    Level const& lv = m_levels[m_num_levels - 1];
+    lv.parser.help();
+    if(lv.command->subcommands)
+    {
+        fputs("\nCommands:\n", stdout);
+        print_subcommands(*lv.command, stdout);
+        fflush(stdout);
+    }
+}
+
+} // namespace opt
+} // namespace c4
@@ -0,0 +1,212 @@
+#ifndef _C4_OPT_COMMAND_HPP_
+#define _C4_OPT_COMMAND_HPP_
+
+#include "c4/opt/compact.hpp"
+#include <stdio.h>
+
+/** @file command.hpp subcommands, eg `tool [options] remote [options]
+ * add [options] <args>`, each with its own options */
+
+namespace c4 {
+namespace opt {
+
+class CommandTrie;
+
+/** A command of a tool, with its options and its own subcommands.
+ * This is plain data, so that the whole tree of commands can be
+ * constexpr. Nothing is done with a command until it is selected:
+ * then its spec is compiled, if it was not given, and the name of the
+ * next command is looked up among its subcommands: with their trie if
+ * it was given, otherwise with a scan of their names.
+ *
+ * @code
+ * constexpr const Command remote_cmds[] = {
+ *     {"add",    add_usage,    nullptr,       nullptr, nullptr, "Add a remote"},
+ *     {"remove", remove_usage, &remove_spec,  nullptr, nullptr, "Remove a remote"},
+ *     {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr}
+ * };
+ * constexpr const Command tool_cmds[] = {
+ *     {"remote", remote_usage, nullptr, remote_cmds, nullptr, "Manage the remotes"},
+ *     ...
+ * };
+ * // many commands: their trie is built once, before main()
+ * static const CommandTrie tool_trie(tool_cmds);
+ * constexpr const Command tool = {"tool", tool_usage, nullptr, tool_cmds, &tool_trie, nullptr};
+ * @endcode */
+struct Command
+{
+    const char *name;                 ///< null in the entry ending a list of subcommands
+    option::Descriptor const* usage;  ///< the options of the command; null for none
+    Spec const* spec;                 ///< the compiled spec of the usage, eg from c4opt-specgen; null to compile it when the command is selected
+    Command const* subcommands;       ///< the subcommands, ending with an entry with a null name; null for none
+    CommandTrie const* trie;          ///< the trie of the names of the subcommands, built once; null to scan the names instead
+    const char *help;                 ///< a one-line description, for the list of commands; may be null
+};
+
+/** the number of subcommands of a command */
+size_t num_subcommands(Command const& cmd);
+
+/** print the subcommands of a command with their descriptions */
+void print_subcommands(Command const& cmd, FILE *stream=stdout);
+
+
+/** A trie of the names of a list of commands, to find a command by
+ * its name in time proportional to the length of the name, whatever
+ * the number of commands, and to resolve abbreviated names. The
+ * children of each node are contiguous and sorted by character. The
+ * trie is built in a single allocation, so it pays back when it is
+ * built once and used for many lookups: give it to the Command with
+ * the list (Command::trie), for CommandParser to use in every parse.
+ * Without it, CommandParser scans the names, which allocates nothing. */
+class CommandTrie
+{
+public:
+
+    CommandTrie(Command const* commands, MemoryResource *mr=get_memory_resource());
+    ~CommandTrie();
+
+    CommandTrie(CommandTrie const&) = delete;
+    CommandTrie& operator= (CommandTrie const&) = delete;
+    CommandTrie(CommandTrie &&that);
+    CommandTrie& operator= (CommandTrie &&) = delete;
+
+public:
+
+    enum : int32_t {
+        npos = -1,       ///< no command has this name
+        ambiguous = -2,  ///< the name is a prefix of several commands
+    };
+
+    /** the position in the list of the command with this name. If
+     * min_abbr_len is not 0, the name may also be a prefix of the name
+     * of a single command, if it has at least min_abbr_len characters.
+     * An exact name always wins over the abbreviations.
+     * @return the position, or npos or ambiguous */
+    int32_t find(csubstr name, size_t min_abbr_len=0) const;
+
+    Command const* commands() const { return m_commands; }
+    size_t num_commands() const { return m_num_commands; }
+    size_t num_nodes() const { return m_num_nodes; }
+
+private:
+
+    struct Node
+    {
+        uint32_t first_child;
+        uint32_t num_children;
+        uint32_t lo, hi;   ///< the commands below this node are m_sorted[lo, hi)
+        int32_t  command;  ///< the command whose name ends here, or -1
+        char     c;        ///< the character leading here from the parent
+    };
+
+    Command const* m_commands;
+    size_t m_num_commands;
+    Node *m_nodes;
+    size_t m_num_nodes;
+    uint32_t *m_sorted;  ///< the positions of the commands, sorted by name
+    size_t m_size;
+    MemoryResource *m_mr;
+
+};
+
+
+/** how CommandParser selects and parses the commands */
+struct CommandRules
+{
+    /** the mode for the options of the selected command. The commands
+     * with subcommands are always parsed in POSIX mode, as their first
+     * positional argument is the name of the next command. */
+    ParseMode_e mode = PARSE_POSIX;
+    /** the names of the commands may be abbreviated to a unique prefix
+     * of at least this length; 0 for no abbreviations */
+    size_t min_abbr_len = 0;
+};
+
+
+/** Selects the commands named in argv from a tree of commands, and
+ * parses the options of each of them with a CompactParser:
+ *
+ *     argv: [root options] name1 [name1 options] name2 [name2 options] <args>
+ *
+ * Each command on the path is a level, the root being level 0. The
+ * options of each level are those before the name of the next command;
+ * so the positional arguments of a level with a selected subcommand
+ * start with its name. A command without subcommands takes all the
+ * remaining arguments. A command with subcommands ends the path if no
+ * name follows its options.
+ *
+ * The cost is that of the selected path only: the commands which are
+ * not selected are never looked at, other than by the lookup of the
+ * names at their level, with the trie of the level or with a scan,
+ * neither of which allocates. A command selected without a Spec has
+ * its spec compiled with RuntimeSpec.
+ *
+ * On error, the parse stops at the level where it happened. Without
+ * an err argument, the error and the help of that level are printed
+ * and the program aborts, as with the other parsers. */
+class CommandParser
+{
+public:
+
+    CommandParser(Command const& root, int argc, const char *const *argv, ParseError *err=nullptr, MemoryResource *mr=get_memory_resource());
+    CommandParser(Command const& root, int argc, const char *const *argv, CommandRules const& rules, ParseError *err=nullptr, MemoryResource *mr=get_memory_resource());
+    ~CommandParser();
+
+    CommandParser(CommandParser const&) = delete;
+    CommandParser& operator= (CommandParser const&) = delete;
+    CommandParser(CommandParser &&that);
+    CommandParser& operator= (CommandParser &&) = delete;
+
+public:
+
+    /** the number of levels: 1 if no command was selected */
+    size_t depth() const { return m_num_levels; }
+
+    /** the command at a level */
+    Command const& command(size_t level) const { C4_CHECK(level < m_num_levels); return *m_levels[level].command; }
+    /** the parsed options of the command at a level. Its argv starts
+     * after the name of the command. */
+    CompactParser const& options(size_t level) const { C4_CHECK(level < m_num_levels); return m_levels[level].parser; }
+    /** the position in argv of the name of the command at a level, or
+     * -1 for the root */
+    int name_argi(size_t level) const { C4_CHECK(level < m_num_levels); return m_levels[level].argi - 1; }
+    /** whether the spec of the command at a level was compiled by this
+     * parser, ie the command had no Spec */
+    bool compiled(size_t level) const { C4_CHECK(level < m_num_levels); return m_levels[level].rt != nullptr; }
+
+    /** the selected command, ie that of the last level */
+    Command const& command() const { return command(m_num_levels - 1); }
+    /** the options of the selected command; its positional arguments
+     * are the arguments of the command */
+    CompactParser const& options() const { return options(m_num_levels - 1); }
+
+    /** print the help of the selected command, and its subcommands */
+    void help() const;
+
+private:
+
+    struct Level
+    {
+        Command const* command;
+        int argi;         ///< the position in argv of the first argument of this level
+        RuntimeSpec *rt;  ///< the spec compiled for the command, or null if it has a Spec
+        CompactParser parser;
+    };
+
+    void _parse(Command const& root, int argc, const char *const *argv, CommandRules const& rules, ParseError *err);
+    bool _push(Command const& cmd, int argi, int argc, const char *const *argv, CommandRules const& rules, ParseError *err);
+    void _destroy();
+
+private:
+
+    Level *m_levels;
+    size_t m_num_levels;
+    size_t m_cap_levels;
+    MemoryResource *m_mr;
+
+};
+
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_COMMAND_HPP_ */
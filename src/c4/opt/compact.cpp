@@ -0,0 +1,370 @@
+#include "c4/opt/compact.hpp"
+#include "c4/opt/suggest.hpp"
+#include <stdio.h>
+#include <string.h>
+
+namespace c4 {
+namespace opt {
+
+namespace {
+/** marks the policies of the indices already seen in the counting pass */
+enum : uint8_t { RETAIN_SEEN = 0x80 };
+} // anon
+
+/** counts the options to be stored and the positional arguments,
+ * without modifying argv */
+struct CompactParser::CountAction : public option::Parser::Action
+{
+    uint8_t *retain = nullptr; ///< one policy per index, or null for RETAIN_ALL
+    size_t num_occ = 0;
+    size_t num_posn = 0;
+
+    bool keepsArgs() const override { return true; }
+    bool perform(option::Option &option) override
+    {
+        if( ! retain)
+        {
+            ++num_occ;
+            return true;
+        }
+        // RETAIN_FIRST and RETAIN_LAST need a single record
+        uint8_t &r = retain[option.index()];
+        if(r == RETAIN_ALL)
+            ++num_occ;
+        else if(r == RETAIN_FIRST || r == RETAIN_LAST)
+        {
+            ++num_occ;
+            r |= RETAIN_SEEN;
+        }
+        return true;
+    }
+    void nonOption(const char **) override { ++num_posn; }
+    bool finished(int numargs, const char **) override
+    {
+        if(numargs > 0)
+            num_posn += (size_t)numargs;
+        return true;
+    }
+};
+
+struct CompactParser::StoreAction : public option::Parser::Action
+{
+    CompactParser *p;
+    size_t capacity;
+    uint8_t const* retain;
+    ParseError *err;
+
+    StoreAction(CompactParser *p_, size_t capacity_, uint8_t const* retain_, ParseError *err_) : p(p_), capacity(capacity_), retain(retain_), err(err_) {}
+
+    bool keepsArgs() const override { return true; }
+
+    bool performAt(option::Option &option, const char **args) override
+    {
+        Head &h = p->m_heads[option.index()];
+        if(retain && retain[option.index()] != RETAIN_ALL && (h.count != 0 || retain[option.index()] == RETAIN_COUNT))
+        {
+            // not retained; the last one replaces the stored one
+            if(retain[option.index()] == RETAIN_LAST)
+                _record(p->m_occ[h.first], option, args);
+            ++h.count;
+            return true;
+        }
+        if(p->m_num_occ >= capacity)
+            return false;
+        uint32_t pos = (uint32_t)p->m_num_occ++;
+        _record(p->m_occ[pos], option, args);
+        if(h.count++ == 0)
+            h.first = pos;
+        else
+            p->m_occ[h.last].next = pos;
+        h.last = pos;
+        return true;
+    }
+
+    void _record(Occurrence &occ, option::Option const& option, const char **args) const
+    {
+        occ.argi = (uint32_t)(args - p->m_argv);
+        occ.offset = (uint32_t)(option.name - *args);
+        occ.next = Occurrence::npos;
+        occ.desc = (uint16_t)(option.desc - p->m_usage);
+        occ.reserved = 0;
+        // the argument is attached iff it starts right after the name
+        // (and its '=', for long options)
+        const char *end = option.name + option.namelen;
+        if(option.arg == nullptr)
+            occ.arg = OCC_ARG_NONE;
+        else if(option.arg == end || (*end == '=' && option.arg == end + 1))
+            occ.arg = OCC_ARG_ATTACHED;
+        else
+            occ.arg = OCC_ARG_SEPARATE;
+    }
+
+    void nonOption(const char **args) override
+    {
+        p->m_posn[p->m_num_posn++] = (uint32_t)(args - p->m_argv);
+    }
+
+    bool finished(int numargs, const char **args) override
+    {
+        for(int k = 0; k < numargs; ++k)
+            p->m_posn[p->m_num_posn++] = (uint32_t)(args + k - p->m_argv);
+        return true;
+    }
+
+    void failed(option::Option const& option, const char **args, bool illegal) override
+    {
+        if(err)
+            *err = detail::make_parse_error(illegal, (int)(args - p->m_argv), (int)(option.name - *args), option.desc, p->m_usage);
+    }
+};
+
+
+//-----------------------------------------------------------------------------
+
+CompactParser::CompactParser(option::Descriptor const* usage, size_t num_usage_entries, int argc, const char **argv, MemoryResource *mr)
+    : CompactParser(usage, num_usage_entries, argc, argv, PARSE_POSIX, nullptr, mr)
+{
+}
+
+CompactParser::CompactParser(Spec const& spec, int argc, const char **argv, MemoryResource *mr)
+    : CompactParser(spec, argc, argv, PARSE_POSIX, nullptr, mr)
+{
+}
+
+CompactParser::CompactParser(option::Descriptor const* usage, size_t num_usage_entries, int argc, const char **argv, ParseError *err, MemoryResource *mr)
+    : CompactParser(usage, num_usage_entries, argc, argv, PARSE_POSIX, err, mr)
+{
+}
+
+CompactParser::CompactParser(Spec const& spec, int argc, const char **argv, ParseError *err, MemoryResource *mr)
+    : CompactParser(spec, argc, argv, PARSE_POSIX, err, mr)
+{
+}
+
+CompactParser::CompactParser(option::Descriptor const* usage, size_t num_usage_entries, int argc, const char *const *argv, ParseMode_e mode, ParseError *err, MemoryResource *mr)
+    : CompactParser(usage, num_usage_entries, argc, argv, mode, with_retention, {}, err, mr)
+{
+}
+
+CompactParser::CompactParser(Spec const& spec, int argc, const char *const *argv, ParseMode_e mode, ParseError *err, MemoryResource *mr)
+    : CompactParser(spec, argc, argv, mode, with_retention, {}, err, mr)
+{
+}
+
+CompactParser::CompactParser(option::Descriptor const* usage, size_t num_usage_entries, int argc, const char *const *argv, ParseMode_e mode, with_retention_t, std::initializer_list<Retention> retention, ParseError *err, MemoryResource *mr)
+    :
+    m_usage(usage),
+    m_num_usage(num_usage_entries),
+    m_spec(),
+    m_argc(argc),
+    m_argv(argv),
+    m_heads(nullptr),
+    m_num_heads(0),
+    m_occ(nullptr),
+    m_num_occ(0),
+    m_posn(nullptr),
+    m_num_posn(0),
+    m_mem_size(0),
+    m_mr(mr)
+{
+    _parse(nullptr, mode, retention, err);
+}
+
+CompactParser::CompactParser(Spec const& spec, int argc, const char *const *argv, ParseMode_e mode, with_retention_t, std::initializer_list<Retention> retention, ParseError *err, MemoryResource *mr)
+    :
+    m_usage(spec.usage()),
+    m_num_usage(spec.num_usage_entries()),
+    m_spec(spec),
+    m_argc(argc),
+    m_argv(argv),
+    m_heads(nullptr),
+    m_num_heads(0),
+    m_occ(nullptr),
+    m_num_occ(0),
+    m_posn(nullptr),
+    m_num_posn(0),
+    m_mem_size(0),
+    m_mr(mr)
+{
+    _parse(&m_spec, mode, retention, err);
+}
+
+CompactParser::CompactParser(CompactParser &&that)
+    :
+    m_usage(that.m_usage),
+    m_num_usage(that.m_num_usage),
+    m_spec(that.m_spec),
+    m_argc(that.m_argc),
+    m_argv(that.m_argv),
+    m_heads(that.m_heads),
+    m_num_heads(that.m_num_heads),
+    m_occ(that.m_occ),
+    m_num_occ(that.m_num_occ),
+    m_posn(that.m_posn),
+    m_num_posn(that.m_num_posn),
+    m_mem_size(that.m_mem_size),
+    m_mr(that.m_mr)
+{
+    that.m_heads = nullptr;
+    that.m_occ = nullptr;
+    that.m_posn = nullptr;
+    that.m_mem_size = 0;
+}
+
+CompactParser::~CompactParser()
+{
+    if(m_heads)
+    {
+        m_mr->deallocate(m_heads, m_mem_size, alignof(Occurrence));
+        m_heads = nullptr;
+        m_occ = nullptr;
+        m_posn = nullptr;
+    }
+}
+
+void CompactParser::_parse(Spec const* spec, ParseMode_e mode, std::initializer_list<Retention> retention, ParseError *err)
+{
+    option::Index const* index = spec ? &spec->index : nullptr;
+    const bool gnu = (mode == PARSE_GNU);
+    // the actions never modify argv (see keepsArgs())
+    const char **argv = const_cast<const char**>(m_argv);
+    m_num_heads = index ? index->options_max : option::Stats(m_usage, 0, (const char**)nullptr).options_max;
+    // the policies are needed only while parsing, but the counting
+    // pass needs them before the size of the results is known: the
+    // block of the results is grown from them, so that an arena grows
+    // it in place, and they are moved to its end
+    uint8_t *retain = nullptr;
+    const size_t retain_size = retention.size() ? m_num_heads : 0;
+    if(retain_size)
+    {
+        for(Retention const& r : retention)
+            C4_CHECK_MSG(r.index >= 0 && size_t(r.index) < m_num_heads && r.policy <= RETAIN_COUNT, "bad retention for option index %d", r.index);
+        retain = (uint8_t*) m_mr->allocate(retain_size, alignof(Occurrence));
+        memset(retain, RETAIN_ALL, retain_size);
+        for(Retention const& r : retention)
+            retain[r.index] = r.policy;
+    }
+    // count first, to allocate the records in a single block of the exact size
+    // the positions of the descriptors must fit in Occurrence::desc;
+    // otherwise nothing is parsed, and the results are empty
+    const bool fits = m_num_usage <= Occurrence::max_usage_entries;
+    CountAction counter;
+    counter.retain = retain;
+    if(fits)
+        option::Parser::workhorse(gnu, m_usage, m_argc, argv, counter, /*single_minus_longopt*/false, /*print_errors*/false, /*min_abbr_len*/0, index);
+    if(retain)
+        for(size_t i = 0; i < m_num_heads; ++i)
+            retain[i] &= (uint8_t)~RETAIN_SEEN;
+    size_t capacity = counter.num_occ;
+    const size_t results_size = m_num_heads * sizeof(Head) + capacity * sizeof(Occurrence) + counter.num_posn * sizeof(uint32_t);
+    m_mem_size = results_size + retain_size;
+    if(retain)
+    {
+        char *block = (char*) m_mr->reallocate(retain, retain_size, m_mem_size, alignof(Occurrence));
+        memmove(block + results_size, block, retain_size);
+        retain = (uint8_t*) (block + results_size);
+        m_heads = (Head*) block;
+    }
+    else
+    {
+        m_heads = (Head*) m_mr->allocate(m_mem_size, alignof(Occurrence));
+    }
+    m_occ = (Occurrence*) (m_heads + m_num_heads);
+    m_posn = (uint32_t*) (m_occ + capacity);
+    for(size_t i = 0; i < m_num_heads; ++i)
+        m_heads[i] = {Occurrence::npos, Occurrence::npos, 0};
+    if(err)
+        *err = {PARSE_OK, -1, 0, -1};
+    if( ! fits)
+    {
+        ParseError e = {PARSE_TOO_MANY_DESCRIPTORS, -1, 0, -1};
+        if(err)
+        {
+            *err = e;
+            return;
+        }
+        char buf[128];
+        format_error(substr(buf, sizeof(buf)), e, m_usage, m_argc, argv);
+        fprintf(stderr, "%s\n", buf);
+        C4_ERROR("parser error");
+    }
+    ParseError printed_err = {PARSE_OK, -1, 0, -1}; // to suggest names for an unknown option
+    StoreAction action(this, capacity, retain, err ? err : &printed_err);
+    bool ok = option::Parser::workhorse(gnu, m_usage, m_argc, argv, action, /*single_minus_longopt*/false, /*print_errors*/err == nullptr, /*min_abbr_len*/0, index);
+    if( ! ok && ! err)
+    {
+        if(printed_err.argi >= 0 && printed_err.argi < m_argc)
+            detail::print_suggestions(printed_err, m_usage, to_csubstr(m_argv[printed_err.argi]));
+        help();
+        C4_ERROR("parser error");
+    }
+}
+
+option::Option CompactParser::_view(uint32_t pos) const
+{
+    if(pos == Occurrence::npos)
+        return option::Option();
+    C4_ASSERT(pos < m_num_occ);
+    return view(m_occ[pos]);
+}
+
+option::Option CompactParser::view(Occurrence const& occ) const
+{
+    const char *name = m_argv[occ.argi] + occ.offset;
+    option::Option opt(&m_usage[occ.desc], name, nullptr);
+    switch(occ.arg)
+    {
+    case OCC_ARG_ATTACHED:
+        // short options are not given with their '-'; long options are
+        opt.arg = name[0] == '-' ? name + opt.namelen + 1 : name + 1;
+        break;
+    case OCC_ARG_SEPARATE:
+        opt.arg = m_argv[occ.argi + 1];
+        break;
+    default:
+        break;
+    }
+    return opt;
+}
+
+const char* CompactParser::operator() (int i) const
+{
+    option::Option opt = (*this)[i];
+    C4_CHECK_MSG(opt.arg, "error in option %d: '%.*s'", i, opt.namelen, opt.name);
+    return opt.arg;
+}
+
+void CompactParser::help() const
+{
+    if(m_spec.index.usage)
+        write_all(stdout, m_spec.help_text(/*columns*/80));
+    else
+        print_help(m_usage, /*columns*/80, stdout);
+}
+
+void CompactParser::check_mandatory(std::initializer_list<int> mandatory_options) const
+{
+    ParseError err;
+    if( ! check_mandatory(mandatory_options, &err))
+    {
+        char buf[256];
+        format_error(substr(buf, sizeof(buf)), err, m_usage, m_argc, const_cast<const char**>(m_argv));
+        fprintf(stderr, "%s\n", buf);
+        C4_ERROR("mandatory options were missing");
+    }
+}
+
+bool CompactParser::check_mandatory(std::initializer_list<int> mandatory_options, ParseError *err) const
+{
+    for(int index : mandatory_options)
+    {
+        if(count(index) != 0)
+            continue;
+        *err = {PARSE_MISSING_MANDATORY, -1, 0, detail::find_descriptor(m_usage, m_num_usage, index)};
+        return false;
+    }
+    return true;
+}
+
+} // namespace opt
+} // namespace c4
@@ -0,0 +1,252 @@
+#ifndef _C4_OPT_COMPACT_HPP_
+#define _C4_OPT_COMPACT_HPP_
+
+#include "c4/opt/opt.hpp"
+#include <iterator>
+
+/** @file compact.hpp a parser storing its results as compact records
+ * which refer to argv by position, for very long command lines */
+
+namespace c4 {
+namespace opt {
+
+typedef enum : uint8_t {
+    OCC_ARG_NONE = 0,   ///< the option has no argument
+    OCC_ARG_ATTACHED,   ///< the argument is in the same token as the option (-lval, --level=val)
+    OCC_ARG_SEPARATE,   ///< the argument is the token following the option (-l val, --level val)
+} OccurrenceArg_e;
+
+/** which occurrences of an option are stored by CompactParser. The
+ * count of occurrences is always kept. */
+typedef enum : uint8_t {
+    RETAIN_ALL = 0,  ///< store every occurrence (the default)
+    RETAIN_FIRST,    ///< store only the first occurrence
+    RETAIN_LAST,     ///< store only the last occurrence
+    RETAIN_COUNT,    ///< store no occurrence; only count them
+} Retain_e;
+
+/** the retention policy for an option index */
+struct Retention
+{
+    int index;
+    Retain_e policy;
+};
+
+/** selects the CompactParser constructors taking retention policies.
+ * As with std::in_place_t, its default constructor is explicit, so
+ * that an empty `{}` for the error of the other constructors is not
+ * ambiguous. */
+struct with_retention_t
+{
+    explicit with_retention_t() = default;
+};
+constexpr const with_retention_t with_retention{};
+
+/** A compact record of one occurrence of an option. Instead of
+ * pointers, it refers to argv by 32-bit positions, so that it takes
+ * 16 bytes where an option::Option takes 40 on 64-bit platforms. Use
+ * CompactParser::view() to get the equivalent option::Option. */
+struct Occurrence
+{
+    enum : uint32_t {
+        npos = uint32_t(-1),
+        max_usage_entries = 0xffffu,  ///< the most entries in a usage array, so that the positions fit in desc
+    };
+
+    uint32_t argi;    ///< position in argv of the token with the option
+    uint32_t offset;  ///< offset of the option's name within its token
+    uint32_t next;    ///< position of the next occurrence with the same index, or npos
+    uint16_t desc;    ///< position of the option's descriptor in the usage array; see max_usage_entries
+    uint8_t  arg;     ///< where the argument is: one of OccurrenceArg_e
+    uint8_t  reserved;
+};
+
+
+/** Parses like Parser, but instead of option::Option objects it stores
+ * one Occurrence per option given in argv, plus a few words per option
+ * index. option::Option views are materialized on demand. This cuts the
+ * memory needed for results to less than half, which matters for
+ * command lines with millions of tokens (eg from response files).
+ *
+ * argv is never modified, in any mode: the positions of the positional
+ * arguments are recorded instead, so that several threads can parse
+ * the same argv at the same time. argv is not copied, and must
+ * outlive the parser. The results are allocated in a single block,
+ * sized by a counting pass over argv.
+ *
+ * Options which are given many times but whose occurrences are not
+ * all needed (eg `--level` where the last one wins, or `-v` which is
+ * only counted) can be given a retention policy, so that the skipped
+ * occurrences take no memory and are not linked:
+ *
+ * @code
+ * CompactParser p(usage, C4_COUNTOF(usage), argc, argv, PARSE_POSIX, with_retention,
+ *                 {{LEVEL, RETAIN_LAST}, {VERBOSE, RETAIN_COUNT}});
+ * p.count(VERBOSE); // all the occurrences are counted
+ * p(LEVEL);         // the last --level
+ * @endcode
+ *
+ * A RETAIN_LAST occurrence overwrites the previous one in place, so in
+ * opts_args() it appears where the first occurrence was. With
+ * RETAIN_COUNT, operator[] converts to false even if count() > 0.
+ *
+ * The usage may have at most Occurrence::max_usage_entries entries
+ * (65535). With more, nothing is parsed, and the error is
+ * PARSE_TOO_MANY_DESCRIPTORS. */
+class CompactParser
+{
+public:
+
+    /** parse; on error, print the help and abort, like Parser */
+    CompactParser(option::Descriptor const* usage, size_t num_usage_entries, int argc, const char **argv, MemoryResource *mr=get_memory_resource());
+    CompactParser(Spec const& spec, int argc, const char **argv, MemoryResource *mr=get_memory_resource());
+    /** parse without printing or aborting; the error (if any) is
+     * recorded in err. See Parser. */
+    CompactParser(option::Descriptor const* usage, size_t num_usage_entries, int argc, const char **argv, ParseError *err, MemoryResource *mr=get_memory_resource());
+    CompactParser(Spec const& spec, int argc, const char **argv, ParseError *err, MemoryResource *mr=get_memory_resource());
+    /** parse in the given mode. Parsing is in POSIX mode otherwise. */
+    CompactParser(option::Descriptor const* usage, size_t num_usage_entries, int argc, const char *const *argv, ParseMode_e mode, ParseError *err=nullptr, MemoryResource *mr=get_memory_resource());
+    CompactParser(Spec const& spec, int argc, const char *const *argv, ParseMode_e mode, ParseError *err=nullptr, MemoryResource *mr=get_memory_resource());
+    /** parse in the given mode, storing the occurrences of the given
+     * option indices according to their retention policy. The other
+     * indices use RETAIN_ALL. */
+    CompactParser(option::Descriptor const* usage, size_t num_usage_entries, int argc, const char *const *argv, ParseMode_e mode, with_retention_t, std::initializer_list<Retention> retention, ParseError *err=nullptr, MemoryResource *mr=get_memory_resource());
+    CompactParser(Spec const& spec, int argc, const char *const *argv, ParseMode_e mode, with_retention_t, std::initializer_list<Retention> retention, ParseError *err=nullptr, MemoryResource *mr=get_memory_resource());
+
+    ~CompactParser();
+
+    CompactParser(CompactParser const&) = delete;
+    CompactParser& operator= (CompactParser const&) = delete;
+    CompactParser(CompactParser &&that);
+    CompactParser& operator= (CompactParser &&) = delete;
+
+public:
+
+    /** the number of times the option with index i was given */
+    int count(int i) const { C4_CHECK(size_t(i) < m_num_heads); return (int)m_heads[i].count; }
+    /** a view of the first occurrence of the option with index i. It
+     * converts to false if the option was not given. */
+    option::Option operator[] (int i) const { C4_CHECK(size_t(i) < m_num_heads); return _view(m_heads[i].first); }
+    /** the argument of the first occurrence of the option with index i */
+    const char* operator() (int i) const;
+
+    option::Descriptor const* usage() const { return m_usage; }
+    /** the number of option indices, ie one more than the greatest index in the usage */
+    size_t num_indices() const { return m_num_heads; }
+
+    /** all the stored occurrences, in the order given in argv */
+    Occurrence const* occurrences() const { return m_occ; }
+    size_t num_occurrences() const { return m_num_occ; }
+
+    /** materialize the option::Option for an occurrence. The view is
+     * not linked to the other occurrences: use opts(i) for that. */
+    option::Option view(Occurrence const& occ) const;
+
+    void help() const;
+    void check_mandatory(std::initializer_list<int> mandatory_options) const;
+    bool check_mandatory(std::initializer_list<int> mandatory_options, ParseError *err) const;
+
+    /** the positions in argv of the positional arguments */
+    uint32_t const* posn_indices() const { return m_posn; }
+    size_t num_posn() const { return m_num_posn; }
+
+    /** the number of bytes allocated for the results, and for the
+     * retention policies if any were given */
+    size_t memory_size() const { return m_mem_size; }
+
+public:
+
+    struct option_iterator
+    {
+        CompactParser const* p;
+        uint32_t pos;
+        bool chained; ///< whether to follow the occurrences with the same index
+        using value_type = option::Option;
+        option::Option operator* () const { return p->_view(pos); }
+        option_iterator& operator++ () { pos = chained ? p->m_occ[pos].next : pos + 1; return *this; }
+        bool operator!= (option_iterator that) const { return pos != that.pos; }
+        bool operator== (option_iterator that) const { return pos == that.pos; }
+    };
+
+    struct positional_arg_iterator
+    {
+        const char *const *argv;
+        uint32_t const* pos;
+        using iterator_category = std::input_iterator_tag;
+        using value_type = const char*;
+        using difference_type = ptrdiff_t;
+        using pointer = const char *const*;
+        using reference = const char*;
+        const char* operator* () const { return argv[*pos]; }
+        positional_arg_iterator& operator++ () { ++pos; return *this; }
+        bool operator!= (positional_arg_iterator that) const { return pos != that.pos; }
+        bool operator== (positional_arg_iterator that) const { return pos == that.pos; }
+    };
+
+    template <class It>
+    struct iterator_range
+    {
+        It begin_, end_;
+        It begin() const { return begin_; }
+        It end() const { return end_; }
+    };
+
+    /** iterate through the occurrences of the option with index i */
+    iterator_range<option_iterator> opts(int i) const
+    {
+        C4_CHECK(size_t(i) < m_num_heads);
+        return {{this, m_heads[i].first, true}, {this, Occurrence::npos, true}};
+    }
+
+    /** iterate through the options in order, as given through argv */
+    iterator_range<option_iterator> opts_args() const
+    {
+        return {{this, 0, false}, {this, (uint32_t)m_num_occ, false}};
+    }
+
+    /** iterate through the positional arguments (ie, those without options) */
+    iterator_range<positional_arg_iterator> posn_args() const
+    {
+        return {{m_argv, m_posn}, {m_argv, m_posn + m_num_posn}};
+    }
+
+    /** iterate through the raw (argc,argv) arguments */
+    iterator_range<const char *const*> raw_args() const
+    {
+        return {m_argv, m_argv + m_argc};
+    }
+
+private:
+
+    struct Head
+    {
+        uint32_t first, last, count;
+    };
+    struct CountAction;
+    struct StoreAction;
+
+    void _parse(Spec const* spec, ParseMode_e mode, std::initializer_list<Retention> retention, ParseError *err);
+    option::Option _view(uint32_t pos) const;
+
+private:
+
+    option::Descriptor const* m_usage;
+    size_t           m_num_usage;
+    Spec             m_spec;  ///< spec.index.usage is null when parsing from a plain usage
+    int              m_argc;
+    const char *const *m_argv;
+    Head            *m_heads;
+    size_t           m_num_heads;
+    Occurrence      *m_occ;
+    size_t           m_num_occ;
+    uint32_t        *m_posn;
+    size_t           m_num_posn;
+    size_t           m_mem_size;
+    MemoryResource  *m_mr;
+
+};
+
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_COMPACT_HPP_ */
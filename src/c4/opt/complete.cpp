@@ -0,0 +1,462 @@
+#include "c4/opt/complete.hpp"
+#include "c4/opt/help.hpp"
+#include <algorithm>
+#include <string.h>
+
+#ifdef C4_WIN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+
+namespace c4 {
+namespace opt {
+
+namespace {
+
+C4_ALWAYS_INLINE bool _word_less(CompletionWord const& a, CompletionWord const& b)
+{
+    int cmp = memcmp(a.str, b.str, a.len < b.len ? a.len : b.len);
+    if(cmp != 0)
+        return cmp < 0;
+    if(a.len != b.len)
+        return a.len < b.len;
+    return a.desc < b.desc;
+}
+
+/** compare a word with a prefix, looking only at the first prefix.len
+ * characters of the word */
+C4_ALWAYS_INLINE int _prefix_cmp(CompletionWord const& w, csubstr prefix)
+{
+    int cmp = memcmp(w.str, prefix.str, w.len < prefix.len ? w.len : prefix.len);
+    if(cmp != 0 || w.len >= prefix.len)
+        return cmp;
+    return -1;
+}
+
+/** appends to a buffer snprintf-style, counting the length needed */
+struct OutWriter
+{
+    substr buf;
+    size_t len;
+    void write(csubstr s)
+    {
+        if(len < buf.len && s.len)
+        {
+            size_t n = s.len < buf.len - len ? s.len : buf.len - len;
+            memcpy(buf.str + len, s.str, n);
+        }
+        len += s.len;
+    }
+    void write(char c)
+    {
+        if(len < buf.len)
+            buf.str[len] = c;
+        ++len;
+    }
+    size_t finish()
+    {
+        if(buf.len)
+            buf.str[len < buf.len ? len : buf.len - 1] = '\0';
+        return len;
+    }
+};
+
+/** writes one candidate per line in the format of a shell */
+struct CandidateWriter
+{
+    OutWriter w;
+    Shell_e shell;
+
+    /** a piece of the candidate; zsh's _describe needs its colons escaped */
+    void piece(csubstr s)
+    {
+        if(shell != SHELL_ZSH)
+        {
+            w.write(s);
+            return;
+        }
+        for(size_t i = 0; i < s.len; ++i)
+        {
+            if(s.str[i] == ':')
+                w.write('\\');
+            w.write(s.str[i]);
+        }
+    }
+    void end(csubstr description)
+    {
+        if(description.len && shell != SHELL_BASH)
+        {
+            w.write(shell == SHELL_ZSH ? ':' : '\t');
+            w.write(description);
+        }
+        w.write('\n');
+    }
+};
+
+/** the description of an option: the text of its help after the first
+ * tab, up to the end of that column or line */
+csubstr _description(option::Descriptor const& d)
+{
+    if(d.help == nullptr)
+        return {};
+    const char *s = strchr(d.help, '\t');
+    if(s == nullptr)
+        return {};
+    ++s;
+    while(*s == ' ')
+        ++s;
+    size_t len = strcspn(s, "\t\n\v");
+    while(len && s[len - 1] == ' ')
+        --len;
+    return csubstr(s, len);
+}
+
+/** @return whether the option of descriptor d takes a value, and its
+ * completer if it has one */
+bool _takes_value(CompletionTable const& table, int32_t d, cspan<ValueCompleter> values, ValueCompleter const** vc)
+{
+    *vc = nullptr;
+    if(d < 0)
+        return false;
+    option::Descriptor const& desc = table.usage[d];
+    for(ValueCompleter const& v : values)
+    {
+        if(v.index == desc.index)
+        {
+            *vc = &v;
+            return true;
+        }
+    }
+    return desc.check_arg == &c4::opt::required
+        || desc.check_arg == &c4::opt::nonempty
+        || desc.check_arg == &c4::opt::integer;
+}
+
+void _complete_paths(CandidateWriter &out, csubstr pre, csubstr prefix, bool dirs_only)
+{
+    size_t slash = prefix.len;
+    while(slash > 0 && prefix.str[slash - 1] != '/')
+        --slash;
+    const csubstr dir = prefix.first(slash);
+    const csubstr base = prefix.sub(slash);
+    char path[1024];
+    if(dir.len + 2 > sizeof(path))
+        return;
+    memcpy(path, dir.str, dir.len);
+    auto matches = [&](const char *name, size_t len) {
+        if(len < base.len || memcmp(name, base.str, base.len) != 0)
+            return false;
+        if(name[0] == '.' && (len == 1 || (len == 2 && name[1] == '.')))
+            return false;
+        // hidden files only when asked for
+        return name[0] != '.' || base.len > 0;
+    };
+    auto emit = [&](const char *name, size_t len, bool is_dir) {
+        if(dirs_only && ! is_dir)
+            return;
+        out.piece(pre);
+        out.piece(dir);
+        out.piece(csubstr(name, len));
+        if(is_dir)
+            out.piece("/");
+        out.end({});
+    };
+    #ifdef C4_WIN
+    path[dir.len] = '*';
+    path[dir.len + 1] = '\0';
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileA(path, &fd);
+    if(h == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        size_t len = strlen(fd.cFileName);
+        if(matches(fd.cFileName, len))
+            emit(fd.cFileName, len, (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+    } while(FindNextFileA(h, &fd));
+    FindClose(h);
+    #else
+    path[dir.len] = '\0';
+    DIR *dp = opendir(dir.len ? path : ".");
+    if( ! dp)
+        return;
+    while(struct dirent *e = readdir(dp))
+    {
+        size_t len = strlen(e->d_name);
+        if( ! matches(e->d_name, len))
+            continue;
+        bool is_dir = false;
+        #ifdef DT_DIR
+        is_dir = e->d_type == DT_DIR;
+        if(e->d_type == DT_UNKNOWN || e->d_type == DT_LNK)
+        #endif
+        {
+            // follow links, as the shells do
+            char full[2048];
+            if(dir.len + len + 1 > sizeof(full))
+                continue;
+            memcpy(full, dir.str, dir.len);
+            memcpy(full + dir.len, e->d_name, len + 1);
+            struct stat st;
+            is_dir = stat(full, &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        emit(e->d_name, len, is_dir);
+    }
+    closedir(dp);
+    #endif
+}
+
+void _complete_value(CandidateWriter &out, ValueCompleter const* vc, csubstr pre, csubstr prefix)
+{
+    if(vc == nullptr)
+        return;
+    switch(vc->kind)
+    {
+    case COMPLETE_CHOICES:
+        for(const char *const* c = vc->choices; c && *c; ++c)
+        {
+            csubstr choice = to_csubstr(*c);
+            if(choice.begins_with(prefix))
+            {
+                out.piece(pre);
+                out.piece(choice);
+                out.end({});
+            }
+        }
+        break;
+    case COMPLETE_FILES:
+    case COMPLETE_DIRS:
+        _complete_paths(out, pre, prefix, vc->kind == COMPLETE_DIRS);
+        break;
+    default:
+        break;
+    }
+}
+
+} // anon
+
+
+//-----------------------------------------------------------------------------
+
+size_t CompletionTable::prefix_range(csubstr prefix, size_t *first) const
+{
+    CompletionWord const* b = words;
+    CompletionWord const* e = words + num_words;
+    CompletionWord const* lo = std::lower_bound(b, e, prefix, [](CompletionWord const& w, csubstr p){ return _prefix_cmp(w, p) < 0; });
+    CompletionWord const* hi = std::upper_bound(lo, e, prefix, [](csubstr p, CompletionWord const& w){ return _prefix_cmp(w, p) > 0; });
+    *first = (size_t)(lo - b);
+    return (size_t)(hi - lo);
+}
+
+int32_t CompletionTable::find(csubstr spelling) const
+{
+    size_t first;
+    size_t num = prefix_range(spelling, &first);
+    // the exact spelling sorts before the longer ones
+    if(num && words[first].len == spelling.len)
+        return (int32_t)words[first].desc;
+    return -1;
+}
+
+
+//-----------------------------------------------------------------------------
+
+CompletionIndex::CompletionIndex(option::Descriptor const* usage, MemoryResource *mr)
+    : m_table{usage, nullptr, 0}, m_size(0), m_mr(mr)
+{
+    size_t num_words = 0, num_chars = 0;
+    for(size_t d = 0; usage[d].shortopt != nullptr; ++d)
+    {
+        size_t ns = strlen(usage[d].shortopt);
+        num_words += ns;
+        num_chars += 3 * ns; // "-x\0"
+        if(usage[d].longopt != nullptr && usage[d].longopt[0] != 0)
+        {
+            ++num_words;
+            num_chars += strlen(usage[d].longopt) + 3; // "--name\0"
+        }
+    }
+    if( ! num_words)
+        return;
+    m_size = num_words * sizeof(CompletionWord) + num_chars;
+    CompletionWord *words = (CompletionWord*) m_mr->allocate(m_size, alignof(CompletionWord));
+    char *chars = (char*)(words + num_words);
+    size_t nw = 0;
+    for(size_t d = 0; usage[d].shortopt != nullptr; ++d)
+    {
+        for(const char *c = usage[d].shortopt; *c; ++c)
+        {
+            words[nw++] = CompletionWord{chars, 2u, (uint32_t)d};
+            *chars++ = '-';
+            *chars++ = *c;
+            *chars++ = '\0';
+        }
+        if(usage[d].longopt != nullptr && usage[d].longopt[0] != 0)
+        {
+            size_t len = strlen(usage[d].longopt);
+            words[nw++] = CompletionWord{chars, (uint32_t)(len + 2), (uint32_t)d};
+            *chars++ = '-';
+            *chars++ = '-';
+            memcpy(chars, usage[d].longopt, len + 1);
+            chars += len + 1;
+        }
+    }
+    // sorted by spelling, then by descriptor: keep the first of each spelling
+    std::sort(words, words + nw, _word_less);
+    size_t nu = 0;
+    for(size_t i = 0; i < nw; ++i)
+    {
+        if(nu && words[nu - 1].len == words[i].len && memcmp(words[nu - 1].str, words[i].str, words[i].len) == 0)
+            continue;
+        words[nu++] = words[i];
+    }
+    m_table.words = words;
+    m_table.num_words = nu;
+}
+
+CompletionIndex::CompletionIndex(CompletionIndex &&that)
+    : m_table(that.m_table), m_size(that.m_size), m_mr(that.m_mr)
+{
+    that.m_table.words = nullptr;
+    that.m_table.num_words = 0;
+    that.m_size = 0;
+}
+
+CompletionIndex::~CompletionIndex()
+{
+    if(m_table.words)
+    {
+        m_mr->deallocate((void*)m_table.words, m_size, alignof(CompletionWord));
+        m_table.words = nullptr;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+size_t complete(substr buf, CompletionTable const& table, Shell_e shell, int num_words, const char **words, cspan<ValueCompleter> values)
+{
+    CandidateWriter out = {{buf, 0}, shell};
+    if(num_words <= 0)
+        return out.w.finish();
+    const int last = num_words - 1;
+    const csubstr cur = to_csubstr(words[last]);
+    // find what the last word is, from the words before it
+    int32_t value_of = -1;
+    ValueCompleter const* vc = nullptr;
+    for(int i = 0; i < last; ++i)
+    {
+        const csubstr w = to_csubstr(words[i]);
+        if(w == "--")
+            return out.w.finish(); // no more options
+        if(w.len > 2 && w.str[0] == '-' && w.str[1] == '-')
+        {
+            if(w.find('=') != csubstr::npos)
+                continue;
+            int32_t d = table.find(w);
+            if( ! _takes_value(table, d, values, &vc))
+                continue;
+            // bash gives --name=val as three words
+            if(shell == SHELL_BASH && i + 1 < last && to_csubstr(words[i + 1]) == "=")
+                ++i;
+            if(i + 1 == last)
+            {
+                value_of = d;
+                break;
+            }
+            ++i;
+        }
+        else if(w.len > 1 && w.str[0] == '-')
+        {
+            // a group of short options: the first taking a value takes
+            // the rest of the word, or the next word
+            for(size_t c = 1; c < w.len; ++c)
+            {
+                const char sp[2] = {'-', w.str[c]};
+                int32_t d = table.find(csubstr(sp, 2));
+                if( ! _takes_value(table, d, values, &vc))
+                    continue;
+                if(c + 1 == w.len)
+                {
+                    if(i + 1 == last)
+                        value_of = d;
+                    else
+                        ++i;
+                }
+                break;
+            }
+            if(value_of >= 0)
+                break;
+        }
+    }
+    if(value_of >= 0)
+    {
+        // bash: the cursor is right after the '=' of --name=
+        csubstr prefix = (shell == SHELL_BASH && cur == "=") ? csubstr("") : cur;
+        _complete_value(out, vc, csubstr(""), prefix);
+        return out.w.finish();
+    }
+    if(cur.len < 1 || cur.str[0] != '-')
+        return out.w.finish();
+    size_t eq = cur.find('=');
+    if(eq != csubstr::npos)
+    {
+        if(cur.len > 2 && cur.str[1] == '-' && _takes_value(table, table.find(cur.first(eq)), values, &vc))
+            _complete_value(out, vc, cur.first(eq + 1), cur.sub(eq + 1));
+        return out.w.finish();
+    }
+    size_t first;
+    size_t num = table.prefix_range(cur, &first);
+    for(size_t i = first; i < first + num; ++i)
+    {
+        CompletionWord const& cw = table.words[i];
+        out.piece(csubstr(cw.str, cw.len));
+        out.end(_description(table.usage[cw.desc]));
+    }
+    return out.w.finish();
+}
+
+bool complete_main(CompletionTable const& table, int argc, const char **argv, cspan<ValueCompleter> values, FILE *out)
+{
+    if(argc < 2 || argv[1] == nullptr)
+        return false;
+    const csubstr flag = to_csubstr(argv[1]);
+    Shell_e shell = SHELL_BASH;
+    if(flag == "--complete=zsh")
+        shell = SHELL_ZSH;
+    else if(flag == "--complete=fish")
+        shell = SHELL_FISH;
+    else if(flag != "--complete" && flag != "--complete=bash")
+        return false;
+    // no words at all: complete an empty word
+    const char *empty[] = {""};
+    const int num_words = argc > 2 ? argc - 2 : 1;
+    const char **words = argc > 2 ? argv + 2 : empty;
+    char stackbuf[4096];
+    size_t len = complete(substr(stackbuf, sizeof(stackbuf)), table, shell, num_words, words, values);
+    if(len < sizeof(stackbuf))
+    {
+        write_all(out, csubstr(stackbuf, len));
+        return true;
+    }
+    MemoryResource *mr = get_memory_resource();
+    char *buf = (char*) mr->allocate(len + 1, 1);
+    // a directory may have changed in between: write what fits
+    size_t len2 = complete(substr(buf, len + 1), table, shell, num_words, words, values);
+    write_all(out, csubstr(buf, len2 < len ? len2 : len));
+    mr->deallocate(buf, len + 1, 1);
+    return true;
+}
+
+bool complete_main(option::Descriptor const* usage, int argc, const char **argv, cspan<ValueCompleter> values, FILE *out)
+{
+    if(argc < 2 || argv[1] == nullptr || ! to_csubstr(argv[1]).begins_with("--complete"))
+        return false;
+    CompletionIndex ix(usage);
+    return complete_main(ix.table(), argc, argv, values, out);
+}
+
+} // namespace opt
+} // namespace c4
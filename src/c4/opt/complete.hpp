@@ -0,0 +1,140 @@
+#ifndef _C4_OPT_COMPLETE_HPP_
+#define _C4_OPT_COMPLETE_HPP_
+
+#include "c4/opt/opt.hpp"
+#include <c4/span.hpp>
+#include <stdio.h>
+
+/** @file complete.hpp shell completion of the options and their
+ * values, answered from a sorted table of the option spellings without
+ * building a parser.
+ *
+ * A program handles `prog --complete[=bash|zsh|fish] <words>...` by
+ * calling complete_main() first thing in main(). The words are those
+ * after the program name, up to and including the word under the
+ * cursor, which may be empty. For example:
+ *
+ * bash:
+ *     _prog() { local IFS=$'\n'; COMPREPLY=($(prog --complete=bash "${COMP_WORDS[@]:1:COMP_CWORD}")); }
+ *     complete -o default -F _prog prog
+ * zsh:
+ *     _prog() { local -a c; c=("${(@f)$(prog --complete=zsh "${(@)words[2,CURRENT]}")}"); _describe 'prog' c || _files; }
+ *     compdef _prog prog
+ * fish:
+ *     complete -c prog -f -a '(prog --complete=fish (commandline -opc)[2..-1] (commandline -ct))'
+ */
+
+namespace c4 {
+namespace opt {
+
+/** the output formats of the completions */
+typedef enum : uint8_t {
+    SHELL_BASH,  ///< one candidate per line, for COMPREPLY
+    SHELL_ZSH,   ///< one "candidate:description" per line, for _describe; ':' in the candidate is escaped
+    SHELL_FISH,  ///< one "candidate<TAB>description" per line
+} Shell_e;
+
+/** how the values of an option are completed */
+typedef enum : uint8_t {
+    COMPLETE_NONE,     ///< the option takes a value, which is not completed
+    COMPLETE_CHOICES,  ///< one of a list of strings
+    COMPLETE_FILES,    ///< a path to a file or directory
+    COMPLETE_DIRS,     ///< a path to a directory
+} ValueKind_e;
+
+/** the completer of the values of an option */
+struct ValueCompleter
+{
+    unsigned index;              ///< the option index, as in option::Descriptor::index
+    ValueKind_e kind;
+    const char *const* choices;  ///< for COMPLETE_CHOICES: the choices, ending with a null
+};
+
+/** a spelling of an option, eg "-v" or "--verbose" */
+struct CompletionWord
+{
+    const char *str;  ///< null-terminated
+    uint32_t len;
+    uint32_t desc;    ///< the position of the descriptor in the usage array
+};
+
+
+/** The spellings of the options of a usage, sorted, so that the
+ * options starting with a prefix are a contiguous range found with two
+ * binary searches. Each spelling appears once, with the first
+ * descriptor having it.
+ *
+ * This is plain data which does not own any memory, so that it can be
+ * generated at build time by c4opt-specgen, as the `completion` table.
+ * To build it at runtime, use CompletionIndex. */
+struct CompletionTable
+{
+    option::Descriptor const* usage;
+    CompletionWord const* words;
+    size_t num_words;
+
+    /** the spellings starting with prefix are words[*first, *first + ret)
+     * @return the number of them */
+    size_t prefix_range(csubstr prefix, size_t *first) const;
+    /** @return the descriptor with this exact spelling, or -1 */
+    int32_t find(csubstr spelling) const;
+};
+
+
+/** Builds the CompletionTable of a usage at runtime, in a single
+ * allocation. */
+class CompletionIndex
+{
+public:
+
+    CompletionIndex(option::Descriptor const* usage, MemoryResource *mr=get_memory_resource());
+    ~CompletionIndex();
+
+    CompletionIndex(CompletionIndex const&) = delete;
+    CompletionIndex& operator= (CompletionIndex const&) = delete;
+    CompletionIndex(CompletionIndex &&that);
+    CompletionIndex& operator= (CompletionIndex &&) = delete;
+
+    CompletionTable const& table() const { return m_table; }
+    operator CompletionTable const& () const { return m_table; }
+
+private:
+
+    CompletionTable m_table;
+    size_t m_size;  ///< the size of the allocation: the words, then their characters
+    MemoryResource *m_mr;
+
+};
+
+
+/** the completions of the last of the words, given the words before
+ * it, written into buf snprintf-style in the format of the shell.
+ *
+ * - a word starting with '-' completes to the options with that
+ *   prefix, with the description taken from the help of each option
+ *   (the text after its first tab)
+ * - the word after an option taking a separate value, and the value
+ *   in `--name=<val>`, complete with the ValueCompleter of the option.
+ *   For bash, which splits `--name=val` into three words, the value
+ *   alone is given.
+ * - anything else, including the words after "--", completes to
+ *   nothing, so that the shell can fall back to its defaults.
+ *
+ * An option takes a value if it has a ValueCompleter, or if its checker
+ * is c4::opt::required, c4::opt::nonempty or c4::opt::integer.
+ * @return the length the output needs, without the terminator */
+size_t complete(substr buf, CompletionTable const& table, Shell_e shell, int num_words, const char **words, cspan<ValueCompleter> values={});
+
+/** if argv[1] is --complete or --complete=<shell>, write the
+ * completions of the words in argv[2..argc) to out, and return true;
+ * the program should then exit. Otherwise return false. The shell is
+ * one of bash (the default), zsh or fish. */
+bool complete_main(CompletionTable const& table, int argc, const char **argv, cspan<ValueCompleter> values={}, FILE *out=stdout);
+/** complete_main() with a table built from the usage, only when argv
+ * asks for completions */
+bool complete_main(option::Descriptor const* usage, int argc, const char **argv, cspan<ValueCompleter> values={}, FILE *out=stdout);
+
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_COMPLETE_HPP_ */
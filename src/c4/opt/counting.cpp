@@ -0,0 +1,53 @@
+#include "c4/opt/counting.hpp"
+
+namespace c4 {
+namespace opt {
+
+MemoryResourceCounting::MemoryResourceCounting(MemoryResource *upstream)
+    : m_counts(), m_upstream(upstream)
+{
+    name = "c4opt_counting";
+}
+
+void* MemoryResourceCounting::do_allocate(size_t sz, size_t alignment, void* hint)
+{
+    void *mem = m_upstream->allocate(sz, alignment, hint);
+    if(mem)
+        _add(sz);
+    return mem;
+}
+
+void MemoryResourceCounting::do_deallocate(void* ptr, size_t sz, size_t alignment)
+{
+    if(ptr)
+        _remove(sz);
+    m_upstream->deallocate(ptr, sz, alignment);
+}
+
+void* MemoryResourceCounting::do_reallocate(void* ptr, size_t oldsz, size_t newsz, size_t alignment)
+{
+    void *mem = m_upstream->reallocate(ptr, oldsz, newsz, alignment);
+    if( ! mem)
+        return mem;
+    if(ptr)
+        _remove(oldsz);
+    _add(newsz);
+    return mem;
+}
+
+
+//-----------------------------------------------------------------------------
+
+MemoryResourceCounting::Scope::Scope()
+    : m_counter(get_memory_resource())
+{
+    set_memory_resource(&m_counter);
+}
+
+MemoryResourceCounting::Scope::~Scope()
+{
+    set_memory_resource(m_counter.upstream());
+}
+
+} // namespace opt
+} // namespace c4
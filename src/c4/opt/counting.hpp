@@ -0,0 +1,127 @@
+#ifndef _C4_OPT_COUNTING_HPP_
+#define _C4_OPT_COUNTING_HPP_
+
+#include <c4/memory_resource.hpp>
+
+/** @file counting.hpp a memory resource which counts what goes through
+ * it, to check that a parse does not allocate more than expected */
+
+namespace c4 {
+namespace opt {
+
+/** what went through a MemoryResourceCounting since its last reset */
+struct AllocCounts
+{
+    size_t num_allocs;    ///< calls to allocate(), and to reallocate() which got new memory
+    size_t num_deallocs;  ///< calls to deallocate(), and to reallocate() which gave memory back
+    size_t bytes;         ///< the total of the bytes requested
+    size_t curr;          ///< the bytes currently allocated
+    size_t peak;          ///< the maximum of curr
+};
+
+/** A memory resource which forwards to an upstream resource, counting
+ * the allocations, the bytes and the peak of the bytes in use. Pass it
+ * to a parser, or install it as the global resource with
+ * MemoryResourceCounting::Scope to also catch the allocations which do
+ * not go through the resource given to c4opt:
+ *
+ * @code
+ * c4::opt::MemoryResourceCounting::Scope scope;
+ * {
+ *     auto p = c4::opt::make_parser(usage, argc, argv);
+ *     ...
+ * }
+ * printf("%zu allocations, %zu bytes at most\n", scope.counts().num_allocs, scope.counts().peak);
+ * @endcode
+ *
+ * Like the arena, it is not thread-safe. */
+class MemoryResourceCounting : public MemoryResource
+{
+public:
+
+    explicit MemoryResourceCounting(MemoryResource *upstream=get_memory_resource());
+
+    MemoryResourceCounting(MemoryResourceCounting const&) = delete;
+    MemoryResourceCounting& operator= (MemoryResourceCounting const&) = delete;
+    MemoryResourceCounting(MemoryResourceCounting &&) = delete;
+    MemoryResourceCounting& operator= (MemoryResourceCounting &&) = delete;
+
+public:
+
+    AllocCounts const& counts() const { return m_counts; }
+
+    /** start counting again. The bytes in use are kept, and become
+     * the new peak. */
+    void reset()
+    {
+        m_counts.num_allocs = 0;
+        m_counts.num_deallocs = 0;
+        m_counts.bytes = 0;
+        m_counts.peak = m_counts.curr;
+    }
+
+    MemoryResource *upstream() const { return m_upstream; }
+
+public:
+
+    /** installs a counting resource as the global resource
+     * (c4::set_memory_resource()) for its lifetime. The previous
+     * global resource is the upstream. */
+    class Scope;
+
+protected:
+
+    void* do_allocate(size_t sz, size_t alignment, void* hint) override;
+    void* do_reallocate(void* ptr, size_t oldsz, size_t newsz, size_t alignment) override;
+    void  do_deallocate(void* ptr, size_t sz, size_t alignment) override;
+
+private:
+
+    void _add(size_t sz)
+    {
+        ++m_counts.num_allocs;
+        m_counts.bytes += sz;
+        m_counts.curr += sz;
+        if(m_counts.curr > m_counts.peak)
+            m_counts.peak = m_counts.curr;
+    }
+    void _remove(size_t sz)
+    {
+        ++m_counts.num_deallocs;
+        m_counts.curr = sz < m_counts.curr ? m_counts.curr - sz : 0;
+    }
+
+private:
+
+    AllocCounts m_counts;
+    MemoryResource *m_upstream;
+
+};
+
+
+class MemoryResourceCounting::Scope
+{
+public:
+
+    Scope();
+    ~Scope();
+
+    Scope(Scope const&) = delete;
+    Scope& operator= (Scope const&) = delete;
+    Scope(Scope &&) = delete;
+    Scope& operator= (Scope &&) = delete;
+
+    AllocCounts const& counts() const { return m_counter.counts(); }
+    void reset() { m_counter.reset(); }
+    MemoryResourceCounting *resource() { return &m_counter; }
+
+private:
+
+    MemoryResourceCounting m_counter;
+
+};
+
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_COUNTING_HPP_ */
@@ -0,0 +1,30 @@
+#ifndef _C4_OPT_DETAIL_FNV1A_HPP_
+#define _C4_OPT_DETAIL_FNV1A_HPP_
+
+#include <c4/config.hpp>
+#include <stddef.h>
+#include <stdint.h>
+
+/** @file fnv1a.hpp the 64-bit FNV-1a hash, for the fingerprints of
+ * the descriptor contents */
+
+namespace c4 {
+namespace opt {
+namespace detail {
+
+constexpr const uint64_t fnv1a_basis = UINT64_C(0xcbf29ce484222325);
+
+/** continue the hash h with len bytes of data. Start with fnv1a_basis. */
+C4_ALWAYS_INLINE uint64_t fnv1a(uint64_t h, const void *data, size_t len)
+{
+    const unsigned char *c = (const unsigned char*)data;
+    for(size_t i = 0; i < len; ++i)
+        h = (h ^ c[i]) * UINT64_C(0x100000001b3);
+    return h;
+}
+
+} // namespace detail
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_DETAIL_FNV1A_HPP_ */
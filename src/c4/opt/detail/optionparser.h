@@ -223,6 +223,20 @@
 #pragma intrinsic(_BitScanReverse)
 #endif
 
+// functions which can be evaluated at compile time when C++14 is available
+#if __cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+#define OPTIONPARSER_CONSTEXPR14 constexpr
+#else
+#define OPTIONPARSER_CONSTEXPR14
+#endif
+
+// profiling counters: compiled only when C4OPT_PROFILE is defined. See Profile.
+#ifdef C4OPT_PROFILE
+#define OPTIONPARSER_PROFILE(stmt) do { if (::option::Profile* prof_ = ::option::Profile::current()) { stmt; } } while (0)
+#else
+#define OPTIONPARSER_PROFILE(stmt) do { } while (0)
+#endif
+
 /** @brief The namespace of The Lean Mean C++ Option Parser. */
 namespace option
 {
@@ -746,6 +760,29 @@ public:
     f->prev_ = tag(new_last);
   }
 
+  /**
+   * @internal
+   * @brief Copies the @c num Options at @c from to the Options at @c to, with their linked lists.
+   *
+   * This is for growing a block of Options (eg the options and buffer arrays) without
+   * relinking: every link is moved by the distance between the blocks. So all the lists of
+   * the source block must be entirely within it.
+   */
+  static void relocate(const Option* from, int num, Option* to)
+  {
+    const unsigned long long delta = (unsigned long long) to - (unsigned long long) from;
+    for (int i = 0; i < num; ++i)
+    {
+      to[i].desc = from[i].desc;
+      to[i].name = from[i].name;
+      to[i].arg = from[i].arg;
+      to[i].namelen = from[i].namelen;
+      // the tag bit is kept, as the distance is a multiple of sizeof(Option)
+      to[i].prev_ = (Option*) ((unsigned long long) from[i].prev_ + delta);
+      to[i].next_ = (Option*) ((unsigned long long) from[i].next_ + delta);
+    }
+  }
+
   /**
    * @brief Casts from Option to const Option* but only if this Option is valid.
    *
@@ -946,6 +983,122 @@ struct Arg
   }
 };
 
+#ifdef C4OPT_PROFILE
+/**
+ * @brief Counters of the work done by Parser::workhorse(), when compiled with
+ * C4OPT_PROFILE. They are incremented in the Profile installed with current() in
+ * the calling thread, if any; nothing is counted otherwise.
+ */
+struct Profile
+{
+  //! @brief Tokens of the argument vector looked at, including non-options.
+  unsigned long long tokens;
+  //! @brief Calls to streq(), streqabbr() and instr(), ie descriptors compared with a token.
+  unsigned long long comparisons;
+  //! @brief Calls to the CheckArg functions.
+  unsigned long long checks;
+  //! @brief Swaps of two tokens done to move the non-option arguments behind the options (GNU mode).
+  unsigned long long swaps;
+  //! @brief If not null, one counter per position in the @c usage array, incremented
+  //! for each call to the descriptor's CheckArg.
+  unsigned* checks_per_desc;
+
+  //! @brief The profile of the calling thread.
+  static Profile*& current()
+  {
+    static thread_local Profile* p = 0;
+    return p;
+  }
+};
+#endif
+
+/**
+ * @brief Precomputed lookup tables for a Descriptor[] array.
+ *
+ * Without an Index, the Parser finds each option with a linear scan over the
+ * @c usage array. When an Index is given to Stats and Parser, short options are
+ * found with a direct table lookup, and long options with a hash table lookup.
+ * Abbreviated long options are still matched with a linear scan.
+ *
+ * An Index is plain data which refers to tables it does not own; this allows the
+ * tables to be built once at runtime, or to be generated at build time and placed
+ * in read-only memory. Positions in the tables are positions in the @c usage array;
+ * the value @ref num_usage (the position of the terminating entry) is used for
+ * "not found", so that it can be used in the same way as the result of a linear
+ * scan.
+ */
+struct Index
+{
+  //! @brief The Descriptor[] array these tables were built for.
+  const Descriptor* usage;
+  //! @brief Number of descriptors in @c usage, not counting the terminating entry.
+  unsigned num_usage;
+  //! @brief The value of Stats::options_max for @c usage.
+  unsigned options_max;
+  //! @brief Position of the dummy descriptor used for unknown options, or @ref num_usage.
+  unsigned unknown;
+  //! @brief 256 entries: position of the first descriptor accepting each short option character.
+  const unsigned* shortopt;
+  //! @brief Hash table with @ref longopt_mask + 1 slots, containing the position of the first
+  //! descriptor with each long option name. Collisions are resolved by linear probing.
+  const unsigned* longopt;
+  //! @brief Number of slots in @ref longopt minus 1. The number of slots must be a power of 2.
+  unsigned longopt_mask;
+  //! @brief The seed used with hash() when building @ref longopt.
+  unsigned seed;
+
+  /**
+   * @brief Hashes a long option name, up to its terminating null or @c '=' character.
+   * With C++14 this is @c constexpr, so that tables can be built at compile time.
+   */
+  static OPTIONPARSER_CONSTEXPR14 unsigned hash(const char* name, unsigned seed)
+  {
+    unsigned h = 2166136261u ^ seed; // FNV-1a
+    while (*name != 0 && *name != '=')
+    {
+      h ^= (unsigned char) *name++;
+      h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+  }
+
+  /**
+   * @brief Like hash(const char*, unsigned) but for a name of explicit length, which
+   * need not be null-terminated. Gives the same value as hash() for the same name.
+   */
+  static OPTIONPARSER_CONSTEXPR14 unsigned hash(const char* name, size_t len, unsigned seed)
+  {
+    unsigned h = 2166136261u ^ seed; // FNV-1a
+    for (size_t i = 0; i < len && name[i] != '='; ++i)
+    {
+      h ^= (unsigned char) name[i];
+      h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+  }
+
+  /**
+   * @brief Returns the position of the descriptor with the given short option character,
+   * or @ref num_usage if there is none.
+   */
+  unsigned findShort(char ch) const
+  {
+    return shortopt[(unsigned char) ch];
+  }
+
+  /**
+   * @brief Returns the position of the first descriptor whose long option matches @c name
+   * (up to its terminating null or @c '=' character), or @ref num_usage if there is none.
+   */
+  unsigned findLong(const char* name) const;
+
+  /**
+   * @brief Like findLong(const char*) but for a name of explicit length, which need not be
+   * null-terminated.
+   */
+  unsigned findLong(const char* name, size_t len) const;
+};
+
 /**
  * @brief Determines the minimum lengths of the buffer and options arrays used for Parser.
  *
@@ -999,10 +1152,10 @@ struct Stats
    * See Parser::parse() for the meaning of the arguments.
    */
   Stats(bool gnu, const Descriptor usage[], int argc, const char** argv, int min_abbr_len = 0, //
-        bool single_minus_longopt = false) :
+        bool single_minus_longopt = false, const Index* index = 0) :
       buffer_max(1), options_max(1) // 1 more than necessary as sentinel
   {
-    add(gnu, usage, argc, argv, min_abbr_len, single_minus_longopt);
+    add(gnu, usage, argc, argv, min_abbr_len, single_minus_longopt, index);
   }
 
   //! @brief Stats(...) with non-const argv.
@@ -1039,7 +1192,7 @@ struct Stats
    * See Parser::parse() for the meaning of the arguments.
    */
   void add(bool gnu, const Descriptor usage[], int argc, const char** argv, int min_abbr_len = 0, //
-           bool single_minus_longopt = false);
+           bool single_minus_longopt = false, const Index* index = 0);
 
   //! @brief add() with non-const argv.
   void add(bool gnu, const Descriptor usage[], int argc, char** argv, int min_abbr_len = 0, //
@@ -1091,13 +1244,17 @@ class Parser
   int nonop_count; //!< @internal @brief see nonOptionsCount()
   const char** nonop_args; //!< @internal @brief see nonOptions()
   bool err; //!< @internal @brief see error()
+  bool err_illegal; //!< @internal @brief see errorIllegal()
+  int err_index; //!< @internal @brief see errorIndex()
+  int err_offset; //!< @internal @brief see errorOffset()
+  const Descriptor* err_desc; //!< @internal @brief see errorDescriptor()
 public:
 
   /**
    * @brief Creates a new Parser.
    */
   Parser() :
-      op_count(0), nonop_count(0), nonop_args(0), err(false)
+      op_count(0), nonop_count(0), nonop_args(0), err(false), err_illegal(false), err_index(-1), err_offset(0), err_desc(0)
   {
   }
 
@@ -1106,16 +1263,17 @@ public:
    * @copydetails parse()
    */
   Parser(bool gnu, const Descriptor usage[], int argc, const char** argv, Option options[], Option buffer[],
-         int min_abbr_len = 0, bool single_minus_longopt = false, int bufmax = -1) :
-      op_count(0), nonop_count(0), nonop_args(0), err(false)
+         int min_abbr_len = 0, bool single_minus_longopt = false, int bufmax = -1, const Index* index = 0,
+         bool print_errors = true) :
+      op_count(0), nonop_count(0), nonop_args(0), err(false), err_illegal(false), err_index(-1), err_offset(0), err_desc(0)
   {
-    parse(gnu, usage, argc, argv, options, buffer, min_abbr_len, single_minus_longopt, bufmax);
+    parse(gnu, usage, argc, argv, options, buffer, min_abbr_len, single_minus_longopt, bufmax, index, print_errors);
   }
 
   //! @brief Parser(...) with non-const argv.
   Parser(bool gnu, const Descriptor usage[], int argc, char** argv, Option options[], Option buffer[],
          int min_abbr_len = 0, bool single_minus_longopt = false, int bufmax = -1) :
-      op_count(0), nonop_count(0), nonop_args(0), err(false)
+      op_count(0), nonop_count(0), nonop_args(0), err(false), err_illegal(false), err_index(-1), err_offset(0), err_desc(0)
   {
     parse(gnu, usage, argc, (const char**) argv, options, buffer, min_abbr_len, single_minus_longopt, bufmax);
   }
@@ -1123,7 +1281,7 @@ public:
   //! @brief POSIX Parser(...) (gnu==false).
   Parser(const Descriptor usage[], int argc, const char** argv, Option options[], Option buffer[], int min_abbr_len = 0,
          bool single_minus_longopt = false, int bufmax = -1) :
-      op_count(0), nonop_count(0), nonop_args(0), err(false)
+      op_count(0), nonop_count(0), nonop_args(0), err(false), err_illegal(false), err_index(-1), err_offset(0), err_desc(0)
   {
     parse(false, usage, argc, argv, options, buffer, min_abbr_len, single_minus_longopt, bufmax);
   }
@@ -1131,7 +1289,7 @@ public:
   //! @brief POSIX Parser(...) (gnu==false) with non-const argv.
   Parser(const Descriptor usage[], int argc, char** argv, Option options[], Option buffer[], int min_abbr_len = 0,
          bool single_minus_longopt = false, int bufmax = -1) :
-      op_count(0), nonop_count(0), nonop_args(0), err(false)
+      op_count(0), nonop_count(0), nonop_args(0), err(false), err_illegal(false), err_index(-1), err_offset(0), err_desc(0)
   {
     parse(false, usage, argc, (const char**) argv, options, buffer, min_abbr_len, single_minus_longopt, bufmax);
   }
@@ -1181,6 +1339,11 @@ public:
    *               If you used Stats::buffer_max to dimension this array, you can pass
    *               -1 (or not pass @c bufmax at all) which tells parse() that the buffer is
    *               "large enough".
+   * @param index Optional lookup tables built for @c usage (see Index). If given, they are used
+   *              instead of scanning @c usage for each option.
+   * @param print_errors passed on to each CheckArg. Pass @c false to parse without printing
+   *              anything; the position of an error is then available via errorIndex(),
+   *              errorOffset() and errorDescriptor().
    * @attention
    * Remember that @c options and @c buffer store Option @e objects, not pointers. Therefore it
    * is not possible for the same object to be in both arrays. For those options that are found in
@@ -1193,7 +1356,8 @@ public:
    * @c options[buffer[i].index()].
    */
   void parse(bool gnu, const Descriptor usage[], int argc, const char** argv, Option options[], Option buffer[],
-             int min_abbr_len = 0, bool single_minus_longopt = false, int bufmax = -1);
+             int min_abbr_len = 0, bool single_minus_longopt = false, int bufmax = -1, const Index* index = 0,
+             bool print_errors = true);
 
   //! @brief parse() with non-const argv.
   void parse(bool gnu, const Descriptor usage[], int argc, char** argv, Option options[], Option buffer[],
@@ -1293,18 +1457,60 @@ public:
     return err;
   }
 
-private:
-  friend struct Stats;
-  class StoreOptionAction;
+  /**
+   * @brief If error(), returns @c true if the error was caused by a CheckArg returning
+   * @ref ARG_ILLEGAL, and @c false if it was caused by an overflow of the option count.
+   */
+  bool errorIllegal() const
+  {
+    return err_illegal;
+  }
+
+  /**
+   * @brief If error(), returns the position in the argument vector of the token with
+   * the option which caused the error. Otherwise, returns -1.
+   */
+  int errorIndex() const
+  {
+    return err_index;
+  }
+
+  /**
+   * @brief If error(), returns the offset of the option which caused the error within
+   * its token. This is nonzero for options within a group of short options.
+   */
+  int errorOffset() const
+  {
+    return err_offset;
+  }
+
+  /**
+   * @brief If error(), returns the Descriptor of the option which caused the error.
+   * For unknown options, this is the dummy descriptor for unknown options.
+   */
+  const Descriptor* errorDescriptor() const
+  {
+    return err_desc;
+  }
+
+  /**
+   * @brief Interface for the actions performed by workhorse() for each parsed Option.
+   * Implement it to process options as they are parsed, without storing them.
+   */
   struct Action;
 
   /**
-   * @internal
-   * @brief This is the core function that does all the parsing.
+   * @brief This is the core function that does all the parsing: it is used by parse() and
+   * Stats with their own Actions. See parse() for the meaning of the arguments.
    * @retval false iff an unrecoverable error occurred.
    */
   static bool workhorse(bool gnu, const Descriptor usage[], int numargs, const char** args, Action& action,
-                        bool single_minus_longopt, bool print_errors, int min_abbr_len);
+                        bool single_minus_longopt, bool print_errors, int min_abbr_len, const Index* index = 0);
+
+private:
+  friend struct Stats;
+  friend struct Index;
+  class StoreOptionAction;
 
   /**
    * @internal
@@ -1322,6 +1528,7 @@ private:
    */
   static bool streq(const char* st1, const char* st2)
   {
+    OPTIONPARSER_PROFILE(++prof_->comparisons);
     while (*st1 != 0)
       if (*st1++ != *st2++)
         return false;
@@ -1354,6 +1561,7 @@ private:
    */
   static bool streqabbr(const char* st1, const char* st2, long long min)
   {
+    OPTIONPARSER_PROFILE(++prof_->comparisons);
     const char* st1start = st1;
     while (*st1 != 0 && (*st1 == *st2))
     {
@@ -1372,6 +1580,7 @@ private:
    */
   static bool instr(char ch, const char* st)
   {
+    OPTIONPARSER_PROFILE(++prof_->comparisons);
     while (*st != 0 && *st != ch)
       ++st;
     return *st == ch;
@@ -1379,27 +1588,113 @@ private:
 
   /**
    * @internal
-   * @brief Rotates <code>args[-count],...,args[-1],args[0]</code> to become
-   *        <code>args[0],args[-count],...,args[-1]</code>.
+   * @brief Moves the options (with their separate arguments) in front of the non-option
+   * arguments in GNU mode, keeping the order of both.
+   *
+   * Moving each option behind all the non-option arguments seen so far would cost
+   * O(n^2) swaps for n tokens. Instead, the tokens seen so far are kept in a stack of
+   * runs, each with its options followed by its non-options. Each token is pushed as a
+   * run, and the two runs at the top are merged (by rotating the non-options of the
+   * lower run with the options of the upper run) while the lower one is not larger, as
+   * in a binary counter. Each token is then moved O(log n) times, and the stack never
+   * holds more than log2(n)+1 runs.
    */
-  static void shift(const char** args, int count)
+  class Permuter
   {
-    for (int i = 0; i > -count; --i)
+    struct Run
+    {
+      const char** begin;
+      const char** split; //!< the first non-option of the run
+      const char** end;
+    };
+
+    Run runs[8 * sizeof(int) + 1];
+    int num_runs;
+    bool active;
+
+  public:
+    Permuter(bool active_) :
+        num_runs(0), active(active_)
     {
-      const char* temp = args[i];
-      args[i] = args[i - 1];
-      args[i - 1] = temp;
     }
-  }
+
+    //! @brief The token at @c arg is an option, or the argument of an option.
+    void option(const char** arg)
+    {
+      push(arg, arg + 1);
+    }
+
+    //! @brief The token at @c arg is a non-option argument.
+    void nonOption(const char** arg)
+    {
+      push(arg, arg);
+    }
+
+    //! @brief Moves all the options pushed so far in front of all the non-options.
+    void finish()
+    {
+      while (num_runs > 1)
+        merge();
+    }
+
+  private:
+    void push(const char** arg, const char** split)
+    {
+      if (!active)
+        return;
+      Run& r = runs[num_runs++];
+      r.begin = arg;
+      r.split = split;
+      r.end = arg + 1;
+      while (num_runs > 1 && size(runs[num_runs - 2]) <= size(runs[num_runs - 1]))
+        merge();
+    }
+
+    static long size(const Run& r)
+    {
+      return (long) (r.end - r.begin);
+    }
+
+    //! @brief Merges the two runs at the top of the stack.
+    void merge()
+    {
+      Run& lo = runs[num_runs - 2];
+      const Run& hi = runs[num_runs - 1];
+      // [lo.split, lo.end) are non-options and [hi.begin, hi.split) are options
+      if (lo.split != lo.end && hi.begin != hi.split)
+      {
+        reverse(lo.split, lo.end);
+        reverse(hi.begin, hi.split);
+        reverse(lo.split, hi.split);
+      }
+      lo.split += hi.split - hi.begin;
+      lo.end = hi.end;
+      --num_runs;
+    }
+
+    static void reverse(const char** first, const char** last)
+    {
+      OPTIONPARSER_PROFILE(prof_->swaps += (unsigned long long) (last - first) / 2);
+      while (first < --last)
+      {
+        const char* temp = *first;
+        *first++ = *last;
+        *last = temp;
+      }
+    }
+  };
 };
 
 /**
- * @internal
  * @brief Interface for actions Parser::workhorse() should perform for each Option it
  * parses.
  */
 struct Parser::Action
 {
+  virtual ~Action()
+  {
+  }
+
   /**
    * @brief Called by Parser::workhorse() for each Option that has been successfully
    * parsed (including unknown
@@ -1413,6 +1708,17 @@ struct Parser::Action
     return true;
   }
 
+  /**
+   * @brief Called by Parser::workhorse() instead of perform(), additionally giving the
+   * position of the option's token in the argument vector (as in failed()). The default
+   * implementation calls perform(). Override this if the position is needed.
+   */
+  virtual bool performAt(Option& option, const char** args)
+  {
+    (void) args;
+    return perform(option);
+  }
+
   /**
    * @brief Called by Parser::workhorse() after finishing the parse.
    * @param numargs the number of non-option arguments remaining
@@ -1427,6 +1733,43 @@ struct Parser::Action
     (void) args;
     return true;
   }
+
+  /**
+   * @brief Called by Parser::workhorse() when it aborts the parse because of @c option.
+   * @param option the offending option. Its @c name points into the token at @c args[0].
+   * @param args the position of the option's token in the argument vector. This is
+   *        also its position in the argument vector originally given to workhorse().
+   * @param illegal @c true if the option's CheckArg returned @ref ARG_ILLEGAL, @c false
+   *        if perform() returned @c false.
+   */
+  virtual void failed(const Option& option, const char** args, bool illegal)
+  {
+    (void) option;
+    (void) args;
+    (void) illegal;
+  }
+
+  /**
+   * @brief If this returns @c true, Parser::workhorse() does not modify the argument
+   * vector. In GNU mode, instead of moving each non-option argument found before the end
+   * of the options to the front of the remaining arguments, it reports it with
+   * nonOption() and leaves it in place. finished() then gets only the non-option
+   * arguments after the options (eg after "--").
+   */
+  virtual bool keepsArgs() const
+  {
+    return false;
+  }
+
+  /**
+   * @brief Called by Parser::workhorse() in GNU mode for each non-option argument found
+   * before the end of the options, if keepsArgs().
+   * @param args the position of the argument in the argument vector.
+   */
+  virtual void nonOption(const char** args)
+  {
+    (void) args;
+  }
 };
 
 /**
@@ -1454,6 +1797,12 @@ public:
     ++*buffer_max;
     return true;
   }
+
+  //! counting does not need the non-option arguments moved
+  bool keepsArgs() const
+  {
+    return true;
+  }
 };
 
 /**
@@ -1467,6 +1816,7 @@ class Parser::StoreOptionAction: public Parser::Action
   Option* options;
   Option* buffer;
   int bufmax; //! Number of slots in @c buffer. @c -1 means "large enough".
+  const char** argv; //! The argument vector, to compute the position of errors.
 public:
   /**
    * @brief Creates a new StoreOption action.
@@ -1474,9 +1824,10 @@ public:
    * @param options_ each Option @c o is chained into the linked list @c options_[o.desc->index]
    * @param buffer_ each Option is appended to this array as long as there's a free slot.
    * @param bufmax_ number of slots in @c buffer_. @c -1 means "large enough".
+   * @param argv_ the argument vector being parsed.
    */
-  StoreOptionAction(Parser& parser_, Option options_[], Option buffer_[], int bufmax_) :
-      parser(parser_), options(options_), buffer(buffer_), bufmax(bufmax_)
+  StoreOptionAction(Parser& parser_, Option options_[], Option buffer_[], int bufmax_, const char** argv_) :
+      parser(parser_), options(options_), buffer(buffer_), bufmax(bufmax_), argv(argv_)
   {
     // find first empty slot in buffer (if any)
     int bufidx = 0;
@@ -1518,44 +1869,94 @@ public:
 
     return true;
   }
+
+  void failed(const Option& option, const char** args, bool illegal)
+  {
+    parser.err_illegal = illegal;
+    parser.err_index = (int) (args - argv);
+    parser.err_offset = (int) (option.name - *args);
+    parser.err_desc = option.desc;
+  }
 };
 
 inline void Parser::parse(bool gnu, const Descriptor usage[], int argc, const char** argv, Option options[],
-                          Option buffer[], int min_abbr_len, bool single_minus_longopt, int bufmax)
+                          Option buffer[], int min_abbr_len, bool single_minus_longopt, int bufmax,
+                          const Index* index, bool print_errors)
 {
-  StoreOptionAction action(*this, options, buffer, bufmax);
-  err = !workhorse(gnu, usage, argc, argv, action, single_minus_longopt, true, min_abbr_len);
+  StoreOptionAction action(*this, options, buffer, bufmax, argv);
+  err_illegal = false;
+  err_index = -1;
+  err_offset = 0;
+  err_desc = 0;
+  err = !workhorse(gnu, usage, argc, argv, action, single_minus_longopt, print_errors, min_abbr_len, index);
 }
 
 inline void Stats::add(bool gnu, const Descriptor usage[], int argc, const char** argv, int min_abbr_len,
-                       bool single_minus_longopt)
+                       bool single_minus_longopt, const Index* index)
 {
   // determine size of options array. This is the greatest index used in the usage + 1
-  int i = 0;
-  while (usage[i].shortopt != 0)
+  if (index != 0)
   {
-    if (usage[i].index + 1 >= options_max)
-      options_max = (usage[i].index + 1) + 1; // 1 more than necessary as sentinel
+    if (index->options_max > options_max)
+      options_max = index->options_max;
+  }
+  else
+  {
+    int i = 0;
+    while (usage[i].shortopt != 0)
+    {
+      if (usage[i].index + 1 >= options_max)
+        options_max = (usage[i].index + 1) + 1; // 1 more than necessary as sentinel
 
-    ++i;
+      ++i;
+    }
   }
 
   CountOptionsAction action(&buffer_max);
-  Parser::workhorse(gnu, usage, argc, argv, action, single_minus_longopt, false, min_abbr_len);
+  Parser::workhorse(gnu, usage, argc, argv, action, single_minus_longopt, false, min_abbr_len, index);
+}
+
+inline unsigned Index::findLong(const char* name) const
+{
+  for (unsigned slot = hash(name, seed) & longopt_mask;; slot = (slot + 1) & longopt_mask)
+  {
+    unsigned pos = longopt[slot];
+    if (pos == num_usage || Parser::streq(usage[pos].longopt, name))
+      return pos;
+  }
+}
+
+inline unsigned Index::findLong(const char* name, size_t len) const
+{
+  for (unsigned slot = hash(name, len, seed) & longopt_mask;; slot = (slot + 1) & longopt_mask)
+  {
+    unsigned pos = longopt[slot];
+    if (pos == num_usage)
+      return pos;
+    const char* lo = usage[pos].longopt;
+    size_t i = 0;
+    while (i < len && lo[i] != 0 && lo[i] == name[i])
+      ++i;
+    if (i == len && lo[i] == 0)
+      return pos;
+  }
 }
 
 inline bool Parser::workhorse(bool gnu, const Descriptor usage[], int numargs, const char** args, Action& action,
-                              bool single_minus_longopt, bool print_errors, int min_abbr_len)
+                              bool single_minus_longopt, bool print_errors, int min_abbr_len, const Index* index)
 {
   // protect against NULL pointer
   if (args == 0)
     numargs = 0;
 
   int nonops = 0;
+  const bool keeps_args = action.keepsArgs();
+  Permuter permuter(gnu && !keeps_args);
 
   while (numargs != 0 && *args != 0)
   {
     const char* param = *args; // param can be --long-option, -srto or non-option argument
+    OPTIONPARSER_PROFILE(++prof_->tokens);
 
     // in POSIX mode the first non-option argument terminates the option list
     // a lone minus character is a non-option argument
@@ -1563,7 +1964,13 @@ inline bool Parser::workhorse(bool gnu, const Descriptor usage[], int numargs, c
     {
       if (gnu)
       {
-        ++nonops;
+        if (keeps_args)
+          action.nonOption(args);
+        else
+        {
+          permuter.nonOption(args);
+          ++nonops;
+        }
         ++args;
         if (numargs > 0)
           --numargs;
@@ -1576,7 +1983,7 @@ inline bool Parser::workhorse(bool gnu, const Descriptor usage[], int numargs, c
     // -- terminates the option list. The -- itself is skipped.
     if (param[1] == '-' && param[2] == 0)
     {
-      shift(args, nonops);
+      permuter.option(args);
       ++args;
       if (numargs > 0)
         --numargs;
@@ -1608,9 +2015,14 @@ inline bool Parser::workhorse(bool gnu, const Descriptor usage[], int numargs, c
       /******************** long option **********************/
       if (handle_short_options == false || try_single_minus_longopt)
       {
-        idx = 0;
-        while (usage[idx].longopt != 0 && !streq(usage[idx].longopt, longopt_name))
-          ++idx;
+        if (index != 0)
+          idx = (int) index->findLong(longopt_name);
+        else
+        {
+          idx = 0;
+          while (usage[idx].longopt != 0 && !streq(usage[idx].longopt, longopt_name))
+            ++idx;
+        }
 
         if (usage[idx].longopt == 0 && min_abbr_len > 0) // if we should try to match abbreviated long options
         {
@@ -1650,9 +2062,14 @@ inline bool Parser::workhorse(bool gnu, const Descriptor usage[], int numargs, c
         if (*++param == 0) // point at the 1st/next option character
           break; // end of short option group
 
-        idx = 0;
-        while (usage[idx].shortopt != 0 && !instr(*param, usage[idx].shortopt))
-          ++idx;
+        if (index != 0)
+          idx = (int) index->findShort(*param);
+        else
+        {
+          idx = 0;
+          while (usage[idx].shortopt != 0 && !instr(*param, usage[idx].shortopt))
+            ++idx;
+        }
 
         if (param[1] == 0) // if the potential argument is separate
           optarg = (have_more_args ? args[1] : 0);
@@ -1666,24 +2083,33 @@ inline bool Parser::workhorse(bool gnu, const Descriptor usage[], int numargs, c
       if (descriptor->shortopt == 0) /**************  unknown option ********************/
       {
         // look for dummy entry (shortopt == "" and longopt == "") to use as Descriptor for unknown options
-        idx = 0;
-        while (usage[idx].shortopt != 0 && (usage[idx].shortopt[0] != 0 || usage[idx].longopt[0] != 0))
-          ++idx;
+        if (index != 0)
+          idx = (int) index->unknown;
+        else
+        {
+          idx = 0;
+          while (usage[idx].shortopt != 0 && (usage[idx].shortopt[0] != 0 || usage[idx].longopt[0] != 0))
+            ++idx;
+        }
         descriptor = (usage[idx].shortopt == 0 ? 0 : &usage[idx]);
       }
 
       if (descriptor != 0)
       {
         Option option(descriptor, param, optarg);
+        const char** optpos = args; // args may move past a separated argument below
+        OPTIONPARSER_PROFILE(++prof_->checks; if (prof_->checks_per_desc) ++prof_->checks_per_desc[descriptor - usage]);
         switch (descriptor->check_arg(option, print_errors))
         {
           case ARG_ILLEGAL:
+            permuter.finish();
+            action.failed(option, optpos, true);
             return false; // fatal
           case ARG_OK:
             // skip one element of the argument vector, if it's a separated argument
             if (optarg != 0 && have_more_args && optarg == args[1])
             {
-              shift(args, nonops);
+              permuter.option(args);
               if (numargs > 0)
                 --numargs;
               ++args;
@@ -1699,13 +2125,17 @@ inline bool Parser::workhorse(bool gnu, const Descriptor usage[], int numargs, c
             break;
         }
 
-        if (!action.perform(option))
+        if (!action.performAt(option, optpos))
+        {
+          permuter.finish();
+          action.failed(option, optpos, false);
           return false;
+        }
       }
 
     } while (handle_short_options);
 
-    shift(args, nonops);
+    permuter.option(args);
     ++args;
     if (numargs > 0)
       --numargs;
@@ -1722,6 +2152,7 @@ inline bool Parser::workhorse(bool gnu, const Descriptor usage[], int numargs, c
       ++numargs;
   }
 
+  permuter.finish();
   return action.finished(numargs + nonops, args - nonops);
 }
 
@@ -1883,9 +2314,11 @@ struct PrintUsageImplementation
 
     if (indent > 0)
     {
-      char space = ' ';
-      for (int i = 0; i < indent; ++i)
-        write(&space, 1);
+      // write the spaces in chunks rather than one at a time
+      static const char spaces[] = "                                ";
+      const int numspaces = (int) sizeof(spaces) - 1;
+      for (int i = indent; i > 0; i -= numspaces)
+        write(spaces, i < numspaces ? i : numspaces);
       x = want_x;
     }
   }
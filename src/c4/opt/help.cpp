@@ -0,0 +1,178 @@
+#include "c4/opt/help.hpp"
+#include "c4/opt/opt.hpp"
+#include "c4/opt/detail/fnv1a.hpp"
+#include <c4/memory_resource.hpp>
+#include <mutex>
+
+#ifdef C4_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+
+namespace c4 {
+namespace opt {
+
+namespace {
+
+/** a rendered help text. The characters are stored right after the
+ * entry, so that each entry needs only one allocation. */
+struct HelpEntry
+{
+    HelpEntry *next;
+    uint64_t key;  ///< see _help_key()
+    size_t len;
+    char *text() { return reinterpret_cast<char*>(this + 1); }
+};
+
+/** accumulates the many small writes from option::printUsage() into a
+ * single growing buffer */
+struct HelpWriter
+{
+    MemoryResource *mr;
+    char *buf;
+    size_t len;
+    size_t cap;
+
+    HelpWriter(MemoryResource *mr_, size_t cap_) : mr(mr_), buf((char*) mr_->allocate(cap_)), len(0), cap(cap_)
+    {
+    }
+
+    ~HelpWriter()
+    {
+        mr->deallocate(buf, cap);
+    }
+
+    void write(const char* str, int size)
+    {
+        size_t sz = (size_t)size;
+        if(len + sz > cap)
+        {
+            size_t newcap = 2 * cap > len + sz ? 2 * cap : len + sz;
+            buf = (char*) mr->reallocate(buf, cap, newcap);
+            cap = newcap;
+        }
+        memcpy(buf + len, str, sz);
+        len += sz;
+    }
+};
+
+/** the key of a help text: a hash of what its layout depends on,
+ * which is only the help strings and the width. A usage rebuilt at
+ * another address finds its text, and a different usage reusing the
+ * address of a freed one does not get the old text. */
+uint64_t _help_key(option::Descriptor const* usage, int width)
+{
+    uint64_t h = detail::fnv1a(detail::fnv1a_basis, &width, sizeof(width));
+    for(option::Descriptor const* d = usage; d->shortopt != nullptr; ++d)
+    {
+        if(d->help)
+            h = detail::fnv1a(h, d->help, strlen(d->help) + 1);
+        else
+            h = detail::fnv1a(h, "\xff", 1); // distinguish null from empty
+    }
+    return h;
+}
+
+struct HelpCache
+{
+    std::mutex mtx;
+    HelpEntry *head = nullptr;
+    MemoryResource *mr;
+
+    // the entries outlive any resource the user may install, so they
+    // are taken from the malloc resource. Getting it here constructs
+    // it before the cache, so that it is destroyed after the cache.
+    HelpCache() : mr(c4::get_memory_resource_malloc()) {}
+    ~HelpCache() { clear(); }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        while(head)
+        {
+            HelpEntry *e = head;
+            head = e->next;
+            mr->deallocate(e, sizeof(HelpEntry) + e->len, alignof(HelpEntry));
+        }
+    }
+
+    csubstr get(option::Descriptor const* usage, int width)
+    {
+        const uint64_t key = _help_key(usage, width);
+        std::lock_guard<std::mutex> lock(mtx);
+        for(HelpEntry *e = head; e; e = e->next)
+        {
+            if(e->key == key)
+                return {e->text(), e->len};
+        }
+        // lay out the whole table once, and keep the result
+        HelpWriter w(mr, 4096);
+        option::printUsage(w, usage, width);
+        HelpEntry *e = (HelpEntry*) mr->allocate(sizeof(HelpEntry) + w.len, alignof(HelpEntry));
+        e->next = head;
+        e->key = key;
+        e->len = w.len;
+        memcpy(e->text(), w.buf, w.len);
+        head = e;
+        return {e->text(), e->len};
+    }
+};
+
+HelpCache& _help_cache()
+{
+    static HelpCache cache;
+    return cache;
+}
+
+} // anon
+
+
+csubstr help_text(option::Descriptor const* usage, int width)
+{
+    return _help_cache().get(usage, width);
+}
+
+void clear_help_cache()
+{
+    _help_cache().clear();
+}
+
+void print_help(option::Descriptor const* usage, int width, FILE *stream)
+{
+    write_all(stream, help_text(usage, width));
+}
+
+void write_all(FILE *stream, csubstr buf)
+{
+    fflush(stream);
+    #ifdef C4_WIN
+    int fd = _fileno(stream);
+    #else
+    int fd = fileno(stream);
+    #endif
+    if(fd < 0)
+    {
+        fwrite(buf.str, 1, buf.len, stream);
+        return;
+    }
+    while(buf.len > 0)
+    {
+        #ifdef C4_WIN
+        int ret = _write(fd, buf.str, (unsigned)buf.len);
+        #else
+        ssize_t ret = ::write(fd, buf.str, buf.len);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        #endif
+        if(ret <= 0)
+            return;
+        buf.str += ret;
+        buf.len -= (size_t)ret;
+    }
+}
+
+} // namespace opt
+} // namespace c4
@@ -0,0 +1,41 @@
+#ifndef _C4_OPT_HELP_HPP_
+#define _C4_OPT_HELP_HPP_
+
+#include <c4/substr.hpp>
+#include <stdio.h>
+
+/** @file help.hpp rendering of the usage help text */
+
+namespace option {
+struct Descriptor;
+} // namespace option
+
+namespace c4 {
+namespace opt {
+
+/** Get the usage help text for the given descriptors, formatted for the
+ * given terminal width. The layout is computed only on the first call
+ * for each width and contents of the help strings, wherever the
+ * descriptors are; the result is kept in a single contiguous buffer
+ * which is returned by every subsequent call. The returned memory is
+ * owned by the help cache, and remains valid until clear_help_cache()
+ * is called, or the program exits. This function is thread-safe. */
+csubstr help_text(option::Descriptor const* usage, int width=80);
+
+/** write the (cached) usage help text to the given stream. The text
+ * is written with a single write() call to the underlying file
+ * descriptor, after flushing any pending output in the stream. */
+void print_help(option::Descriptor const* usage, int width=80, FILE *stream=stdout);
+
+/** write a buffer to the given stream, bypassing its FILE buffer. The
+ * stream is flushed first so that the output ordering is preserved. */
+void write_all(FILE *stream, csubstr buf);
+
+/** release all the memory held by the help cache. Any text previously
+ * returned by help_text() is invalidated. */
+void clear_help_cache();
+
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_HELP_HPP_ */
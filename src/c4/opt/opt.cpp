@@ -1,10 +1,12 @@
 #include "c4/opt/opt.hpp"
+#include "c4/opt/suggest.hpp"
 #include "c4/platform.hpp"
 #include <stdlib.h>
 #include <stdio.h>
-
-#ifndef C4_WIN
-#include <alloca.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef C4OPT_PROFILE
+#include <chrono>
 #endif
 
 
@@ -12,11 +14,57 @@ namespace c4 {
 namespace opt {
 
 namespace {
+
+#ifdef C4OPT_PROFILE
+/** adds the time spent in its scope to a phase of a profile */
+struct PhaseTimer
+{
+    ParseProfile *profile;
+    ParsePhase_e phase;
+    std::chrono::steady_clock::time_point start;
+    PhaseTimer(ParseProfile *p, ParsePhase_e ph) : profile(p), phase(ph), start(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer()
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        profile->phase_ns[phase] += (uint64_t)ns;
+    }
+};
+/** makes a profile the one where workhorse() counts, in its scope */
+struct ProfileScope
+{
+    option::Profile *prev;
+    ProfileScope(option::Profile *p) : prev(option::Profile::current()) { option::Profile::current() = p; }
+    ~ProfileScope() { option::Profile::current() = prev; }
+};
+#define C4OPT_PROFILE_PHASE(phase) PhaseTimer _c4opt_phase_timer(&profile, phase)
+#else
+#define C4OPT_PROFILE_PHASE(phase)
+#endif
+
+/** the members of Parser other than the profile */
+struct ParserFields
+{
+    int argc;
+    const char **argv;
+    c4::Allocator<option::Option> alloc;
+    size_t num_opts;
+    option::Descriptor const *usage;
+    Spec spec;
+    option::Stats stats;
+    option::Option *options;
+    option::Option *buffer;
+    option::Parser parser;
+};
+#ifdef C4OPT_PROFILE
+static_assert(sizeof(Parser) >= sizeof(ParserFields) + sizeof(ParseProfile), "the profile must be in the parser");
+#else
+static_assert(sizeof(Parser) == sizeof(ParserFields), "without C4OPT_PROFILE, the profile must add nothing to the parser");
+#endif
+
 void _arg_val_err(const char* msg1, option::Option const& opt, const char* msg2)
 {
-    fprintf(stderr, "%s", msg1);
-    fwrite(opt.name, (size_t)opt.namelen, 1, stderr);
-    fprintf(stderr, "%s\n", msg2);
+    // a single write, so that messages from several threads do not interleave
+    fprintf(stderr, "%s%.*s%s\n", msg1, opt.namelen, opt.name, msg2);
 }
 } // anon
 
@@ -73,7 +121,192 @@ option::ArgStatus integer(option::Option const& option, bool msg)
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 
-Parser::Parser(Parser && that) : usage(that.usage)
+namespace detail {
+ParseError make_parse_error(bool illegal, int argi, int offset, option::Descriptor const* desc, option::Descriptor const* usage)
+{
+    ParseError err = {PARSE_OK, argi, offset, desc ? (int32_t)(desc - usage) : -1};
+    if( ! illegal)
+        err.code = PARSE_TOO_MANY_OPTIONS;
+    else if(desc && desc->shortopt[0] == 0 && desc->longopt[0] == 0)
+        err.code = PARSE_UNKNOWN_OPTION;
+    else
+        err.code = PARSE_ILLEGAL_ARGUMENT;
+    return err;
+}
+
+unsigned find_long(option::Descriptor const* usage, option::Index const* index, csubstr name)
+{
+    if(index)
+        return index->findLong(name.str, name.len);
+    unsigned idx = 0;
+    for( ; usage[idx].longopt != nullptr; ++idx)
+        if(strncmp(usage[idx].longopt, name.str, name.len) == 0 && usage[idx].longopt[name.len] == 0)
+            break;
+    return idx;
+}
+
+unsigned find_short(option::Descriptor const* usage, option::Index const* index, char c)
+{
+    unsigned idx = 0;
+    if(c == 0)
+    {
+        while(usage[idx].shortopt != nullptr)
+            ++idx;
+        return idx;
+    }
+    if(index)
+        return index->findShort(c);
+    for( ; usage[idx].shortopt != nullptr; ++idx)
+        if(strchr(usage[idx].shortopt, c) != nullptr)
+            break;
+    return idx;
+}
+
+option::Descriptor const* descriptor_at(option::Descriptor const* usage, option::Index const* index, unsigned idx)
+{
+    if(usage[idx].shortopt != nullptr)
+        return &usage[idx];
+    if(index)
+        idx = index->unknown;
+    else
+        for(idx = 0; usage[idx].shortopt != nullptr && (usage[idx].shortopt[0] != 0 || usage[idx].longopt[0] != 0); )
+            ++idx;
+    return usage[idx].shortopt == nullptr ? nullptr : &usage[idx];
+}
+
+int32_t find_descriptor(option::Descriptor const* usage, size_t num_usage_entries, int index)
+{
+    for(size_t d = 0; d < num_usage_entries && usage[d].shortopt != nullptr; ++d)
+        if(usage[d].index == (unsigned)index)
+            return (int32_t)d;
+    return -1;
+}
+} // namespace detail
+
+size_t format_error(substr buf, ParseError const& err, option::Descriptor const *usage, int argc, const char **argv)
+{
+    // the name of the offending option, as given in argv
+    if(err.argi >= 0 && err.argi < argc && argv[err.argi] != nullptr)
+    {
+        const char *tok = argv[err.argi];
+        return detail::format_error(buf, err, usage, to_csubstr(tok));
+    }
+    return detail::format_error(buf, err, usage, csubstr{});
+}
+
+namespace detail {
+size_t format_error(substr buf, ParseError const& err, option::Descriptor const *usage, csubstr tok)
+{
+    // the name of the offending option, as given in its token, or as
+    // spelled on the command line when there is no token; either way
+    // with its dashes: -l or --level
+    const char *dashes = "";
+    const char *name = "";
+    int namelen = 0;
+    if(tok.str != nullptr && (size_t)err.offset < tok.len)
+    {
+        name = tok.str + err.offset;
+        if(err.offset > 0 && tok.str[0] == '-' && tok.str[1] != '-')
+        {
+            dashes = "-"; // within a group of short options
+            namelen = 1;
+        }
+        else
+            while((size_t)(err.offset + namelen) < tok.len && name[namelen] != 0 && name[namelen] != '=')
+                ++namelen;
+    }
+    else if(err.desc >= 0)
+    {
+        option::Descriptor const& d = usage[err.desc];
+        if(d.longopt[0] != 0)
+        {
+            dashes = "--";
+            name = d.longopt;
+            namelen = (int)strlen(name);
+        }
+        else if(d.shortopt[0] != 0)
+        {
+            dashes = "-";
+            name = d.shortopt;
+            namelen = 1;
+        }
+    }
+    const char *msg1 = "Option '", *msg2 = "";
+    switch(err.code)
+    {
+    case PARSE_OK:
+        name = "";
+        namelen = 0;
+        msg1 = "";
+        break;
+    case PARSE_UNKNOWN_OPTION:
+        msg1 = "Unknown option '";
+        msg2 = "'";
+        break;
+    case PARSE_ILLEGAL_ARGUMENT:
+        msg2 = "': illegal argument";
+        break;
+    case PARSE_TOO_MANY_OPTIONS:
+        msg2 = "': too many options";
+        break;
+    case PARSE_MISSING_MANDATORY:
+        msg2 = "' is mandatory and was not given";
+        break;
+    case PARSE_TOO_MANY_TOKENS:
+        msg1 = "Too many arguments";
+        name = "";
+        namelen = 0;
+        break;
+    case PARSE_TOO_MANY_BYTES:
+        msg1 = "The arguments are too long";
+        name = "";
+        namelen = 0;
+        break;
+    case PARSE_TOO_MANY_OCCURRENCES:
+        msg2 = "': given too many times";
+        break;
+    case PARSE_ARG_TOO_LONG:
+        msg2 = "': argument is too long";
+        break;
+    case PARSE_TOO_MUCH_WORK:
+        msg1 = "The arguments are too expensive to parse";
+        name = "";
+        namelen = 0;
+        break;
+    case PARSE_UNKNOWN_COMMAND:
+        dashes = "";
+        msg1 = "Unknown command '";
+        msg2 = "'";
+        break;
+    case PARSE_AMBIGUOUS_COMMAND:
+        dashes = "";
+        msg1 = "Ambiguous command '";
+        msg2 = "'";
+        break;
+    case PARSE_TOO_MANY_DESCRIPTORS:
+        msg1 = "Too many options in the usage";
+        name = "";
+        namelen = 0;
+        break;
+    default:
+        msg1 = "unknown error";
+        name = "";
+        namelen = 0;
+        break;
+    }
+    if(namelen == 0)
+        dashes = "";
+    int ret = snprintf(buf.str, buf.len, "%s%s%.*s%s", msg1, dashes, namelen, name, msg2);
+    return ret > 0 ? (size_t)ret : 0;
+}
+} // namespace detail
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+Parser::Parser(Parser && that) : usage(that.usage), spec(that.spec)
 {
     argc = that.argc;
     argv = that.argv;
@@ -85,16 +318,32 @@ Parser::Parser(Parser && that) : usage(that.usage)
     parser = that.parser;
     that.options = nullptr;
     that.buffer = nullptr;
+    #ifdef C4OPT_PROFILE
+    profile = that.profile;
+    that.profile.checks_per_desc = nullptr;
+    #endif
 }
 
 Parser::~Parser()
 {
     if(options)
     {
-        _free(options, stats.options_max + stats.buffer_max);
+        _free(options, _block_size(stats.buffer_max));
         options = nullptr;
         buffer = nullptr;
     }
+    #ifdef C4OPT_PROFILE
+    if(profile.checks_per_desc)
+        alloc.resource()->deallocate(profile.checks_per_desc, num_opts * sizeof(unsigned), alignof(unsigned));
+    #endif
+}
+
+unsigned Parser::_block_size(unsigned buffer_size) const
+{
+    // the heads, the buffer, and the scratch of _fix_counts(): an int
+    // per head, in whole options
+    const unsigned scratch = (unsigned)((stats.options_max * sizeof(int) + sizeof(option::Option) - 1u) / sizeof(option::Option));
+    return stats.options_max + buffer_size + scratch;
 }
 
 option::Option *Parser::_allocate(unsigned num)
@@ -109,34 +358,137 @@ void Parser::_free(option::Option *ptr, unsigned num)
 {
     for(unsigned i = 0; i < num; ++i)
     {
-        buffer[i].~Option();
+        ptr[i].~Option();
     }
     alloc.deallocate(ptr, num);
 }
 
+void Parser::_reserve(unsigned buffer_size)
+{
+    if(buffer_size <= stats.buffer_max)
+        return;
+    // at least double, for amortized growth over repeated appends
+    if(buffer_size < 2u * stats.buffer_max)
+        buffer_size = 2u * stats.buffer_max;
+    option::Option *block = _allocate(_block_size(buffer_size));
+    // move the heads and the filled part of the buffer, moving the
+    // links of their lists with them, instead of relinking
+    option::Option::relocate(options, (int)stats.options_max + parser.optionsCount(), block);
+    _free(options, _block_size(stats.buffer_max));
+    options = block;
+    buffer = block + stats.options_max;
+    stats.buffer_max = buffer_size;
+}
+
+void Parser::_check_error(int argc_, const char **argv_, ParseError *err)
+{
+    if(err)
+    {
+        if(parser.error())
+            *err = detail::make_parse_error(parser.errorIllegal(), parser.errorIndex(), parser.errorOffset(), parser.errorDescriptor(), usage);
+        else
+            *err = {PARSE_OK, -1, 0, -1};
+    }
+    else if(parser.error())
+    {
+        ParseError e = detail::make_parse_error(parser.errorIllegal(), parser.errorIndex(), parser.errorOffset(), parser.errorDescriptor(), usage);
+        if(e.argi >= 0 && e.argi < argc_)
+            detail::print_suggestions(e, usage, to_csubstr(argv_[e.argi]));
+        help();
+        C4_ERROR("parser error");
+    }
+}
+
 Parser::Parser(option::Descriptor const *usage_, size_t num_usage_entries, int argc_, const char **argv_, c4::Allocator<option::Option> a)
+    : Parser(usage_, num_usage_entries, nullptr, argc_, argv_, nullptr, a)
+{
+}
+
+Parser::Parser(Spec const& spec_, int argc_, const char **argv_, c4::Allocator<option::Option> a)
+    : Parser(spec_.usage(), spec_.num_usage_entries(), &spec_, argc_, argv_, nullptr, a)
+{
+}
+
+Parser::Parser(option::Descriptor const *usage_, size_t num_usage_entries, int argc_, const char **argv_, ParseError *err, c4::Allocator<option::Option> a)
+    : Parser(usage_, num_usage_entries, nullptr, argc_, argv_, err, a)
+{
+    C4_ASSERT(err != nullptr);
+}
+
+Parser::Parser(Spec const& spec_, int argc_, const char **argv_, ParseError *err, c4::Allocator<option::Option> a)
+    : Parser(spec_.usage(), spec_.num_usage_entries(), &spec_, argc_, argv_, err, a)
+{
+    C4_ASSERT(err != nullptr);
+}
+
+Parser::Parser(option::Descriptor const *usage_, size_t num_usage_entries, Spec const* spec_, int argc_, const char **argv_, ParseError *err, c4::Allocator<option::Option> a)
     :
     argc(argc_),
     argv(argv_),
     alloc(a),
     num_opts(num_usage_entries),
     usage(usage_),
-    stats(usage_, argc, argv),
-    options(_allocate(stats.options_max + stats.buffer_max)), // allocate a single block for both options and buffer
-    buffer(options + stats.options_max),
-    parser(usage, argc, argv, options, buffer)//, /*min_abbr_len*/2, /*single_minus_longopt*/true, /*bufmax*/-1);
+    spec(spec_ ? *spec_ : Spec{}),
+    stats(),
+    options(nullptr),
+    buffer(nullptr),
+    parser()
+{
+    option::Index const* index = spec_ ? &spec.index : nullptr;
+    #ifdef C4OPT_PROFILE
+    profile = ParseProfile();
+    profile.checks_per_desc = (unsigned*) alloc.resource()->allocate(num_opts * sizeof(unsigned), alignof(unsigned));
+    memset(profile.checks_per_desc, 0, num_opts * sizeof(unsigned));
+    ProfileScope profile_scope(&profile);
+    #endif
+    {
+        C4OPT_PROFILE_PHASE(PHASE_STATS);
+        stats.add(/*gnu*/false, usage, argc, argv, /*min_abbr_len*/0, /*single_minus_longopt*/false, index);
+    }
+    options = _allocate(_block_size(stats.buffer_max)); // allocate a single block for the options, the buffer and the scratch
+    buffer = options + stats.options_max;
+    {
+        C4OPT_PROFILE_PHASE(PHASE_PARSE);
+        parser.parse(/*gnu*/false, usage, argc, argv, options, buffer, /*min_abbr_len*/0, /*single_minus_longopt*/false, /*bufmax*/-1, index, /*print_errors*/err == nullptr);
+    }
+    {
+        C4OPT_PROFILE_PHASE(PHASE_FIX_COUNTS);
+        _fix_counts();
+    }
+    _check_error(argc, argv, err);
+}
+
+bool Parser::append(int argc_, const char **argv_, ParseError *err)
 {
-    _fix_counts();
-    if(parser.error())
+    option::Index const* index = spec.index.usage ? &spec.index : nullptr;
+    #ifdef C4OPT_PROFILE
+    ProfileScope profile_scope(&profile);
+    #endif
+    option::Stats more;
     {
-        help();
-        C4_ERROR("parser error");
+        C4OPT_PROFILE_PHASE(PHASE_STATS);
+        more.add(/*gnu*/false, usage, argc_, argv_, /*min_abbr_len*/0, /*single_minus_longopt*/false, index);
+    }
+    // more.buffer_max counts the new options plus the empty slot
+    // which ends the buffer
+    _reserve((unsigned)parser.optionsCount() + more.buffer_max);
+    {
+        // the new occurrences are stored after the current ones, and
+        // appended to the lists of their heads; the lists need no fixing
+        C4OPT_PROFILE_PHASE(PHASE_PARSE);
+        parser.parse(/*gnu*/false, usage, argc_, argv_, options, buffer, /*min_abbr_len*/0, /*single_minus_longopt*/false, /*bufmax*/(int)stats.buffer_max, index, /*print_errors*/err == nullptr);
     }
+    _check_error(argc_, argv_, err);
+    return ! parser.error();
 }
 
 void Parser::help() const
 {
-    option::printUsage(fwrite, stdout, usage, /*columns*/80);
+    C4OPT_PROFILE_PHASE(PHASE_HELP);
+    if(spec.index.usage)
+        write_all(stdout, spec.help_text(/*columns*/80));
+    else
+        print_help(usage, /*columns*/80, stdout);
 }
 
 void Parser::check_mandatory(std::initializer_list<int> mandatory_options) const
@@ -144,7 +496,7 @@ void Parser::check_mandatory(std::initializer_list<int> mandatory_options) const
     int ok = 1;
     for(int index : mandatory_options)
     {
-        if(options[index].count() == 0)
+        if( ! options[index])
         {
             _arg_val_err("Option '", options[index], "' is mandatory and was not given");
             ok &= 0;
@@ -156,34 +508,57 @@ void Parser::check_mandatory(std::initializer_list<int> mandatory_options) const
     }
 }
 
+bool Parser::check_mandatory(std::initializer_list<int> mandatory_options, ParseError *err) const
+{
+    for(int index : mandatory_options)
+    {
+        if(options[index])
+            continue;
+        *err = {PARSE_MISSING_MANDATORY, -1, 0, detail::find_descriptor(usage, num_opts, index)};
+        return false;
+    }
+    return true;
+}
+
 void Parser::_fix_counts()
 {
-    #ifdef C4_WIN
-    int *counts = (int*) _alloca(num_opts * sizeof(int));
-    #else
-    int *counts = (int*) alloca(num_opts * sizeof(int));
-    #endif
-    memset(counts, 0, num_opts * sizeof(int));
+    // the scratch is at the end of the block of the options, so that
+    // counting costs no allocation for any number of descriptors.
+    // Only the indices with a head are counted: the options in the
+    // buffer all have one.
+    const size_t num_counts = num_opts < stats.options_max ? num_opts : stats.options_max;
+    int *counts = (int*) (buffer + stats.buffer_max);
+    memset(counts, 0, num_counts * sizeof(int));
 
     for(int i = 0; i < parser.optionsCount(); ++i)
     {
         auto & opt = buffer[i];
-        if(opt.index() < 0 || size_t(opt.index()) >= num_opts)
+        if(opt.index() < 0 || size_t(opt.index()) >= num_counts)
             continue;
         ++counts[opt.index()];
     }
-    for(size_t j = 0; j < num_opts; ++j)
+    // relink, in a single pass over the buffer, the lists which miss
+    // occurrences; they are marked with a negative count. Note the
+    // options array has only stats.options_max heads, which can be
+    // fewer than the descriptors.
+    bool relink = false;
+    for(size_t j = 0; j < num_counts; ++j)
     {
         if(counts[j] == options[j].count())
             continue;
-        for(int i = 0; i < parser.optionsCount(); ++i)
-        {
-            auto & opt = buffer[i];
-            if(opt.index() == i && options[j].first() != &opt)
-            {
-                options[j].append(&opt);
-            }
-        }
+        counts[j] = -1;
+        options[j] = option::Option();
+        relink = true;
+    }
+    for(int i = 0; relink && i < parser.optionsCount(); ++i)
+    {
+        auto & opt = buffer[i];
+        if(opt.index() < 0 || size_t(opt.index()) >= num_counts || counts[opt.index()] >= 0)
+            continue;
+        if(options[opt.index()])
+            options[opt.index()].append(&opt);
+        else
+            options[opt.index()] = opt;
     }
 }
 
@@ -199,13 +574,40 @@ Parser make_parser(option::Descriptor const *usage, size_t num_usage_entries,
     return Parser(usage, num_usage_entries, argc, argv, alloc);
 }
 
-Parser make_parser(option::Descriptor const *usage, size_t N,
+Parser make_parser(Spec const& spec,
                    int argc, const char **argv,
-                   int help_index,
+                   c4::Allocator<option::Option> alloc)
+{
+    return Parser(spec, argc, argv, alloc);
+}
+
+Parser make_parser(option::Descriptor const *usage, size_t num_usage_entries,
+                   int argc, const char **argv,
+                   ParseError *err,
                    std::initializer_list<int> mandatory_indices,
                    c4::Allocator<option::Option> alloc)
 {
-    auto p = Parser(usage, N, argc, argv, alloc);
+    auto p = Parser(usage, num_usage_entries, argc, argv, err, alloc);
+    if( ! *err)
+        p.check_mandatory(mandatory_indices, err);
+    return p;
+}
+
+Parser make_parser(Spec const& spec,
+                   int argc, const char **argv,
+                   ParseError *err,
+                   std::initializer_list<int> mandatory_indices,
+                   c4::Allocator<option::Option> alloc)
+{
+    auto p = Parser(spec, argc, argv, err, alloc);
+    if( ! *err)
+        p.check_mandatory(mandatory_indices, err);
+    return p;
+}
+
+namespace {
+void _handle_help_and_mandatory(Parser const& p, int help_index, std::initializer_list<int> mandatory_indices)
+{
     if(p[help_index])
     {
         p.help();
@@ -215,6 +617,224 @@ Parser make_parser(option::Descriptor const *usage, size_t N,
     {
         p.check_mandatory(mandatory_indices);
     }
+}
+} // anon
+
+Parser make_parser(option::Descriptor const *usage, size_t N,
+                   int argc, const char **argv,
+                   int help_index,
+                   std::initializer_list<int> mandatory_indices,
+                   c4::Allocator<option::Option> alloc)
+{
+    auto p = Parser(usage, N, argc, argv, alloc);
+    _handle_help_and_mandatory(p, help_index, mandatory_indices);
+    return p;
+}
+
+Parser make_parser(Spec const& spec,
+                   int argc, const char **argv,
+                   int help_index,
+                   std::initializer_list<int> mandatory_indices,
+                   c4::Allocator<option::Option> alloc)
+{
+    auto p = Parser(spec, argc, argv, alloc);
+    _handle_help_and_mandatory(p, help_index, mandatory_indices);
+    return p;
+}
+
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+/** a token to look for in scan_early_exit(), packed into the 64-bit
+ * word of its first 8 characters plus the remaining characters */
+struct EarlyToken
+{
+    uint64_t prefix;
+    const char *rest;  ///< the characters after the first 8, or null
+    int index;
+};
+
+C4_ALWAYS_INLINE uint64_t _pack_token(const char *s, const char **rest)
+{
+    uint64_t w = 0;
+    size_t i = 0;
+    for(; i < 8 && s[i] != 0; ++i)
+        w |= uint64_t((unsigned char)s[i]) << (8u * i);
+    *rest = (i == 8 && s[8] != 0) ? s + 8 : nullptr;
+    return w;
+}
+
+/** whether the parse takes the token after the option token arg as
+ * the argument of its last option, as in option::Parser: the last
+ * option of the token has no attached argument and its checker
+ * accepts the next token. Where the parse would fail, a next token
+ * which is not an option is taken to be the offending argument, so
+ * that it does not end the options. */
+bool _takes_next(option::Descriptor const* usage, option::Index const* index, const char *arg, const char *next)
+{
+    option::Descriptor const* desc;
+    const char *name;
+    if(arg[1] == '-')
+    {
+        name = arg + 2;
+        csubstr n = to_csubstr(name);
+        if(n.find('=') != csubstr::npos)
+            return false;
+        desc = detail::descriptor_at(usage, index, detail::find_long(usage, index, n));
+    }
+    else
+    {
+        // the short options of the group, until one takes the rest
+        // of the token as its argument
+        for(name = arg + 1; ; ++name)
+        {
+            desc = detail::descriptor_at(usage, index, detail::find_short(usage, index, *name));
+            if(desc == nullptr || name[1] == 0)
+                break;
+            option::ArgStatus stat = desc->check_arg(option::Option(desc, name, name + 1), false);
+            if(stat == option::ARG_OK || stat == option::ARG_ILLEGAL)
+                return false;
+        }
+    }
+    if(desc == nullptr)
+        return false;
+    switch(desc->check_arg(option::Option(desc, name, next), false))
+    {
+    case option::ARG_OK:
+        return true;
+    case option::ARG_ILLEGAL:
+        return next[0] != '-' || next[1] == 0;
+    default:
+        return false;
+    }
+}
+
+int _scan_tokens(option::Descriptor const* usage, option::Index const* index, EarlyToken const* tokens, size_t num_tokens, int argc, const char **argv)
+{
+    for(int i = 0; i < argc && argv[i] != nullptr; ++i)
+    {
+        const char *arg = argv[i];
+        // as in the parse, which is POSIX: the first positional
+        // argument ends the options, as does "--"
+        if(arg[0] != '-' || arg[1] == 0 || (arg[1] == '-' && arg[2] == 0))
+            break;
+        const char *rest;
+        uint64_t w = _pack_token(arg, &rest);
+        for(size_t t = 0; t < num_tokens; ++t)
+        {
+            if(w != tokens[t].prefix)
+                continue;
+            if(rest == tokens[t].rest || (rest && tokens[t].rest && strcmp(rest, tokens[t].rest) == 0))
+                return tokens[t].index;
+        }
+        // skip the argument of the option, which may look like a
+        // positional argument or like one of the tokens
+        if(i + 1 < argc && argv[i + 1] != nullptr && _takes_next(usage, index, arg, argv[i + 1]))
+            ++i;
+    }
+    return -1;
+}
+
+int _scan_early_exit(option::Descriptor const *usage, size_t num_usage_entries, option::Index const* index,
+                     int argc, const char **argv,
+                     std::initializer_list<int> indices)
+{
+    EarlyToken tokens[early_exit_max_tokens];
+    size_t num_tokens = 0;
+    char buf[9] = {};
+    for(size_t d = 0; d < num_usage_entries && usage[d].shortopt != nullptr; ++d)
+    {
+        option::Descriptor const& desc = usage[d];
+        bool wanted = false;
+        for(int i : indices)
+            wanted |= (i >= 0 && (unsigned)i == desc.index);
+        if( ! wanted)
+            continue;
+        // the tokens past the capacity are not looked for
+        for(const char *c = desc.shortopt; *c != 0 && num_tokens < C4_COUNTOF(tokens); ++c)
+        {
+            const char tok[] = {'-', *c, 0};
+            const char *unused;
+            tokens[num_tokens++] = {_pack_token(tok, &unused), nullptr, (int)desc.index};
+        }
+        if(desc.longopt[0] != 0 && num_tokens < C4_COUNTOF(tokens))
+        {
+            size_t len = strlen(desc.longopt);
+            buf[0] = buf[1] = '-';
+            memcpy(buf + 2, desc.longopt, len < 6 ? len : 6);
+            buf[2 + (len < 6 ? len : 6)] = 0;
+            const char *unused;
+            tokens[num_tokens++] = {_pack_token(buf, &unused), len > 6 ? desc.longopt + 6 : nullptr, (int)desc.index};
+        }
+    }
+    return _scan_tokens(usage, index, tokens, num_tokens, argc, argv);
+}
+
+} // anon
+
+int scan_early_exit(option::Descriptor const *usage, size_t num_usage_entries,
+                    int argc, const char **argv,
+                    std::initializer_list<int> indices)
+{
+    return _scan_early_exit(usage, num_usage_entries, nullptr, argc, argv, indices);
+}
+
+int scan_early_exit(Spec const& spec,
+                    int argc, const char **argv,
+                    std::initializer_list<int> indices)
+{
+    return _scan_early_exit(spec.usage(), spec.num_usage_entries(), &spec.index, argc, argv, indices);
+}
+
+namespace {
+void _handle_early_exit(option::Descriptor const *usage, size_t N, Spec const* spec,
+                        int argc, const char **argv, EarlyExit const& early)
+{
+    int found = spec ?
+        scan_early_exit(*spec, argc, argv, {early.help_index, early.version_index}) :
+        scan_early_exit(usage, N, argc, argv, {early.help_index, early.version_index});
+    if(found < 0)
+        return;
+    if(found == early.help_index)
+    {
+        write_all(stdout, spec ? spec->help_text(/*columns*/80) : help_text(usage, /*columns*/80));
+    }
+    else
+    {
+        C4_ASSERT(found == early.version_index);
+        const char *v = early.version ? early.version : "";
+        size_t len = strlen(v);
+        write_all(stdout, csubstr(v, len));
+        if(len == 0 || v[len - 1] != '\n')
+            write_all(stdout, csubstr("\n", 1));
+    }
+    std::exit(0);
+}
+} // anon
+
+Parser make_parser(option::Descriptor const *usage, size_t N,
+                   int argc, const char **argv,
+                   EarlyExit const& early,
+                   std::initializer_list<int> mandatory_indices,
+                   c4::Allocator<option::Option> alloc)
+{
+    _handle_early_exit(usage, N, nullptr, argc, argv, early);
+    auto p = Parser(usage, N, argc, argv, alloc);
+    p.check_mandatory(mandatory_indices);
+    return p;
+}
+
+Parser make_parser(Spec const& spec,
+                   int argc, const char **argv,
+                   EarlyExit const& early,
+                   std::initializer_list<int> mandatory_indices,
+                   c4::Allocator<option::Option> alloc)
+{
+    _handle_early_exit(spec.usage(), spec.num_usage_entries(), &spec, argc, argv, early);
+    auto p = Parser(spec, argc, argv, alloc);
+    p.check_mandatory(mandatory_indices);
     return p;
 }
 
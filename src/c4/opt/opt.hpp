@@ -3,6 +3,7 @@
 
 #include <c4/error.hpp>
 #include <c4/allocator.hpp>
+#include <stdint.h>
 
 C4_SUPPRESS_WARNING_GCC_PUSH
 C4_SUPPRESS_WARNING_GCC("-Wnon-virtual-dtor")
@@ -10,6 +11,9 @@ C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
 #include "c4/opt/detail/optionparser.h"
 C4_SUPPRESS_WARNING_GCC_POP
 
+#include "c4/opt/help.hpp"
+#include "c4/opt/spec.hpp"
+
 /** @file opt.hpp command line option parser utilities */
 
 namespace c4 {
@@ -67,6 +71,108 @@ option::ArgStatus multicheck(option::Option const& option, bool msg)
 }
 
 
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+/** how options and positional arguments may be mixed */
+typedef enum {
+    PARSE_POSIX = 0,  ///< the first positional argument ends the options
+    PARSE_GNU,        ///< options and positional arguments may be mixed; "--" ends the options
+} ParseMode_e;
+
+typedef enum : uint32_t {
+    PARSE_OK = 0,             ///< no error
+    PARSE_UNKNOWN_OPTION,     ///< an option was not found in the usage
+    PARSE_ILLEGAL_ARGUMENT,   ///< the checker of an option rejected its argument
+    PARSE_TOO_MANY_OPTIONS,   ///< an option could not be stored
+    PARSE_MISSING_MANDATORY,  ///< a mandatory option was not given
+    PARSE_TOO_MANY_TOKENS,    ///< there were more tokens than ParseLimits::max_tokens
+    PARSE_TOO_MANY_BYTES,     ///< the tokens were longer than ParseLimits::max_bytes in total
+    PARSE_TOO_MANY_OCCURRENCES, ///< an option was given more than ParseLimits::max_occurrences times
+    PARSE_ARG_TOO_LONG,       ///< an argument was longer than ParseLimits::max_arg_len
+    PARSE_TOO_MUCH_WORK,      ///< the parse needed more than ParseLimits::max_comparisons
+    PARSE_UNKNOWN_COMMAND,    ///< a command was not found among the subcommands; see CommandParser
+    PARSE_AMBIGUOUS_COMMAND,  ///< an abbreviated command name matched several subcommands
+    PARSE_TOO_MANY_DESCRIPTORS, ///< the usage had more descriptors than the parser can record; see CompactParser
+} ParseErrorCode_e;
+
+/** a compact record of a parse error, filled by the non-printing
+ * parse functions instead of printing and aborting. Use
+ * format_error() to get the message, only if it is needed. */
+struct ParseError
+{
+    uint32_t code;    ///< a ParseErrorCode_e
+    int32_t  argi;    ///< the position in argv of the offending token, or -1
+    int32_t  offset;  ///< the offset of the offending option within its token (nonzero in short option groups)
+    int32_t  desc;    ///< the position in the usage array of the offending descriptor, or -1
+
+    explicit operator bool() const { return code != PARSE_OK; }
+};
+
+/** Limits on the resources spent parsing, for input from untrusted
+ * sources. A parse exceeding any of them stops at that point, with
+ * the corresponding ParseErrorCode_e. The defaults are unlimited. */
+struct ParseLimits
+{
+    size_t max_tokens = size_t(-1);       ///< the number of tokens; at most INT32_MAX, so that their positions fit in ParseError::argi
+    size_t max_bytes = size_t(-1);        ///< the total length of the tokens
+    size_t max_occurrences = size_t(-1);  ///< the occurrences of each option index
+    size_t max_arg_len = size_t(-1);      ///< the length of each option argument
+    size_t max_comparisons = size_t(-1);  ///< the descriptors looked at to find the options
+};
+
+/** write the message for an error into buf, snprintf-style: the
+ * result is always terminated if buf is not empty. Options are named
+ * with their dashes, as on the command line: -l, --level.
+ * @return the length the message needs, without the terminator. */
+size_t format_error(substr buf, ParseError const& err, option::Descriptor const *usage, int argc, const char **argv);
+
+namespace detail {
+/** classify an error reported by the option parser */
+ParseError make_parse_error(bool illegal, int argi, int offset, option::Descriptor const* desc, option::Descriptor const* usage);
+/** the position of the first descriptor with the given long option
+ * (which need not be null-terminated), or of the terminator if there
+ * is none. Uses the lookup table of the index if it is not null. */
+unsigned find_long(option::Descriptor const* usage, option::Index const* index, csubstr name);
+/** the position of the first descriptor with the given short option,
+ * or of the terminator if there is none */
+unsigned find_short(option::Descriptor const* usage, option::Index const* index, char c);
+/** the descriptor at position idx as returned by find_long() or
+ * find_short(), or the descriptor for unknown options if idx is the
+ * terminator. Null if there is neither. */
+option::Descriptor const* descriptor_at(option::Descriptor const* usage, option::Index const* index, unsigned idx);
+/** the position in the usage array of the first descriptor with the given index, or -1 */
+int32_t find_descriptor(option::Descriptor const* usage, size_t num_usage_entries, int index);
+/** format_error() for the given token of the offending option, which
+ * need not be null-terminated. Pass an empty token to name the option
+ * from its descriptor. */
+size_t format_error(substr buf, ParseError const& err, option::Descriptor const *usage, csubstr tok);
+} // namespace detail
+
+
+#ifdef C4OPT_PROFILE
+/** the phases of a parse timed in ParseProfile */
+typedef enum : uint8_t {
+    PHASE_STATS = 0,   ///< sizing the arrays (option::Stats)
+    PHASE_PARSE,       ///< filling the arrays (option::Parser)
+    PHASE_FIX_COUNTS,  ///< linking the options of each index
+    PHASE_HELP,        ///< Parser::help()
+    PHASE_COUNT
+} ParsePhase_e;
+
+/** What a Parser did, when c4opt is compiled with C4OPT_PROFILE
+ * (cmake -DC4OPT_PROFILE=ON). The counters of option::Profile are
+ * summed over the stats and parse passes, and checks_per_desc has one
+ * entry per position in the usage array. Without C4OPT_PROFILE, none
+ * of this exists and the parse does no extra work. */
+struct ParseProfile : public option::Profile
+{
+    uint64_t phase_ns[PHASE_COUNT];  ///< the time spent in each phase, in nanoseconds
+};
+#endif
+
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
@@ -80,10 +186,14 @@ struct Parser
 
     size_t          num_opts;
     option::Descriptor const *usage;
+    Spec            spec;  ///< the compiled spec. spec.index.usage is null when parsing from a plain usage
     option::Stats   stats;
     option::Option *options; ///< using a raw pointer here to avoid dependency on vector
     option::Option *buffer;  ///< using a raw pointer here to avoid dependency on vector
     option::Parser  parser;
+    #ifdef C4OPT_PROFILE
+    mutable ParseProfile profile;  ///< mutable, to time help()
+    #endif
 
 public:
 
@@ -97,14 +207,48 @@ public:
 
 private:
 
+    unsigned _block_size(unsigned buffer_size) const;
     option::Option *_allocate(unsigned num);
     void _free(option::Option *ptr, unsigned num);
+    void _reserve(unsigned buffer_size);
+    void _check_error(int argc_, const char **argv_, ParseError *err);
+
+    Parser(option::Descriptor const *usage_, size_t num_usage_entries, Spec const* spec_, int argc_, const char **argv_, ParseError *err, c4::Allocator<option::Option> a);
 
 public:
 
     Parser(option::Descriptor const *usage_, size_t num_usage_entries, int argc_, const char **argv_, c4::Allocator<option::Option> a={});
+    /** parse using the lookup tables from a compiled spec. The spec is
+     * copied, but the tables it refers to must outlive the parser. */
+    Parser(Spec const& spec_, int argc_, const char **argv_, c4::Allocator<option::Option> a={});
+
+    /** parse without printing or aborting on error: the error (if
+     * any) is recorded in err. The parser is still usable for the
+     * options before the error. */
+    Parser(option::Descriptor const *usage_, size_t num_usage_entries, int argc_, const char **argv_, ParseError *err, c4::Allocator<option::Option> a={});
+    Parser(Spec const& spec_, int argc_, const char **argv_, ParseError *err, c4::Allocator<option::Option> a={});
+
+    /** parse more arguments onto the result, as if they followed
+     * those already parsed: the occurrences are added at the end of
+     * opts_args() and of the list of their option, so that last()
+     * is the one given last, eg when layering default, configured
+     * and user arguments. The arguments parsed before are not looked
+     * at again, and the buffer grows geometrically, so that appending
+     * n options costs O(n) over all the calls. The positional
+     * arguments are those of the last call which had any; raw_args()
+     * are still those of the constructor. argv_ must outlive the
+     * parser.
+     *
+     * Without err, an error is printed and the program aborts, as in
+     * the constructor. Its argi is the position in argv_.
+     * @return true if there was no error */
+    bool append(int argc_, const char **argv_, ParseError *err=nullptr);
 
     void check_mandatory(std::initializer_list<int> mandatory_options) const;
+    /** check without printing or aborting: the first missing option
+     * is recorded in err.
+     * @return true if all the mandatory options were given */
+    bool check_mandatory(std::initializer_list<int> mandatory_options, ParseError *err) const;
     void help() const;
 
     option::Option const& operator[] (int i) const { C4_CHECK(size_t(i) < num_opts); return options[i]; }
@@ -211,6 +355,37 @@ Parser make_parser(option::Descriptor const (&usage)[N],
     return make_parser(usage, N, argc, argv, alloc);
 }
 
+Parser make_parser(Spec const& spec,
+                   int argc, const char **argv,
+                   c4::Allocator<option::Option> alloc=c4::Allocator<option::Option>{});
+
+
+//-----------------------------------------------------------------------------
+
+/** Parse without any I/O, exit or exception: the first error (from the
+ * checkers or from the mandatory options) is recorded in err. */
+Parser make_parser(option::Descriptor const *usage, size_t num_usage_entries,
+                   int argc, const char **argv,
+                   ParseError *err,
+                   std::initializer_list<int> mandatory_indices=std::initializer_list<int>(),
+                   c4::Allocator<option::Option> alloc=c4::Allocator<option::Option>{});
+
+template <size_t N>
+Parser make_parser(option::Descriptor const (&usage)[N],
+                   int argc, const char **argv,
+                   ParseError *err,
+                   std::initializer_list<int> mandatory_indices=std::initializer_list<int>(),
+                   c4::Allocator<option::Option> alloc=c4::Allocator<option::Option>{})
+{
+    return make_parser(usage, N, argc, argv, err, mandatory_indices, alloc);
+}
+
+Parser make_parser(Spec const& spec,
+                   int argc, const char **argv,
+                   ParseError *err,
+                   std::initializer_list<int> mandatory_indices=std::initializer_list<int>(),
+                   c4::Allocator<option::Option> alloc=c4::Allocator<option::Option>{});
+
 
 //-----------------------------------------------------------------------------
 
@@ -230,6 +405,74 @@ Parser make_parser(option::Descriptor const (&usage)[N],
     return make_parser(usage, N, argc, argv, help_index, mandatory_indices, alloc);
 }
 
+Parser make_parser(Spec const& spec,
+                   int argc, const char **argv,
+                   int help_index,
+                   std::initializer_list<int> mandatory_indices=std::initializer_list<int>(),
+                   c4::Allocator<option::Option> alloc=c4::Allocator<option::Option>{});
+
+
+//-----------------------------------------------------------------------------
+
+/** the most tokens looked for by scan_early_exit() */
+constexpr const size_t early_exit_max_tokens = 32;
+
+/** Scan argv for the exact tokens of the descriptors with the given
+ * indices (eg -h, --help, --version), without storing any option.
+ * Only the tokens which the parse would take as options are matched:
+ * the scan stops at the first positional argument and at "--", and
+ * skips the arguments of the options. Each option token is packed into
+ * a 64-bit word, and compared with each of the tokens looked for, which
+ * are the first early_exit_max_tokens short and long names of those
+ * descriptors, in the order of the usage. To know whether an option
+ * takes the next token, its descriptor is looked up (linearly in the
+ * usage, or with the index of the spec) and its checker is called, so
+ * the checkers of the options before a match are called again by the
+ * parse. Nothing is allocated.
+ * @return the index of the first match, or -1 if none was found */
+int scan_early_exit(option::Descriptor const *usage, size_t num_usage_entries,
+                    int argc, const char **argv,
+                    std::initializer_list<int> indices);
+/** scan_early_exit() looking up the descriptors with the index of the spec */
+int scan_early_exit(Spec const& spec,
+                    int argc, const char **argv,
+                    std::initializer_list<int> indices);
+
+/** the options for which make_parser() should exit right away, before
+ * parsing the arguments; see scan_early_exit() */
+struct EarlyExit
+{
+    int help_index;           ///< print the help and exit(0). -1 for none.
+    int version_index;        ///< print the version and exit(0). -1 for none.
+    const char *version;      ///< the text to print for the version
+};
+
+/** Parse with an early exit: if any token of the help or version
+ * options is given, print the help/version and exit right away,
+ * without parsing the arguments, as told in scan_early_exit().
+ * Otherwise, parse normally and check the mandatory options. */
+Parser make_parser(option::Descriptor const *usage, size_t N,
+                   int argc, const char **argv,
+                   EarlyExit const& early,
+                   std::initializer_list<int> mandatory_indices=std::initializer_list<int>(),
+                   c4::Allocator<option::Option> alloc=c4::Allocator<option::Option>{});
+
+template <size_t N>
+Parser make_parser(option::Descriptor const (&usage)[N],
+                   int argc, const char **argv,
+                   EarlyExit const& early,
+                   std::initializer_list<int> mandatory_indices=std::initializer_list<int>(),
+                   c4::Allocator<option::Option> alloc=c4::Allocator<option::Option>{})
+{
+    return make_parser(usage, N, argc, argv, early, mandatory_indices, alloc);
+}
+
+Parser make_parser(Spec const& spec,
+                   int argc, const char **argv,
+                   EarlyExit const& early,
+                   std::initializer_list<int> mandatory_indices=std::initializer_list<int>(),
+                   c4::Allocator<option::Option> alloc=c4::Allocator<option::Option>{});
+
 
 } // namespace opt
 } // namespace c4
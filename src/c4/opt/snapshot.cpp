@@ -0,0 +1,228 @@
+#include "c4/opt/snapshot.hpp"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace c4 {
+namespace opt {
+
+namespace {
+
+constexpr const char snapshot_magic[8] = {'c', '4', 'o', 'p', 't', 's', 'n', 'p'};
+
+C4_ALWAYS_INLINE size_t _align8(size_t sz)
+{
+    return (sz + 7u) & ~size_t(7u);
+}
+
+void _set_value(SnapshotOccurrence *occ, const char *arg)
+{
+    occ->ival = 0;
+    if(arg == nullptr)
+    {
+        occ->type = SNAPSHOT_VALUE_NONE;
+        return;
+    }
+    occ->type = SNAPSHOT_VALUE_STRING;
+    if(arg[0] == 0)
+        return;
+    char *end = nullptr;
+    errno = 0;
+    long long i = strtoll(arg, &end, 10);
+    if(*end == 0 && errno == 0)
+    {
+        occ->type = SNAPSHOT_VALUE_INT;
+        occ->ival = (int64_t)i;
+        return;
+    }
+    errno = 0;
+    double f = strtod(arg, &end);
+    if(*end == 0 && errno == 0)
+    {
+        occ->type = SNAPSHOT_VALUE_FLOAT;
+        occ->fval = f;
+    }
+}
+
+/** write a snapshot from the options returned by get_opt(k) for k in
+ * [0,num_occ) and the positional arguments returned by get_posn(k)
+ * for k in [0,num_posn) */
+template<class GetOpt, class GetPosn>
+size_t _write_snapshot(substr buf, option::Descriptor const* usage, size_t num_indices,
+                       size_t num_occ, GetOpt &&get_opt,
+                       size_t num_posn, GetPosn &&get_posn)
+{
+    size_t num_usage = 0;
+    while(usage[num_usage].shortopt != nullptr)
+        ++num_usage;
+    // compute the layout
+    size_t strings_size = 0;
+    for(size_t k = 0; k < num_occ; ++k)
+    {
+        option::Option o = get_opt(k);
+        strings_size += (size_t)o.namelen + 1u;
+        if(o.arg)
+            strings_size += strlen(o.arg) + 1u;
+    }
+    for(size_t k = 0; k < num_posn; ++k)
+        strings_size += strlen(get_posn(k)) + 1u;
+    const size_t heads = _align8(sizeof(SnapshotHeader));
+    const size_t occurrences = _align8(heads + num_indices * sizeof(SnapshotHead));
+    const size_t posn = occurrences + num_occ * sizeof(SnapshotOccurrence);
+    const size_t strings = posn + num_posn * sizeof(uint32_t);
+    const size_t size = _align8(strings + strings_size);
+    C4_CHECK_MSG(size <= UINT32_MAX, "snapshot too large: %zu bytes", size);
+    if(buf.len < size)
+        return size;
+    C4_CHECK(((uintptr_t)buf.str & 7u) == 0);
+    // write
+    memset(buf.str, 0, size);
+    SnapshotHeader *hdr = (SnapshotHeader*) buf.str;
+    memcpy(hdr->magic, snapshot_magic, sizeof(hdr->magic));
+    hdr->version = SnapshotHeader::current_version;
+    hdr->size = (uint32_t)size;
+    hdr->fingerprint = spec_fingerprint(usage);
+    hdr->num_usage = (uint32_t)num_usage;
+    hdr->num_indices = (uint32_t)num_indices;
+    hdr->num_occurrences = (uint32_t)num_occ;
+    hdr->num_posn = (uint32_t)num_posn;
+    hdr->heads = (uint32_t)heads;
+    hdr->occurrences = (uint32_t)occurrences;
+    hdr->posn = (uint32_t)posn;
+    hdr->strings = (uint32_t)strings;
+    SnapshotHead *h = (SnapshotHead*) (buf.str + heads);
+    SnapshotOccurrence *occ = (SnapshotOccurrence*) (buf.str + occurrences);
+    uint32_t *pos = (uint32_t*) (buf.str + posn);
+    size_t s = strings;
+    auto add_str = [&](const char *str, size_t len) {
+        memcpy(buf.str + s, str, len); // the terminator is already zero
+        uint32_t off = (uint32_t)s;
+        s += len + 1u;
+        return off;
+    };
+    for(size_t i = 0; i < num_indices; ++i)
+        h[i] = {SnapshotOccurrence::npos, 0};
+    for(size_t k = 0; k < num_occ; ++k)
+    {
+        option::Option o = get_opt(k);
+        occ[k].desc = (uint32_t)(o.desc - usage);
+        occ[k].name = add_str(o.name, (size_t)o.namelen);
+        occ[k].arg = o.arg ? add_str(o.arg, strlen(o.arg)) : SnapshotOccurrence::npos;
+        _set_value(&occ[k], o.arg);
+    }
+    // link in reverse, so that each option index is in the order of argv
+    for(size_t k = num_occ; k-- > 0; )
+    {
+        SnapshotHead &head = h[usage[occ[k].desc].index];
+        occ[k].next = head.first;
+        head.first = (uint32_t)k;
+        ++head.count;
+    }
+    for(size_t k = 0; k < num_posn; ++k)
+    {
+        const char *p = get_posn(k);
+        pos[k] = add_str(p, strlen(p));
+    }
+    C4_ASSERT(s <= size);
+    return size;
+}
+
+} // anon
+
+
+size_t write_snapshot(substr buf, Parser const& p)
+{
+    return _write_snapshot(buf, p.usage, p.stats.options_max,
+                           (size_t)p.parser.optionsCount(), [&](size_t k) { return p.buffer[k]; },
+                           (size_t)p.parser.nonOptionsCount(), [&](size_t k) { return p.parser.nonOption((int)k); });
+}
+
+size_t write_snapshot(substr buf, CompactParser const& p)
+{
+    return _write_snapshot(buf, p.usage(), p.num_indices(),
+                           p.num_occurrences(), [&](size_t k) { return p.view(p.occurrences()[k]); },
+                           p.num_posn(), [&](size_t k) { return p.raw_args().begin()[p.posn_indices()[k]]; });
+}
+
+
+//-----------------------------------------------------------------------------
+
+Snapshot::Snapshot(void const* blob, size_t size, option::Descriptor const* usage)
+    : Snapshot()
+{
+    const char *b = (const char*) blob;
+    if(b == nullptr || ((uintptr_t)b & 7u) != 0 || size < sizeof(SnapshotHeader))
+        return;
+    SnapshotHeader const* hdr = (SnapshotHeader const*) b;
+    if(memcmp(hdr->magic, snapshot_magic, sizeof(hdr->magic)) != 0
+       || hdr->version != SnapshotHeader::current_version
+       || hdr->size > size
+       || hdr->fingerprint != spec_fingerprint(usage))
+        return;
+    size_t num_usage = 0;
+    while(usage[num_usage].shortopt != nullptr)
+        ++num_usage;
+    const uint64_t sz = hdr->size;
+    if(hdr->num_usage != num_usage
+       || hdr->heads + uint64_t(hdr->num_indices) * sizeof(SnapshotHead) > sz
+       || hdr->occurrences + uint64_t(hdr->num_occurrences) * sizeof(SnapshotOccurrence) > sz
+       || hdr->posn + uint64_t(hdr->num_posn) * sizeof(uint32_t) > sz
+       || (hdr->heads & 7u) != 0 || (hdr->occurrences & 7u) != 0 || (hdr->posn & 3u) != 0
+       || hdr->strings > sz)
+        return;
+    // every string ends with a zero, so it is enough that each
+    // offset is within the strings and that the block ends with a zero
+    if(hdr->strings < sz && b[sz - 1] != 0)
+        return;
+    auto str_ok = [&](uint32_t off) { return off >= hdr->strings && off < sz; };
+    SnapshotHead const* heads = (SnapshotHead const*) (b + hdr->heads);
+    SnapshotOccurrence const* occ = (SnapshotOccurrence const*) (b + hdr->occurrences);
+    uint32_t const* posn = (uint32_t const*) (b + hdr->posn);
+    const uint32_t n = hdr->num_occurrences;
+    for(uint32_t i = 0; i < hdr->num_indices; ++i)
+        if((heads[i].first >= n && heads[i].first != SnapshotOccurrence::npos) || heads[i].count > n)
+            return;
+    for(uint32_t k = 0; k < n; ++k)
+    {
+        SnapshotOccurrence const& o = occ[k];
+        if(o.desc >= num_usage
+           || usage[o.desc].index >= hdr->num_indices
+           || ! str_ok(o.name)
+           || (o.arg != SnapshotOccurrence::npos && ! str_ok(o.arg))
+           || (o.next != SnapshotOccurrence::npos && (o.next <= k || o.next >= n)) // forward links only: no cycles
+           || o.type > SNAPSHOT_VALUE_FLOAT)
+            return;
+    }
+    for(uint32_t k = 0; k < hdr->num_posn; ++k)
+        if( ! str_ok(posn[k]))
+            return;
+    m_blob = b;
+    m_usage = usage;
+    m_heads = heads;
+    m_occ = occ;
+    m_posn = posn;
+    m_hdr = hdr;
+}
+
+option::Option Snapshot::_view(uint32_t pos) const
+{
+    if(pos == SnapshotOccurrence::npos)
+        return option::Option();
+    C4_ASSERT(pos < m_hdr->num_occurrences);
+    return view(m_occ[pos]);
+}
+
+option::Option Snapshot::view(SnapshotOccurrence const& occ) const
+{
+    return option::Option(&m_usage[occ.desc], m_blob + occ.name, str(occ.arg));
+}
+
+const char* Snapshot::operator() (int i) const
+{
+    option::Option opt = (*this)[i];
+    C4_CHECK_MSG(opt.arg, "error in option %d: '%.*s'", i, opt.namelen, opt.name);
+    return opt.arg;
+}
+
+} // namespace opt
+} // namespace c4
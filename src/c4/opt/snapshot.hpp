@@ -0,0 +1,188 @@
+#ifndef _C4_OPT_SNAPSHOT_HPP_
+#define _C4_OPT_SNAPSHOT_HPP_
+
+#include "c4/opt/compact.hpp"
+
+/** @file snapshot.hpp relocatable binary snapshots of parse results,
+ * to hand them over to other processes */
+
+namespace c4 {
+namespace opt {
+
+typedef enum : uint8_t {
+    SNAPSHOT_VALUE_NONE = 0,  ///< the option has no argument
+    SNAPSHOT_VALUE_STRING,    ///< the argument is not a number
+    SNAPSHOT_VALUE_INT,       ///< the argument is a decimal integer; see SnapshotOccurrence::ival
+    SNAPSHOT_VALUE_FLOAT,     ///< the argument is a floating point number; see SnapshotOccurrence::fval
+} SnapshotValue_e;
+
+/** The header of a snapshot. A snapshot is a single block without
+ * pointers: everything in it is referred to by its offset from the
+ * start of the block. It can thus be copied, written to a file or
+ * mapped from shared memory at any address, and queried in place with
+ * Snapshot. The block is in the native byte order. */
+struct SnapshotHeader
+{
+    enum : uint32_t { current_version = 1 };
+
+    char     magic[8];         ///< "c4optsnp"
+    uint32_t version;          ///< current_version
+    uint32_t size;             ///< the size of the whole block, in bytes
+    uint64_t fingerprint;      ///< the spec_fingerprint() of the descriptors
+    uint32_t num_usage;        ///< the number of descriptors, without the terminating entry
+    uint32_t num_indices;      ///< the number of SnapshotHead entries: one per option index
+    uint32_t num_occurrences;  ///< the number of SnapshotOccurrence entries
+    uint32_t num_posn;         ///< the number of positional arguments
+    uint32_t heads;            ///< offset of the SnapshotHead array
+    uint32_t occurrences;      ///< offset of the SnapshotOccurrence array, in the order of argv
+    uint32_t posn;             ///< offset of the array of offsets (uint32_t) of the positional arguments
+    uint32_t strings;          ///< offset of the strings; each is terminated by a zero
+};
+
+struct SnapshotHead
+{
+    uint32_t first;  ///< the first occurrence of the option index, or npos
+    uint32_t count;  ///< the number of occurrences of the option index
+};
+
+struct SnapshotOccurrence
+{
+    enum : uint32_t { npos = uint32_t(-1) };
+
+    uint32_t desc;     ///< the position of the descriptor in the usage array
+    uint32_t name;     ///< offset of the option name, as given (eg "--level" or "l")
+    uint32_t arg;      ///< offset of the argument, or npos if there is none
+    uint32_t next;     ///< the next occurrence with the same index, or npos
+    uint8_t  type;     ///< the type of the argument: one of SnapshotValue_e
+    uint8_t  reserved[7];
+    union
+    {
+        int64_t ival;  ///< the value when type is SNAPSHOT_VALUE_INT
+        double  fval;  ///< the value when type is SNAPSHOT_VALUE_FLOAT
+    };
+};
+
+
+/** write a snapshot of the results of a parser into buf. The snapshot
+ * is written only if buf is large enough; call first with an empty
+ * buf to get the size.
+ * @return the size of the snapshot */
+size_t write_snapshot(substr buf, Parser const& p);
+size_t write_snapshot(substr buf, CompactParser const& p);
+
+
+/** Queries a snapshot in place, with the same accessors as Parser. The
+ * snapshot is validated on construction, including its fingerprint
+ * against the descriptors: if anything is wrong, ok() is false, and
+ * the snapshot must not be queried.
+ *
+ * The block is not copied, and must outlive this object. It should be
+ * aligned to 8 bytes. The options returned from this are views, with
+ * their name and argument pointing into the block. */
+class Snapshot
+{
+public:
+
+    Snapshot() : m_blob(nullptr), m_usage(nullptr), m_hdr(nullptr), m_heads(nullptr), m_occ(nullptr), m_posn(nullptr) {}
+    Snapshot(void const* blob, size_t size, option::Descriptor const* usage);
+    Snapshot(void const* blob, size_t size, Spec const& spec) : Snapshot(blob, size, spec.usage()) {}
+
+    bool ok() const { return m_hdr != nullptr; }
+    explicit operator bool() const { return ok(); }
+
+    SnapshotHeader const& header() const { C4_ASSERT(ok()); return *m_hdr; }
+
+public:
+
+    /** the number of times the option with index i was given */
+    int count(int i) const { C4_CHECK(size_t(i) < m_hdr->num_indices); return (int)m_heads[i].count; }
+    /** a view of the first occurrence of the option with index i. It
+     * converts to false if the option was not given. */
+    option::Option operator[] (int i) const { C4_CHECK(size_t(i) < m_hdr->num_indices); return _view(m_heads[i].first); }
+    /** the argument of the first occurrence of the option with index i */
+    const char* operator() (int i) const;
+
+    /** the first occurrence of the option with index i, or null */
+    SnapshotOccurrence const* first(int i) const
+    {
+        C4_CHECK(size_t(i) < m_hdr->num_indices);
+        return m_heads[i].first != SnapshotOccurrence::npos ? m_occ + m_heads[i].first : nullptr;
+    }
+
+    SnapshotOccurrence const* occurrences() const { return m_occ; }
+    size_t num_occurrences() const { return m_hdr->num_occurrences; }
+
+    option::Option view(SnapshotOccurrence const& occ) const;
+    const char* str(uint32_t offset) const { return offset != SnapshotOccurrence::npos ? m_blob + offset : nullptr; }
+
+public:
+
+    struct option_iterator
+    {
+        Snapshot const* s;
+        uint32_t pos;
+        bool chained; ///< whether to follow the occurrences with the same index
+        using value_type = option::Option;
+        option::Option operator* () const { return s->_view(pos); }
+        option_iterator& operator++ () { pos = chained ? s->m_occ[pos].next : pos + 1; return *this; }
+        bool operator!= (option_iterator that) const { return pos != that.pos; }
+        bool operator== (option_iterator that) const { return pos == that.pos; }
+    };
+
+    struct positional_arg_iterator
+    {
+        Snapshot const* s;
+        uint32_t const* pos;
+        using value_type = const char*;
+        const char* operator* () const { return s->m_blob + *pos; }
+        positional_arg_iterator& operator++ () { ++pos; return *this; }
+        bool operator!= (positional_arg_iterator that) const { return pos != that.pos; }
+        bool operator== (positional_arg_iterator that) const { return pos == that.pos; }
+    };
+
+    template <class It>
+    struct iterator_range
+    {
+        It begin_, end_;
+        It begin() const { return begin_; }
+        It end() const { return end_; }
+    };
+
+    /** iterate through the occurrences of the option with index i */
+    iterator_range<option_iterator> opts(int i) const
+    {
+        C4_CHECK(size_t(i) < m_hdr->num_indices);
+        return {{this, m_heads[i].first, true}, {this, SnapshotOccurrence::npos, true}};
+    }
+
+    /** iterate through the options in order, as given through argv */
+    iterator_range<option_iterator> opts_args() const
+    {
+        return {{this, 0, false}, {this, m_hdr->num_occurrences, false}};
+    }
+
+    /** iterate through the positional arguments (ie, those without options) */
+    iterator_range<positional_arg_iterator> posn_args() const
+    {
+        return {{this, m_posn}, {this, m_posn + m_hdr->num_posn}};
+    }
+
+private:
+
+    option::Option _view(uint32_t pos) const;
+
+private:
+
+    const char *m_blob;
+    option::Descriptor const* m_usage;
+    SnapshotHeader const* m_hdr;
+    SnapshotHead const* m_heads;
+    SnapshotOccurrence const* m_occ;
+    uint32_t const* m_posn;
+
+};
+
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_SNAPSHOT_HPP_ */
@@ -0,0 +1,155 @@
+#include "c4/opt/spec.hpp"
+#include "c4/opt/help.hpp"
+#include "c4/opt/detail/fnv1a.hpp"
+#include <c4/error.hpp>
+#include <stdint.h>
+#include <string.h>
+
+namespace c4 {
+namespace opt {
+
+namespace {
+
+/** number of seeds to try for a perfect hash before doubling the table */
+constexpr const unsigned max_seed_attempts = 64;
+
+unsigned _next_pow2(unsigned v)
+{
+    unsigned p = 1;
+    while(p < v)
+        p <<= 1;
+    return p;
+}
+
+/** attempt to place every long option in the table without collisions.
+ * Repeated names are placed only once, for their first descriptor.
+ * @return true if no collisions occurred */
+bool _fill_longopts(option::Descriptor const* usage, unsigned num_usage, unsigned *slots, unsigned mask, unsigned seed)
+{
+    bool perfect = true;
+    for(unsigned i = 0; i <= mask; ++i)
+        slots[i] = num_usage;
+    for(unsigned pos = 0; pos < num_usage; ++pos)
+    {
+        const char *name = usage[pos].longopt;
+        unsigned slot = option::Index::hash(name, seed) & mask;
+        while(slots[slot] != num_usage)
+        {
+            if(strcmp(usage[slots[slot]].longopt, name) == 0)
+                break; // already there
+            perfect = false;
+            slot = (slot + 1) & mask;
+        }
+        if(slots[slot] == num_usage)
+            slots[slot] = pos;
+    }
+    return perfect;
+}
+
+} // anon
+
+
+uint64_t spec_fingerprint(option::Descriptor const* usage)
+{
+    uint64_t h = detail::fnv1a_basis;
+    for(option::Descriptor const* d = usage; d->shortopt != nullptr; ++d)
+    {
+        uint32_t nums[2] = {d->index, (uint32_t)d->type};
+        h = detail::fnv1a(h, nums, sizeof(nums));
+        h = detail::fnv1a(h, d->shortopt, strlen(d->shortopt) + 1); // include the terminator to separate the fields
+        h = detail::fnv1a(h, d->longopt, strlen(d->longopt) + 1);
+    }
+    return h;
+}
+
+
+csubstr Spec::help_text(int width) const
+{
+    for(size_t i = 0; i < num_help; ++i)
+    {
+        if(help[i].width == width)
+            return {help[i].str, help[i].len};
+    }
+    return c4::opt::help_text(index.usage, width);
+}
+
+
+RuntimeSpec::RuntimeSpec(option::Descriptor const* usage, MemoryResource *mr)
+    : m_spec(), m_tables(nullptr), m_tables_size(0), m_mr(mr)
+{
+    option::Index &ix = m_spec.index;
+    ix.usage = usage;
+    ix.num_usage = 0;
+    ix.options_max = 1; // as in option::Stats: 1 more than necessary as sentinel
+    while(usage[ix.num_usage].shortopt != 0)
+    {
+        option::Descriptor const& d = usage[ix.num_usage];
+        if(d.index + 1 >= ix.options_max)
+            ix.options_max = (d.index + 1) + 1;
+        ++ix.num_usage;
+    }
+    ix.unknown = ix.num_usage;
+    for(unsigned pos = 0; pos < ix.num_usage; ++pos)
+    {
+        if(usage[pos].shortopt[0] == 0 && usage[pos].longopt[0] == 0)
+        {
+            ix.unknown = pos;
+            break;
+        }
+    }
+    // try increasing seeds to find a perfect hash; double the table
+    // size if none is found. The table is always at most half full.
+    unsigned num_slots = _next_pow2(2 * ix.num_usage > 8 ? 2 * ix.num_usage : 8);
+    bool perfect = false;
+    while( ! perfect)
+    {
+        if(m_tables)
+            m_mr->deallocate(m_tables, m_tables_size * sizeof(unsigned), alignof(unsigned));
+        m_tables_size = 256 + num_slots;
+        m_tables = (unsigned*) m_mr->allocate(m_tables_size * sizeof(unsigned), alignof(unsigned));
+        ix.longopt_mask = num_slots - 1;
+        for(ix.seed = 0; ix.seed < max_seed_attempts; ++ix.seed)
+        {
+            perfect = _fill_longopts(usage, ix.num_usage, m_tables + 256, ix.longopt_mask, ix.seed);
+            if(perfect)
+                break;
+        }
+        if( ! perfect && num_slots >= 16 * _next_pow2(ix.num_usage + 1))
+        {
+            // give up on a perfect hash: linear probing is still correct
+            ix.seed = 0;
+            _fill_longopts(usage, ix.num_usage, m_tables + 256, ix.longopt_mask, ix.seed);
+            break;
+        }
+        num_slots *= 2;
+    }
+    unsigned *shortopt = m_tables;
+    for(unsigned c = 0; c < 256; ++c)
+        shortopt[c] = ix.num_usage;
+    for(unsigned pos = ix.num_usage; pos > 0; --pos) // reverse order, so the first wins
+    {
+        for(const char *c = usage[pos-1].shortopt; *c != 0; ++c)
+            shortopt[(unsigned char)*c] = pos-1;
+    }
+    ix.shortopt = m_tables;
+    ix.longopt = m_tables + 256;
+}
+
+RuntimeSpec::RuntimeSpec(RuntimeSpec &&that)
+    : m_spec(that.m_spec), m_tables(that.m_tables), m_tables_size(that.m_tables_size), m_mr(that.m_mr)
+{
+    that.m_tables = nullptr;
+    that.m_tables_size = 0;
+}
+
+RuntimeSpec::~RuntimeSpec()
+{
+    if(m_tables)
+    {
+        m_mr->deallocate(m_tables, m_tables_size * sizeof(unsigned), alignof(unsigned));
+        m_tables = nullptr;
+    }
+}
+
+} // namespace opt
+} // namespace c4
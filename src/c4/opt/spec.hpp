@@ -0,0 +1,269 @@
+#ifndef _C4_OPT_SPEC_HPP_
+#define _C4_OPT_SPEC_HPP_
+
+#include <c4/memory_resource.hpp>
+#include <c4/substr.hpp>
+#include <stdint.h>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wnon-virtual-dtor")
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+#include "c4/opt/detail/optionparser.h"
+C4_SUPPRESS_WARNING_GCC_POP
+
+/** @file spec.hpp compiled option specs: descriptors together with
+ * their lookup tables and pre-rendered help */
+
+namespace c4 {
+namespace opt {
+
+/** usage help text pre-rendered for a terminal width */
+struct HelpText
+{
+    int width;
+    const char *str;
+    size_t len;
+};
+
+
+/** A 64-bit fingerprint of the contents of the descriptors: their
+ * index, type, short and long options. The checkers and the help are
+ * not included. Use it to check that data produced with a usage is
+ * consumed with the same usage, eg across processes. */
+uint64_t spec_fingerprint(option::Descriptor const* usage);
+
+
+/** A compiled option spec: the descriptors, the lookup tables used by
+ * the parser to find options without scanning the descriptors, and
+ * optionally the help text already rendered for some terminal widths.
+ *
+ * This is plain data which does not own any memory, so that it can be
+ * generated at build time (see c4opt_generate_spec() in CMake) and
+ * placed in read-only memory. To compile a spec at runtime, use
+ * RuntimeSpec. */
+struct Spec
+{
+    option::Index index;
+    HelpText const* help;  ///< pre-rendered help texts; may be null
+    size_t num_help;
+
+    option::Descriptor const* usage() const { return index.usage; }
+    /** the number of descriptors, including the terminating entry */
+    size_t num_usage_entries() const { return index.num_usage + 1u; }
+
+    /** get the help text for the given width. If it was not pre-rendered
+     * for this width, it is rendered and cached; see c4::opt::help_text() */
+    csubstr help_text(int width=80) const;
+
+    uint64_t fingerprint() const { return spec_fingerprint(index.usage); }
+};
+
+
+/** Compiles a spec at runtime, building its lookup tables. The long
+ * option table is a perfect hash whenever a collision-free seed can be
+ * found, so that each lookup needs a single string comparison. */
+class RuntimeSpec
+{
+public:
+
+    RuntimeSpec(option::Descriptor const* usage, MemoryResource *mr=get_memory_resource());
+    ~RuntimeSpec();
+
+    RuntimeSpec(RuntimeSpec const&) = delete;
+    RuntimeSpec& operator= (RuntimeSpec const&) = delete;
+    RuntimeSpec(RuntimeSpec &&that);
+    RuntimeSpec& operator= (RuntimeSpec &&) = delete;
+
+    Spec const& spec() const { return m_spec; }
+    operator Spec const& () const { return m_spec; }
+
+    /** the number of slots in the long option table */
+    size_t num_longopt_slots() const { return m_spec.index.longopt_mask + 1u; }
+
+private:
+
+    Spec m_spec;
+    unsigned *m_tables;
+    size_t m_tables_size;
+    MemoryResource *m_mr;
+
+};
+
+
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+
+#if C4_CPP >= 14
+
+/** the result of validating a usage with compile() */
+typedef enum {
+    SPEC_OK = 0,
+    SPEC_MISSING_SENTINEL,     ///< the last descriptor is not zero-filled, or a descriptor before it has a null shortopt
+    SPEC_NULL_LONGOPT,         ///< a descriptor has a null longopt; use "" for none
+    SPEC_MINUS_SHORTOPT,       ///< a shortopt contains the '-' character
+    SPEC_DUPLICATE_SHORTOPT,   ///< a short option character is used by descriptors which are not aliases (same index and type)
+    SPEC_DUPLICATE_LONGOPT,    ///< a long option name is used more than once
+    SPEC_INDEX_OUT_OF_RANGE,   ///< a descriptor index is not smaller than the number of descriptors
+} SpecStatus_e;
+
+namespace detail {
+constexpr size_t spec_slots(size_t num_usage_entries, size_t slots=8)
+{
+    return slots >= 2 * num_usage_entries ? slots : spec_slots(num_usage_entries, 2 * slots);
+}
+} // namespace detail
+
+/** A spec compiled at compile time with compile(). This holds the
+ * lookup tables by value; use spec() to get a Spec referring to them.
+ * @see C4OPT_COMPILE_SPEC() */
+template<size_t N>
+struct StaticSpec
+{
+    enum : size_t { num_slots = detail::spec_slots(N) };
+
+    SpecStatus_e status;
+    unsigned bad_entry;  ///< the position of the first offending descriptor, when status != SPEC_OK
+
+    option::Descriptor const* usage;
+    unsigned options_max;
+    unsigned unknown;
+    unsigned shortopt[256];
+    unsigned longopt[num_slots];
+
+    constexpr bool ok() const { return status == SPEC_OK; }
+
+    /** the Spec referring to these tables. The StaticSpec must outlive it. */
+    constexpr Spec spec() const
+    {
+        return Spec{{usage, unsigned(N - 1), options_max, unknown, shortopt, longopt, unsigned(num_slots - 1), 0u}, nullptr, 0u};
+    }
+    constexpr operator Spec () const { return spec(); }
+};
+
+
+namespace detail {
+constexpr bool spec_streq(const char *a, const char *b)
+{
+    while(*a != 0 && *a == *b)
+    {
+        ++a;
+        ++b;
+    }
+    return *a == *b;
+}
+template<size_t N>
+constexpr StaticSpec<N> spec_error(StaticSpec<N> s, SpecStatus_e status, size_t pos)
+{
+    s.status = status;
+    s.bad_entry = unsigned(pos);
+    return s;
+}
+} // namespace detail
+
+/** Compile a usage at compile time: validate it and build the lookup
+ * tables used by the parser. Requires C++14. The usage must be
+ * constexpr for the result to be constexpr:
+ *
+ * @code
+ * constexpr const option::Descriptor usage[] = {...};
+ * constexpr auto spec = c4::opt::compile(usage);
+ * static_assert(spec.ok(), "bad usage");
+ * auto p = c4::opt::make_parser(spec, argc, argv);
+ * @endcode
+ *
+ * Unlike RuntimeSpec, this does not search for a perfect hash seed;
+ * collisions in the long option table are resolved by linear probing.
+ *
+ * @see C4OPT_COMPILE_SPEC() to get a specific static_assert() message
+ * for each kind of error */
+template<size_t N>
+constexpr StaticSpec<N> compile(option::Descriptor const (&usage)[N])
+{
+    static_assert(N > 0, "the usage must have at least the terminating entry");
+    StaticSpec<N> s{};
+    s.status = SPEC_OK;
+    s.usage = usage;
+    s.options_max = 1; // as in option::Stats: 1 more than necessary as sentinel
+    s.unknown = unsigned(N - 1);
+    // validate
+    option::Descriptor const& last = usage[N - 1];
+    if(last.index != 0 || last.type != 0 || last.shortopt != nullptr || last.longopt != nullptr || last.check_arg != nullptr || last.help != nullptr)
+        return detail::spec_error(s, SPEC_MISSING_SENTINEL, N - 1);
+    for(size_t i = 0; i + 1 < N; ++i)
+    {
+        option::Descriptor const& d = usage[i];
+        if(d.shortopt == nullptr)
+            return detail::spec_error(s, SPEC_MISSING_SENTINEL, i);
+        if(d.longopt == nullptr)
+            return detail::spec_error(s, SPEC_NULL_LONGOPT, i);
+        if(d.index + 1 >= N)
+            return detail::spec_error(s, SPEC_INDEX_OUT_OF_RANGE, i);
+        if(d.index + 1 >= s.options_max)
+            s.options_max = (d.index + 1) + 1;
+        if(d.shortopt[0] == 0 && d.longopt[0] == 0 && s.unknown == N - 1)
+            s.unknown = unsigned(i);
+        for(const char *c = d.shortopt; *c != 0; ++c)
+        {
+            if(*c == '-')
+                return detail::spec_error(s, SPEC_MINUS_SHORTOPT, i);
+            for(size_t j = 0; j < i; ++j)
+            {
+                for(const char *o = usage[j].shortopt; *o != 0; ++o)
+                    if(*o == *c && (usage[j].index != d.index || usage[j].type != d.type))
+                        return detail::spec_error(s, SPEC_DUPLICATE_SHORTOPT, i);
+            }
+        }
+        if(d.longopt[0] != 0)
+        {
+            for(size_t j = 0; j < i; ++j)
+                if(detail::spec_streq(usage[j].longopt, d.longopt))
+                    return detail::spec_error(s, SPEC_DUPLICATE_LONGOPT, i);
+        }
+    }
+    // build the tables
+    for(unsigned c = 0; c < 256; ++c)
+        s.shortopt[c] = unsigned(N - 1);
+    for(size_t i = N - 1; i > 0; --i) // reverse order, so the first wins
+        for(const char *c = usage[i-1].shortopt; *c != 0; ++c)
+            s.shortopt[(unsigned char)*c] = unsigned(i - 1);
+    for(size_t slot = 0; slot < StaticSpec<N>::num_slots; ++slot)
+        s.longopt[slot] = unsigned(N - 1);
+    for(size_t i = 0; i + 1 < N; ++i)
+    {
+        size_t slot = option::Index::hash(usage[i].longopt, 0u) & (StaticSpec<N>::num_slots - 1);
+        while(s.longopt[slot] != N - 1)
+        {
+            if(detail::spec_streq(usage[s.longopt[slot]].longopt, usage[i].longopt))
+                break; // only the dummy descriptors can repeat a name
+            slot = (slot + 1) & (StaticSpec<N>::num_slots - 1);
+        }
+        if(s.longopt[slot] == N - 1)
+            s.longopt[slot] = unsigned(i);
+    }
+    return s;
+}
+
+/** declare a constexpr spec compiled from a constexpr usage, with a
+ * specific static_assert() message for each kind of error. */
+#define C4OPT_COMPILE_SPEC(name, usage)                                 \
+    constexpr const auto name = ::c4::opt::compile(usage);              \
+    static_assert(name.status != ::c4::opt::SPEC_MISSING_SENTINEL,      \
+                  "c4opt: " #usage " must end with a zero-filled Descriptor, and only there"); \
+    static_assert(name.status != ::c4::opt::SPEC_NULL_LONGOPT,          \
+                  "c4opt: " #usage " has a null longopt; use \"\" instead"); \
+    static_assert(name.status != ::c4::opt::SPEC_MINUS_SHORTOPT,        \
+                  "c4opt: " #usage " has a shortopt with '-'");         \
+    static_assert(name.status != ::c4::opt::SPEC_DUPLICATE_SHORTOPT,    \
+                  "c4opt: " #usage " has a short option used by descriptors which are not aliases"); \
+    static_assert(name.status != ::c4::opt::SPEC_DUPLICATE_LONGOPT,     \
+                  "c4opt: " #usage " has a repeated long option");      \
+    static_assert(name.status != ::c4::opt::SPEC_INDEX_OUT_OF_RANGE,    \
+                  "c4opt: " #usage " has a descriptor index which is out of range")
+
+#endif // C4_CPP >= 14
+
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_SPEC_HPP_ */
@@ -0,0 +1,314 @@
+#include "c4/opt/spec_cache.hpp"
+#include "c4/opt/help.hpp"
+#include "c4/opt/detail/fnv1a.hpp"
+#include <c4/error.hpp>
+#include <stdio.h>
+#include <string.h>
+#include <new>
+
+#ifdef C4_WIN
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace c4 {
+namespace opt {
+
+namespace {
+
+constexpr const char spec_cache_magic[8] = {'c', '4', 'o', 'p', 't', 's', 'p', 'c'};
+
+C4_ALWAYS_INLINE size_t _align8(size_t sz)
+{
+    return (sz + 7u) & ~size_t(7u);
+}
+
+/** validate the tables of a cache against the descriptors, so that a
+ * corrupted cache cannot make the parser loop or misbehave: every
+ * entry must be a valid position, the long option table must have an
+ * empty slot, and every option of the descriptors must be found */
+bool _valid_tables(option::Index const& ix)
+{
+    option::Descriptor const* usage = ix.usage;
+    const unsigned n = ix.num_usage;
+    for(unsigned c = 0; c < 256; ++c)
+    {
+        unsigned e = ix.shortopt[c];
+        if(e > n || (e < n && strchr(usage[e].shortopt, (int)c) == nullptr) || (e < n && c == 0))
+            return false;
+    }
+    bool has_empty = false;
+    for(unsigned s = 0; s <= ix.longopt_mask; ++s)
+    {
+        if(ix.longopt[s] > n)
+            return false;
+        has_empty |= (ix.longopt[s] == n);
+    }
+    if( ! has_empty)
+        return false;
+    for(unsigned pos = 0; pos < n; ++pos)
+    {
+        for(const char *c = usage[pos].shortopt; *c != 0; ++c)
+            if(ix.shortopt[(unsigned char)*c] > pos) // the first descriptor must win
+                return false;
+        unsigned found = ix.findLong(usage[pos].longopt);
+        if(found == n || strcmp(usage[found].longopt, usage[pos].longopt) != 0)
+            return false;
+    }
+    return true;
+}
+
+} // anon
+
+
+uint64_t spec_cache_key(option::Descriptor const* usage)
+{
+    uint64_t h = spec_fingerprint(usage);
+    for(option::Descriptor const* d = usage; d->shortopt != nullptr; ++d)
+    {
+        if(d->help)
+            h = detail::fnv1a(h, d->help, strlen(d->help) + 1);
+        else
+            h = detail::fnv1a(h, "\xff", 1); // distinguish null from empty
+    }
+    return h;
+}
+
+size_t write_spec_cache(substr buf, Spec const& spec)
+{
+    option::Index const& ix = spec.index;
+    C4_CHECK(ix.usage != nullptr);
+    const size_t shortopt = sizeof(SpecCacheHeader);
+    const size_t longopt = shortopt + 256u * sizeof(uint32_t);
+    const size_t help = _align8(longopt + (ix.longopt_mask + 1u) * sizeof(uint32_t));
+    size_t strings = help + spec.num_help * 3u * sizeof(uint32_t);
+    size_t size = strings;
+    for(size_t i = 0; i < spec.num_help; ++i)
+        size += spec.help[i].len + 1u;
+    size = _align8(size);
+    C4_CHECK_MSG(size <= UINT32_MAX, "spec too large: %zu bytes", size);
+    if(buf.len < size)
+        return size;
+    memset(buf.str, 0, size);
+    SpecCacheHeader *hdr = (SpecCacheHeader*) buf.str;
+    memcpy(hdr->magic, spec_cache_magic, sizeof(hdr->magic));
+    hdr->version = SpecCacheHeader::current_version;
+    hdr->size = (uint32_t)size;
+    hdr->key = spec_cache_key(ix.usage);
+    hdr->num_usage = ix.num_usage;
+    hdr->options_max = ix.options_max;
+    hdr->unknown = ix.unknown;
+    hdr->longopt_mask = ix.longopt_mask;
+    hdr->seed = ix.seed;
+    hdr->num_help = (uint32_t)spec.num_help;
+    hdr->shortopt = (uint32_t)shortopt;
+    hdr->longopt = (uint32_t)longopt;
+    hdr->help = (uint32_t)help;
+    uint32_t *tab = (uint32_t*) (buf.str + shortopt);
+    for(unsigned c = 0; c < 256; ++c)
+        tab[c] = ix.shortopt[c];
+    tab = (uint32_t*) (buf.str + longopt);
+    for(unsigned s = 0; s <= ix.longopt_mask; ++s)
+        tab[s] = ix.longopt[s];
+    uint32_t *entries = (uint32_t*) (buf.str + help);
+    for(size_t i = 0; i < spec.num_help; ++i)
+    {
+        HelpText const& h = spec.help[i];
+        entries[3 * i + 0] = (uint32_t)h.width;
+        entries[3 * i + 1] = (uint32_t)strings;
+        entries[3 * i + 2] = (uint32_t)h.len;
+        memcpy(buf.str + strings, h.str, h.len);
+        strings += h.len + 1u;
+    }
+    return size;
+}
+
+
+//-----------------------------------------------------------------------------
+
+SpecCache::SpecCache(const char *path, option::Descriptor const* usage, std::initializer_list<int> widths, MemoryResource *mr)
+    : m_spec(), m_map(nullptr), m_map_size(0), m_built(nullptr), m_help(nullptr), m_num_help(0), m_written(false), m_mr(mr)
+{
+    if( ! _load(path, usage, widths))
+        _build(path, usage, widths);
+}
+
+SpecCache::~SpecCache()
+{
+    _unmap();
+    if(m_built)
+    {
+        m_built->~RuntimeSpec();
+        m_mr->deallocate(m_built, sizeof(RuntimeSpec), alignof(RuntimeSpec));
+        m_built = nullptr;
+    }
+    if(m_help)
+    {
+        m_mr->deallocate(m_help, m_num_help * sizeof(HelpText), alignof(HelpText));
+        m_help = nullptr;
+    }
+}
+
+void SpecCache::_unmap()
+{
+    if( ! m_map)
+        return;
+    #ifdef C4_WIN
+    m_mr->deallocate(m_map, m_map_size, alignof(uint64_t));
+    #else
+    munmap(m_map, m_map_size);
+    #endif
+    m_map = nullptr;
+    m_map_size = 0;
+}
+
+bool SpecCache::_load(const char *path, option::Descriptor const* usage, std::initializer_list<int> widths)
+{
+    // map the file
+    #ifdef C4_WIN
+    FILE *f = fopen(path, "rb");
+    if( ! f)
+        return false;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if(len < (long)sizeof(SpecCacheHeader))
+    {
+        fclose(f);
+        return false;
+    }
+    m_map_size = (size_t)len;
+    m_map = m_mr->allocate(m_map_size, alignof(uint64_t));
+    bool ok = fread(m_map, 1, m_map_size, f) == m_map_size;
+    fclose(f);
+    if( ! ok)
+    {
+        _unmap();
+        return false;
+    }
+    #else
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SpecCacheHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *map = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(map == MAP_FAILED)
+        return false;
+    m_map = map;
+    m_map_size = (size_t)st.st_size;
+    #endif
+    // validate it
+    const char *b = (const char*) m_map;
+    SpecCacheHeader const* hdr = (SpecCacheHeader const*) b;
+    const uint64_t sz = m_map_size;
+    unsigned num_usage = 0, options_max = 1; // as in option::Stats: 1 more than necessary as sentinel
+    for(; usage[num_usage].shortopt != nullptr; ++num_usage)
+        if(usage[num_usage].index + 1 >= options_max)
+            options_max = (usage[num_usage].index + 1) + 1;
+    bool ok = memcmp(hdr->magic, spec_cache_magic, sizeof(hdr->magic)) == 0
+        && hdr->version == SpecCacheHeader::current_version
+        && hdr->size == sz
+        && hdr->num_usage == num_usage
+        && hdr->options_max == options_max
+        && hdr->unknown <= num_usage
+        && (hdr->longopt_mask & (hdr->longopt_mask + 1u)) == 0 // a power of 2, minus 1
+        && (hdr->shortopt & 3u) == 0 && hdr->shortopt + 256u * uint64_t(sizeof(uint32_t)) <= sz
+        && (hdr->longopt & 3u) == 0 && hdr->longopt + (uint64_t(hdr->longopt_mask) + 1u) * sizeof(uint32_t) <= sz
+        && (hdr->help & 3u) == 0 && hdr->help + uint64_t(hdr->num_help) * 3u * sizeof(uint32_t) <= sz
+        && hdr->key == spec_cache_key(usage);
+    uint32_t const* entries = (uint32_t const*) (b + hdr->help);
+    for(uint32_t i = 0; ok && i < hdr->num_help; ++i)
+        ok = uint64_t(entries[3 * i + 1]) + entries[3 * i + 2] < sz && b[entries[3 * i + 1] + entries[3 * i + 2]] == 0;
+    // the help must have been rendered for the requested widths
+    ok = ok && hdr->num_help == widths.size();
+    for(uint32_t i = 0; ok && i < hdr->num_help; ++i)
+        ok = (int)entries[3 * i] == widths.begin()[i];
+    if(ok)
+    {
+        option::Index &ix = m_spec.index;
+        ix.usage = usage;
+        ix.num_usage = hdr->num_usage;
+        ix.options_max = hdr->options_max;
+        ix.unknown = hdr->unknown;
+        ix.shortopt = (unsigned const*) (b + hdr->shortopt);
+        ix.longopt = (unsigned const*) (b + hdr->longopt);
+        ix.longopt_mask = hdr->longopt_mask;
+        ix.seed = hdr->seed;
+        ok = _valid_tables(ix);
+    }
+    if( ! ok)
+    {
+        m_spec = Spec{};
+        _unmap();
+        return false;
+    }
+    m_num_help = hdr->num_help;
+    if(m_num_help)
+    {
+        m_help = (HelpText*) m_mr->allocate(m_num_help * sizeof(HelpText), alignof(HelpText));
+        for(size_t i = 0; i < m_num_help; ++i)
+            m_help[i] = {(int)entries[3 * i], b + entries[3 * i + 1], entries[3 * i + 2]};
+    }
+    m_spec.help = m_help;
+    m_spec.num_help = m_num_help;
+    return true;
+}
+
+void SpecCache::_build(const char *path, option::Descriptor const* usage, std::initializer_list<int> widths)
+{
+    m_built = new (m_mr->allocate(sizeof(RuntimeSpec), alignof(RuntimeSpec))) RuntimeSpec(usage, m_mr);
+    m_spec = m_built->spec();
+    m_num_help = widths.size();
+    if(m_num_help)
+    {
+        m_help = (HelpText*) m_mr->allocate(m_num_help * sizeof(HelpText), alignof(HelpText));
+        size_t i = 0;
+        for(int w : widths)
+        {
+            csubstr h = help_text(usage, w); // cached for the lifetime of the program
+            m_help[i++] = {w, h.str, h.len};
+        }
+    }
+    m_spec.help = m_help;
+    m_spec.num_help = m_num_help;
+    // write the cache to a temporary file, then move it into place so
+    // that readers never see a partially written file
+    size_t size = write_spec_cache({}, m_spec);
+    char *buf = (char*) m_mr->allocate(size, alignof(uint64_t));
+    write_spec_cache({buf, size}, m_spec);
+    size_t pathlen = strlen(path);
+    char *tmp = (char*) m_mr->allocate(pathlen + 32, 1);
+    #ifdef C4_WIN
+    snprintf(tmp, pathlen + 32, "%s.tmp%d", path, _getpid());
+    #else
+    snprintf(tmp, pathlen + 32, "%s.tmp%d", path, (int)getpid());
+    #endif
+    FILE *f = fopen(tmp, "wb");
+    if(f)
+    {
+        bool ok = fwrite(buf, 1, size, f) == size;
+        ok &= (fclose(f) == 0);
+        #ifdef C4_WIN
+        if(ok)
+            remove(path); // rename() does not replace existing files
+        #endif
+        m_written = ok && rename(tmp, path) == 0;
+        if( ! m_written)
+            remove(tmp);
+    }
+    m_mr->deallocate(tmp, pathlen + 32, 1);
+    m_mr->deallocate(buf, size, alignof(uint64_t));
+}
+
+} // namespace opt
+} // namespace c4
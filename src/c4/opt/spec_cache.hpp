@@ -0,0 +1,107 @@
+#ifndef _C4_OPT_SPEC_CACHE_HPP_
+#define _C4_OPT_SPEC_CACHE_HPP_
+
+#include "c4/opt/spec.hpp"
+#include <initializer_list>
+
+/** @file spec_cache.hpp compiled specs cached in a file, to skip
+ * building the lookup tables and rendering the help at startup */
+
+namespace c4 {
+namespace opt {
+
+/** The header of a spec cache file. The file is a single block without
+ * pointers: everything in it is referred to by its offset from the
+ * start of the block, so that it can be mapped and used in place. The
+ * block is in the native byte order. */
+struct SpecCacheHeader
+{
+    enum : uint32_t { current_version = 1 };
+
+    char     magic[8];      ///< "c4optspc"
+    uint32_t version;       ///< current_version
+    uint32_t size;          ///< the size of the whole block, in bytes
+    uint64_t key;           ///< spec_cache_key() of the descriptors
+    uint32_t num_usage;     ///< option::Index::num_usage
+    uint32_t options_max;   ///< option::Index::options_max
+    uint32_t unknown;       ///< option::Index::unknown
+    uint32_t longopt_mask;  ///< option::Index::longopt_mask
+    uint32_t seed;          ///< option::Index::seed
+    uint32_t num_help;      ///< the number of pre-rendered help texts
+    uint32_t shortopt;      ///< offset of the short option table (256 uint32_t)
+    uint32_t longopt;       ///< offset of the long option table (longopt_mask+1 uint32_t)
+    uint32_t help;          ///< offset of the help entries: (width, offset, length) as uint32_t each
+    uint32_t reserved;
+};
+
+/** the key of a spec cache: a 64-bit hash of everything in the
+ * descriptors which goes into the cache, ie spec_fingerprint() plus the
+ * help strings */
+uint64_t spec_cache_key(option::Descriptor const* usage);
+
+/** serialize a spec into buf. It is written only if buf is large
+ * enough; call first with an empty buf to get the size.
+ * @return the size of the serialized spec */
+size_t write_spec_cache(substr buf, Spec const& spec);
+
+
+/** A spec loaded from a cache file, or compiled and written to the
+ * cache file when the file is missing, invalid, or was produced from
+ * different descriptors or for different help widths. The file is
+ * mapped into memory and its tables are used in place, so loading it
+ * costs validating it and hashing the descriptors.
+ *
+ * @code
+ * c4::opt::SpecCache cache("/var/cache/app/options.c4opt", usage, {80, 120});
+ * auto p = c4::opt::make_parser(cache.spec(), argc, argv);
+ * @endcode
+ *
+ * The file is replaced atomically when it is written, so that several
+ * processes can share it. Failing to write it is not an error: the
+ * spec is still usable. */
+class SpecCache
+{
+public:
+
+    /** @param path the cache file
+     * @param usage the descriptors
+     * @param widths the terminal widths for which to pre-render the help */
+    SpecCache(const char *path, option::Descriptor const* usage, std::initializer_list<int> widths={80}, MemoryResource *mr=get_memory_resource());
+    ~SpecCache();
+
+    SpecCache(SpecCache const&) = delete;
+    SpecCache& operator= (SpecCache const&) = delete;
+    SpecCache(SpecCache &&) = delete;
+    SpecCache& operator= (SpecCache &&) = delete;
+
+    Spec const& spec() const { return m_spec; }
+    operator Spec const& () const { return m_spec; }
+
+    /** whether the spec was loaded from the cache file */
+    bool loaded() const { return m_map != nullptr; }
+    /** whether the cache file was (re)written */
+    bool written() const { return m_written; }
+
+private:
+
+    bool _load(const char *path, option::Descriptor const* usage, std::initializer_list<int> widths);
+    void _build(const char *path, option::Descriptor const* usage, std::initializer_list<int> widths);
+    void _unmap();
+
+private:
+
+    Spec m_spec;
+    void *m_map;          ///< the mapped cache file
+    size_t m_map_size;
+    RuntimeSpec *m_built; ///< the spec compiled when the cache was not usable
+    HelpText *m_help;
+    size_t m_num_help;
+    bool m_written;
+    MemoryResource *m_mr;
+
+};
+
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_SPEC_CACHE_HPP_ */
@@ -0,0 +1,342 @@
+#include "c4/opt/suggest.hpp"
+#include "c4/opt/detail/fnv1a.hpp"
+#include <c4/memory_resource.hpp>
+#include <chrono>
+#include <mutex>
+#include <new>
+#include <string.h>
+
+
+namespace c4 {
+namespace opt {
+
+namespace {
+
+/** the edit distance from the pattern whose character masks are peq
+ * (of length m, 1 <= m <= 64) to text, with the bit-parallel algorithm
+ * of Myers as formulated by Hyyrö. Pv/Mv are the vertical +1/-1 deltas
+ * of the current column of the dynamic programming matrix, and score
+ * is its last row.
+ * @return the distance, or bound+1 if it is larger than bound */
+uint32_t _edit_distance(uint64_t const* peq, size_t m, const char *text, size_t n, uint32_t bound)
+{
+    const uint64_t last = uint64_t(1) << (m - 1);
+    uint64_t pv = ~uint64_t(0), mv = 0;
+    size_t score = m;
+    for(size_t j = 0; j < n; ++j)
+    {
+        const uint64_t eq = peq[(uint8_t)text[j]];
+        const uint64_t xv = eq | mv;
+        const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if(ph & last)
+            ++score;
+        else if(mh & last)
+            --score;
+        // the first row is the distance from the empty pattern, so it
+        // always grows by one
+        ph = (ph << 1) | 1u;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+        // each of the remaining characters lowers the score by one at most
+        if(score > bound + (n - 1 - j))
+            return bound + 1;
+    }
+    return (uint32_t)score;
+}
+
+/** insert into the suggestions sorted by distance and position, if it
+ * is better than the worst when they are full */
+void _insert(Suggestion *out, size_t cap, size_t *num, Suggestion s)
+{
+    size_t i = *num;
+    if(i == cap)
+    {
+        Suggestion const& worst = out[cap - 1];
+        if(s.distance > worst.distance || (s.distance == worst.distance && s.desc > worst.desc))
+            return;
+        --i;
+    }
+    else
+    {
+        ++*num;
+    }
+    for( ; i > 0 && (out[i-1].distance > s.distance || (out[i-1].distance == s.distance && out[i-1].desc > s.desc)); --i)
+        out[i] = out[i-1];
+    out[i] = s;
+}
+
+/** call fn(str, len) for each long option of the usage, with its
+ * terminator, in order: the index depends only on these */
+template<class Fn>
+void _for_each_name(option::Descriptor const* usage, Fn &&fn)
+{
+    for(option::Descriptor const* d = usage; d->shortopt != nullptr; ++d)
+    {
+        if(d->longopt)
+            fn(d->longopt, strlen(d->longopt) + 1);
+        else
+            fn("\xff", 1); // distinguish null from empty
+    }
+}
+
+/** an index and the long options it was built from. These are stored
+ * right after the entry, so that each entry needs only one allocation
+ * besides the index. */
+struct SuggestEntry
+{
+    SuggestEntry *next;
+    uint64_t key;      ///< the hash of the long options
+    size_t names_len;  ///< the length of the long options, with their terminators
+    SuggestIndex index;
+    SuggestEntry(SuggestEntry *next_, uint64_t key_, size_t names_len_, option::Descriptor const* usage, MemoryResource *mr)
+        : next(next_), key(key_), names_len(names_len_), index(usage, mr)
+    {
+        char *out = names();
+        _for_each_name(usage, [&](const char *str, size_t len){ memcpy(out, str, len); out += len; });
+    }
+    char *names() { return reinterpret_cast<char*>(this + 1); }
+    /** whether the long options of usage are those of the index; the
+     * hash is not enough, as a collision would make the index read
+     * past the usage */
+    bool matches(option::Descriptor const* usage, uint64_t key_, size_t names_len_)
+    {
+        if(key != key_ || names_len != names_len_)
+            return false;
+        const char *in = names();
+        bool same = true;
+        _for_each_name(usage, [&](const char *str, size_t len){ same = same && memcmp(in, str, len) == 0; in += len; });
+        return same;
+    }
+};
+
+struct SuggestCache
+{
+    std::mutex mtx;
+    SuggestEntry *head = nullptr;
+    MemoryResource *mr;
+
+    // as in the help cache, the entries come from the malloc resource,
+    // which is constructed before the cache and so outlives it
+    SuggestCache() : mr(c4::get_memory_resource_malloc()) {}
+    ~SuggestCache() { clear(); }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        while(head)
+        {
+            SuggestEntry *e = head;
+            head = e->next;
+            const size_t size = sizeof(SuggestEntry) + e->names_len;
+            e->~SuggestEntry();
+            mr->deallocate(e, size, alignof(SuggestEntry));
+        }
+    }
+
+    SuggestIndex const& get(option::Descriptor const* usage)
+    {
+        uint64_t key = detail::fnv1a_basis;
+        size_t names_len = 0;
+        _for_each_name(usage, [&](const char *str, size_t len){ key = detail::fnv1a(key, str, len); names_len += len; });
+        std::lock_guard<std::mutex> lock(mtx);
+        for(SuggestEntry *e = head; e; e = e->next)
+        {
+            if(e->matches(usage, key, names_len))
+                return e->index;
+        }
+        void *mem = mr->allocate(sizeof(SuggestEntry) + names_len, alignof(SuggestEntry));
+        head = new (mem) SuggestEntry(head, key, names_len, usage, mr);
+        return head->index;
+    }
+};
+
+SuggestCache& _suggest_cache()
+{
+    static SuggestCache cache;
+    return cache;
+}
+
+/** appends to a buffer snprintf-style, counting the length needed */
+struct MsgWriter
+{
+    substr buf;
+    size_t len;
+    void write(csubstr s)
+    {
+        if(len < buf.len)
+        {
+            size_t n = s.len < buf.len - len ? s.len : buf.len - len;
+            memcpy(buf.str + len, s.str, n);
+        }
+        len += s.len;
+    }
+    size_t finish()
+    {
+        if(buf.len)
+            buf.str[len < buf.len ? len : buf.len - 1] = '\0';
+        return len;
+    }
+};
+
+} // anon
+
+
+//-----------------------------------------------------------------------------
+
+SuggestIndex::SuggestIndex(option::Descriptor const* usage, MemoryResource *mr)
+    : m_usage(usage), m_names(nullptr), m_by_len(nullptr), m_num_names(0), m_max_len(0), m_mr(mr)
+{
+    size_t num_usage = 0;
+    for( ; usage[num_usage].shortopt != nullptr; ++num_usage)
+    {
+        const char *lo = usage[num_usage].longopt;
+        if(lo == nullptr || lo[0] == 0)
+            continue;
+        size_t len = strlen(lo);
+        m_max_len = len > m_max_len ? len : m_max_len;
+        ++m_num_names;
+    }
+    if( ! m_num_names)
+        return;
+    // a counting sort by length, which keeps the order of the usage
+    // within each length
+    m_names = (uint32_t*) m_mr->allocate((m_num_names + m_max_len + 2) * sizeof(uint32_t), alignof(uint32_t));
+    m_by_len = m_names + m_num_names;
+    memset(m_by_len, 0, (m_max_len + 2) * sizeof(uint32_t));
+    for(size_t d = 0; d < num_usage; ++d)
+        if(usage[d].longopt != nullptr && usage[d].longopt[0] != 0)
+            ++m_by_len[strlen(usage[d].longopt) + 1];
+    for(size_t len = 1; len <= m_max_len + 1; ++len)
+        m_by_len[len] += m_by_len[len - 1];
+    for(size_t d = 0; d < num_usage; ++d)
+        if(usage[d].longopt != nullptr && usage[d].longopt[0] != 0)
+            m_names[m_by_len[strlen(usage[d].longopt)]++] = (uint32_t)d;
+    // the loop above moved each start to the next length
+    for(size_t len = m_max_len + 1; len > 0; --len)
+        m_by_len[len] = m_by_len[len - 1];
+    m_by_len[0] = 0;
+}
+
+SuggestIndex::SuggestIndex(SuggestIndex &&that)
+    : m_usage(that.m_usage), m_names(that.m_names), m_by_len(that.m_by_len), m_num_names(that.m_num_names), m_max_len(that.m_max_len), m_mr(that.m_mr)
+{
+    that.m_names = nullptr;
+    that.m_by_len = nullptr;
+    that.m_num_names = 0;
+}
+
+SuggestIndex::~SuggestIndex()
+{
+    if(m_names)
+    {
+        m_mr->deallocate(m_names, (m_num_names + m_max_len + 2) * sizeof(uint32_t), alignof(uint32_t));
+        m_names = nullptr;
+    }
+}
+
+size_t SuggestIndex::suggest(option::Descriptor const* usage, csubstr name, span<Suggestion> out, SuggestLimits const& limits) const
+{
+    const size_t m = name.len;
+    if(m == 0 || m > 64 || out.size() == 0 || m_num_names == 0)
+        return 0;
+    uint64_t peq[256] = {};
+    for(size_t i = 0; i < m; ++i)
+        peq[(uint8_t)name.str[i]] |= uint64_t(1) << i;
+    uint32_t bound = limits.max_distance ? limits.max_distance : (uint32_t)((m + 2) / 3);
+    const auto start = std::chrono::steady_clock::now();
+    size_t num = 0, visited = 0;
+    // from the closest length outwards; the bound shrinks when there
+    // are enough suggestions, and with it the lengths to visit
+    for(size_t dlen = 0; dlen <= bound; ++dlen)
+    {
+        for(int side = 0; side < (dlen ? 2 : 1); ++side)
+        {
+            if(side == 0 && dlen > m)
+                continue;
+            const size_t len = side == 0 ? m - dlen : m + dlen;
+            if(len == 0 || len > m_max_len)
+                continue;
+            for(uint32_t i = m_by_len[len]; i < m_by_len[len + 1] && dlen <= bound; ++i)
+            {
+                if((++visited & 31u) == 0)
+                {
+                    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                    if((uint64_t)ns > limits.max_ns)
+                        return num;
+                }
+                const uint32_t d = m_names[i];
+                const uint32_t dist = _edit_distance(peq, m, usage[d].longopt, len, bound);
+                if(dist > bound)
+                    continue;
+                _insert(out.data(), out.size(), &num, Suggestion{(int32_t)d, dist});
+                if(num == out.size())
+                    bound = out[num - 1].distance;
+            }
+        }
+    }
+    return num;
+}
+
+
+//-----------------------------------------------------------------------------
+
+size_t suggest(option::Descriptor const* usage, csubstr name, span<Suggestion> out, SuggestLimits const& limits)
+{
+    // the cached index may have been built from another usage with the
+    // same long options, which need not be alive anymore
+    return _suggest_cache().get(usage).suggest(usage, name, out, limits);
+}
+
+void clear_suggest_cache()
+{
+    _suggest_cache().clear();
+}
+
+size_t format_suggestions(substr buf, ParseError const& err, option::Descriptor const *usage, int argc, const char **argv)
+{
+    if(err.argi >= 0 && err.argi < argc && argv[err.argi] != nullptr)
+        return detail::format_suggestions(buf, err, usage, to_csubstr(argv[err.argi]));
+    return detail::format_suggestions(buf, err, usage, csubstr{});
+}
+
+namespace detail {
+size_t format_suggestions(substr buf, ParseError const& err, option::Descriptor const *usage, csubstr tok)
+{
+    MsgWriter w = {buf, 0};
+    // only long options: a mistyped short option is a single character
+    if(err.code != PARSE_UNKNOWN_OPTION || err.offset != 0 || tok.len < 3 || tok.str[0] != '-' || tok.str[1] != '-')
+        return w.finish();
+    csubstr name = tok.sub(2);
+    for(size_t i = 0; i < name.len; ++i)
+    {
+        if(name.str[i] == '=')
+        {
+            name = name.first(i);
+            break;
+        }
+    }
+    Suggestion sugg[3];
+    size_t num = suggest(usage, name, sugg);
+    for(size_t i = 0; i < num; ++i)
+    {
+        w.write(i == 0 ? csubstr("Did you mean '--") : (i + 1 < num ? csubstr("', '--") : csubstr("' or '--")));
+        w.write(to_csubstr(usage[sugg[i].desc].longopt));
+    }
+    if(num)
+        w.write("'?");
+    return w.finish();
+}
+
+void print_suggestions(ParseError const& err, option::Descriptor const *usage, csubstr tok)
+{
+    char buf[256];
+    if(format_suggestions(substr(buf, sizeof(buf)), err, usage, tok))
+        fprintf(stderr, "%s\n", buf);
+}
+} // namespace detail
+
+} // namespace opt
+} // namespace c4
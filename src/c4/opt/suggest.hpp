@@ -0,0 +1,116 @@
+#ifndef _C4_OPT_SUGGEST_HPP_
+#define _C4_OPT_SUGGEST_HPP_
+
+#include "c4/opt/opt.hpp"
+#include <c4/span.hpp>
+#include <stdio.h>
+
+/** @file suggest.hpp "did you mean" suggestions for unknown long
+ * options. Nothing here is used by a successful parse: the index is
+ * built and searched only when there is an unknown option to report. */
+
+namespace c4 {
+namespace opt {
+
+/** a long option close to the name of an unknown option */
+struct Suggestion
+{
+    int32_t  desc;      ///< the position of the descriptor in the usage array
+    uint32_t distance;  ///< the edit distance from the unknown name to the long option
+};
+
+/** bounds on the search for suggestions */
+struct SuggestLimits
+{
+    /** the largest edit distance suggested. 0 means a third of the
+     * length of the unknown name, rounded up. */
+    uint32_t max_distance = 0;
+    /** the time budget of the search, in nanoseconds. The long options
+     * are visited from the closest to the farthest in length, and those
+     * not visited when the budget runs out are not suggested. */
+    uint64_t max_ns = 1000000;
+};
+
+
+/** The long options of a usage, ordered by length, to find those
+ * closest to an unknown name. The edit distance (Levenshtein) to each
+ * candidate is computed with the bit-parallel algorithm of Myers, in
+ * the formulation of Hyyrö: one pass over the candidate with a few
+ * word operations per character, for names of up to 64 characters.
+ * Only the candidates whose length is within the bound of the distance
+ * are looked at, the bound shrinks to the worst of the suggestions kept
+ * once there are enough of them, and each comparison stops as soon as
+ * it cannot get under the bound. */
+class SuggestIndex
+{
+public:
+
+    SuggestIndex(option::Descriptor const* usage, MemoryResource *mr=get_memory_resource());
+    ~SuggestIndex();
+
+    SuggestIndex(SuggestIndex const&) = delete;
+    SuggestIndex& operator= (SuggestIndex const&) = delete;
+    SuggestIndex(SuggestIndex &&that);
+    SuggestIndex& operator= (SuggestIndex &&) = delete;
+
+public:
+
+    /** the long options closest to name (without its dashes), best
+     * first: by distance, then by position in the usage. At most
+     * out.size() are given.
+     * @return the number of suggestions written to out */
+    size_t suggest(csubstr name, span<Suggestion> out, SuggestLimits const& limits={}) const
+    {
+        return suggest(m_usage, name, out, limits);
+    }
+    /** suggest() with the long options of usage, which must have the
+     * same long options as the usage of the index, at the same
+     * positions (eg a copy of it) */
+    size_t suggest(option::Descriptor const* usage, csubstr name, span<Suggestion> out, SuggestLimits const& limits={}) const;
+
+    option::Descriptor const* usage() const { return m_usage; }
+    /** the number of descriptors with a long option */
+    size_t num_names() const { return m_num_names; }
+
+private:
+
+    option::Descriptor const* m_usage;
+    uint32_t *m_names;   ///< the positions of the descriptors with a long option, by length of the long option
+    uint32_t *m_by_len;  ///< the first entry of m_names with each length, for lengths in [0, m_max_len+1]
+    size_t m_num_names;
+    size_t m_max_len;
+    MemoryResource *m_mr;
+
+};
+
+
+/** the suggestions for name, from an index of the usage which is built
+ * on the first call and kept until clear_suggest_cache() or the exit.
+ * The index is found by the contents of the long options, so usages
+ * with the same long options share it, and a usage rebuilt at the
+ * same address does not get a stale one. This function is
+ * thread-safe. */
+size_t suggest(option::Descriptor const* usage, csubstr name, span<Suggestion> out, SuggestLimits const& limits={});
+
+/** release the indices kept by suggest() */
+void clear_suggest_cache();
+
+/** if err is an unknown long option, write into buf the long options
+ * suggested for it, eg "Did you mean '--verbose'?", snprintf-style.
+ * Nothing is written for other errors, or if there is no suggestion.
+ * @return the length the message needs, without the terminator */
+size_t format_suggestions(substr buf, ParseError const& err, option::Descriptor const *usage, int argc, const char **argv);
+
+namespace detail {
+/** format_suggestions() for the given token of the offending option,
+ * which need not be null-terminated */
+size_t format_suggestions(substr buf, ParseError const& err, option::Descriptor const *usage, csubstr tok);
+/** print the suggestions for an error to stderr, if there are any. The
+ * parsers call this when they print their errors. */
+void print_suggestions(ParseError const& err, option::Descriptor const *usage, csubstr tok);
+} // namespace detail
+
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_SUGGEST_HPP_ */
@@ -0,0 +1,130 @@
+#include "c4/opt/tokenizer.hpp"
+
+namespace c4 {
+namespace opt {
+
+Tokenizer::Tokenizer(option::Descriptor const* usage, int argc, const char *const *argv, ParseMode_e mode)
+    :
+    m_usage(usage),
+    m_index(nullptr),
+    m_argc(argv ? argc : 0),
+    m_argv(argv),
+    m_argi(0),
+    m_short(nullptr),
+    m_gnu(mode == PARSE_GNU),
+    m_options_done(false),
+    m_failed(false),
+    m_err{PARSE_OK, -1, 0, -1}
+{
+}
+
+Tokenizer::Tokenizer(Spec const& spec, int argc, const char *const *argv, ParseMode_e mode)
+    : Tokenizer(spec.usage(), argc, argv, mode)
+{
+    m_index = &spec.index;
+}
+
+bool Tokenizer::next(Token *tok)
+{
+    tok->kind = TOKEN_END;
+    tok->argi = m_argi;
+    tok->option = option::Option();
+    tok->arg = nullptr;
+    if(m_failed)
+        return false;
+    if(m_short && _short(tok))
+        return true;
+    const char *param;
+    while((param = _arg(m_argi)) != nullptr)
+    {
+        // a lone minus is a positional argument
+        if(m_options_done || param[0] != '-' || param[1] == 0)
+        {
+            // in POSIX mode the first positional argument ends the options
+            m_options_done |= ! m_gnu;
+            tok->kind = TOKEN_POSITIONAL;
+            tok->argi = m_argi++;
+            tok->arg = param;
+            return true;
+        }
+        // -- ends the options, and is skipped
+        if(param[1] == '-' && param[2] == 0)
+        {
+            m_options_done = true;
+            ++m_argi;
+            continue;
+        }
+        if(param[1] == '-') // --long-option
+        {
+            const char *name = param + 2;
+            size_t len = 0;
+            while(name[len] != 0 && name[len] != '=')
+                ++len;
+            option::Descriptor const* desc = detail::descriptor_at(m_usage, m_index, detail::find_long(m_usage, m_index, csubstr(name, len)));
+            if( ! desc)
+            {
+                ++m_argi;
+                continue;
+            }
+            return _emit(tok, desc, param, name[len] == '=' ? name + len + 1 : _arg(m_argi + 1));
+        }
+        m_short = param + 1;
+        if(_short(tok))
+            return true;
+    }
+    return false;
+}
+
+bool Tokenizer::_short(Token *tok)
+{
+    for( ; *m_short != 0; ++m_short)
+    {
+        option::Descriptor const* desc = detail::descriptor_at(m_usage, m_index, detail::find_short(m_usage, m_index, *m_short));
+        if(desc)
+            return _emit(tok, desc, m_short, m_short[1] != 0 ? m_short + 1 : _arg(m_argi + 1));
+    }
+    // end of the group
+    m_short = nullptr;
+    ++m_argi;
+    return false;
+}
+
+bool Tokenizer::_emit(Token *tok, option::Descriptor const* desc, const char *name, const char *optarg)
+{
+    const char *param = m_argv[m_argi];
+    const bool separate = (optarg != nullptr && optarg == _arg(m_argi + 1));
+    option::Option opt(desc, name, optarg);
+    tok->argi = m_argi;
+    switch(desc->check_arg(opt, /*msg*/false))
+    {
+    case option::ARG_ILLEGAL:
+        m_failed = true;
+        m_err = detail::make_parse_error(true, m_argi, (int)(name - param), desc, m_usage);
+        tok->kind = TOKEN_ERROR;
+        tok->option = opt;
+        return true;
+    case option::ARG_OK:
+        // no further short options are possible after an argument
+        m_short = nullptr;
+        m_argi += separate ? 2 : 1;
+        break;
+    default:
+        opt.arg = nullptr;
+        if(m_short == nullptr)
+        {
+            ++m_argi;
+        }
+        else if(*++m_short == 0)
+        {
+            m_short = nullptr;
+            ++m_argi;
+        }
+        break;
+    }
+    tok->kind = TOKEN_OPTION;
+    tok->option = opt;
+    return true;
+}
+
+} // namespace opt
+} // namespace c4
@@ -0,0 +1,171 @@
+#ifndef _C4_OPT_TOKENIZER_HPP_
+#define _C4_OPT_TOKENIZER_HPP_
+
+#include "c4/opt/opt.hpp"
+
+#if C4_CPP >= 20 && defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#define C4OPT_HAS_COROUTINES
+#endif
+
+/** @file tokenizer.hpp pull-style parsing: one option or positional
+ * argument at a time */
+
+namespace c4 {
+namespace opt {
+
+typedef enum : uint8_t {
+    TOKEN_END = 0,     ///< there are no more tokens
+    TOKEN_OPTION,      ///< an option, with its argument if it has one
+    TOKEN_POSITIONAL,  ///< a positional argument
+    TOKEN_ERROR,       ///< a checker rejected an option. See Tokenizer::error().
+} TokenKind_e;
+
+/** an item yielded by Tokenizer */
+struct Token
+{
+    TokenKind_e    kind;
+    int            argi;    ///< the position in argv of the token
+    option::Option option;  ///< the option (TOKEN_OPTION or TOKEN_ERROR). It is not linked to other options.
+    const char    *arg;     ///< the positional argument (TOKEN_POSITIONAL)
+};
+
+
+/** Parses argv one item at a time, as requested with next(), matching
+ * the options as Parser does. Nothing is stored besides the position
+ * in argv, so an application can handle each option as it comes, and
+ * stop early without paying for the rest of argv.
+ *
+ * @code
+ * c4::opt::Tokenizer tk(usage, argc, argv);
+ * for(c4::opt::Token const& t : tk)
+ * {
+ *     if(t.kind == c4::opt::TOKEN_OPTION && t.option.index() == HELP)
+ *         break; // nothing else is parsed
+ *     ...
+ * }
+ * if(tk.error())
+ *     ...
+ * @endcode
+ *
+ * Errors are not printed: the checkers are called with msg=false,
+ * and the first error ends the iteration after being given as a
+ * TOKEN_ERROR item. argv is never modified. */
+class Tokenizer
+{
+public:
+
+    Tokenizer(option::Descriptor const* usage, int argc, const char *const *argv, ParseMode_e mode=PARSE_POSIX);
+    /** parse using the lookup tables from a compiled spec, which must
+     * outlive the tokenizer */
+    Tokenizer(Spec const& spec, int argc, const char *const *argv, ParseMode_e mode=PARSE_POSIX);
+
+    /** get the next item. After an error, which is given as a
+     * TOKEN_ERROR item, there are no more items.
+     * @return false when there are no more items (tok->kind == TOKEN_END) */
+    bool next(Token *tok);
+
+    /** the error which ended the iteration, if any */
+    ParseError const& error() const { return m_err; }
+
+    /** the position in argv of the next token to look at */
+    int position() const { return m_argi; }
+
+public:
+
+    struct iterator
+    {
+        Tokenizer *t;
+        Token tok;
+        Token const& operator* () const { return tok; }
+        Token const* operator-> () const { return &tok; }
+        iterator& operator++ () { if( ! t->next(&tok)) t = nullptr; return *this; }
+        bool operator!= (iterator const& that) const { return t != that.t; }
+        bool operator== (iterator const& that) const { return t == that.t; }
+    };
+
+    /** continue from the current position */
+    iterator begin() { iterator it{this, {}}; ++it; return it; }
+    iterator end() { return {nullptr, {}}; }
+
+private:
+
+    /** the token at position i, or null if there is none. A negative
+     * argc means that argv ends with a null. */
+    const char* _arg(int i) const { return (m_argc < 0 || i < m_argc) ? m_argv[i] : nullptr; }
+    bool _short(Token *tok);
+    bool _emit(Token *tok, option::Descriptor const* desc, const char *name, const char *optarg);
+
+private:
+
+    option::Descriptor const* m_usage;
+    option::Index const* m_index;
+    int m_argc;
+    const char *const *m_argv;
+    int m_argi;           ///< the current token
+    const char *m_short;  ///< the next option character within a group of short options, or null
+    bool m_gnu;
+    bool m_options_done;  ///< whether the rest are positional arguments
+    bool m_failed;
+    ParseError m_err;
+
+};
+
+
+#ifdef C4OPT_HAS_COROUTINES
+/** a minimal generator of tokens, for use with coroutines */
+class TokenGenerator
+{
+public:
+
+    struct promise_type
+    {
+        Token current;
+        TokenGenerator get_return_object() { return TokenGenerator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(Token const& t) noexcept { current = t; return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    struct iterator
+    {
+        std::coroutine_handle<promise_type> h;
+        Token const& operator* () const { return h.promise().current; }
+        Token const* operator-> () const { return &h.promise().current; }
+        iterator& operator++ () { h.resume(); return *this; }
+        bool operator== (std::default_sentinel_t) const { return h.done(); }
+    };
+
+    explicit TokenGenerator(std::coroutine_handle<promise_type> h) : m_h(h) {}
+    TokenGenerator(TokenGenerator &&that) noexcept : m_h(that.m_h) { that.m_h = nullptr; }
+    TokenGenerator(TokenGenerator const&) = delete;
+    TokenGenerator& operator= (TokenGenerator const&) = delete;
+    TokenGenerator& operator= (TokenGenerator &&) = delete;
+    ~TokenGenerator() { if(m_h) m_h.destroy(); }
+
+    iterator begin() { m_h.resume(); return {m_h}; }
+    std::default_sentinel_t end() { return {}; }
+
+private:
+
+    std::coroutine_handle<promise_type> m_h;
+
+};
+
+/** yield the items of a tokenizer, as given by Tokenizer::next() */
+inline TokenGenerator tokens(Tokenizer t)
+{
+    Token tok;
+    while(t.next(&tok))
+        co_yield tok;
+}
+#endif // C4OPT_HAS_COROUTINES
+
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_TOKENIZER_HPP_ */
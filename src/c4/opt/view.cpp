@@ -0,0 +1,475 @@
+#include "c4/opt/view.hpp"
+#include "c4/opt/suggest.hpp"
+#include <stdio.h>
+#include <string.h>
+
+namespace c4 {
+namespace opt {
+
+namespace {
+
+struct CountSink
+{
+    size_t num_occ = 0;
+    size_t num_posn = 0;
+    uint32_t occurrence(option::Descriptor const*, csubstr, csubstr, uint32_t) { ++num_occ; return PARSE_OK; }
+    void posn(uint32_t) { ++num_posn; }
+    void failed(ParseError const&) {}
+};
+
+} // anon
+
+
+//-----------------------------------------------------------------------------
+
+ViewParser::ViewParser(option::Descriptor const* usage, size_t num_usage_entries, cspan<csubstr> tokens, ParseMode_e mode, MemoryResource *mr)
+    : ViewParser(usage, num_usage_entries, tokens, nullptr, mode, mr)
+{
+}
+
+ViewParser::ViewParser(Spec const& spec, cspan<csubstr> tokens, ParseMode_e mode, MemoryResource *mr)
+    : ViewParser(spec, tokens, nullptr, mode, mr)
+{
+}
+
+ViewParser::ViewParser(option::Descriptor const* usage, size_t num_usage_entries, cspan<csubstr> tokens, ParseError *err, ParseMode_e mode, MemoryResource *mr)
+    : ViewParser(usage, num_usage_entries, tokens, ParseLimits(), err, mode, mr)
+{
+}
+
+ViewParser::ViewParser(Spec const& spec, cspan<csubstr> tokens, ParseError *err, ParseMode_e mode, MemoryResource *mr)
+    : ViewParser(spec, tokens, ParseLimits(), err, mode, mr)
+{
+}
+
+ViewParser::ViewParser(option::Descriptor const* usage, size_t num_usage_entries, cspan<csubstr> tokens, ParseLimits const& limits, ParseError *err, ParseMode_e mode, MemoryResource *mr)
+    :
+    m_usage(usage),
+    m_num_usage(num_usage_entries),
+    m_spec(),
+    m_tokens(tokens),
+    m_heads(nullptr),
+    m_num_heads(0),
+    m_occ(nullptr),
+    m_num_occ(0),
+    m_posn(nullptr),
+    m_num_posn(0),
+    m_mem_size(0),
+    m_scratch(nullptr),
+    m_scratch_size(0),
+    m_mr(mr)
+{
+    _parse(nullptr, mode, limits, err);
+}
+
+ViewParser::ViewParser(Spec const& spec, cspan<csubstr> tokens, ParseLimits const& limits, ParseError *err, ParseMode_e mode, MemoryResource *mr)
+    :
+    m_usage(spec.usage()),
+    m_num_usage(spec.num_usage_entries()),
+    m_spec(spec),
+    m_tokens(tokens),
+    m_heads(nullptr),
+    m_num_heads(0),
+    m_occ(nullptr),
+    m_num_occ(0),
+    m_posn(nullptr),
+    m_num_posn(0),
+    m_mem_size(0),
+    m_scratch(nullptr),
+    m_scratch_size(0),
+    m_mr(mr)
+{
+    _parse(&m_spec, mode, limits, err);
+}
+
+ViewParser::ViewParser(ViewParser &&that)
+    :
+    m_usage(that.m_usage),
+    m_num_usage(that.m_num_usage),
+    m_spec(that.m_spec),
+    m_tokens(that.m_tokens),
+    m_heads(that.m_heads),
+    m_num_heads(that.m_num_heads),
+    m_occ(that.m_occ),
+    m_num_occ(that.m_num_occ),
+    m_posn(that.m_posn),
+    m_num_posn(that.m_num_posn),
+    m_mem_size(that.m_mem_size),
+    m_scratch(nullptr),
+    m_scratch_size(0),
+    m_mr(that.m_mr)
+{
+    that.m_heads = nullptr;
+    that.m_occ = nullptr;
+    that.m_posn = nullptr;
+    that.m_mem_size = 0;
+}
+
+ViewParser::~ViewParser()
+{
+    if(m_heads)
+    {
+        m_mr->deallocate(m_heads, m_mem_size, alignof(ViewOption));
+        m_heads = nullptr;
+        m_occ = nullptr;
+        m_posn = nullptr;
+    }
+}
+
+const char* ViewParser::_terminated(csubstr tok, csubstr next)
+{
+    size_t needed = tok.len + 1u + (next.str ? next.len + 1u : 0u);
+    if(needed > m_scratch_size)
+    {
+        if(m_scratch)
+            m_mr->deallocate(m_scratch, m_scratch_size, 1);
+        m_scratch_size = needed > 2 * m_scratch_size ? needed : 2 * m_scratch_size;
+        m_scratch = (char*) m_mr->allocate(m_scratch_size, 1);
+    }
+    memcpy(m_scratch, tok.str, tok.len);
+    m_scratch[tok.len] = 0;
+    if(next.str)
+    {
+        memcpy(m_scratch + tok.len + 1u, next.str, next.len);
+        m_scratch[tok.len + 1u + next.len] = 0;
+    }
+    return m_scratch;
+}
+
+template<class Sink>
+bool ViewParser::_scan(option::Index const* index, bool gnu, bool print_errors, ParseLimits const& limits, Sink &&sink)
+{
+    // the positions of the tokens must also fit in ParseError::argi
+    const size_t max_tokens = limits.max_tokens < size_t(INT32_MAX) ? limits.max_tokens : size_t(INT32_MAX);
+    if(m_tokens.size() > max_tokens)
+    {
+        sink.failed({PARSE_TOO_MANY_TOKENS, (int32_t)max_tokens, 0, -1});
+        return false;
+    }
+    const uint32_t num_tokens = (uint32_t)m_tokens.size();
+    csubstr const* tokens = m_tokens.data();
+    size_t bytes = 0;
+    size_t comparisons = 0;
+    // the descriptors looked at to find an option: one with an index,
+    // otherwise all those before it, and again all of them to find
+    // the unknown descriptor if it was not found
+    auto lookup = [&](unsigned idx) -> option::Descriptor const* {
+        const size_t looked_at = index ? 1u : (m_usage[idx].shortopt ? idx + 1u : 2u * idx + 1u);
+        comparisons += looked_at;
+        OPTIONPARSER_PROFILE(prof_->comparisons += looked_at);
+        return detail::descriptor_at(m_usage, index, idx);
+    };
+    auto fail = [&](uint32_t code, option::Descriptor const* desc, uint32_t token, uint32_t offset) {
+        if(code == PARSE_TOO_MANY_OPTIONS || code == PARSE_ILLEGAL_ARGUMENT)
+            sink.failed(detail::make_parse_error(code == PARSE_ILLEGAL_ARGUMENT, (int)token, (int)offset, desc, m_usage));
+        else
+            sink.failed({code, (int32_t)token, (int32_t)offset, desc ? (int32_t)(desc - m_usage) : -1});
+        return false;
+    };
+    uint32_t i = 0;
+    while(i < num_tokens)
+    {
+        csubstr tok = tokens[i];
+        bytes += tok.len;
+        if(bytes > limits.max_bytes)
+            return fail(PARSE_TOO_MANY_BYTES, nullptr, i, 0);
+        // a lone minus is a non-option argument
+        if(tok.len < 2 || tok.str[0] != '-')
+        {
+            if( ! gnu)
+            {
+                bytes -= tok.len; // counted below, with the rest
+                break;
+            }
+            OPTIONPARSER_PROFILE(++prof_->tokens);
+            sink.posn(i++);
+            continue;
+        }
+        OPTIONPARSER_PROFILE(++prof_->tokens);
+        // -- terminates the option list, and is skipped
+        if(tok.len == 2 && tok.str[1] == '-')
+        {
+            ++i;
+            break;
+        }
+        // the separate argument, if there is one
+        csubstr next;
+        if(i + 1 < num_tokens)
+        {
+            next = tokens[i + 1];
+            if(next.str == nullptr)
+                next = csubstr("");
+        }
+        // the next token may be an argument: bound it before it is
+        // copied and checked. One past max_arg_len is enough to fail
+        // below, and a token over the remaining max_bytes fails the
+        // parse anyway, whether or not it is an argument
+        const bool next_too_many_bytes = next.len > limits.max_bytes - bytes;
+        csubstr bounded_next = next.len > limits.max_arg_len ? next.first(limits.max_arg_len + 1) : next;
+        bool consumed_next = false;
+        if(tok.str[1] == '-') // --long-option
+        {
+            csubstr body = tok.sub(2);
+            size_t eq = body.find('=');
+            csubstr name = eq == csubstr::npos ? body : body.first(eq);
+            option::Descriptor const* desc = lookup(detail::find_long(m_usage, index, name));
+            if(comparisons > limits.max_comparisons)
+                return fail(PARSE_TOO_MUCH_WORK, nullptr, i, 0);
+            if(desc)
+            {
+                if(eq == csubstr::npos && next_too_many_bytes)
+                    return fail(PARSE_TOO_MANY_BYTES, nullptr, i + 1, 0);
+                const char *s = _terminated(tok, eq == csubstr::npos ? bounded_next : csubstr());
+                const char *sarg = eq != csubstr::npos ? s + 2 + eq + 1 : (next.str ? s + tok.len + 1 : nullptr);
+                option::Option opt(desc, s, sarg);
+                csubstr arg;
+                OPTIONPARSER_PROFILE(++prof_->checks);
+                switch(desc->check_arg(opt, print_errors))
+                {
+                case option::ARG_ILLEGAL:
+                    return fail(PARSE_ILLEGAL_ARGUMENT, desc, i, 0);
+                case option::ARG_OK:
+                    if(eq != csubstr::npos)
+                        arg = body.sub(eq + 1);
+                    else if(next.str)
+                    {
+                        arg = next;
+                        consumed_next = true;
+                    }
+                    break;
+                default:
+                    break;
+                }
+                if(arg.len > limits.max_arg_len)
+                    return fail(PARSE_ARG_TOO_LONG, desc, i, 0);
+                uint32_t code = sink.occurrence(desc, tok.first(2 + name.len), arg, i);
+                if(code != PARSE_OK)
+                    return fail(code, desc, i, 0);
+            }
+        }
+        else // -short -options
+        {
+            // a single copy serves all the options in the group
+            const char *s = nullptr;
+            for(size_t k = 1; k < tok.len; ++k)
+            {
+                option::Descriptor const* desc = lookup(detail::find_short(m_usage, index, tok.str[k]));
+                if(comparisons > limits.max_comparisons)
+                    return fail(PARSE_TOO_MUCH_WORK, nullptr, i, (uint32_t)k);
+                if( ! desc)
+                    continue;
+                if( ! s)
+                {
+                    if(next_too_many_bytes)
+                        return fail(PARSE_TOO_MANY_BYTES, nullptr, i + 1, 0);
+                    s = _terminated(tok, bounded_next);
+                }
+                const bool attached = k + 1 < tok.len;
+                const char *sarg = attached ? s + k + 1 : (next.str ? s + tok.len + 1 : nullptr);
+                option::Option opt(desc, s + k, sarg);
+                csubstr arg;
+                bool has_arg = false;
+                OPTIONPARSER_PROFILE(++prof_->checks);
+                switch(desc->check_arg(opt, print_errors))
+                {
+                case option::ARG_ILLEGAL:
+                    return fail(PARSE_ILLEGAL_ARGUMENT, desc, i, (uint32_t)k);
+                case option::ARG_OK:
+                    if(attached)
+                        arg = tok.sub(k + 1);
+                    else if(next.str)
+                    {
+                        arg = next;
+                        consumed_next = true;
+                    }
+                    has_arg = arg.str != nullptr;
+                    break;
+                default:
+                    break;
+                }
+                if(arg.len > limits.max_arg_len)
+                    return fail(PARSE_ARG_TOO_LONG, desc, i, (uint32_t)k);
+                uint32_t code = sink.occurrence(desc, tok.sub(k, 1), arg, i);
+                if(code != PARSE_OK)
+                    return fail(code, desc, i, (uint32_t)k);
+                // no further short options are possible after an argument
+                if(has_arg)
+                    break;
+            }
+        }
+        if(consumed_next)
+        {
+            bytes += next.len;
+            if(bytes > limits.max_bytes)
+                return fail(PARSE_TOO_MANY_BYTES, nullptr, i + 1, 0);
+        }
+        i += consumed_next ? 2u : 1u;
+    }
+    for( ; i < num_tokens; ++i)
+    {
+        OPTIONPARSER_PROFILE(++prof_->tokens);
+        bytes += tokens[i].len;
+        if(bytes > limits.max_bytes)
+            return fail(PARSE_TOO_MANY_BYTES, nullptr, i, 0);
+        sink.posn(i);
+    }
+    return true;
+}
+
+void ViewParser::_parse(Spec const* spec, ParseMode_e mode, ParseLimits const& limits, ParseError *err)
+{
+    option::Index const* index = spec ? &spec->index : nullptr;
+    const bool gnu = (mode == PARSE_GNU);
+    // count first, to allocate the results in a single block of the exact size
+    CountSink counter;
+    _scan(index, gnu, /*print_errors*/false, limits, counter);
+    m_num_heads = index ? index->options_max : option::Stats(m_usage, 0, (const char**)nullptr).options_max;
+    m_mem_size = m_num_heads * sizeof(Head);
+    m_mem_size = (m_mem_size + alignof(ViewOption) - 1) / alignof(ViewOption) * alignof(ViewOption);
+    const size_t occ_offset = m_mem_size;
+    m_mem_size += counter.num_occ * sizeof(ViewOption) + counter.num_posn * sizeof(uint32_t);
+    m_heads = (Head*) m_mr->allocate(m_mem_size, alignof(ViewOption));
+    m_occ = (ViewOption*) ((char*)m_heads + occ_offset);
+    m_posn = (uint32_t*) (m_occ + counter.num_occ);
+    for(size_t i = 0; i < m_num_heads; ++i)
+        m_heads[i] = {ViewOption::npos, ViewOption::npos, 0};
+    if(err)
+        *err = {PARSE_OK, -1, 0, -1};
+    struct StoreSink
+    {
+        ViewParser *p;
+        size_t capacity;
+        size_t max_occurrences;
+        ParseError *err;
+        uint32_t occurrence(option::Descriptor const* desc, csubstr name, csubstr arg, uint32_t token)
+        {
+            if(p->m_num_occ >= capacity)
+                return PARSE_TOO_MANY_OPTIONS;
+            Head &h = p->m_heads[desc->index];
+            if(h.count >= max_occurrences)
+                return PARSE_TOO_MANY_OCCURRENCES;
+            uint32_t pos = (uint32_t)p->m_num_occ++;
+            p->m_occ[pos] = {desc, name, arg, token, ViewOption::npos};
+            if(h.count++ == 0)
+                h.first = pos;
+            else
+                p->m_occ[h.last].next = pos;
+            h.last = pos;
+            return PARSE_OK;
+        }
+        void posn(uint32_t token)
+        {
+            p->m_posn[p->m_num_posn++] = token;
+        }
+        void failed(ParseError const& e)
+        {
+            if(err)
+                *err = e;
+        }
+    };
+    ParseError printed_err = {PARSE_OK, -1, 0, -1}; // to suggest names for an unknown option
+    StoreSink store{this, counter.num_occ, limits.max_occurrences, err ? err : &printed_err};
+    bool ok = _scan(index, gnu, /*print_errors*/err == nullptr, limits, store);
+    if(m_scratch)
+    {
+        m_mr->deallocate(m_scratch, m_scratch_size, 1);
+        m_scratch = nullptr;
+        m_scratch_size = 0;
+    }
+    if( ! ok && ! err)
+    {
+        if(printed_err.argi >= 0 && (size_t)printed_err.argi < m_tokens.size())
+            detail::print_suggestions(printed_err, m_usage, m_tokens[(size_t)printed_err.argi]);
+        help();
+        C4_ERROR("parser error");
+    }
+}
+
+ViewOption const& ViewParser::operator[] (int i) const
+{
+    static const ViewOption none = {nullptr, {}, {}, ViewOption::npos, ViewOption::npos};
+    C4_CHECK(size_t(i) < m_num_heads);
+    uint32_t first = m_heads[i].first;
+    return first == ViewOption::npos ? none : m_occ[first];
+}
+
+csubstr ViewParser::operator() (int i) const
+{
+    ViewOption const& opt = (*this)[i];
+    C4_CHECK_MSG(opt.arg.str, "error in option %d: '%.*s'", i, (int)opt.name.len, opt.name.str);
+    return opt.arg;
+}
+
+void ViewParser::help() const
+{
+    if(m_spec.index.usage)
+        write_all(stdout, m_spec.help_text(/*columns*/80));
+    else
+        print_help(m_usage, /*columns*/80, stdout);
+}
+
+void ViewParser::check_mandatory(std::initializer_list<int> mandatory_options) const
+{
+    ParseError err;
+    if( ! check_mandatory(mandatory_options, &err))
+    {
+        char buf[256];
+        format_error(substr(buf, sizeof(buf)), err, m_usage, m_tokens);
+        fprintf(stderr, "%s\n", buf);
+        C4_ERROR("mandatory options were missing");
+    }
+}
+
+bool ViewParser::check_mandatory(std::initializer_list<int> mandatory_options, ParseError *err) const
+{
+    for(int index : mandatory_options)
+    {
+        if(count(index) != 0)
+            continue;
+        *err = {PARSE_MISSING_MANDATORY, -1, 0, detail::find_descriptor(m_usage, m_num_usage, index)};
+        return false;
+    }
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+size_t format_error(substr buf, ParseError const& err, option::Descriptor const *usage, cspan<csubstr> tokens)
+{
+    csubstr tok;
+    if(err.argi >= 0 && (size_t)err.argi < tokens.size())
+        tok = tokens[(size_t)err.argi];
+    return detail::format_error(buf, err, usage, tok);
+}
+
+ViewParser make_parser(option::Descriptor const *usage, size_t num_usage_entries,
+                       cspan<csubstr> tokens,
+                       ParseError *err,
+                       std::initializer_list<int> mandatory_indices,
+                       MemoryResource *mr)
+{
+    ViewParser p(usage, num_usage_entries, tokens, err, PARSE_POSIX, mr);
+    if(err == nullptr)
+        p.check_mandatory(mandatory_indices);
+    else if( ! *err)
+        p.check_mandatory(mandatory_indices, err);
+    return p;
+}
+
+ViewParser make_parser(Spec const& spec,
+                       cspan<csubstr> tokens,
+                       ParseError *err,
+                       std::initializer_list<int> mandatory_indices,
+                       MemoryResource *mr)
+{
+    ViewParser p(spec, tokens, err, PARSE_POSIX, mr);
+    if(err == nullptr)
+        p.check_mandatory(mandatory_indices);
+    else if( ! *err)
+        p.check_mandatory(mandatory_indices, err);
+    return p;
+}
+
+} // namespace opt
+} // namespace c4
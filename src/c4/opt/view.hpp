@@ -0,0 +1,225 @@
+#ifndef _C4_OPT_VIEW_HPP_
+#define _C4_OPT_VIEW_HPP_
+
+#include "c4/opt/opt.hpp"
+#include <c4/span.hpp>
+#include <iterator>
+
+/** @file view.hpp a parser for tokens given as string views, which
+ * need not be null-terminated, eg slices of a larger buffer */
+
+namespace c4 {
+namespace opt {
+
+/** An occurrence of an option given in the tokens. The name and the
+ * argument are views into the tokens. */
+struct ViewOption
+{
+    enum : uint32_t { npos = uint32_t(-1) };
+
+    option::Descriptor const* desc;  ///< null if this is not an occurrence
+    csubstr  name;   ///< eg "--level" or "l", as in option::Option::name, but without the trailing characters
+    csubstr  arg;    ///< the argument. arg.str is null if the option has no argument
+    uint32_t token;  ///< the position of the option's token
+    uint32_t next;   ///< the position of the next occurrence with the same index, or npos
+
+    int index() const { return desc ? desc->index : -1; }
+    bool has_arg() const { return arg.str != nullptr; }
+    explicit operator bool() const { return desc != nullptr; }
+};
+
+
+/** Parses tokens given as a span of csubstr, which need not be
+ * null-terminated: all the matching is done with explicit lengths,
+ * and the results are views into the tokens, which are not copied and
+ * must outlive the parser.
+ *
+ * The tokens are matched as by Parser: no abbreviations, and no single
+ * minus long options. The checkers of the descriptors need
+ * null-terminated strings, so each option they are called with is
+ * first copied into a scratch buffer, which is released at the end of
+ * the parse. Tokens containing a null character are seen truncated by
+ * the checkers.
+ *
+ * The time and memory needed are linear in the total length of the
+ * tokens. For tokens from untrusted sources, give ParseLimits to
+ * bound them further: the parse stops at the first token exceeding a
+ * limit, and the error is recorded in err. With C4OPT_PROFILE, the
+ * work is counted in option::Profile::current(), if there is one. */
+class ViewParser
+{
+public:
+
+    /** parse; on error, print the help and abort, like Parser */
+    ViewParser(option::Descriptor const* usage, size_t num_usage_entries, cspan<csubstr> tokens, ParseMode_e mode=PARSE_POSIX, MemoryResource *mr=get_memory_resource());
+    ViewParser(Spec const& spec, cspan<csubstr> tokens, ParseMode_e mode=PARSE_POSIX, MemoryResource *mr=get_memory_resource());
+    /** parse without printing or aborting; the error (if any) is
+     * recorded in err, with argi being the position of the token. */
+    ViewParser(option::Descriptor const* usage, size_t num_usage_entries, cspan<csubstr> tokens, ParseError *err, ParseMode_e mode=PARSE_POSIX, MemoryResource *mr=get_memory_resource());
+    ViewParser(Spec const& spec, cspan<csubstr> tokens, ParseError *err, ParseMode_e mode=PARSE_POSIX, MemoryResource *mr=get_memory_resource());
+    /** parse within the given limits. If err is null, exceeding a
+     * limit prints the help and aborts, as any other error. */
+    ViewParser(option::Descriptor const* usage, size_t num_usage_entries, cspan<csubstr> tokens, ParseLimits const& limits, ParseError *err, ParseMode_e mode=PARSE_POSIX, MemoryResource *mr=get_memory_resource());
+    ViewParser(Spec const& spec, cspan<csubstr> tokens, ParseLimits const& limits, ParseError *err, ParseMode_e mode=PARSE_POSIX, MemoryResource *mr=get_memory_resource());
+
+    ~ViewParser();
+
+    ViewParser(ViewParser const&) = delete;
+    ViewParser& operator= (ViewParser const&) = delete;
+    ViewParser(ViewParser &&that);
+    ViewParser& operator= (ViewParser &&) = delete;
+
+public:
+
+    /** the number of times the option with index i was given */
+    int count(int i) const { C4_CHECK(size_t(i) < m_num_heads); return (int)m_heads[i].count; }
+    /** the first occurrence of the option with index i. It converts to
+     * false if the option was not given. */
+    ViewOption const& operator[] (int i) const;
+    /** the argument of the first occurrence of the option with index i */
+    csubstr operator() (int i) const;
+
+    option::Descriptor const* usage() const { return m_usage; }
+    /** the number of option indices, ie one more than the greatest index in the usage */
+    size_t num_indices() const { return m_num_heads; }
+
+    /** all the occurrences, in the order given in the tokens */
+    ViewOption const* occurrences() const { return m_occ; }
+    size_t num_occurrences() const { return m_num_occ; }
+
+    void help() const;
+    void check_mandatory(std::initializer_list<int> mandatory_options) const;
+    bool check_mandatory(std::initializer_list<int> mandatory_options, ParseError *err) const;
+
+    /** the positions in the tokens of the positional arguments */
+    uint32_t const* posn_indices() const { return m_posn; }
+    size_t num_posn() const { return m_num_posn; }
+
+public:
+
+    struct option_iterator
+    {
+        ViewOption const* occ;
+        uint32_t pos;
+        bool chained; ///< whether to follow the occurrences with the same index
+        using value_type = ViewOption;
+        ViewOption const& operator* () const { return occ[pos]; }
+        ViewOption const* operator-> () const { return occ + pos; }
+        option_iterator& operator++ () { pos = chained ? occ[pos].next : pos + 1; return *this; }
+        bool operator!= (option_iterator that) const { return pos != that.pos; }
+        bool operator== (option_iterator that) const { return pos == that.pos; }
+    };
+
+    struct positional_arg_iterator
+    {
+        csubstr const* tokens;
+        uint32_t const* pos;
+        using iterator_category = std::input_iterator_tag;
+        using value_type = csubstr;
+        using difference_type = ptrdiff_t;
+        using pointer = csubstr const*;
+        using reference = csubstr const&;
+        csubstr const& operator* () const { return tokens[*pos]; }
+        positional_arg_iterator& operator++ () { ++pos; return *this; }
+        bool operator!= (positional_arg_iterator that) const { return pos != that.pos; }
+        bool operator== (positional_arg_iterator that) const { return pos == that.pos; }
+    };
+
+    template <class It>
+    struct iterator_range
+    {
+        It begin_, end_;
+        It begin() const { return begin_; }
+        It end() const { return end_; }
+    };
+
+    /** iterate through the occurrences of the option with index i */
+    iterator_range<option_iterator> opts(int i) const
+    {
+        C4_CHECK(size_t(i) < m_num_heads);
+        return {{m_occ, m_heads[i].first, true}, {m_occ, ViewOption::npos, true}};
+    }
+
+    /** iterate through the options in order, as given in the tokens */
+    iterator_range<option_iterator> opts_args() const
+    {
+        return {{m_occ, 0, false}, {m_occ, (uint32_t)m_num_occ, false}};
+    }
+
+    /** iterate through the positional arguments (ie, those without options) */
+    iterator_range<positional_arg_iterator> posn_args() const
+    {
+        return {{m_tokens.data(), m_posn}, {m_tokens.data(), m_posn + m_num_posn}};
+    }
+
+    /** iterate through the raw tokens */
+    cspan<csubstr> raw_args() const { return m_tokens; }
+
+private:
+
+    struct Head
+    {
+        uint32_t first;
+        uint32_t last;
+        uint32_t count;
+    };
+
+    void _parse(Spec const* spec, ParseMode_e mode, ParseLimits const& limits, ParseError *err);
+    template<class Sink>
+    bool _scan(option::Index const* index, bool gnu, bool print_errors, ParseLimits const& limits, Sink &&sink);
+    const char* _terminated(csubstr tok, csubstr next);
+
+private:
+
+    option::Descriptor const* m_usage;
+    size_t           m_num_usage;
+    Spec             m_spec;
+    cspan<csubstr>   m_tokens;
+    Head            *m_heads;
+    size_t           m_num_heads;
+    ViewOption      *m_occ;
+    size_t           m_num_occ;
+    uint32_t        *m_posn;
+    size_t           m_num_posn;
+    size_t           m_mem_size;
+    char            *m_scratch;       ///< null-terminated copies of the tokens, for the checkers
+    size_t           m_scratch_size;
+    MemoryResource  *m_mr;
+
+};
+
+
+//-----------------------------------------------------------------------------
+
+/** format_error() for an error in parsing tokens given as string views */
+size_t format_error(substr buf, ParseError const& err, option::Descriptor const *usage, cspan<csubstr> tokens);
+
+/** Parse tokens given as string views, which need not be
+ * null-terminated. The option names and arguments in the result are
+ * views into the tokens. See ViewParser. */
+ViewParser make_parser(option::Descriptor const *usage, size_t num_usage_entries,
+                       cspan<csubstr> tokens,
+                       ParseError *err=nullptr,
+                       std::initializer_list<int> mandatory_indices=std::initializer_list<int>(),
+                       MemoryResource *mr=get_memory_resource());
+
+template <size_t N>
+ViewParser make_parser(option::Descriptor const (&usage)[N],
+                       cspan<csubstr> tokens,
+                       ParseError *err=nullptr,
+                       std::initializer_list<int> mandatory_indices=std::initializer_list<int>(),
+                       MemoryResource *mr=get_memory_resource())
+{
+    return make_parser(usage, N, tokens, err, mandatory_indices, mr);
+}
+
+ViewParser make_parser(Spec const& spec,
+                       cspan<csubstr> tokens,
+                       ParseError *err=nullptr,
+                       std::initializer_list<int> mandatory_indices=std::initializer_list<int>(),
+                       MemoryResource *mr=get_memory_resource());
+
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_VIEW_HPP_ */
@@ -0,0 +1,170 @@
+#include "test_allocs.hpp"
+#include "test_common.hpp"
+#include <c4/opt/arena.hpp>
+#include <c4/opt/bind.hpp>
+#include <c4/opt/compact.hpp>
+#include <c4/opt/help.hpp>
+#include <c4/opt/tokenizer.hpp>
+#include <c4/opt/view.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+using namespace test_common;
+
+#ifdef C4OPT_PROFILE
+const size_t profile_allocs = 1; // the checks_per_desc of each Parser
+#else
+const size_t profile_allocs = 0;
+#endif
+
+TEST(allocs, counting_resource)
+{
+    c4::opt::MemoryResourceCounting counter;
+    void *a = counter.allocate(100);
+    void *b = counter.allocate(50);
+    EXPECT_ALLOCS(counter, 2);
+    EXPECT_EQ(counter.counts().bytes, 150u);
+    EXPECT_EQ(counter.counts().peak, 150u);
+    b = counter.reallocate(b, 50, 200);
+    counter.deallocate(a, 100);
+    EXPECT_ALLOCS(counter, 3);
+    EXPECT_EQ(counter.counts().num_deallocs, 2u);
+    EXPECT_EQ(counter.counts().curr, 200u);
+    EXPECT_EQ(counter.counts().peak, 300u);
+    counter.reset();
+    EXPECT_ALLOCS(counter, 0);
+    EXPECT_EQ(counter.counts().peak, 200u);
+    counter.deallocate(b, 200);
+    EXPECT_EQ(counter.counts().curr, 0u);
+}
+
+TEST(allocs, scope_installs_the_global_resource)
+{
+    c4::MemoryResource *prev = c4::get_memory_resource();
+    {
+        c4::opt::MemoryResourceCounting::Scope allocs;
+        EXPECT_EQ(c4::get_memory_resource(), allocs.resource());
+        c4::get_memory_resource()->deallocate(c4::get_memory_resource()->allocate(10), 10);
+        EXPECT_ALLOCS(allocs, 1);
+    }
+    EXPECT_EQ(c4::get_memory_resource(), prev);
+}
+
+TEST(allocs, parser_allocates_one_block_sized_by_stats)
+{
+    Args args({"-vv", "-l1", "--level=2", "--name", "foo", "-hvn", "bar", "file"});
+    c4::opt::MemoryResourceCounting::Scope allocs;
+    {
+        auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv());
+        EXPECT_ALLOCS(allocs, 1 + profile_allocs);
+        // the options and the buffer, sized by option::Stats: one
+        // entry per option index, plus one per option given, plus the
+        // sentinels; then an int per option index to count them
+        const size_t scratch = (p.stats.options_max * sizeof(int) + sizeof(option::Option) - 1) / sizeof(option::Option);
+        EXPECT_EQ(allocs.counts().bytes, (p.stats.options_max + p.stats.buffer_max + scratch) * sizeof(option::Option)
+                                         + profile_allocs * p.num_opts * sizeof(unsigned));
+        EXPECT_EQ(p.stats.options_max, (unsigned)VERBOSE + 2u);
+        EXPECT_EQ((int)p.stats.buffer_max, p.parser.optionsCount() + 1);
+        // the accessors do not allocate
+        allocs.reset();
+        EXPECT_EQ(p[VERBOSE].count(), 3);
+        for(option::Option const& o : p.opts_args())
+            EXPECT_NE(o.name, nullptr);
+        for(const char *a : p.posn_args())
+            EXPECT_STREQ(a, "file");
+        EXPECT_ALLOCS(allocs, 0);
+    }
+    EXPECT_EQ(allocs.counts().curr, 0u);
+}
+
+TEST(allocs, large_usage)
+{
+    // the scratch to count the options grows with the descriptors,
+    // and is still part of the block
+    std::vector<std::string> names;
+    std::vector<option::Descriptor> usage;
+    usage.push_back(common_usage[0]);
+    for(unsigned i = 1; i < 100; ++i)
+        names.push_back("opt" + std::to_string(i));
+    for(unsigned i = 1; i < 100; ++i)
+        usage.push_back({i, 0, "", names[i - 1].c_str(), c4::opt::none, ""});
+    usage.push_back({0, 0, 0, 0, 0, 0});
+    Args args({"--opt1", "--opt99", "--opt1"});
+    c4::opt::MemoryResourceCounting::Scope allocs;
+    {
+        auto p = c4::opt::make_parser(usage.data(), usage.size(), args.argc(), args.argv());
+        EXPECT_EQ(p[1].count(), 2);
+        EXPECT_EQ(p[99].count(), 1);
+        EXPECT_ALLOCS(allocs, 1 + profile_allocs);
+        EXPECT_EQ(allocs.counts().num_deallocs, 0u);
+    }
+    EXPECT_EQ(allocs.counts().curr, 0u);
+}
+
+TEST(allocs, steady_state_parse_does_not_allocate)
+{
+    Args args({"-vv", "-l1", "--level=2", "--name", "foo", "file"});
+    c4::opt::RuntimeSpec rs(common_usage);
+    c4::opt::MemoryResourceCounting upstream;
+    c4::opt::MemoryResourceArena arena(4096, &upstream);
+    for(int rep = 0; rep < 3; ++rep)
+    {
+        c4::opt::MemoryResourceCounting::Scope allocs;
+        upstream.reset();
+        {
+            auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv(), &arena);
+            auto ps = c4::opt::make_parser(rs.spec(), args.argc(), args.argv(), &arena);
+            c4::opt::CompactParser cp(rs.spec(), args.argc(), args.argv(), &arena);
+            c4::opt::CompactParser cpr(rs.spec(), args.argc(), args.argv(), c4::opt::PARSE_GNU, c4::opt::with_retention, {{LEVEL, c4::opt::RETAIN_LAST}}, nullptr, &arena);
+            c4::opt::ViewParser vp(rs.spec(), args.tokens(), c4::opt::PARSE_POSIX, &arena);
+            EXPECT_EQ(p[VERBOSE].count(), 2);
+            EXPECT_STREQ(ps(NAME), "foo");
+            EXPECT_EQ(cp.count(LEVEL), 2);
+            EXPECT_EQ(cpr.count(LEVEL), 2);
+            EXPECT_LT(cpr.num_occurrences(), cp.num_occurrences());
+            EXPECT_EQ(vp.count(LEVEL), 2);
+        }
+        // nothing from the global resource, ever
+        EXPECT_ALLOCS(allocs, 0);
+        // the arena needs its upstream only in the first round
+        if(rep > 0)
+        {
+            EXPECT_ALLOCS(upstream, 0);
+        }
+        arena.reset();
+    }
+}
+
+TEST(allocs, tokenizer_does_not_allocate)
+{
+    Args args({"-vv", "-l1", "--level=2", "--name", "foo", "file"});
+    c4::opt::RuntimeSpec rs(common_usage);
+    c4::opt::MemoryResourceCounting::Scope allocs;
+    int num = 0;
+    c4::opt::Tokenizer tk(rs.spec(), args.argc(), args.argv());
+    for(c4::opt::Token const& t : tk)
+        num += (t.kind == c4::opt::TOKEN_OPTION);
+    EXPECT_EQ(num, 5);
+    c4::opt::Tokenizer tku(common_usage, args.argc(), args.argv(), c4::opt::PARSE_GNU);
+    for(c4::opt::Token const& t : tku)
+        num += (t.kind == c4::opt::TOKEN_OPTION);
+    EXPECT_EQ(num, 10);
+    EXPECT_ALLOCS(allocs, 0);
+}
+
+TEST(allocs, cached_help_does_not_allocate)
+{
+    c4::opt::RuntimeSpec rs(common_usage);
+    (void)c4::opt::help_text(common_usage, 77);
+    (void)rs.spec().help_text(78);
+    c4::opt::MemoryResourceCounting::Scope allocs;
+    EXPECT_NE(c4::opt::help_text(common_usage, 77).len, 0u);
+    EXPECT_NE(rs.spec().help_text(78).len, 0u);
+    EXPECT_ALLOCS(allocs, 0);
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
@@ -0,0 +1,43 @@
+#ifndef _C4_OPT_TEST_ALLOCS_HPP_
+#define _C4_OPT_TEST_ALLOCS_HPP_
+
+/** @file test_allocs.hpp gtest assertions on the allocations counted by
+ * a c4::opt::MemoryResourceCounting (or a Scope of it):
+ *
+ * @code
+ * c4::opt::MemoryResourceCounting::Scope allocs;
+ * auto p = c4::opt::make_parser(usage, argc, argv, &arena);
+ * EXPECT_ALLOCS(allocs, 0);
+ * @endcode
+ */
+
+#include <c4/opt/counting.hpp>
+#include <gtest/gtest.h>
+
+namespace c4 {
+namespace opt {
+namespace test {
+
+inline AllocCounts const& alloc_counts(MemoryResourceCounting const& c) { return c.counts(); }
+inline AllocCounts const& alloc_counts(MemoryResourceCounting::Scope const& s) { return s.counts(); }
+
+template<class Counter>
+::testing::AssertionResult check_allocs(const char *counter_expr, const char * /*num_expr*/, Counter const& counter, size_t num_allocs)
+{
+    AllocCounts const& c = alloc_counts(counter);
+    if(c.num_allocs == num_allocs)
+        return ::testing::AssertionSuccess();
+    return ::testing::AssertionFailure()
+        << counter_expr << ": expected " << num_allocs << " allocations, got " << c.num_allocs
+        << " (bytes=" << c.bytes << " peak=" << c.peak << " in use=" << c.curr << " deallocations=" << c.num_deallocs << ")";
+}
+
+} // namespace test
+} // namespace opt
+} // namespace c4
+
+/** check the number of allocations since the counter was reset */
+#define EXPECT_ALLOCS(counter, num) EXPECT_PRED_FORMAT2(::c4::opt::test::check_allocs, counter, (size_t)(num))
+#define ASSERT_ALLOCS(counter, num) ASSERT_PRED_FORMAT2(::c4::opt::test::check_allocs, counter, (size_t)(num))
+
+#endif /* _C4_OPT_TEST_ALLOCS_HPP_ */
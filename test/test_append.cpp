@@ -0,0 +1,191 @@
+#include "test_allocs.hpp"
+#include "test_common.hpp"
+#include <c4/opt/opt.hpp>
+#include <c4/opt/spec.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+using namespace test_common;
+
+/** the list of an option must have the occurrences of opts_args()
+ * with its index, in the same order, both ways */
+void check_lists(c4::opt::Parser const& p)
+{
+    for(int i = 0; i < (int)p.num_opts; ++i)
+    {
+        std::vector<option::Option const*> expected;
+        for(option::Option const& o : p.opts_args())
+            if(o.index() == i)
+                expected.push_back(&o);
+        ASSERT_EQ(p[i].count(), (int)expected.size()) << "index " << i;
+        if(expected.empty())
+            continue;
+        // the head is a copy of the first occurrence
+        option::Option const* o = &p[i];
+        EXPECT_EQ(o->name, expected[0]->name);
+        for(size_t j = 1; j < expected.size(); ++j)
+        {
+            o = o->next();
+            ASSERT_EQ(o, expected[j]) << "index " << i << " occurrence " << j;
+        }
+        EXPECT_EQ(o->next(), nullptr);
+        EXPECT_EQ(p[i].last(), o);
+        for(size_t j = expected.size() - 1; j > 0; --j)
+            o = o->prev();
+        EXPECT_EQ(o, &p[i]);
+    }
+}
+
+TEST(append, layers)
+{
+    Args defaults({"--level=1", "--name", "default", "default_file"});
+    Args config({"-v", "--level=2"});
+    Args user({"-vl3", "user_file", "-h"});
+    auto p = c4::opt::make_parser(common_usage, defaults.argc(), defaults.argv());
+    EXPECT_EQ(p[LEVEL].count(), 1);
+    EXPECT_TRUE(p.append(config.argc(), config.argv()));
+    // no positional arguments in the config: those before are kept
+    ASSERT_EQ(p.posn_args().end() - p.posn_args().begin(), 1);
+    EXPECT_STREQ(p.posn_args()[0], "default_file");
+    EXPECT_TRUE(p.append(user.argc(), user.argv()));
+    EXPECT_EQ(p[LEVEL].count(), 3);
+    EXPECT_STREQ(p[LEVEL].arg, "1");
+    EXPECT_STREQ(p[LEVEL].last()->arg, "3");
+    EXPECT_STREQ(p(NAME), "default");
+    EXPECT_EQ(p[VERBOSE].count(), 2);
+    EXPECT_FALSE(p[HELP]);
+    // the arguments of the last call which had any
+    ASSERT_EQ(p.posn_args().end() - p.posn_args().begin(), 2);
+    EXPECT_STREQ(p.posn_args()[0], "user_file");
+    EXPECT_STREQ(p.posn_args()[1], "-h");
+    // the raw arguments are those of the constructor
+    EXPECT_EQ(p.raw_args().begin(), defaults.argv());
+    const int indices[] = {LEVEL, NAME, VERBOSE, LEVEL, VERBOSE, LEVEL};
+    ASSERT_EQ(p.opts_args().end() - p.opts_args().begin(), (int)C4_COUNTOF(indices));
+    for(size_t i = 0; i < C4_COUNTOF(indices); ++i)
+        EXPECT_EQ(p.opts_args()[i].index(), indices[i]) << i;
+    check_lists(p);
+}
+
+TEST(append, same_as_parsing_all_at_once)
+{
+    Args a({"-v", "-l1", "-nfoo"});
+    Args b({"--level=2", "-vv"});
+    Args c({"-n", "bar", "-l3"});
+    Args all({"-v", "-l1", "-nfoo", "--level=2", "-vv", "-n", "bar", "-l3"});
+    auto expected = c4::opt::make_parser(common_usage, all.argc(), all.argv());
+    auto p = c4::opt::make_parser(common_usage, a.argc(), a.argv());
+    p.append(b.argc(), b.argv());
+    p.append(c.argc(), c.argv());
+    ASSERT_EQ(p.parser.optionsCount(), expected.parser.optionsCount());
+    for(int i = 0; i < expected.parser.optionsCount(); ++i)
+    {
+        EXPECT_EQ(p.opts_args()[i].index(), expected.opts_args()[i].index()) << i;
+        EXPECT_STREQ(p.opts_args()[i].arg, expected.opts_args()[i].arg) << i;
+    }
+    for(int i = 0; i < (int)p.num_opts; ++i)
+        EXPECT_EQ(p[i].count(), expected[i].count()) << i;
+    check_lists(p);
+}
+
+TEST(append, spec)
+{
+    c4::opt::RuntimeSpec rs(common_usage);
+    Args a({"--level=1"});
+    Args b({"--level=2", "--name=x", "file"});
+    auto p = c4::opt::make_parser(rs.spec(), a.argc(), a.argv());
+    EXPECT_TRUE(p.append(b.argc(), b.argv()));
+    EXPECT_EQ(p[LEVEL].count(), 2);
+    EXPECT_STREQ(p[LEVEL].last()->arg, "2");
+    EXPECT_STREQ(p(NAME), "x");
+    EXPECT_STREQ(p.posn_args()[0], "file");
+    check_lists(p);
+}
+
+TEST(append, empty)
+{
+    Args b({"-v"});
+    auto p = c4::opt::make_parser(common_usage, 0, nullptr);
+    EXPECT_TRUE(p.append(0, nullptr));
+    EXPECT_EQ(p.parser.optionsCount(), 0);
+    EXPECT_TRUE(p.append(b.argc(), b.argv()));
+    EXPECT_TRUE(p.append(0, nullptr));
+    EXPECT_EQ(p[VERBOSE].count(), 1);
+    check_lists(p);
+}
+
+TEST(append, after_move)
+{
+    Args a({"-v"});
+    Args b({"-v", "-l2"});
+    auto p = c4::opt::make_parser(common_usage, a.argc(), a.argv());
+    c4::opt::Parser q(std::move(p));
+    EXPECT_TRUE(q.append(b.argc(), b.argv()));
+    EXPECT_EQ(q[VERBOSE].count(), 2);
+    EXPECT_EQ(q[LEVEL].count(), 1);
+    check_lists(q);
+}
+
+TEST(append, errors)
+{
+    Args a({"-v", "--level=1"});
+    Args b({"-v", "--level=x", "-v"});
+    c4::opt::ParseError err;
+    auto p = c4::opt::make_parser(common_usage, a.argc(), a.argv(), &err);
+    EXPECT_FALSE(err);
+    EXPECT_FALSE(p.append(b.argc(), b.argv(), &err));
+    EXPECT_EQ(err.code, (uint32_t)c4::opt::PARSE_ILLEGAL_ARGUMENT);
+    // the position in the appended arguments
+    EXPECT_EQ(err.argi, 1);
+    // the options before the error were kept
+    EXPECT_EQ(p[VERBOSE].count(), 2);
+    EXPECT_EQ(p[LEVEL].count(), 1);
+    check_lists(p);
+    // and the parser can still be appended to
+    Args c({"--level=3"});
+    EXPECT_TRUE(p.append(c.argc(), c.argv(), &err));
+    EXPECT_FALSE(err);
+    EXPECT_STREQ(p[LEVEL].last()->arg, "3");
+    check_lists(p);
+}
+
+TEST(append, amortized_growth)
+{
+    Args a({"-v", "--name=a"});
+    Args b({"-v", "--level=1"});
+    const int num_appends = 1000;
+    c4::opt::MemoryResourceCounting counter;
+    {
+        auto p = c4::opt::make_parser(common_usage, a.argc(), a.argv(), &counter);
+        counter.reset();
+        size_t num_grows = 0;
+        unsigned cap = p.stats.buffer_max;
+        for(int i = 0; i < num_appends; ++i)
+        {
+            ASSERT_TRUE(p.append(b.argc(), b.argv()));
+            if(p.stats.buffer_max != cap)
+            {
+                EXPECT_GE(p.stats.buffer_max, 2u * cap);
+                cap = p.stats.buffer_max;
+                ++num_grows;
+            }
+        }
+        // one allocation per doubling of the buffer, each of them
+        // giving the previous block back
+        EXPECT_ALLOCS(counter, num_grows);
+        EXPECT_LE(num_grows, 12u);
+        EXPECT_EQ(counter.counts().num_deallocs, num_grows);
+        EXPECT_EQ(p[VERBOSE].count(), 1 + num_appends);
+        EXPECT_EQ(p[LEVEL].count(), num_appends);
+        EXPECT_STREQ(p(NAME), "a");
+        EXPECT_EQ(p.parser.optionsCount(), 2 + 2 * num_appends);
+        check_lists(p);
+    }
+    EXPECT_EQ(counter.counts().curr, 0u);
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
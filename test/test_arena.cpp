@@ -0,0 +1,96 @@
+#include "test_allocs.hpp"
+#include "test_common.hpp"
+#include <c4/opt/arena.hpp>
+#include <c4/opt/compact.hpp>
+#include <c4/opt/view.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+using namespace test_common;
+
+TEST(arena, bump_and_reset)
+{
+    c4::opt::MemoryResourceCounting upstream;
+    c4::opt::MemoryResourceArena arena(256, &upstream);
+    void *a = arena.allocate(10, 1);
+    void *b = arena.allocate(16, 16);
+    EXPECT_EQ(((uintptr_t)b & 15u), 0u);
+    EXPECT_GT((char*)b, (char*)a);
+    EXPECT_ALLOCS(upstream, 1);
+    // the last allocation is given back; others are not
+    arena.deallocate(b, 16, 16);
+    EXPECT_EQ(arena.allocate(16, 16), b);
+    arena.deallocate(a, 10, 1);
+    // grow the last allocation in place
+    EXPECT_EQ(arena.reallocate(b, 16, 64, 16), b);
+    // larger than a block
+    void *big = arena.allocate(1000, 8);
+    EXPECT_NE(big, nullptr);
+    EXPECT_ALLOCS(upstream, 2);
+    EXPECT_EQ(arena.num_blocks(), 2u);
+    size_t cap = arena.capacity();
+    arena.reset();
+    EXPECT_EQ(arena.used(), 0u);
+    // the blocks are reused
+    EXPECT_EQ(arena.allocate(10, 1), a);
+    EXPECT_EQ(arena.allocate(1000, 8), big);
+    EXPECT_ALLOCS(upstream, 2);
+    EXPECT_EQ(arena.capacity(), cap);
+    arena.release();
+    EXPECT_EQ(upstream.counts().num_deallocs, 2u);
+    EXPECT_EQ(arena.num_blocks(), 0u);
+}
+
+TEST(arena, external_buffer)
+{
+    alignas(16) char buf[512];
+    c4::opt::MemoryResourceArena arena(c4::substr(buf, sizeof(buf)), /*upstream*/nullptr);
+    char *a = (char*) arena.allocate(100, 8);
+    EXPECT_GE(a, buf);
+    EXPECT_LE(a + 100, buf + sizeof(buf));
+    EXPECT_EQ(arena.num_blocks(), 0u);
+    arena.reset();
+    EXPECT_EQ(arena.allocate(100, 8), a);
+}
+
+TEST(arena, all_parser_memory_comes_from_the_resource)
+{
+    Args args({"-vv", "-l1", "--level=2", "--name", "foo", "file"});
+    std::vector<c4::csubstr> tokens;
+    for(auto const& s : args.sbuf)
+        tokens.emplace_back(s.data(), s.size());
+    c4::opt::MemoryResourceCounting upstream;
+    c4::opt::MemoryResourceArena arena(4096, &upstream);
+    const char *first = nullptr;
+    for(int rep = 0; rep < 3; ++rep)
+    {
+        c4::opt::MemoryResourceCounting::Scope global;
+        {
+            c4::opt::RuntimeSpec rs(common_usage, &arena);
+            auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv(), &arena);
+            EXPECT_EQ(p[VERBOSE].count(), 2);
+            EXPECT_STREQ(p(NAME), "foo");
+            auto ps = c4::opt::make_parser(rs.spec(), args.argc(), args.argv(), &arena);
+            EXPECT_STREQ(ps(LEVEL), "1");
+            c4::opt::CompactParser cp(rs.spec(), args.argc(), args.argv(), &arena);
+            EXPECT_EQ(cp.count(LEVEL), 2);
+            c4::opt::ViewParser vp(rs.spec(), {tokens.data(), tokens.size()}, c4::opt::PARSE_POSIX, &arena);
+            EXPECT_EQ(vp.count(LEVEL), 2);
+            if(rep == 0)
+                first = (const char*) p.options;
+            else
+                EXPECT_EQ((const char*) p.options, first);
+        }
+        EXPECT_ALLOCS(global, 0);
+        EXPECT_GT(arena.used(), 0u);
+        arena.reset();
+    }
+    // the arena got its memory once, and reused it after each reset
+    EXPECT_ALLOCS(upstream, 1);
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
@@ -0,0 +1,120 @@
+#include "test_common.hpp"
+#include <c4/opt/bind.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+struct Config
+{
+    bool verbose;
+    int level;
+    unsigned count;
+    double ratio;
+    const char *name;
+    c4::csubstr path;
+    int debug;
+};
+
+static const auto config_opts = c4::opt::bind<Config>(
+    "USAGE: app [options]\n\nOptions:",
+    C4OPT_FIELD(Config, verbose, "v", "verbose", option::Arg::Optional, "  -v, --verbose[=<bool>]  \tBe verbose."),
+    C4OPT_FIELD(Config, level  , "l", "level"  , c4::opt::integer , "  -l <val>, --level=<val>  \tSet the level."),
+    C4OPT_FIELD(Config, count  , "c", "count"  , c4::opt::required, "  -c <val>, --count=<val>  \tSet the count."),
+    C4OPT_FIELD(Config, ratio  , "r", "ratio"  , c4::opt::required, "  -r <val>, --ratio=<val>  \tSet the ratio."),
+    C4OPT_FIELD(Config, name   , "n", "name"   , c4::opt::nonempty, "  -n <val>, --name=<val>  \tSet the name."),
+    C4OPT_FIELD(Config, path   , "p", "path"   , c4::opt::required, "  -p <val>, --path=<val>  \tSet the path."),
+    C4OPT_FIELD(Config, debug  , "d", "debug"  , c4::opt::none    , "  -d, --debug  \tIncrease the debug level."));
+
+TEST(bind, descriptors)
+{
+    ASSERT_EQ(config_opts.num_usage_entries(), 9u);
+    EXPECT_EQ(config_opts.usage[0].index, 0u);
+    EXPECT_STREQ(config_opts.usage[0].shortopt, "");
+    EXPECT_EQ(config_opts.usage[0].check_arg, &c4::opt::unknown);
+    EXPECT_EQ(config_opts.usage[1].index, 1u);
+    EXPECT_STREQ(config_opts.usage[1].longopt, "verbose");
+    EXPECT_EQ(config_opts.usage[7].index, 7u);
+    EXPECT_STREQ(config_opts.usage[7].longopt, "debug");
+    EXPECT_EQ(config_opts.usage[8].shortopt, nullptr);
+}
+
+TEST(bind, parse)
+{
+    Config cfg = {};
+    cfg.name = "default";
+    Args args({"-v", "--level=-3", "-c", "42", "--ratio=0.5", "-p", "/tmp", "-ddd", "--debug"});
+    auto res = config_opts.parse(&cfg, args.argc(), args.argv());
+    ASSERT_TRUE(res);
+    EXPECT_EQ(res.num_posn, 0);
+    EXPECT_TRUE(cfg.verbose);
+    EXPECT_EQ(cfg.level, -3);
+    EXPECT_EQ(cfg.count, 42u);
+    EXPECT_EQ(cfg.ratio, 0.5);
+    EXPECT_STREQ(cfg.name, "default"); // untouched
+    EXPECT_EQ(cfg.path, "/tmp");
+    EXPECT_EQ(cfg.path.str, args.cbuf[6]); // no copies
+    EXPECT_EQ(cfg.debug, 4);
+}
+
+TEST(bind, last_wins)
+{
+    Config cfg = {};
+    Args args({"-l", "1", "-l", "2", "--name=a", "--name=b", "-v", "--verbose=false"});
+    ASSERT_TRUE(config_opts.parse(&cfg, args.argc(), args.argv()));
+    EXPECT_EQ(cfg.level, 2);
+    EXPECT_STREQ(cfg.name, "b");
+    EXPECT_FALSE(cfg.verbose);
+}
+
+TEST(bind, positional)
+{
+    Config cfg = {};
+    Args args({"-l", "1", "pos0", "pos1"});
+    auto res = config_opts.parse(&cfg, args.argc(), args.argv());
+    ASSERT_TRUE(res);
+    ASSERT_EQ(res.num_posn, 2);
+    EXPECT_STREQ(res.posn[0], "pos0");
+    EXPECT_STREQ(res.posn[1], "pos1");
+    // in POSIX mode, options after positionals are not parsed
+    Args args2({"pos0", "-l", "2"});
+    res = config_opts.parse(&cfg, args2.argc(), args2.argv());
+    ASSERT_TRUE(res);
+    EXPECT_EQ(cfg.level, 1);
+    EXPECT_EQ(res.num_posn, 3);
+    // ... but they are in GNU mode
+    res = config_opts.parse(&cfg, args2.argc(), args2.argv(), /*gnu*/true);
+    ASSERT_TRUE(res);
+    EXPECT_EQ(cfg.level, 2);
+    ASSERT_EQ(res.num_posn, 1);
+    EXPECT_STREQ(res.posn[0], "pos0");
+}
+
+TEST(bind, errors)
+{
+    Config cfg = {};
+    {
+        Args args({"--unknown"});
+        EXPECT_FALSE(config_opts.parse(&cfg, args.argc(), args.argv()));
+    }
+    {
+        Args args({"-c", "-1"});
+        EXPECT_FALSE(config_opts.parse(&cfg, args.argc(), args.argv()));
+    }
+    {
+        Args args({"-r", "1.5x"});
+        EXPECT_FALSE(config_opts.parse(&cfg, args.argc(), args.argv()));
+    }
+    {
+        Args args({"--verbose=maybe"});
+        EXPECT_FALSE(config_opts.parse(&cfg, args.argc(), args.argv()));
+    }
+    {
+        Args args({"-l", "99999999999"}); // does not fit int
+        EXPECT_FALSE(config_opts.parse(&cfg, args.argc(), args.argv()));
+    }
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
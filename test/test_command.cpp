@@ -0,0 +1,427 @@
+#include "test_allocs.hpp"
+#include "test_common.hpp"
+#include <c4/opt/command.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+typedef enum {
+    UNKNOWN,
+    HELP,
+    VERBOSE,
+    ALL,
+    MESSAGE,
+    FETCH,
+    TAGS,
+} CommandIndex_e;
+static const option::Descriptor root_usage[] =
+{
+    {UNKNOWN, 0, ""  , ""       , c4::opt::unknown , "USAGE: tool [options] <command> [<args>]\n\nOptions:" },
+    {HELP   , 0, "h" , "help"   , c4::opt::none    , "  -h, --help  \tPrint usage and exit." },
+    {VERBOSE, 0, "v" , "verbose", c4::opt::none    , "  -v, --verbose  \tBe verbose." },
+    {0,0,0,0,0,0}
+};
+static const option::Descriptor commit_usage[] =
+{
+    {HELP   , 0, "h" , "help"   , c4::opt::none    , "USAGE: tool commit [options] <files>\n\nOptions:\n  -h, --help  \tPrint usage and exit." },
+    {ALL    , 0, "a" , "all"    , c4::opt::none    , "  -a, --all  \tCommit all the changes." },
+    {MESSAGE, 0, "m" , "message", c4::opt::required, "  -m <msg>, --message=<msg>  \tThe commit message." },
+    {0,0,0,0,0,0}
+};
+static const option::Descriptor add_usage[] =
+{
+    {UNKNOWN, 0, ""  , ""       , c4::opt::unknown , "USAGE: tool remote add [options] <name> <url>\n\nOptions:" },
+    {FETCH  , 0, "f" , "fetch"  , c4::opt::none    , "  -f, --fetch  \tFetch after adding." },
+    {TAGS   , 0, ""  , "tags"   , c4::opt::none    , "  --tags  \tImport the tags." },
+    {0,0,0,0,0,0}
+};
+
+static const c4::opt::RuntimeSpec add_spec(add_usage);
+
+static const c4::opt::Command remote_cmds[] = {
+    {"add", add_usage, &add_spec.spec(), nullptr, nullptr, "Add a remote"},
+    {"remove", nullptr, nullptr, nullptr, nullptr, "Remove a remote"},
+    {"rename", nullptr, nullptr, nullptr, nullptr, nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+static const c4::opt::Command tool_cmds[] = {
+    {"remote", root_usage, nullptr, remote_cmds, nullptr, "Manage the remotes"},
+    {"rebase", nullptr, nullptr, nullptr, nullptr, "Rebase the branch"},
+    {"commit", commit_usage, nullptr, nullptr, nullptr, "Record the changes"},
+    {"config", nullptr, nullptr, nullptr, nullptr, "Get and set options"},
+    {"co", commit_usage, nullptr, nullptr, nullptr, "Same as commit"},
+    {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+static const c4::opt::Command tool = {"tool", root_usage, nullptr, tool_cmds, nullptr, nullptr};
+// the same tool, with the trie of its commands
+static const c4::opt::CommandTrie tool_trie(tool_cmds);
+static const c4::opt::Command tool_with_trie = {"tool", root_usage, nullptr, tool_cmds, &tool_trie, nullptr};
+
+std::vector<std::string> posn(c4::opt::CompactParser const& p)
+{
+    std::vector<std::string> v;
+    for(const char *a : p.posn_args())
+        v.emplace_back(a);
+    return v;
+}
+
+TEST(command, trie)
+{
+    c4::opt::CommandTrie trie(tool_cmds);
+    EXPECT_EQ(trie.num_commands(), 5u);
+    EXPECT_EQ(trie.commands(), tool_cmds);
+    EXPECT_EQ(trie.find("remote"), 0);
+    EXPECT_EQ(trie.find("rebase"), 1);
+    EXPECT_EQ(trie.find("commit"), 2);
+    EXPECT_EQ(trie.find("config"), 3);
+    EXPECT_EQ(trie.find("co"), 4);
+    EXPECT_EQ(trie.find("c"), c4::opt::CommandTrie::npos);
+    EXPECT_EQ(trie.find("rem"), c4::opt::CommandTrie::npos);
+    EXPECT_EQ(trie.find("remotes"), c4::opt::CommandTrie::npos);
+    EXPECT_EQ(trie.find(""), c4::opt::CommandTrie::npos);
+    // abbreviations
+    EXPECT_EQ(trie.find("rem", 2), 0);
+    EXPECT_EQ(trie.find("reb", 2), 1);
+    EXPECT_EQ(trie.find("re", 2), c4::opt::CommandTrie::ambiguous);
+    EXPECT_EQ(trie.find("com", 2), 2);
+    EXPECT_EQ(trie.find("con", 2), 3);
+    EXPECT_EQ(trie.find("co", 2), 4); // the exact name wins
+    EXPECT_EQ(trie.find("r", 2), c4::opt::CommandTrie::npos); // too short
+    EXPECT_EQ(trie.find("rem", 4), c4::opt::CommandTrie::npos);
+    EXPECT_EQ(trie.find("rex", 2), c4::opt::CommandTrie::npos);
+    // the nodes are shared by the common prefixes
+    EXPECT_EQ(trie.num_nodes(), 1u + 6u + 4u + 6u + 4u); // remote, (re)base, commit, (co)nfig
+    // moved from
+    c4::opt::CommandTrie moved(std::move(trie));
+    EXPECT_EQ(moved.find("config"), 3);
+    EXPECT_EQ(trie.find("config"), c4::opt::CommandTrie::npos);
+    // no commands
+    c4::opt::CommandTrie none(nullptr);
+    EXPECT_EQ(none.num_commands(), 0u);
+    EXPECT_EQ(none.find("x"), c4::opt::CommandTrie::npos);
+    EXPECT_EQ(none.find("", 1), c4::opt::CommandTrie::npos);
+}
+
+TEST(command, trie_matches_linear_search)
+{
+    std::mt19937 rng(4321);
+    std::vector<std::string> names;
+    for(int i = 0; i < 500; ++i)
+    {
+        std::string s(1 + rng() % 6, 'a');
+        for(char &c : s)
+            c = "abc-"[rng() % 4];
+        if(std::find(names.begin(), names.end(), s) == names.end())
+            names.push_back(s);
+    }
+    std::vector<c4::opt::Command> cmds;
+    for(auto const& n : names)
+        cmds.push_back({n.c_str(), nullptr, nullptr, nullptr, nullptr, nullptr});
+    cmds.push_back({nullptr, nullptr, nullptr, nullptr, nullptr, nullptr});
+    c4::opt::CommandTrie trie(cmds.data());
+    for(int t = 0; t < 2000; ++t)
+    {
+        std::string q(rng() % 7, 'a');
+        for(char &c : q)
+            c = "abc-"[rng() % 4];
+        // the one with the exact name, or the only one with the prefix
+        int32_t exact = -1, prefixed = -1;
+        size_t num_prefixed = 0;
+        for(size_t i = 0; i < names.size(); ++i)
+        {
+            if(names[i] == q)
+                exact = (int32_t)i;
+            if(names[i].compare(0, q.size(), q) == 0)
+            {
+                ++num_prefixed;
+                prefixed = (int32_t)i;
+            }
+        }
+        c4::csubstr cq(q.data(), q.size());
+        EXPECT_EQ(trie.find(cq), exact) << q;
+        int32_t expected = exact >= 0 ? exact : (q.size() < 2 || ! num_prefixed ? -1 : (num_prefixed == 1 ? prefixed : -2));
+        EXPECT_EQ(trie.find(cq, 2), expected) << q;
+    }
+}
+
+TEST(command, dispatch)
+{
+    Args args({"-v", "commit", "-a", "-m", "msg", "file1", "-v"});
+    c4::opt::ParseError err;
+    c4::opt::CommandParser p(tool, args.argc(), args.argv(), &err);
+    ASSERT_FALSE(err);
+    ASSERT_EQ(p.depth(), 2u);
+    EXPECT_EQ(&p.command(0), &tool);
+    EXPECT_EQ(&p.command(), &tool_cmds[2]);
+    EXPECT_EQ(p.name_argi(0), -1);
+    EXPECT_EQ(p.name_argi(1), 1);
+    EXPECT_EQ(p.options(0).count(VERBOSE), 1);
+    EXPECT_EQ(p.options().count(ALL), 1);
+    EXPECT_STREQ(p.options()(MESSAGE), "msg");
+    // POSIX: the first positional argument ends the options
+    EXPECT_EQ(posn(p.options()), (std::vector<std::string>{"file1", "-v"}));
+    // the positional arguments of a level start with the next command
+    EXPECT_EQ(posn(p.options(0)).front(), "commit");
+    EXPECT_TRUE(p.compiled(0));
+    EXPECT_TRUE(p.compiled(1));
+}
+
+TEST(command, nested)
+{
+    Args args({"remote", "-v", "add", "--fetch", "origin", "url"});
+    c4::opt::CommandParser p(tool, args.argc(), args.argv());
+    ASSERT_EQ(p.depth(), 3u);
+    EXPECT_STREQ(p.command(1).name, "remote");
+    EXPECT_STREQ(p.command().name, "add");
+    EXPECT_EQ(p.name_argi(1), 0);
+    EXPECT_EQ(p.name_argi(2), 2);
+    EXPECT_EQ(p.options(1).count(VERBOSE), 1);
+    EXPECT_EQ(p.options().count(FETCH), 1);
+    EXPECT_EQ(p.options().count(TAGS), 0);
+    EXPECT_EQ(posn(p.options()), (std::vector<std::string>{"origin", "url"}));
+    // add has a spec, which is used as it is
+    EXPECT_TRUE(p.compiled(1));
+    EXPECT_FALSE(p.compiled(2));
+    // moved
+    c4::opt::CommandParser moved(std::move(p));
+    EXPECT_EQ(moved.depth(), 3u);
+    EXPECT_EQ(moved.options().count(FETCH), 1);
+    EXPECT_EQ(p.depth(), 0u);
+}
+
+TEST(command, path_ends_without_a_name)
+{
+    {
+        Args args({"-v"});
+        c4::opt::CommandParser p(tool, args.argc(), args.argv());
+        EXPECT_EQ(p.depth(), 1u);
+        EXPECT_EQ(p.options().count(VERBOSE), 1);
+    }
+    {
+        Args args({"remote", "-v"});
+        c4::opt::CommandParser p(tool, args.argc(), args.argv());
+        EXPECT_EQ(p.depth(), 2u);
+        EXPECT_STREQ(p.command().name, "remote");
+    }
+    {
+        c4::opt::CommandParser p(tool, 0, nullptr);
+        EXPECT_EQ(p.depth(), 1u);
+    }
+}
+
+TEST(command, commands_without_options)
+{
+    Args args({"config", "key", "value"});
+    c4::opt::CommandParser p(tool, args.argc(), args.argv());
+    ASSERT_EQ(p.depth(), 2u);
+    EXPECT_EQ(posn(p.options()), (std::vector<std::string>{"key", "value"}));
+    Args bad({"config", "-x"});
+    c4::opt::ParseError err;
+    c4::opt::CommandParser pb(tool, bad.argc(), bad.argv(), &err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_UNKNOWN_OPTION);
+    EXPECT_EQ(err.argi, 1);
+}
+
+TEST(command, mode_of_the_selected_command)
+{
+    Args args({"commit", "file", "-a"});
+    c4::opt::CommandRules rules;
+    rules.mode = c4::opt::PARSE_GNU;
+    c4::opt::CommandParser gnu(tool, args.argc(), args.argv(), rules);
+    EXPECT_EQ(gnu.options().count(ALL), 1);
+    EXPECT_EQ(posn(gnu.options()), (std::vector<std::string>{"file"}));
+    c4::opt::CommandParser posix(tool, args.argc(), args.argv());
+    EXPECT_EQ(posix.options().count(ALL), 0);
+    EXPECT_EQ(posn(posix.options()), (std::vector<std::string>{"file", "-a"}));
+    // the levels with subcommands are always POSIX
+    Args args2({"remote", "add", "-f"});
+    c4::opt::CommandParser p2(tool, args2.argc(), args2.argv(), rules);
+    ASSERT_EQ(p2.depth(), 3u);
+    EXPECT_EQ(p2.options().count(FETCH), 1);
+}
+
+TEST(command, abbreviations)
+{
+    c4::opt::CommandRules rules;
+    rules.min_abbr_len = 3;
+    Args args({"rem", "ad", "x"});
+    c4::opt::ParseError err;
+    c4::opt::CommandParser p(tool, args.argc(), args.argv(), rules, &err);
+    // "ad" is too short
+    EXPECT_EQ(err.code, c4::opt::PARSE_UNKNOWN_COMMAND);
+    EXPECT_EQ(err.argi, 1);
+    ASSERT_EQ(p.depth(), 2u);
+    EXPECT_STREQ(p.command().name, "remote");
+    rules.min_abbr_len = 2;
+    c4::opt::CommandParser p2(tool, args.argc(), args.argv(), rules, &err);
+    EXPECT_FALSE(err);
+    EXPECT_STREQ(p2.command().name, "add");
+    Args amb({"-v", "re"});
+    c4::opt::CommandParser p3(tool, amb.argc(), amb.argv(), rules, &err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_AMBIGUOUS_COMMAND);
+    EXPECT_EQ(err.argi, 1);
+    char buf[64];
+    c4::opt::format_error(c4::substr(buf, sizeof(buf)), err, root_usage, amb.argc(), amb.argv());
+    EXPECT_STREQ(buf, "Ambiguous command 're'");
+}
+
+TEST(command, lookup_with_a_trie)
+{
+    c4::opt::ParseError err;
+    {
+        Args args({"-v", "commit", "-a", "-m", "msg", "file1"});
+        c4::opt::CommandParser p(tool_with_trie, args.argc(), args.argv(), &err);
+        ASSERT_FALSE(err);
+        ASSERT_EQ(p.depth(), 2u);
+        EXPECT_EQ(&p.command(), &tool_cmds[2]);
+        EXPECT_EQ(p.name_argi(1), 1);
+        EXPECT_EQ(p.options().count(ALL), 1);
+    }
+    {
+        // the level below has no trie, and is scanned
+        c4::opt::CommandRules rules;
+        rules.min_abbr_len = 2;
+        Args args({"rem", "ad", "x"});
+        c4::opt::CommandParser p(tool_with_trie, args.argc(), args.argv(), rules, &err);
+        EXPECT_FALSE(err);
+        ASSERT_EQ(p.depth(), 3u);
+        EXPECT_STREQ(p.command().name, "add");
+        Args amb({"-v", "re"});
+        c4::opt::CommandParser p2(tool_with_trie, amb.argc(), amb.argv(), rules, &err);
+        EXPECT_EQ(err.code, c4::opt::PARSE_AMBIGUOUS_COMMAND);
+        EXPECT_EQ(err.argi, 1);
+    }
+    {
+        Args args({"-v", "comit"});
+        c4::opt::CommandParser p(tool_with_trie, args.argc(), args.argv(), &err);
+        EXPECT_EQ(err.code, c4::opt::PARSE_UNKNOWN_COMMAND);
+        EXPECT_EQ(err.argi, 1);
+        EXPECT_EQ(p.depth(), 1u);
+    }
+}
+
+TEST(command, errors)
+{
+    c4::opt::ParseError err;
+    {
+        Args args({"-v", "comit", "-a"});
+        c4::opt::CommandParser p(tool, args.argc(), args.argv(), &err);
+        EXPECT_EQ(err.code, c4::opt::PARSE_UNKNOWN_COMMAND);
+        EXPECT_EQ(err.argi, 1);
+        EXPECT_EQ(p.depth(), 1u);
+        char buf[64];
+        c4::opt::format_error(c4::substr(buf, sizeof(buf)), err, root_usage, args.argc(), args.argv());
+        EXPECT_STREQ(buf, "Unknown command 'comit'");
+    }
+    {
+        // the position is in the whole argv
+        Args args({"remote", "add", "--fetch", "--bogus"});
+        c4::opt::CommandParser p(tool, args.argc(), args.argv(), &err);
+        EXPECT_EQ(err.code, c4::opt::PARSE_UNKNOWN_OPTION);
+        EXPECT_EQ(err.argi, 3);
+        EXPECT_EQ(p.depth(), 3u);
+    }
+    {
+        Args args({"commit", "-m"});
+        c4::opt::CommandParser p(tool, args.argc(), args.argv(), &err);
+        EXPECT_EQ(err.code, c4::opt::PARSE_ILLEGAL_ARGUMENT);
+        EXPECT_EQ(err.argi, 1);
+    }
+    {
+        // without an unknown descriptor, unknown options are dropped
+        Args args({"commit", "-a", "--bogus"});
+        c4::opt::CommandParser p(tool, args.argc(), args.argv(), &err);
+        EXPECT_FALSE(err);
+        EXPECT_EQ(p.options().count(ALL), 1);
+    }
+}
+
+/** a tool with num_commands commands, each with num_options options */
+struct BigTool
+{
+    std::vector<std::string> names;
+    std::vector<std::vector<option::Descriptor>> usages;
+    std::vector<c4::opt::Command> cmds;
+    c4::opt::Command root;
+    c4::opt::CommandTrie const* trie = nullptr;
+    BigTool(size_t num_commands, size_t num_options)
+    {
+        names.reserve(num_commands + num_options);
+        for(size_t i = 0; i < num_commands; ++i)
+            names.push_back("cmd" + std::to_string(i));
+        for(size_t j = 0; j < num_options; ++j)
+            names.push_back("opt" + std::to_string(j));
+        usages.resize(num_commands);
+        for(size_t i = 0; i < num_commands; ++i)
+        {
+            // only the selected command is small
+            size_t n = i == 7 ? 3 : num_options;
+            for(size_t j = 0; j < n; ++j)
+                usages[i].push_back({(unsigned)j, 0, "", names[num_commands + j].c_str(), c4::opt::none, ""});
+            usages[i].push_back({0, 0, 0, 0, 0, 0});
+            cmds.push_back({names[i].c_str(), usages[i].data(), nullptr, nullptr, nullptr, nullptr});
+        }
+        cmds.push_back({nullptr, nullptr, nullptr, nullptr, nullptr, nullptr});
+        root = {"big", root_usage, nullptr, cmds.data(), nullptr, nullptr};
+    }
+    ~BigTool() { delete trie; }
+    void build_trie()
+    {
+        trie = new c4::opt::CommandTrie(cmds.data());
+        root.trie = trie;
+    }
+};
+
+TEST(command, only_the_selected_command_is_compiled)
+{
+    BigTool small(80, 3), big(80, 500);
+    Args args({"-v", "cmd7", "--opt1", "arg"});
+    size_t bytes[2];
+    for(int i = 0; i < 2; ++i)
+    {
+        c4::opt::MemoryResourceCounting counter;
+        {
+            c4::opt::CommandParser p(i ? big.root : small.root, args.argc(), args.argv(), nullptr, &counter);
+            ASSERT_EQ(p.depth(), 2u);
+            EXPECT_EQ(p.options().count(1), 1);
+        }
+        EXPECT_EQ(counter.counts().curr, 0u);
+        bytes[i] = counter.counts().bytes;
+    }
+    // the other commands have 500 options in the big tool, yet nothing
+    // is spent on them
+    EXPECT_EQ(bytes[0], bytes[1]);
+}
+
+TEST(command, finding_a_command_does_not_allocate)
+{
+    BigTool few(8, 3), many(800, 3), many_with_trie(800, 3);
+    many_with_trie.build_trie();
+    c4::opt::Command const* roots[] = {&few.root, &many.root, &many_with_trie.root};
+    Args args({"-v", "cmd7", "--opt1", "arg"});
+    c4::opt::AllocCounts counts[3];
+    for(int i = 0; i < 3; ++i)
+    {
+        c4::opt::MemoryResourceCounting counter;
+        {
+            c4::opt::CommandParser p(*roots[i], args.argc(), args.argv(), nullptr, &counter);
+            ASSERT_EQ(p.depth(), 2u);
+            EXPECT_STREQ(p.command().name, "cmd7");
+        }
+        counts[i] = counter.counts();
+    }
+    // nothing depends on the number of commands at the level, nor on
+    // how they are looked up
+    for(int i = 1; i < 3; ++i)
+    {
+        EXPECT_EQ(counts[0].num_allocs, counts[i].num_allocs) << i;
+        EXPECT_EQ(counts[0].bytes, counts[i].bytes) << i;
+    }
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
@@ -0,0 +1,93 @@
+#ifndef _C4_OPT_TEST_COMMON_HPP_
+#define _C4_OPT_TEST_COMMON_HPP_
+
+/** @file test_common.hpp the command line holder and the descriptor
+ * table shared by the tests */
+
+#include <c4/opt/opt.hpp>
+#include <c4/span.hpp>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+/** Owns the tokens of a command line, and gives them both as a
+ * null-terminated argv and as views (see tokens()). The views are
+ * slices of a single buffer where the tokens are not separated, so
+ * that they are not null-terminated. */
+struct Args
+{
+    std::vector<std::string> sbuf;
+    std::vector<const char*> cbuf;  ///< argv, with a null after the last token
+    std::string buf;                ///< the tokens, one after the other
+    std::vector<c4::csubstr> tbuf;  ///< the slices of buf
+
+    Args(std::initializer_list<const char*> il) : sbuf(il.begin(), il.end()) { _init(); }
+    Args(std::vector<std::string> tokens) : sbuf(std::move(tokens)) { _init(); }
+    // the pointers are into the strings, which may be moved inline
+    Args(Args &&that) : sbuf(std::move(that.sbuf)) { _init(); }
+    Args(Args const&) = delete;
+
+    void _init()
+    {
+        for(auto const& s : sbuf)
+        {
+            cbuf.push_back(s.c_str());
+            buf += s;
+        }
+        cbuf.push_back(nullptr);
+        size_t pos = 0;
+        for(auto const& s : sbuf)
+        {
+            tbuf.emplace_back(buf.data() + pos, s.size());
+            pos += s.size();
+        }
+    }
+
+    int argc() const { return (int)sbuf.size(); }
+    const char ** argv() { return cbuf.data(); }
+    c4::cspan<c4::csubstr> tokens() const { return {tbuf.data(), tbuf.size()}; }
+    /** whether s points into the buffer of the tokens */
+    bool in_tokens(c4::csubstr s) const { return s.str >= buf.data() && s.str + s.len <= buf.data() + buf.size(); }
+};
+
+
+/** the descriptors shared by the tests. Use with
+ * `using namespace test_common;` (test_spec.cpp and test_command.cpp
+ * have tables of their own, with other indices of the same names) */
+namespace test_common {
+
+typedef enum {
+    UNKNOWN,
+    HELP,
+    LEVEL,
+    NAME,
+    VERBOSE,
+    NUM_COMMON_OPTIONS  ///< the index of the first option of a test extending the table
+} CommonIndex_e;
+
+/** the descriptors of common_usage, without the terminator, to
+ * extend it in a test:
+ * @code
+ * typedef enum { RATIO = NUM_COMMON_OPTIONS } MyIndex_e;
+ * static const option::Descriptor my_usage[] = {
+ *     C4OPT_TEST_COMMON_DESCRIPTORS,
+ *     {RATIO, 0, "r", "ratio", c4::opt::required, "  -r <val>, --ratio=<val>  \tSet the ratio."},
+ *     {0,0,0,0,0,0}
+ * };
+ * @endcode */
+#define C4OPT_TEST_COMMON_DESCRIPTORS                                                                                \
+    {::test_common::UNKNOWN, 0, ""  , ""       , c4::opt::unknown , "USAGE: app [options]\n\nOptions:" },            \
+    {::test_common::HELP   , 0, "h" , "help"   , c4::opt::none    , "  -h, --help  \tPrint usage and exit." },       \
+    {::test_common::LEVEL  , 0, "l" , "level"  , c4::opt::integer , "  -l <val>, --level=<val>  \tSet the level." }, \
+    {::test_common::NAME   , 0, "n" , "name"   , c4::opt::required, "  -n <val>, --name=<val>  \tSet the name." },   \
+    {::test_common::VERBOSE, 0, "v" , "verbose", c4::opt::none    , "  -v, --verbose  \tBe verbose." }
+
+static const option::Descriptor common_usage[] =
+{
+    C4OPT_TEST_COMMON_DESCRIPTORS,
+    {0,0,0,0,0,0}
+};
+
+} // namespace test_common
+
+#endif /* _C4_OPT_TEST_COMMON_HPP_ */
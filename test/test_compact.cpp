@@ -0,0 +1,277 @@
+#include "test_common.hpp"
+#include <c4/opt/arena.hpp>
+#include <c4/opt/compact.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+using namespace test_common;
+
+TEST(compact, record_size)
+{
+    EXPECT_EQ(sizeof(c4::opt::Occurrence), 16u);
+}
+
+TEST(compact, same_results_as_parser)
+{
+    Args args({"-vv", "-l1", "--level=2", "-l", "3", "--level", "4", "-n=", "--name=foo", "-vn", "bar", "file0", "file1"});
+    auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv());
+    c4::opt::CompactParser cp(common_usage, C4_COUNTOF(common_usage), args.argc(), args.argv());
+    ASSERT_EQ(cp.num_occurrences(), (size_t)p.parser.optionsCount());
+    for(int i : {HELP, LEVEL, NAME, VERBOSE})
+    {
+        EXPECT_EQ(cp.count(i), p[i].count()) << i;
+        EXPECT_EQ((bool)cp[i], (bool)p[i]) << i;
+        std::vector<std::string> expected, actual;
+        for(auto const& o : p.opts(i))
+            expected.emplace_back(std::string(o.name, o.namelen) + "=" + (o.arg ? o.arg : "(null)"));
+        for(option::Option o : cp.opts(i))
+            actual.emplace_back(std::string(o.name, o.namelen) + "=" + (o.arg ? o.arg : "(null)"));
+        EXPECT_EQ(actual, expected) << i;
+    }
+    size_t pos = 0;
+    for(option::Option o : cp.opts_args())
+    {
+        option::Option const& e = p.opts_args()[(int)pos];
+        EXPECT_EQ(o.desc, e.desc);
+        EXPECT_EQ(o.name, e.name);
+        EXPECT_EQ(o.namelen, e.namelen);
+        EXPECT_EQ(o.arg, e.arg);
+        ++pos;
+    }
+    EXPECT_EQ(pos, cp.num_occurrences());
+    EXPECT_STREQ(cp(LEVEL), "1");
+    EXPECT_STREQ(cp(NAME), "="); // short options take everything after the name
+    std::vector<std::string> posn(cp.posn_args().begin(), cp.posn_args().end());
+    EXPECT_EQ(posn, (std::vector<std::string>{"file0", "file1"}));
+}
+
+TEST(compact, records)
+{
+    Args args({"-vl", "7", "--name=x", "--level", "8"});
+    c4::opt::CompactParser cp(common_usage, C4_COUNTOF(common_usage), args.argc(), args.argv());
+    ASSERT_EQ(cp.num_occurrences(), 4u);
+    auto const* occ = cp.occurrences();
+    EXPECT_EQ(occ[0].argi, 0u); EXPECT_EQ(occ[0].offset, 1u); EXPECT_EQ(occ[0].desc, 4); EXPECT_EQ(occ[0].arg, c4::opt::OCC_ARG_NONE);
+    EXPECT_EQ(occ[1].argi, 0u); EXPECT_EQ(occ[1].offset, 2u); EXPECT_EQ(occ[1].desc, 2); EXPECT_EQ(occ[1].arg, c4::opt::OCC_ARG_SEPARATE);
+    EXPECT_EQ(occ[2].argi, 2u); EXPECT_EQ(occ[2].offset, 0u); EXPECT_EQ(occ[2].desc, 3); EXPECT_EQ(occ[2].arg, c4::opt::OCC_ARG_ATTACHED);
+    EXPECT_EQ(occ[3].argi, 3u); EXPECT_EQ(occ[3].offset, 0u); EXPECT_EQ(occ[3].desc, 2); EXPECT_EQ(occ[3].arg, c4::opt::OCC_ARG_SEPARATE);
+    EXPECT_EQ(occ[1].next, 3u);
+    EXPECT_EQ(occ[3].next, (uint32_t)c4::opt::Occurrence::npos);
+    EXPECT_EQ(cp.posn_args().begin(), cp.posn_args().end());
+}
+
+TEST(compact, spec)
+{
+    c4::opt::RuntimeSpec rs(common_usage);
+    Args args({"-v", "--level", "3", "-h", "file"});
+    c4::opt::CompactParser cp(rs.spec(), args.argc(), args.argv());
+    EXPECT_EQ(cp.count(VERBOSE), 1);
+    EXPECT_EQ(cp.count(HELP), 1);
+    EXPECT_EQ(cp.count(NAME), 0);
+    EXPECT_FALSE(cp[NAME]);
+    EXPECT_STREQ(cp(LEVEL), "3");
+}
+
+TEST(compact, errors)
+{
+    Args args({"-v", "-l", "abc"});
+    c4::opt::ParseError err;
+    c4::opt::CompactParser cp(common_usage, C4_COUNTOF(common_usage), args.argc(), args.argv(), &err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_ILLEGAL_ARGUMENT);
+    EXPECT_EQ(err.argi, 1);
+    EXPECT_EQ(err.offset, 1);
+    EXPECT_EQ(err.desc, 2);
+    EXPECT_EQ(cp.count(VERBOSE), 1);
+    c4::opt::ParseError merr;
+    EXPECT_FALSE(cp.check_mandatory({VERBOSE, NAME}, &merr));
+    EXPECT_EQ(merr.code, c4::opt::PARSE_MISSING_MANDATORY);
+    EXPECT_EQ(merr.desc, 3);
+}
+
+TEST(compact, too_many_descriptors)
+{
+    std::vector<option::Descriptor> usage(common_usage, common_usage + C4_COUNTOF(common_usage) - 1);
+    while(usage.size() < c4::opt::Occurrence::max_usage_entries)
+        usage.push_back({HELP, 0, "", "", c4::opt::none, nullptr});
+    usage.push_back({0,0,0,0,0,0});
+    Args args({"-v", "--name", "foo"});
+    c4::opt::ParseError err;
+    c4::opt::CompactParser cp(usage.data(), usage.size(), args.argc(), args.argv(), &err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_TOO_MANY_DESCRIPTORS);
+    EXPECT_EQ(err.argi, -1);
+    // nothing is parsed
+    EXPECT_EQ(cp.count(VERBOSE), 0);
+    EXPECT_EQ(cp.num_occurrences(), 0u);
+    char buf[64];
+    c4::opt::format_error(c4::substr(buf, sizeof(buf)), err, usage.data(), args.argc(), args.argv());
+    EXPECT_STREQ(buf, "Too many options in the usage");
+    // one less fits
+    usage.pop_back();
+    usage.pop_back();
+    usage.push_back({0,0,0,0,0,0});
+    c4::opt::CompactParser fits(usage.data(), usage.size(), args.argc(), args.argv(), &err);
+    EXPECT_FALSE(err);
+    EXPECT_EQ(fits.count(VERBOSE), 1);
+    EXPECT_EQ(fits.count(NAME), 1);
+}
+
+TEST(compact, memory_is_smaller)
+{
+    std::vector<std::string> sbuf;
+    for(int i = 0; i < 1000; ++i)
+    {
+        sbuf.emplace_back("-v");
+        sbuf.emplace_back("--level=" + std::to_string(i));
+    }
+    std::vector<const char*> argv;
+    for(auto const& s : sbuf)
+        argv.push_back(s.c_str());
+    c4::opt::CompactParser cp(common_usage, C4_COUNTOF(common_usage), (int)argv.size(), argv.data());
+    EXPECT_EQ(cp.num_occurrences(), argv.size());
+    EXPECT_EQ(cp.count(LEVEL), 1000);
+    EXPECT_LE(cp.memory_size(), 16u * (argv.size() + 1) + 12u * 8u);
+    EXPECT_LT(cp.memory_size(), sizeof(option::Option) * argv.size() / 2);
+}
+
+TEST(compact, retention)
+{
+    std::vector<std::string> sbuf;
+    for(int i = 0; i < 1000; ++i)
+    {
+        sbuf.emplace_back("-v");
+        sbuf.emplace_back("--level=" + std::to_string(i));
+        sbuf.emplace_back("-n" + std::to_string(i));
+    }
+    sbuf.emplace_back("file");
+    std::vector<const char*> argv;
+    for(auto const& s : sbuf)
+        argv.push_back(s.c_str());
+    c4::opt::CompactParser all(common_usage, C4_COUNTOF(common_usage), (int)argv.size(), argv.data());
+    c4::opt::CompactParser cp(common_usage, C4_COUNTOF(common_usage), (int)argv.size(), argv.data(), c4::opt::PARSE_POSIX, c4::opt::with_retention,
+                              {{LEVEL, c4::opt::RETAIN_LAST}, {NAME, c4::opt::RETAIN_FIRST}, {VERBOSE, c4::opt::RETAIN_COUNT}});
+    // the counts are the same
+    for(int i : {HELP, LEVEL, NAME, VERBOSE})
+        EXPECT_EQ(cp.count(i), all.count(i)) << i;
+    EXPECT_EQ(cp.count(VERBOSE), 1000);
+    // but only two occurrences were stored
+    ASSERT_EQ(cp.num_occurrences(), 2u);
+    EXPECT_LT(cp.memory_size(), all.memory_size() / 100);
+    EXPECT_STREQ(cp(LEVEL), "999");
+    EXPECT_STREQ(cp(NAME), "0");
+    EXPECT_FALSE(cp[VERBOSE]);
+    EXPECT_EQ(cp.opts(VERBOSE).begin(), cp.opts(VERBOSE).end());
+    std::vector<std::string> args;
+    for(option::Option o : cp.opts_args())
+        args.emplace_back(std::string(o.name, o.namelen) + "=" + o.arg);
+    EXPECT_EQ(args, (std::vector<std::string>{"--level=999", "n=0"}));
+    std::vector<std::string> posn(cp.posn_args().begin(), cp.posn_args().end());
+    EXPECT_EQ(posn, (std::vector<std::string>{"file"}));
+    // the same with a spec
+    c4::opt::RuntimeSpec rs(common_usage);
+    c4::opt::CompactParser sp(rs.spec(), (int)argv.size(), argv.data(), c4::opt::PARSE_GNU, c4::opt::with_retention, {{LEVEL, c4::opt::RETAIN_FIRST}});
+    EXPECT_EQ(sp.count(LEVEL), 1000);
+    EXPECT_EQ(sp.num_occurrences(), 2001u);
+    EXPECT_STREQ(sp(LEVEL), "0");
+    int num = 0;
+    for(option::Option o : sp.opts(LEVEL))
+        num += (bool)o;
+    EXPECT_EQ(num, 1);
+}
+
+TEST(compact, retention_takes_one_allocation)
+{
+    Args args({"-v", "--level=1", "-v", "--level=2", "file"});
+    c4::opt::MemoryResourceArena arena(4096);
+    {
+        c4::opt::CompactParser cp(common_usage, C4_COUNTOF(common_usage), args.argc(), args.argv(), c4::opt::PARSE_POSIX,
+                                  c4::opt::with_retention, {{LEVEL, c4::opt::RETAIN_LAST}}, nullptr, &arena);
+        EXPECT_STREQ(cp(LEVEL), "2");
+        EXPECT_EQ(cp.count(VERBOSE), 2);
+        // the policies were grown in place into the results
+        EXPECT_EQ(arena.used(), cp.memory_size());
+    }
+    // and given back to the arena
+    EXPECT_EQ(arena.used(), 0u);
+}
+
+TEST(compact, empty_error_is_not_ambiguous)
+{
+    Args args({"-v", "file"});
+    c4::opt::CompactParser cp(common_usage, C4_COUNTOF(common_usage), args.argc(), args.argv(), c4::opt::PARSE_POSIX, {});
+    EXPECT_EQ(cp.count(VERBOSE), 1);
+    c4::opt::RuntimeSpec rs(common_usage);
+    c4::opt::CompactParser sp(rs.spec(), args.argc(), args.argv(), c4::opt::PARSE_GNU, {});
+    EXPECT_EQ(sp.count(VERBOSE), 1);
+}
+
+TEST(compact, argv_is_not_modified)
+{
+    Args args({"file0", "-v", "file1", "--level", "2", "-", "-n", "foo", "file2", "--", "-v", "file3"});
+    const std::vector<const char*> orig = args.cbuf;
+    c4::opt::CompactParser cp(common_usage, C4_COUNTOF(common_usage), args.argc(), args.argv(), c4::opt::PARSE_GNU);
+    EXPECT_EQ(args.cbuf, orig);
+    EXPECT_EQ(cp.count(VERBOSE), 1);
+    EXPECT_STREQ(cp(LEVEL), "2");
+    EXPECT_STREQ(cp(NAME), "foo");
+    std::vector<std::string> posn(cp.posn_args().begin(), cp.posn_args().end());
+    EXPECT_EQ(posn, (std::vector<std::string>{"file0", "file1", "-", "file2", "-v", "file3"}));
+    ASSERT_EQ(cp.num_posn(), 6u);
+    std::vector<uint32_t> indices(cp.posn_indices(), cp.posn_indices() + cp.num_posn());
+    EXPECT_EQ(indices, (std::vector<uint32_t>{0, 2, 5, 8, 10, 11}));
+    // the same as the permuting parser
+    Args permuted({"file0", "-v", "file1", "--level", "2", "-", "-n", "foo", "file2", "--", "-v", "file3"});
+    option::Option options[8], buffer[8];
+    option::Parser gp(/*gnu*/true, common_usage, permuted.argc(), permuted.argv(), options, buffer);
+    ASSERT_FALSE(gp.error());
+    ASSERT_EQ(gp.nonOptionsCount(), (int)cp.num_posn());
+    for(int k = 0; k < gp.nonOptionsCount(); ++k)
+        EXPECT_STREQ(gp.nonOption(k), posn[k].c_str()) << k;
+    EXPECT_NE(permuted.cbuf, orig);
+    // in POSIX mode the first positional argument ends the options
+    c4::opt::CompactParser pp(common_usage, C4_COUNTOF(common_usage), args.argc(), args.argv(), c4::opt::PARSE_POSIX);
+    EXPECT_EQ(pp.num_occurrences(), 0u);
+    EXPECT_EQ(pp.num_posn(), (size_t)args.argc());
+    EXPECT_EQ(args.cbuf, orig);
+}
+
+TEST(compact, concurrent_parses_of_the_same_argv)
+{
+    std::vector<std::string> sbuf;
+    for(int i = 0; i < 1000; ++i)
+    {
+        sbuf.emplace_back("file" + std::to_string(i));
+        sbuf.emplace_back(i & 1 ? "-v" : "--level=" + std::to_string(i));
+    }
+    std::vector<const char*> argv;
+    for(auto const& s : sbuf)
+        argv.push_back(s.c_str());
+    const std::vector<const char*> orig = argv;
+    const int num_threads = 8;
+    std::vector<int> failures(num_threads, 0);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&, t]{
+            for(int rep = 0; rep < 20; ++rep)
+            {
+                c4::opt::CompactParser cp(common_usage, C4_COUNTOF(common_usage), (int)argv.size(), argv.data(), c4::opt::PARSE_GNU);
+                int k = 0;
+                for(const char *arg : cp.posn_args())
+                    failures[t] += (arg != orig[2 * k++]);
+                failures[t] += (k != 1000) + (cp.count(VERBOSE) != 500) + (cp.count(LEVEL) != 500);
+            }
+        });
+    }
+    for(auto &th : threads)
+        th.join();
+    for(int t = 0; t < num_threads; ++t)
+        EXPECT_EQ(failures[t], 0) << t;
+    EXPECT_EQ(argv, orig);
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
@@ -0,0 +1,257 @@
+#include <c4/opt/complete.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#ifndef C4_WIN
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+typedef enum {
+    UNKNOWN,
+    HELP,
+    COLOR,
+    DIR,
+    FILE_,
+    LEVEL,
+    VERBOSE,
+    VERSION,
+} CompleteIndex_e;
+static const option::Descriptor complete_usage[] =
+{
+    {UNKNOWN, 0, ""  , ""       , c4::opt::unknown , "USAGE: app [options]\n\nOptions:" },
+    {HELP   , 0, "h" , "help"   , c4::opt::none    , "  -h, --help  \tPrint usage and exit." },
+    {COLOR  , 0, "c" , "color"  , c4::opt::required, "  -c <when>, --color=<when>  \tColorize the output." },
+    {DIR    , 0, "d" , "dir"    , c4::opt::required, "  -d <dir>, --dir=<dir>  \tChange to a directory." },
+    {FILE_  , 0, "f" , "file"   , c4::opt::required, "  -f <file>, --file=<file>  \tRead from a file." },
+    {LEVEL  , 0, "l" , "level"  , c4::opt::integer , "  -l <val>, --level=<val>  \tSet the level." },
+    {VERBOSE, 0, "v" , "verbose", c4::opt::none    , "  -v, --verbose  \tBe verbose." },
+    {VERBOSE, 0, "v" , "loud"   , c4::opt::none    , "  --loud  \tSame as --verbose." },
+    {VERSION, 0, ""  , "version", c4::opt::none    , nullptr },
+    {0,0,0,0,0,0}
+};
+
+static const char *const colors[] = {"always", "auto", "never", "a:b", nullptr};
+static const c4::opt::ValueCompleter complete_values[] = {
+    {COLOR, c4::opt::COMPLETE_CHOICES, colors},
+    {DIR, c4::opt::COMPLETE_DIRS, nullptr},
+    {FILE_, c4::opt::COMPLETE_FILES, nullptr},
+};
+
+std::string completions(c4::opt::Shell_e shell, std::initializer_list<const char*> words)
+{
+    c4::opt::CompletionIndex ix(complete_usage);
+    std::vector<const char*> w(words.begin(), words.end());
+    size_t len = c4::opt::complete({}, ix, shell, (int)w.size(), w.data(), complete_values);
+    std::string s(len + 1, '\0');
+    EXPECT_EQ(c4::opt::complete({&s[0], s.size()}, ix, shell, (int)w.size(), w.data(), complete_values), len);
+    s.resize(len);
+    return s;
+}
+
+std::string bash(std::initializer_list<const char*> words)
+{
+    return completions(c4::opt::SHELL_BASH, words);
+}
+
+/** the lines of the output, sorted: directories are listed in any order */
+std::string sorted(std::string s)
+{
+    std::vector<std::string> lines;
+    for(size_t pos = 0, next; pos < s.size(); pos = next + 1)
+    {
+        next = s.find('\n', pos);
+        lines.push_back(s.substr(pos, next - pos));
+    }
+    std::sort(lines.begin(), lines.end());
+    std::string out;
+    for(auto const& l : lines)
+        out += l + '\n';
+    return out;
+}
+
+TEST(complete, table)
+{
+    c4::opt::CompletionIndex ix(complete_usage);
+    c4::opt::CompletionTable const& t = ix.table();
+    EXPECT_EQ(t.usage, complete_usage);
+    // -v is given once, for its first descriptor
+    ASSERT_EQ(t.num_words, 14u);
+    for(size_t i = 1; i < t.num_words; ++i)
+        EXPECT_LT(std::string(t.words[i-1].str), std::string(t.words[i].str));
+    size_t first = 0;
+    ASSERT_EQ(t.prefix_range("--ver", &first), 2u);
+    EXPECT_STREQ(t.words[first].str, "--verbose");
+    EXPECT_STREQ(t.words[first + 1].str, "--version");
+    EXPECT_EQ(t.prefix_range("-", &first), 14u);
+    EXPECT_EQ(first, 0u);
+    EXPECT_EQ(t.prefix_range("--", &first), 8u);
+    EXPECT_EQ(t.prefix_range("--verbosex", &first), 0u);
+    EXPECT_EQ(t.prefix_range("-x", &first), 0u);
+    EXPECT_EQ(t.find("--color"), 2);
+    EXPECT_EQ(t.find("-v"), 6);
+    EXPECT_EQ(t.find("--loud"), 7);
+    EXPECT_EQ(t.find("--col"), -1);
+    EXPECT_EQ(t.find("--colors"), -1);
+    // moved from
+    c4::opt::CompletionIndex moved(std::move(ix));
+    EXPECT_EQ(moved.table().num_words, 14u);
+    EXPECT_EQ(ix.table().num_words, 0u);
+}
+
+TEST(complete, options)
+{
+    EXPECT_EQ(bash({"--ver"}), "--verbose\n--version\n");
+    EXPECT_EQ(bash({"--verb"}), "--verbose\n");
+    EXPECT_EQ(bash({"--x"}), "");
+    EXPECT_EQ(bash({"-"}), "--color\n--dir\n--file\n--help\n--level\n--loud\n--verbose\n--version\n-c\n-d\n-f\n-h\n-l\n-v\n");
+    // positional arguments are left to the shell
+    EXPECT_EQ(bash({""}), "");
+    EXPECT_EQ(bash({"fi"}), "");
+    EXPECT_EQ(bash({"file.txt", "-v", "--he"}), "--help\n");
+    // and so is everything after --
+    EXPECT_EQ(bash({"--", "--he"}), "");
+    EXPECT_EQ(bash({}), "");
+}
+
+TEST(complete, formats)
+{
+    EXPECT_EQ(completions(c4::opt::SHELL_ZSH, {"--ver"}), "--verbose:Be verbose.\n--version\n");
+    EXPECT_EQ(completions(c4::opt::SHELL_FISH, {"--ver"}), "--verbose\tBe verbose.\n--version\n");
+    EXPECT_EQ(completions(c4::opt::SHELL_FISH, {"-c"}), "-c\tColorize the output.\n");
+    EXPECT_EQ(completions(c4::opt::SHELL_ZSH, {"--color", "a"}), "always\nauto\na\\:b\n");
+    EXPECT_EQ(completions(c4::opt::SHELL_ZSH, {"--color=a"}), "--color=always\n--color=auto\n--color=a\\:b\n");
+}
+
+TEST(complete, values)
+{
+    const char *all = "always\nauto\nnever\na:b\n";
+    EXPECT_EQ(bash({"--color", ""}), all);
+    EXPECT_EQ(bash({"--color", "n"}), "never\n");
+    EXPECT_EQ(bash({"-c", "au"}), "auto\n");
+    EXPECT_EQ(bash({"-vc", "n"}), "never\n");
+    EXPECT_EQ(bash({"-cv", "n"}), ""); // -c takes "v"
+    EXPECT_EQ(bash({"--color=n"}), "--color=never\n");
+    EXPECT_EQ(completions(c4::opt::SHELL_FISH, {"--color=n"}), "--color=never\n");
+    // bash splits --color=n into three words, and replaces only the last
+    EXPECT_EQ(bash({"--color", "=", "n"}), "never\n");
+    EXPECT_EQ(bash({"--color", "="}), all);
+    EXPECT_EQ(bash({"--color", "=", "never", "--he"}), "--help\n");
+    // the value is not an option, even if it looks like one
+    EXPECT_EQ(bash({"--color", "--he"}), "");
+    EXPECT_EQ(bash({"--color", "--", "--he"}), "--help\n");
+    EXPECT_EQ(bash({"-c", "--", "--he"}), "--help\n");
+    // an option with a value but no completer
+    EXPECT_EQ(bash({"--level", ""}), "");
+    EXPECT_EQ(bash({"--level", "1", "--verb"}), "--verbose\n");
+    EXPECT_EQ(bash({"--level=1", "--verb"}), "--verbose\n");
+    // an option without a value
+    EXPECT_EQ(bash({"--verbose", "--verb"}), "--verbose\n");
+    EXPECT_EQ(bash({"--verbose=", "--verb"}), "--verbose\n");
+    EXPECT_EQ(bash({"--help="}), "");
+}
+
+#ifndef C4_WIN
+TEST(complete, paths)
+{
+    char tmpl[] = "/tmp/c4opt_complete_XXXXXX";
+    ASSERT_NE(mkdtemp(tmpl), nullptr);
+    const std::string root = tmpl;
+    ASSERT_EQ(mkdir((root + "/sub").c_str(), 0700), 0);
+    ASSERT_EQ(mkdir((root + "/src").c_str(), 0700), 0);
+    ASSERT_EQ(mkdir((root + "/.hidden").c_str(), 0700), 0);
+    for(const char *f : {"/sub.txt", "/readme", "/sub/a.txt", "/.hidden_file"})
+        fclose(fopen((root + f).c_str(), "wb"));
+    ASSERT_EQ(symlink((root + "/sub").c_str(), (root + "/link").c_str()), 0);
+
+    std::string dir = root + "/";
+    std::string su = root + "/su";
+    std::string dot = root + "/.";
+    std::string sub = root + "/sub/";
+    EXPECT_EQ(sorted(bash({"--file", dir.c_str()})), sorted(dir + "link/\n" + dir + "readme\n" + dir + "src/\n" + dir + "sub/\n" + dir + "sub.txt\n"));
+    EXPECT_EQ(sorted(bash({"--dir", dir.c_str()})), sorted(dir + "link/\n" + dir + "src/\n" + dir + "sub/\n"));
+    EXPECT_EQ(sorted(bash({"-f", su.c_str()})), sorted(dir + "sub/\n" + dir + "sub.txt\n"));
+    EXPECT_EQ(sorted(bash({"-f", dot.c_str()})), sorted(dir + ".hidden/\n" + dir + ".hidden_file\n"));
+    EXPECT_EQ(bash({"-f", sub.c_str()}), sub + "a.txt\n");
+    std::string inl = "--file=" + su;
+    EXPECT_EQ(sorted(bash({inl.c_str()})), sorted("--file=" + dir + "sub/\n--file=" + dir + "sub.txt\n"));
+    EXPECT_EQ(bash({"-f", (root + "/nothere/").c_str()}), "");
+
+    for(const char *f : {"/sub/a.txt", "/sub.txt", "/readme", "/.hidden_file", "/link"})
+        unlink((root + f).c_str());
+    for(const char *d : {"/sub", "/src", "/.hidden", ""})
+        rmdir((root + d).c_str());
+}
+#endif
+
+TEST(complete, truncated)
+{
+    c4::opt::CompletionIndex ix(complete_usage);
+    const char *words[] = {"--ver"};
+    char buf[8];
+    EXPECT_EQ(c4::opt::complete({buf, sizeof(buf)}, ix, c4::opt::SHELL_BASH, 1, words), strlen("--verbose\n--version\n"));
+    EXPECT_STREQ(buf, "--verbo");
+}
+
+std::string run_main(std::initializer_list<const char*> args, bool *handled)
+{
+    std::vector<const char*> argv(args.begin(), args.end());
+    FILE *out = tmpfile();
+    *handled = c4::opt::complete_main(complete_usage, (int)argv.size(), argv.data(), complete_values, out);
+    std::string s(4096, '\0');
+    rewind(out);
+    s.resize(fread(&s[0], 1, s.size(), out));
+    fclose(out);
+    return s;
+}
+
+TEST(complete, main)
+{
+    bool handled = false;
+    EXPECT_EQ(run_main({"app", "--complete", "--ver"}, &handled), "--verbose\n--version\n");
+    EXPECT_TRUE(handled);
+    EXPECT_EQ(run_main({"app", "--complete=bash", "-c", "n"}, &handled), "never\n");
+    EXPECT_TRUE(handled);
+    EXPECT_EQ(run_main({"app", "--complete=zsh", "--ver"}, &handled), "--verbose:Be verbose.\n--version\n");
+    EXPECT_TRUE(handled);
+    EXPECT_EQ(run_main({"app", "--complete=fish", "--verb"}, &handled), "--verbose\tBe verbose.\n");
+    EXPECT_TRUE(handled);
+    EXPECT_EQ(run_main({"app", "--complete"}, &handled), "");
+    EXPECT_TRUE(handled);
+    // not a completion request: the program runs as usual
+    EXPECT_EQ(run_main({"app", "--verbose"}, &handled), "");
+    EXPECT_FALSE(handled);
+    EXPECT_EQ(run_main({"app", "--complete=csh", "--ver"}, &handled), "");
+    EXPECT_FALSE(handled);
+    EXPECT_EQ(run_main({"app"}, &handled), "");
+    EXPECT_FALSE(handled);
+}
+
+TEST(complete, large_output)
+{
+    // more than fits in the buffer on the stack
+    std::vector<std::string> names;
+    std::vector<option::Descriptor> usage;
+    usage.push_back(complete_usage[0]);
+    for(unsigned i = 1; i < 1000; ++i)
+        names.push_back("option" + std::to_string(i));
+    for(unsigned i = 1; i < 1000; ++i)
+        usage.push_back({i, 0, "", names[i - 1].c_str(), c4::opt::none, "  --optionN  \tAn option."});
+    usage.push_back({0, 0, 0, 0, 0, 0});
+    const char *argv[] = {"app", "--complete=fish", "--opt"};
+    FILE *out = tmpfile();
+    ASSERT_TRUE(c4::opt::complete_main(usage.data(), 3, argv, {}, out));
+    std::string s(100000, '\0');
+    rewind(out);
+    s.resize(fread(&s[0], 1, s.size(), out));
+    fclose(out);
+    EXPECT_EQ((size_t)std::count(s.begin(), s.end(), '\n'), 999u);
+    EXPECT_EQ(s.substr(0, 22), "--option1\tAn option.\n-");
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
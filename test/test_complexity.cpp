@@ -0,0 +1,353 @@
+#include "test_common.hpp"
+#include <c4/opt/opt.hpp>
+#include <c4/opt/compact.hpp>
+#include <c4/opt/counting.hpp>
+#include <c4/opt/view.hpp>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+// Each test runs a path of the parse with inputs of size n and 8n,
+// built to be adversarial for that path, and counts the work done:
+// the counters of option::Profile, for which this test is linked with
+// a copy of the library compiled with C4OPT_PROFILE, and the bytes
+// allocated. The test fails if any of them grows faster
+// than O(n log n) can give: from n to 8n, n log n grows at most by a
+// factor of 8*(1+3/log2(n)), ie as n^k with k < 1.2 for the sizes used
+// here, while quadratic paths give k = 2. The times are measured by
+// the benchmarks instead (see bm/bm_parse.cpp), which fit their growth
+// without gating the tests on the load of the machine. A path where
+// no work is counted is skipped.
+
+#ifndef C4OPT_PROFILE
+#error "this test needs C4OPT_PROFILE; see c4opt_add_test(... PROFILED ...)"
+#endif
+
+namespace {
+
+const double max_exponent = 1.25;
+
+/** the work done by a path */
+struct Work
+{
+    double tokens = 0;       ///< option::Profile::tokens
+    double comparisons = 0;  ///< option::Profile::comparisons
+    double checks = 0;       ///< option::Profile::checks
+    double swaps = 0;        ///< option::Profile::swaps
+    double bytes = 0;        ///< allocated from the global resource
+};
+
+/** count the work of fn. The option::Parser it calls count in the
+ * profile installed here; c4::opt::Parser counts in its own profile,
+ * which is added with add_work(). */
+Work measure(std::function<void()> const& fn)
+{
+    Work w;
+    c4::opt::MemoryResourceCounting::Scope allocs;
+    option::Profile prof = {};
+    option::Profile *prev = option::Profile::current();
+    option::Profile::current() = &prof;
+    fn();
+    option::Profile::current() = prev;
+    w.tokens = (double)prof.tokens;
+    w.comparisons = (double)prof.comparisons;
+    w.checks = (double)prof.checks;
+    w.swaps = (double)prof.swaps;
+    w.bytes = (double)allocs.counts().bytes;
+    return w;
+}
+
+/** add the work of a c4::opt::Parser to the profile of measure() */
+void add_work(c4::opt::Parser const& p)
+{
+    if(option::Profile *prof = option::Profile::current())
+    {
+        prof->tokens += p.profile.tokens;
+        prof->comparisons += p.profile.comparisons;
+        prof->checks += p.profile.checks;
+        prof->swaps += p.profile.swaps;
+    }
+}
+
+/** the growth exponent of a counter from n to 8n; 0 if nothing was
+ * counted at n */
+double growth_exponent(double small, double large)
+{
+    if(small == 0)
+        return large == 0 ? 0. : 100.;
+    return std::log2(large / small) / 3.;
+}
+
+/** @param setup creates the input of size n, and returns the path to measure */
+void check_growth(size_t n, std::function<std::function<void()>(size_t)> const& setup)
+{
+    Work small = measure(setup(n));
+    Work large = measure(setup(8 * n));
+    EXPECT_LT(growth_exponent(small.tokens, large.tokens), max_exponent) << "tokens: " << small.tokens << " -> " << large.tokens;
+    EXPECT_LT(growth_exponent(small.comparisons, large.comparisons), max_exponent) << "comparisons: " << small.comparisons << " -> " << large.comparisons;
+    EXPECT_LT(growth_exponent(small.checks, large.checks), max_exponent) << "checks: " << small.checks << " -> " << large.checks;
+    EXPECT_LT(growth_exponent(small.swaps, large.swaps), max_exponent) << "swaps: " << small.swaps << " -> " << large.swaps;
+    EXPECT_LT(growth_exponent(small.bytes, large.bytes), max_exponent) << "bytes: " << small.bytes << " -> " << large.bytes;
+    // the bytes alone do not tell the time
+    if(large.tokens == 0 && large.comparisons == 0 && large.checks == 0 && large.swaps == 0)
+        GTEST_SKIP() << "no work is counted on this path";
+}
+
+#define EXPECT_AT_MOST_NLOGN(n, ...)                                  \
+    do {                                                              \
+        SCOPED_TRACE("n=" #n);                                        \
+        check_growth(n, __VA_ARGS__);                                 \
+    } while(0)
+
+
+/** a usage with num options --o<i>, the last one being --last. The
+ * even ones but the last take an argument */
+struct Usage
+{
+    std::vector<std::string> names;
+    std::vector<option::Descriptor> desc;
+    explicit Usage(size_t num)
+    {
+        names.reserve(num);
+        desc.push_back({0, 0, "", "", c4::opt::unknown, "USAGE: app [options]\n\nOptions:"});
+        for(size_t i = 1; i <= num; ++i)
+        {
+            names.push_back(i == num ? "last" : "o" + std::to_string(i));
+            desc.push_back({(unsigned)i, 0, i == 1 ? "v" : "", names.back().c_str(),
+                            i % 2 || i == num ? c4::opt::none : c4::opt::required,
+                            "  --oN  \tAn option with a description which is long enough to be wrapped by the help formatting."});
+        }
+        desc.push_back({0, 0, 0, 0, 0, 0});
+    }
+    option::Descriptor const* usage() const { return desc.data(); }
+    size_t size() const { return desc.size(); }
+};
+
+/** n tokens: all the positional arguments first, then all the
+ * options, so that each option has to be moved behind all the
+ * positional arguments when permuting */
+Args positional_first(size_t n)
+{
+    std::vector<std::string> a;
+    for(size_t i = 0; i < n / 2; ++i)
+        a.push_back("file" + std::to_string(i));
+    for(size_t i = n / 2; i < n; ++i)
+        a.push_back(i % 3 ? "-v" : "--o1");
+    return Args(std::move(a));
+}
+
+/** n tokens alternating positional arguments and options, some of them with separate arguments */
+Args interleaved(size_t n)
+{
+    std::vector<std::string> a;
+    for(size_t i = 0; a.size() < n; ++i)
+    {
+        a.push_back("file" + std::to_string(i));
+        if(i % 2)
+        {
+            a.push_back("--o2");
+            a.push_back("val");
+        }
+        else
+        {
+            a.push_back("-v");
+        }
+    }
+    return Args(std::move(a));
+}
+
+/** n occurrences of the same option */
+Args same_option(size_t n)
+{
+    std::vector<std::string> a;
+    for(size_t i = 0; i < n; ++i)
+        a.push_back("--o2=" + std::to_string(i));
+    return Args(std::move(a));
+}
+
+} // anon
+
+
+//-----------------------------------------------------------------------------
+// the number of tokens
+
+TEST(complexity, gnu_permutation)
+{
+    static const Usage u(8);
+    EXPECT_AT_MOST_NLOGN(2048, [](size_t n) {
+        auto args = std::make_shared<Args>(positional_first(n));
+        return [args, n]{
+            std::vector<const char*> argv = args->cbuf; // permuted by the parser
+            option::Stats stats(/*gnu*/true, u.usage(), args->argc(), argv.data());
+            std::vector<option::Option> options(stats.options_max), buffer(stats.buffer_max);
+            option::Parser parser(/*gnu*/true, u.usage(), args->argc(), argv.data(), options.data(), buffer.data());
+            EXPECT_EQ(parser.nonOptionsCount(), (int)n / 2);
+        };
+    });
+    EXPECT_AT_MOST_NLOGN(2048, [](size_t n) {
+        auto args = std::make_shared<Args>(interleaved(n));
+        return [args]{
+            std::vector<const char*> argv = args->cbuf;
+            option::Stats stats(/*gnu*/true, u.usage(), args->argc(), argv.data());
+            std::vector<option::Option> options(stats.options_max), buffer(stats.buffer_max);
+            option::Parser parser(/*gnu*/true, u.usage(), args->argc(), argv.data(), options.data(), buffer.data());
+            EXPECT_FALSE(parser.error());
+        };
+    });
+}
+
+TEST(complexity, gnu_permutation_keeps_the_order)
+{
+    static const Usage u(8);
+    Args args = interleaved(1001);
+    std::vector<const char*> argv = args.cbuf;
+    option::Stats stats(/*gnu*/true, u.usage(), args.argc(), argv.data());
+    std::vector<option::Option> options(stats.options_max), buffer(stats.buffer_max);
+    option::Parser parser(/*gnu*/true, u.usage(), args.argc(), argv.data(), options.data(), buffer.data());
+    ASSERT_FALSE(parser.error());
+    // the options, in their order, then the positional arguments, in their order
+    std::vector<const char*> opts, posn;
+    for(size_t i = 0; i < args.sbuf.size(); ++i)
+    {
+        const char *tok = args.cbuf[i];
+        bool is_arg = i > 0 && args.sbuf[i - 1] == "--o2";
+        (tok[0] == '-' || is_arg ? opts : posn).push_back(tok);
+    }
+    std::vector<const char*> expected = opts;
+    expected.insert(expected.end(), posn.begin(), posn.end());
+    EXPECT_EQ(std::vector<const char*>(argv.begin(), argv.begin() + args.argc()), expected);
+    ASSERT_EQ(parser.nonOptionsCount(), (int)posn.size());
+    EXPECT_EQ(parser.nonOptions(), argv.data() + opts.size());
+    // on error, what was parsed before the error is permuted
+    const char *err_argv[] = {"a", "-v", "b", "--o2", nullptr}; // --o2 requires an argument
+    option::Parser err_parser(/*gnu*/true, u.usage(), 4, err_argv, options.data(), buffer.data());
+    EXPECT_TRUE(err_parser.error());
+    EXPECT_STREQ(err_argv[0], "-v");
+    EXPECT_STREQ(err_argv[1], "a");
+    EXPECT_STREQ(err_argv[2], "b");
+    EXPECT_STREQ(err_argv[3], "--o2");
+}
+
+TEST(complexity, posix_parsers)
+{
+    static const Usage u(8);
+    static const c4::opt::RuntimeSpec rs(u.usage());
+    EXPECT_AT_MOST_NLOGN(4096, [](size_t n) {
+        auto args = std::make_shared<Args>(same_option(n));
+        return [args]{
+            c4::opt::ParseError err;
+            auto p = c4::opt::make_parser(u.usage(), u.size(), args->argc(), args->argv(), &err, {2});
+            add_work(p);
+            EXPECT_EQ(p[2].count(), args->argc());
+        };
+    });
+    EXPECT_AT_MOST_NLOGN(4096, [](size_t n) {
+        auto args = std::make_shared<Args>(same_option(n));
+        return [args]{
+            c4::opt::CompactParser cp(rs.spec(), args->argc(), args->argv());
+            EXPECT_EQ(cp.count(2), args->argc());
+        };
+    });
+    EXPECT_AT_MOST_NLOGN(4096, [](size_t n) {
+        auto args = std::make_shared<Args>(same_option(n));
+        return [args]{
+            c4::opt::ViewParser vp(rs.spec(), args->tokens());
+            EXPECT_EQ(vp.count(2), args->argc());
+        };
+    });
+}
+
+TEST(complexity, gnu_parsers_which_keep_argv)
+{
+    static const Usage u(8);
+    static const c4::opt::RuntimeSpec rs(u.usage());
+    EXPECT_AT_MOST_NLOGN(4096, [](size_t n) {
+        auto args = std::make_shared<Args>(interleaved(n));
+        return [args]{
+            c4::opt::CompactParser cp(rs.spec(), args->argc(), args->argv(), c4::opt::PARSE_GNU);
+            EXPECT_GT(cp.num_posn(), 0u);
+        };
+    });
+    EXPECT_AT_MOST_NLOGN(4096, [](size_t n) {
+        auto args = std::make_shared<Args>(interleaved(n));
+        return [args]{
+            c4::opt::ViewParser vp(rs.spec(), args->tokens(), c4::opt::PARSE_GNU);
+            EXPECT_GT(vp.num_posn(), 0u);
+        };
+    });
+}
+
+TEST(complexity, short_option_group)
+{
+    static const Usage u(8);
+    EXPECT_AT_MOST_NLOGN(4096, [](size_t n) {
+        auto args = std::make_shared<Args>(std::vector<std::string>{"-" + std::string(n, 'v')});
+        return [args, n]{
+            auto p = c4::opt::make_parser(u.usage(), u.size(), args->argc(), args->argv());
+            add_work(p);
+            EXPECT_EQ(p.parser.optionsCount(), (int)n);
+        };
+    });
+}
+
+
+//-----------------------------------------------------------------------------
+// the number of descriptors
+
+TEST(complexity, descriptors)
+{
+    EXPECT_AT_MOST_NLOGN(512, [](size_t n) {
+        auto u = std::make_shared<Usage>(n);
+        // the last ones: a linear scan finds them last
+        auto args = std::make_shared<Args>(std::vector<std::string>{"--o" + std::to_string(n - 1), "--last", "--nonexistent"});
+        return [u, args]{
+            c4::opt::ParseError err;
+            auto p = c4::opt::make_parser(u->usage(), u->size(), args->argc(), args->argv(), &err);
+            add_work(p);
+            EXPECT_EQ(p.parser.optionsCount(), 2);
+        };
+    });
+}
+
+TEST(complexity, spec_compile)
+{
+    // nothing but the bytes is counted when compiling a spec: its time
+    // is fitted by table_size_compile in bm/bm_parse.cpp
+    EXPECT_AT_MOST_NLOGN(512, [](size_t n) {
+        auto u = std::make_shared<Usage>(n);
+        return [u]{
+            c4::opt::RuntimeSpec rs(u->usage());
+            EXPECT_EQ(rs.spec().index.num_usage, u->size() - 1);
+        };
+    });
+}
+
+TEST(complexity, abbreviations)
+{
+    // an abbreviation is looked for with two scans of the descriptors,
+    // also when there is an index
+    static const Usage fixed(8);
+    auto parse = [](Usage const& u, Args &args, int expected){
+        option::Stats stats(/*gnu*/false, u.usage(), args.argc(), args.argv(), /*min_abbr_len*/2);
+        std::vector<option::Option> options(stats.options_max), buffer(stats.buffer_max);
+        option::Parser parser(/*gnu*/false, u.usage(), args.argc(), args.argv(), options.data(), buffer.data(), /*min_abbr_len*/2);
+        EXPECT_EQ(parser.optionsCount(), expected);
+    };
+    EXPECT_AT_MOST_NLOGN(256, [&](size_t n) {
+        auto u = std::make_shared<Usage>(n);
+        auto args = std::make_shared<Args>(std::vector<std::string>(64, "--las"));
+        return [u, args, parse]{ parse(*u, *args, 64); };
+    });
+    EXPECT_AT_MOST_NLOGN(4096, [&](size_t n) {
+        auto args = std::make_shared<Args>(std::vector<std::string>(n, "--las"));
+        return [args, n, parse]{ parse(fixed, *args, (int)n); };
+    });
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
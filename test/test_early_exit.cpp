@@ -0,0 +1,112 @@
+#include "test_common.hpp"
+#include <c4/opt/opt.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+using namespace test_common;
+
+typedef enum {
+    VERSION = NUM_COMMON_OPTIONS,
+} EarlyIndex_e;
+static const option::Descriptor early_usage[] =
+{
+    C4OPT_TEST_COMMON_DESCRIPTORS,
+    {VERSION, 0, ""  , "version", c4::opt::none    , "  --version  \tPrint the version and exit." },
+    // aliases: a second short option, and a long option of more than 8 characters
+    {HELP   , 0, "?" , ""       , c4::opt::none    , "  -?  \tSame as --help." },
+    {VERBOSE, 0, ""  , "verbose-output-please", c4::opt::none, "  --verbose-output-please  \tSame as --verbose." },
+    {0,0,0,0,0,0}
+};
+
+int scan(std::initializer_list<const char*> il, std::initializer_list<int> indices={HELP, VERSION})
+{
+    static const c4::opt::RuntimeSpec rs(early_usage);
+    Args args(il);
+    int found = c4::opt::scan_early_exit(early_usage, C4_COUNTOF(early_usage), args.argc(), args.argv(), indices);
+    // the same with the index of the spec
+    EXPECT_EQ(c4::opt::scan_early_exit(rs.spec(), args.argc(), args.argv(), indices), found);
+    return found;
+}
+
+TEST(early_exit, scan)
+{
+    EXPECT_EQ(scan({}), -1);
+    EXPECT_EQ(scan({"-l", "1", "file"}), -1);
+    EXPECT_EQ(scan({"-h"}), HELP);
+    EXPECT_EQ(scan({"-?"}), HELP);
+    EXPECT_EQ(scan({"--help"}), HELP);
+    EXPECT_EQ(scan({"--version"}), VERSION);
+    EXPECT_EQ(scan({"-l", "1", "file", "--version", "-h"}), -1);
+    EXPECT_EQ(scan({"-l", "1", "-h", "--version"}), HELP);
+    // only exact tokens
+    EXPECT_EQ(scan({"-hl"}), -1);
+    EXPECT_EQ(scan({"--hel"}), -1);
+    EXPECT_EQ(scan({"--helpx"}), -1);
+    EXPECT_EQ(scan({"--versio"}), -1);
+    EXPECT_EQ(scan({"--versionx"}), -1);
+    EXPECT_EQ(scan({"--verbose-output-please"}), -1);
+    // stops where the options end
+    EXPECT_EQ(scan({"-l", "1", "--", "--help"}), -1);
+    EXPECT_EQ(scan({"file", "--help"}), -1);
+    EXPECT_EQ(scan({"-", "--help"}), -1);
+    // skips the arguments of the options
+    EXPECT_EQ(scan({"-n", "--help"}), -1);
+    EXPECT_EQ(scan({"--name", "-h", "--version"}), VERSION);
+    EXPECT_EQ(scan({"-vn", "-h", "--version"}), VERSION);
+    EXPECT_EQ(scan({"-nfoo", "-h"}), HELP);
+    EXPECT_EQ(scan({"--name=foo", "-h"}), HELP);
+    EXPECT_EQ(scan({"-v", "-h"}), HELP);
+    // only the registered indices
+    EXPECT_EQ(scan({"--help"}, {VERSION}), -1);
+    EXPECT_EQ(scan({"--verbose-output-please"}, {VERBOSE}), VERBOSE);
+    EXPECT_EQ(scan({"--verbose-output-pleasE"}, {VERBOSE}), -1);
+    EXPECT_EQ(scan({"-v"}, {VERBOSE}), VERBOSE);
+}
+
+TEST(early_exit, too_many_tokens)
+{
+    // 40 short aliases: the tokens past the capacity are not looked for
+    static const option::Descriptor many_usage[] =
+    {
+        {0   , 0, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMN", "help", c4::opt::none, "" },
+        {0,0,0,0,0,0}
+    };
+    static_assert(c4::opt::early_exit_max_tokens == 32, "the cases below assume this");
+    Args first({"-a"}), last_looked_for({"-F"}), not_looked_for({"-G"}), longopt({"--help"});
+    EXPECT_EQ(c4::opt::scan_early_exit(many_usage, C4_COUNTOF(many_usage), first.argc(), first.argv(), {0}), 0);
+    EXPECT_EQ(c4::opt::scan_early_exit(many_usage, C4_COUNTOF(many_usage), last_looked_for.argc(), last_looked_for.argv(), {0}), 0);
+    EXPECT_EQ(c4::opt::scan_early_exit(many_usage, C4_COUNTOF(many_usage), not_looked_for.argc(), not_looked_for.argv(), {0}), -1);
+    EXPECT_EQ(c4::opt::scan_early_exit(many_usage, C4_COUNTOF(many_usage), longopt.argc(), longopt.argv(), {0}), -1);
+}
+
+TEST(early_exit, skips_parsing)
+{
+    // the illegal value and the unknown option would be fatal errors
+    // if they were parsed
+    c4::opt::EarlyExit early = {HELP, VERSION, "app 1.2.3"};
+    {
+        Args args({"-l", "notanumber", "--unknown", "--version"});
+        EXPECT_EXIT(c4::opt::make_parser(early_usage, args.argc(), args.argv(), early), ::testing::ExitedWithCode(0), "");
+    }
+    {
+        Args args({"-l", "notanumber", "--unknown", "-h"});
+        EXPECT_EXIT(c4::opt::make_parser(early_usage, args.argc(), args.argv(), early), ::testing::ExitedWithCode(0), "");
+    }
+}
+
+TEST(early_exit, parses_normally_otherwise)
+{
+    c4::opt::EarlyExit early = {HELP, VERSION, "app 1.2.3"};
+    Args args({"-l", "3", "--", "--version"});
+    auto p = c4::opt::make_parser(early_usage, args.argc(), args.argv(), early, {LEVEL});
+    EXPECT_STREQ(p(LEVEL), "3");
+    EXPECT_FALSE(p[VERSION]);
+    ASSERT_EQ(p.parser.nonOptionsCount(), 1);
+    EXPECT_STREQ(p.parser.nonOption(0), "--version");
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
@@ -0,0 +1,139 @@
+#include "test_common.hpp"
+#include <c4/opt/opt.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+using namespace test_common;
+
+std::string message(c4::opt::ParseError const& err, Args &args)
+{
+    size_t len = c4::opt::format_error({}, err, common_usage, args.argc(), args.argv());
+    std::string s(len + 1, '\0');
+    EXPECT_EQ(c4::opt::format_error({&s[0], s.size()}, err, common_usage, args.argc(), args.argv()), len);
+    s.resize(len);
+    return s;
+}
+
+TEST(errors, ok)
+{
+    Args args({"-v", "--level=1", "file"});
+    c4::opt::ParseError err;
+    auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv(), &err, {LEVEL});
+    EXPECT_FALSE(err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_OK);
+    EXPECT_EQ(err.argi, -1);
+    EXPECT_EQ(err.desc, -1);
+    EXPECT_EQ(p[VERBOSE].count(), 1);
+    EXPECT_STREQ(p(LEVEL), "1");
+    EXPECT_EQ(message(err, args), "");
+}
+
+TEST(errors, record_is_compact)
+{
+    EXPECT_EQ(sizeof(c4::opt::ParseError), 16u);
+}
+
+TEST(errors, unknown_long)
+{
+    Args args({"-v", "--nope=1", "file"});
+    c4::opt::ParseError err;
+    auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv(), &err);
+    EXPECT_TRUE(err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_UNKNOWN_OPTION);
+    EXPECT_EQ(err.argi, 1);
+    EXPECT_EQ(err.offset, 0);
+    EXPECT_EQ(err.desc, 0);
+    EXPECT_EQ(message(err, args), "Unknown option '--nope'");
+    // the options before the error are available
+    EXPECT_EQ(p[VERBOSE].count(), 1);
+}
+
+TEST(errors, unknown_short_in_group)
+{
+    Args args({"--level", "2", "-vxh"});
+    c4::opt::ParseError err;
+    auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv(), &err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_UNKNOWN_OPTION);
+    EXPECT_EQ(err.argi, 2);
+    EXPECT_EQ(err.offset, 2);
+    EXPECT_EQ(err.desc, 0);
+    EXPECT_EQ(message(err, args), "Unknown option '-x'");
+}
+
+TEST(errors, illegal_argument)
+{
+    {
+        Args args({"-v", "-l", "abc"});
+        c4::opt::ParseError err;
+        auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv(), &err);
+        EXPECT_EQ(err.code, c4::opt::PARSE_ILLEGAL_ARGUMENT);
+        EXPECT_EQ(err.argi, 1);
+        EXPECT_EQ(err.offset, 1);
+        EXPECT_EQ(err.desc, 2);
+        EXPECT_EQ(message(err, args), "Option '-l': illegal argument");
+    }
+    {
+        Args args({"-v", "--level="});
+        c4::opt::ParseError err;
+        auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv(), &err);
+        EXPECT_EQ(err.code, c4::opt::PARSE_ILLEGAL_ARGUMENT);
+        EXPECT_EQ(err.argi, 1);
+        EXPECT_EQ(err.offset, 0);
+        EXPECT_EQ(err.desc, 2);
+        EXPECT_EQ(message(err, args), "Option '--level': illegal argument");
+    }
+}
+
+TEST(errors, missing_mandatory)
+{
+    Args args({"-v", "file"});
+    c4::opt::ParseError err;
+    auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv(), &err, {LEVEL, NAME});
+    EXPECT_EQ(err.code, c4::opt::PARSE_MISSING_MANDATORY);
+    EXPECT_EQ(err.argi, -1);
+    EXPECT_EQ(err.desc, 2);
+    EXPECT_EQ(message(err, args), "Option '--level' is mandatory and was not given");
+    EXPECT_FALSE(p.check_mandatory({VERBOSE, NAME}, &err));
+    EXPECT_EQ(err.desc, 3);
+    EXPECT_TRUE(p.check_mandatory({VERBOSE}, &err));
+}
+
+TEST(errors, truncated_message)
+{
+    Args args({"--nope"});
+    c4::opt::ParseError err;
+    auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv(), &err);
+    char buf[8];
+    size_t len = c4::opt::format_error({buf, sizeof(buf)}, err, common_usage, args.argc(), args.argv());
+    EXPECT_EQ(len, strlen("Unknown option '--nope'"));
+    EXPECT_STREQ(buf, "Unknown");
+}
+
+TEST(errors, spec)
+{
+    c4::opt::RuntimeSpec rs(common_usage);
+    Args args({"-v", "-l", "abc"});
+    c4::opt::ParseError err;
+    auto p = c4::opt::make_parser(rs.spec(), args.argc(), args.argv(), &err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_ILLEGAL_ARGUMENT);
+    EXPECT_EQ(err.argi, 1);
+    EXPECT_EQ(err.desc, 2);
+}
+
+TEST(errors, nothing_is_printed)
+{
+    Args args({"-v", "--nope"});
+    testing::internal::CaptureStdout();
+    testing::internal::CaptureStderr();
+    c4::opt::ParseError err;
+    auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv(), &err, {LEVEL});
+    EXPECT_EQ(testing::internal::GetCapturedStderr(), "");
+    EXPECT_EQ(testing::internal::GetCapturedStdout(), "");
+    EXPECT_EQ(err.code, c4::opt::PARSE_UNKNOWN_OPTION);
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
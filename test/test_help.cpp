@@ -0,0 +1,98 @@
+#include <c4/opt/opt.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+typedef enum {
+    UNKNOWN,
+    HELP,
+    VERBOSE,
+    LEVEL,
+} HelpIndex_e;
+static const option::Descriptor help_usage[] =
+{
+    {UNKNOWN, 0, ""  , ""       , c4::opt::unknown , "USAGE: app [options] [<arg> [<more args>]]\n\nOptions:" },
+    {HELP   , 0, "h" , "help"   , c4::opt::none    , "  -h, --help  \tPrint usage and exit." },
+    {VERBOSE, 0, "v" , "verbose", c4::opt::none    , "  -v, --verbose  \tBe verbose. This help text is long enough that it will have to be wrapped on narrower terminals." },
+    {LEVEL  , 0, "l" , "level"  , c4::opt::integer , "  -l <val>, --level=<val>  \tSet the level." },
+    {0,0,0,0,0,0}
+};
+
+struct StringWriter
+{
+    std::string s;
+    void write(const char* str, int size) { s.append(str, (size_t)size); }
+};
+
+std::string reference_help(int width)
+{
+    StringWriter w;
+    option::printUsage(w, help_usage, width);
+    return w.s;
+}
+
+TEST(help, matches_print_usage)
+{
+    for(int width : {20, 40, 80, 120})
+    {
+        c4::csubstr txt = c4::opt::help_text(help_usage, width);
+        std::string ref = reference_help(width);
+        EXPECT_EQ(std::string(txt.str, txt.len), ref) << "width=" << width;
+    }
+}
+
+TEST(help, is_cached)
+{
+    c4::csubstr first = c4::opt::help_text(help_usage, 80);
+    c4::csubstr second = c4::opt::help_text(help_usage, 80);
+    EXPECT_EQ(first.str, second.str);
+    EXPECT_EQ(first.len, second.len);
+    c4::csubstr narrow = c4::opt::help_text(help_usage, 40);
+    EXPECT_NE(first.str, narrow.str);
+    EXPECT_NE(std::string(first.str, first.len), std::string(narrow.str, narrow.len));
+}
+
+TEST(help, clear_cache)
+{
+    c4::csubstr before = c4::opt::help_text(help_usage, 60);
+    std::string copy(before.str, before.len);
+    c4::opt::clear_help_cache();
+    c4::csubstr after = c4::opt::help_text(help_usage, 60);
+    EXPECT_EQ(std::string(after.str, after.len), copy);
+}
+
+TEST(help, is_cached_by_contents)
+{
+    c4::csubstr orig = c4::opt::help_text(help_usage, 80);
+    // the same contents at another address share the text
+    std::vector<option::Descriptor> copy(help_usage, help_usage + C4_COUNTOF(help_usage));
+    c4::csubstr same = c4::opt::help_text(copy.data(), 80);
+    EXPECT_EQ(same.str, orig.str);
+    // other contents at the same address do not get the old text
+    copy[VERBOSE].help = "  -v, --verbose  \tBe verbose.";
+    c4::csubstr changed = c4::opt::help_text(copy.data(), 80);
+    EXPECT_NE(changed.str, orig.str);
+    StringWriter w;
+    option::printUsage(w, copy.data(), 80);
+    EXPECT_EQ(std::string(changed.str, changed.len), w.s);
+}
+
+TEST(help, print_help)
+{
+    FILE *f = tmpfile();
+    ASSERT_NE(f, nullptr);
+    fputs("before\n", f); // must be flushed before the help is written
+    c4::opt::print_help(help_usage, 80, f);
+    fseek(f, 0, SEEK_END);
+    long sz = ftell(f);
+    rewind(f);
+    std::string contents((size_t)sz, '\0');
+    EXPECT_EQ(fread(&contents[0], 1, (size_t)sz, f), (size_t)sz);
+    fclose(f);
+    EXPECT_EQ(contents, "before\n" + reference_help(80));
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
@@ -0,0 +1,263 @@
+#include "test_common.hpp"
+#include <c4/opt/counting.hpp>
+#include <c4/opt/view.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+using namespace test_common;
+
+std::string message(c4::opt::ParseError const& err, Args const& t)
+{
+    char buf[128];
+    c4::opt::format_error(c4::substr(buf, sizeof(buf)), err, common_usage, t.tokens());
+    return buf;
+}
+
+TEST(limits, defaults_are_unlimited)
+{
+    c4::opt::ParseLimits limits;
+    Args t({"-vv", "--level=2", "-n", "foo", "file"});
+    c4::opt::ParseError err;
+    c4::opt::ViewParser p(common_usage, C4_COUNTOF(common_usage), t.tokens(), limits, &err);
+    EXPECT_FALSE(err);
+    EXPECT_EQ(p.count(VERBOSE), 2);
+    EXPECT_EQ(p(NAME), "foo");
+}
+
+TEST(limits, max_tokens)
+{
+    Args t({"-v", "-v", "-v", "file"});
+    c4::opt::ParseLimits limits;
+    limits.max_tokens = 4;
+    c4::opt::ParseError err;
+    c4::opt::ViewParser ok(common_usage, C4_COUNTOF(common_usage), t.tokens(), limits, &err);
+    EXPECT_FALSE(err);
+    limits.max_tokens = 3;
+    c4::opt::ViewParser p(common_usage, C4_COUNTOF(common_usage), t.tokens(), limits, &err);
+    ASSERT_TRUE(err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_TOO_MANY_TOKENS);
+    EXPECT_EQ(err.argi, 3);
+    // nothing was parsed
+    EXPECT_EQ(p.num_occurrences(), 0u);
+    EXPECT_EQ(message(err, t), "Too many arguments");
+}
+
+TEST(limits, max_bytes)
+{
+    Args t({"-v", "--name", "foo", "file0", "file1"});
+    c4::opt::ParseLimits limits;
+    limits.max_bytes = 21;
+    c4::opt::ParseError err;
+    c4::opt::ViewParser ok(common_usage, C4_COUNTOF(common_usage), t.tokens(), limits, &err);
+    EXPECT_FALSE(err);
+    for(size_t max : {20u, 16u, 10u, 8u, 2u, 1u})
+    {
+        limits.max_bytes = max;
+        c4::opt::ViewParser p(common_usage, C4_COUNTOF(common_usage), t.tokens(), limits, &err);
+        ASSERT_TRUE(err) << max;
+        EXPECT_EQ(err.code, c4::opt::PARSE_TOO_MANY_BYTES) << max;
+        // the token where the limit was crossed
+        size_t total = 0;
+        int argi = 0;
+        while((total += t.sbuf[(size_t)argi].size()) <= max)
+            ++argi;
+        EXPECT_EQ(err.argi, argi) << max;
+    }
+    EXPECT_EQ(message(err, t), "The arguments are too long");
+}
+
+TEST(limits, max_occurrences)
+{
+    Args t({"-vvv", "--level=1", "-v", "-l2", "--verbose"});
+    c4::opt::ParseLimits limits;
+    limits.max_occurrences = 5;
+    c4::opt::ParseError err;
+    c4::opt::ViewParser ok(common_usage, C4_COUNTOF(common_usage), t.tokens(), limits, &err);
+    EXPECT_FALSE(err);
+    EXPECT_EQ(ok.count(VERBOSE), 5);
+    limits.max_occurrences = 3;
+    c4::opt::ViewParser p(common_usage, C4_COUNTOF(common_usage), t.tokens(), limits, &err);
+    ASSERT_TRUE(err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_TOO_MANY_OCCURRENCES);
+    EXPECT_EQ(err.argi, 2);
+    EXPECT_EQ(err.offset, 1);
+    EXPECT_EQ(err.desc, 4);
+    EXPECT_EQ(message(err, t), "Option '-v': given too many times");
+    // with a spec
+    c4::opt::RuntimeSpec rs(common_usage);
+    limits.max_occurrences = 1;
+    c4::opt::ViewParser ps(rs.spec(), t.tokens(), limits, &err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_TOO_MANY_OCCURRENCES);
+    EXPECT_EQ(err.argi, 0);
+    EXPECT_EQ(err.offset, 2);
+}
+
+TEST(limits, max_arg_len)
+{
+    Args t({"--name=abcd", "-nabcde", "-n", "abcdef"});
+    c4::opt::ParseLimits limits;
+    limits.max_arg_len = 6;
+    c4::opt::ParseError err;
+    c4::opt::ViewParser ok(common_usage, C4_COUNTOF(common_usage), t.tokens(), limits, &err);
+    EXPECT_FALSE(err);
+    for(size_t max : {5u, 4u, 3u})
+    {
+        limits.max_arg_len = max;
+        c4::opt::ViewParser p(common_usage, C4_COUNTOF(common_usage), t.tokens(), limits, &err);
+        ASSERT_TRUE(err) << max;
+        EXPECT_EQ(err.code, c4::opt::PARSE_ARG_TOO_LONG) << max;
+        EXPECT_EQ(err.argi, max == 5u ? 2 : (max == 4u ? 1 : 0)) << max;
+        EXPECT_EQ(err.desc, 3) << max;
+    }
+    EXPECT_EQ(message(err, t), "Option '--name': argument is too long");
+}
+
+TEST(limits, max_comparisons)
+{
+    Args t({"-v", "--verbose", "--nope"});
+    c4::opt::ParseLimits limits;
+    // without an index, the descriptors before the option are looked at
+    limits.max_comparisons = 5 + 5 + 2 * 5 + 1;
+    c4::opt::ParseError err;
+    c4::opt::ViewParser ok(common_usage, C4_COUNTOF(common_usage), t.tokens(), limits, &err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_UNKNOWN_OPTION);
+    EXPECT_EQ(ok.count(VERBOSE), 2);
+    limits.max_comparisons = 5 + 5 + 2 * 5;
+    c4::opt::ViewParser p(common_usage, C4_COUNTOF(common_usage), t.tokens(), limits, &err);
+    ASSERT_TRUE(err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_TOO_MUCH_WORK);
+    EXPECT_EQ(err.argi, 2);
+    EXPECT_EQ(message(err, t), "The arguments are too expensive to parse");
+    // with an index, a single one
+    c4::opt::RuntimeSpec rs(common_usage);
+    limits.max_comparisons = 3;
+    c4::opt::ViewParser ps(rs.spec(), t.tokens(), limits, &err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_UNKNOWN_OPTION);
+    limits.max_comparisons = 2;
+    c4::opt::ViewParser ps2(rs.spec(), t.tokens(), limits, &err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_TOO_MUCH_WORK);
+}
+
+TEST(limits, memory_is_bounded)
+{
+    std::vector<std::string> many(100000, "-v");
+    Args t(many);
+    c4::opt::ParseLimits limits;
+    limits.max_tokens = 1000;
+    c4::opt::MemoryResourceCounting mr;
+    c4::opt::ParseError err;
+    {
+        c4::opt::ViewParser p(common_usage, C4_COUNTOF(common_usage), t.tokens(), limits, &err, c4::opt::PARSE_POSIX, &mr);
+        EXPECT_EQ(err.code, c4::opt::PARSE_TOO_MANY_TOKENS);
+    }
+    // only the heads were allocated
+    EXPECT_LT(mr.counts().peak, 128u);
+    limits.max_tokens = size_t(-1);
+    limits.max_occurrences = 1000;
+    {
+        c4::opt::ViewParser p(common_usage, C4_COUNTOF(common_usage), t.tokens(), limits, &err, c4::opt::PARSE_POSIX, &mr);
+        EXPECT_EQ(err.code, c4::opt::PARSE_TOO_MANY_OCCURRENCES);
+        EXPECT_EQ(err.argi, 1000);
+        EXPECT_EQ(p.num_occurrences(), 1000u);
+    }
+    // a single long token: the scratch copy for the checkers is made once
+    std::string group(100000, 'v');
+    group[0] = '-';
+    Args g({group.c_str()});
+    mr.reset();
+    c4::opt::ViewParser p(common_usage, C4_COUNTOF(common_usage), g.tokens(), c4::opt::ParseLimits(), &err, c4::opt::PARSE_POSIX, &mr);
+    EXPECT_FALSE(err);
+    EXPECT_EQ(p.count(VERBOSE), 99999);
+    EXPECT_LT(mr.counts().peak, group.size() + 100000 * (sizeof(c4::opt::ViewOption) + 1));
+}
+
+TEST(limits, long_argument_is_not_copied)
+{
+    // the next token is refused from its length, before it is copied
+    // for the checker: only a bounded prefix of it is ever looked at
+    std::string big(size_t(16) << 20, 'x');
+    for(const char *opt : {"--name", "-n", "-vn"})
+    {
+        std::vector<c4::csubstr> tokens = {c4::to_csubstr(opt), c4::csubstr(big.data(), big.size())};
+        c4::opt::ParseError err;
+        c4::opt::MemoryResourceCounting mr;
+        c4::opt::ParseLimits limits;
+        limits.max_arg_len = 64;
+        {
+            c4::opt::ViewParser p(common_usage, C4_COUNTOF(common_usage), {tokens.data(), tokens.size()}, limits, &err, c4::opt::PARSE_POSIX, &mr);
+            EXPECT_EQ(err.code, c4::opt::PARSE_ARG_TOO_LONG) << opt;
+            EXPECT_EQ(err.argi, 0) << opt;
+        }
+        EXPECT_LT(mr.counts().peak, 1024u) << opt;
+        limits = c4::opt::ParseLimits();
+        limits.max_bytes = 1024;
+        mr.reset();
+        {
+            c4::opt::ViewParser p(common_usage, C4_COUNTOF(common_usage), {tokens.data(), tokens.size()}, limits, &err, c4::opt::PARSE_POSIX, &mr);
+            EXPECT_EQ(err.code, c4::opt::PARSE_TOO_MANY_BYTES) << opt;
+            EXPECT_EQ(err.argi, 1) << opt;
+        }
+        EXPECT_LT(mr.counts().peak, 1024u) << opt;
+    }
+}
+
+TEST(limits, token_positions_fit_in_the_error)
+{
+    // more tokens than ParseError::argi can refer to are refused
+    // before any of them is looked at
+    Args t({"-v"});
+    c4::cspan<c4::csubstr> huge(t.tokens().data(), size_t(INT32_MAX) + 1u);
+    c4::opt::ParseError err;
+    c4::opt::ViewParser p(common_usage, C4_COUNTOF(common_usage), huge, &err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_TOO_MANY_TOKENS);
+    EXPECT_EQ(err.argi, INT32_MAX);
+    EXPECT_EQ(p.num_occurrences(), 0u);
+}
+
+TEST(limits, worst_cases_are_linear)
+{
+    c4::opt::RuntimeSpec rs(common_usage);
+    // each input must parse within a number of descriptor comparisons
+    // and of allocated bytes proportional to its length, and with a
+    // number of allocations which does not grow with it
+    struct Case { const char *name; std::vector<std::string> (*make)(size_t n); };
+    const Case cases[] = {
+        {"short group", [](size_t n){ std::string s(n, 'v'); s[0] = '-'; return std::vector<std::string>{s}; }},
+        {"short group with arg", [](size_t n){ std::string s(n, 'v'); s[0] = '-'; s[n/2] = 'n'; return std::vector<std::string>{s}; }},
+        {"many options", [](size_t n){ return std::vector<std::string>(n / 4, "-vvv"); }},
+        {"long options", [](size_t n){ return std::vector<std::string>(n / 16, "--verbose"); }},
+        {"long values", [](size_t n){ return std::vector<std::string>{"--name", std::string(n, '='), "-l", "1"}; }},
+    };
+    for(Case const& c : cases)
+    {
+        for(size_t n : {20000u, 320000u})
+        {
+            Args tok(c.make(n));
+            c4::opt::ParseLimits limits;
+            // without an index, finding an option of common_usage
+            // looks at no more than 2*5+1 descriptors
+            limits.max_comparisons = 11 * n;
+            for(c4::opt::Spec const* spec : {(c4::opt::Spec const*)nullptr, &rs.spec()})
+            {
+                c4::opt::ParseError err;
+                c4::opt::MemoryResourceCounting mr;
+                {
+                    c4::opt::ViewParser p = spec ?
+                        c4::opt::ViewParser(*spec, tok.tokens(), limits, &err, c4::opt::PARSE_GNU, &mr) :
+                        c4::opt::ViewParser(common_usage, C4_COUNTOF(common_usage), tok.tokens(), limits, &err, c4::opt::PARSE_GNU, &mr);
+                    EXPECT_FALSE(err) << c.name << " n=" << n << " code=" << err.code;
+                }
+                // at most an option per byte, plus the scratch copy
+                // of a token for the checkers
+                EXPECT_LE(mr.counts().peak, (sizeof(c4::opt::ViewOption) + 4) * n + 1024) << c.name << " n=" << n;
+                EXPECT_LE(mr.counts().num_allocs, 4u) << c.name << " n=" << n;
+            }
+        }
+    }
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
@@ -0,0 +1,93 @@
+#include "test_common.hpp"
+#include <c4/opt/opt.hpp>
+#include <c4/opt/view.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+// the profile exists only when c4opt is compiled with C4OPT_PROFILE:
+// this test is linked with a profiled copy of the library
+#ifndef C4OPT_PROFILE
+#error "this test needs C4OPT_PROFILE; see c4opt_add_test(... PROFILED ...)"
+#endif
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+using namespace test_common;
+
+TEST(profile, counters)
+{
+    Args args({"-vv", "--level=2", "--name", "foo", "file"});
+    auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv());
+    c4::opt::ParseProfile const& prof = p.profile;
+    // each pass (stats and parse) looks at the 4 tokens before the
+    // positional argument, which ends the options
+    EXPECT_EQ(prof.tokens, 2u * 4u);
+    // each checker is called once per pass
+    EXPECT_EQ(prof.checks, 2u * 4u);
+    EXPECT_EQ(prof.checks_per_desc[VERBOSE], 2u * 2u);
+    EXPECT_EQ(prof.checks_per_desc[LEVEL], 2u);
+    EXPECT_EQ(prof.checks_per_desc[NAME], 2u);
+    EXPECT_EQ(prof.checks_per_desc[HELP], 0u);
+    // the linear scans compare with each descriptor before the match
+    EXPECT_GE(prof.comparisons, prof.checks);
+    EXPECT_EQ(prof.swaps, 0u);
+    EXPECT_GT(prof.phase_ns[c4::opt::PHASE_STATS] + prof.phase_ns[c4::opt::PHASE_PARSE], 0u);
+    EXPECT_EQ(prof.phase_ns[c4::opt::PHASE_HELP], 0u);
+    // the profile is moved with the parser
+    auto moved = std::move(p);
+    EXPECT_EQ(moved.profile.checks_per_desc[VERBOSE], 2u * 2u);
+}
+
+TEST(profile, spec_does_fewer_comparisons)
+{
+    Args args({"--verbose", "--level=2", "--name", "foo", "-vvv"});
+    c4::opt::RuntimeSpec rs(common_usage);
+    auto plain = c4::opt::make_parser(common_usage, args.argc(), args.argv());
+    auto with_spec = c4::opt::make_parser(rs.spec(), args.argc(), args.argv());
+    EXPECT_EQ(plain.profile.tokens, with_spec.profile.tokens);
+    EXPECT_EQ(plain.profile.checks, with_spec.profile.checks);
+    // one comparison per long option, to confirm the hash lookup
+    EXPECT_EQ(with_spec.profile.comparisons, 2u * 3u);
+    EXPECT_GT(plain.profile.comparisons, with_spec.profile.comparisons);
+}
+
+TEST(profile, workhorse_counts_in_the_current_profile)
+{
+    Args args({"file0", "-v", "file1", "--level", "3", "file2", "-h"});
+    option::Stats stats(/*gnu*/true, common_usage, args.argc(), args.argv());
+    std::vector<option::Option> options(stats.options_max), buffer(stats.buffer_max);
+    // nothing is counted without a current profile
+    option::Parser parser(/*gnu*/true, common_usage, args.argc(), args.argv(), options.data(), buffer.data());
+    option::Profile prof = {};
+    option::Profile::current() = &prof;
+    Args args2({"file0", "-v", "file1", "--level", "3", "file2", "-h"});
+    std::fill(options.begin(), options.end(), option::Option());
+    std::fill(buffer.begin(), buffer.end(), option::Option());
+    parser.parse(/*gnu*/true, common_usage, args2.argc(), args2.argv(), options.data(), buffer.data());
+    option::Profile::current() = nullptr;
+    EXPECT_EQ(parser.optionsCount(), 3);
+    EXPECT_EQ(prof.tokens, 6u); // the argument of --level is not looked at as a token
+    EXPECT_EQ(prof.checks, 3u);
+    // the positional arguments are moved behind the options
+    EXPECT_GT(prof.swaps, 0u);
+}
+
+TEST(profile, view_counts_in_the_current_profile)
+{
+    Args args({"-vv", "--level=2", "--name", "foo", "file"});
+    option::Profile prof = {};
+    option::Profile::current() = &prof;
+    c4::opt::ViewParser vp(common_usage, C4_COUNTOF(common_usage), args.tokens());
+    option::Profile::current() = nullptr;
+    EXPECT_EQ(vp.count(VERBOSE), 2);
+    // each pass (counting and storing) looks at the 4 tokens, the
+    // argument of --name not being one, and calls the checkers once
+    EXPECT_EQ(prof.tokens, 2u * 4u);
+    EXPECT_EQ(prof.checks, 2u * 4u);
+    EXPECT_GE(prof.comparisons, prof.checks);
+    EXPECT_EQ(prof.swaps, 0u);
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
@@ -0,0 +1,170 @@
+#include "test_common.hpp"
+#include <c4/opt/snapshot.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+using namespace test_common;
+
+typedef enum {
+    RATIO = NUM_COMMON_OPTIONS,
+} SnapshotIndex_e;
+static const option::Descriptor snapshot_usage[] =
+{
+    C4OPT_TEST_COMMON_DESCRIPTORS,
+    {RATIO  , 0, "r" , "ratio"  , c4::opt::required, "  -r <val>, --ratio=<val>  \tSet the ratio." },
+    {0,0,0,0,0,0}
+};
+
+/** an 8-byte aligned block */
+struct Blob
+{
+    std::vector<uint64_t> mem;
+    size_t size = 0;
+    template<class P>
+    explicit Blob(P const& p)
+    {
+        size = c4::opt::write_snapshot({}, p);
+        mem.resize((size + 7) / 8);
+        EXPECT_EQ(c4::opt::write_snapshot({(char*)mem.data(), size}, p), size);
+    }
+    char *data() { return (char*)mem.data(); }
+};
+
+std::vector<std::string> names_and_args(c4::opt::Snapshot const& s, int i)
+{
+    std::vector<std::string> v;
+    for(option::Option o : s.opts(i))
+        v.emplace_back(std::string(o.name, o.namelen) + "=" + (o.arg ? o.arg : "(null)"));
+    return v;
+}
+
+TEST(snapshot, query_in_place)
+{
+    Args args({"-vv", "--level=2", "-l", "3", "--name", "foo", "-r0.5", "-n", "x1", "file0", "file1"});
+    auto p = c4::opt::make_parser(snapshot_usage, args.argc(), args.argv());
+    Blob blob(p);
+    // relocate it, and destroy the source arguments
+    Blob moved = blob;
+    memset(blob.data(), 0, blob.size);
+    args.sbuf.assign(args.sbuf.size(), std::string(16, 'x'));
+    c4::opt::Snapshot s(moved.data(), moved.size, snapshot_usage);
+    ASSERT_TRUE(s.ok());
+    EXPECT_EQ(s.count(HELP), 0);
+    EXPECT_FALSE(s[HELP]);
+    EXPECT_EQ(s.count(VERBOSE), 2);
+    EXPECT_EQ(s.count(LEVEL), 2);
+    EXPECT_EQ(s.count(NAME), 2);
+    EXPECT_EQ(s.count(RATIO), 1);
+    EXPECT_STREQ(s(LEVEL), "2");
+    EXPECT_EQ(names_and_args(s, LEVEL), (std::vector<std::string>{"--level=2", "l=3"}));
+    EXPECT_EQ(names_and_args(s, NAME), (std::vector<std::string>{"--name=foo", "n=x1"}));
+    EXPECT_EQ(names_and_args(s, VERBOSE), (std::vector<std::string>{"v=(null)", "v=(null)"}));
+    size_t num = 0;
+    for(option::Option o : s.opts_args())
+    {
+        EXPECT_EQ(o.desc, p.buffer[num].desc);
+        ++num;
+    }
+    EXPECT_EQ(num, (size_t)p.parser.optionsCount());
+    std::vector<std::string> posn;
+    for(const char *arg : s.posn_args())
+        posn.emplace_back(arg);
+    EXPECT_EQ(posn, (std::vector<std::string>{"file0", "file1"}));
+}
+
+TEST(snapshot, typed_values)
+{
+    Args args({"-v", "-l", "-42", "-r", "0.25", "-n", "foo", "-n", ""});
+    auto p = c4::opt::make_parser(snapshot_usage, args.argc(), args.argv());
+    Blob blob(p);
+    c4::opt::Snapshot s(blob.data(), blob.size, snapshot_usage);
+    ASSERT_TRUE(s.ok());
+    EXPECT_EQ(s.first(VERBOSE)->type, c4::opt::SNAPSHOT_VALUE_NONE);
+    EXPECT_EQ(s.first(LEVEL)->type, c4::opt::SNAPSHOT_VALUE_INT);
+    EXPECT_EQ(s.first(LEVEL)->ival, -42);
+    EXPECT_EQ(s.first(RATIO)->type, c4::opt::SNAPSHOT_VALUE_FLOAT);
+    EXPECT_EQ(s.first(RATIO)->fval, 0.25);
+    EXPECT_EQ(s.first(NAME)->type, c4::opt::SNAPSHOT_VALUE_STRING);
+    EXPECT_EQ(s.occurrences()[s.first(NAME)->next].type, c4::opt::SNAPSHOT_VALUE_STRING);
+    EXPECT_STREQ(s.str(s.occurrences()[s.first(NAME)->next].arg), "");
+    EXPECT_EQ(s.first(HELP), nullptr);
+}
+
+TEST(snapshot, from_compact_parser)
+{
+    Args args({"-vl", "7", "--name=x", "--level", "8", "pos"});
+    auto p = c4::opt::make_parser(snapshot_usage, args.argc(), args.argv());
+    c4::opt::CompactParser cp(snapshot_usage, C4_COUNTOF(snapshot_usage), args.argc(), args.argv());
+    Blob blob(p), cblob(cp);
+    ASSERT_EQ(blob.size, cblob.size);
+    EXPECT_EQ(memcmp(blob.data(), cblob.data(), blob.size), 0);
+}
+
+TEST(snapshot, validation)
+{
+    Args args({"-v", "--level=2", "file"});
+    auto p = c4::opt::make_parser(snapshot_usage, args.argc(), args.argv());
+    Blob blob(p);
+    EXPECT_TRUE(c4::opt::Snapshot(blob.data(), blob.size, snapshot_usage).ok());
+    EXPECT_FALSE(c4::opt::Snapshot(nullptr, 0, snapshot_usage).ok());
+    EXPECT_FALSE(c4::opt::Snapshot(blob.data(), blob.size - 8, snapshot_usage).ok());
+    EXPECT_FALSE(c4::opt::Snapshot(blob.data() + 1, blob.size - 1, snapshot_usage).ok());
+    // a different spec
+    EXPECT_FALSE(c4::opt::Snapshot(blob.data(), blob.size, snapshot_usage + 1).ok());
+    // corrupted contents
+    {
+        Blob bad = blob;
+        auto *hdr = (c4::opt::SnapshotHeader*)bad.data();
+        auto *occ = (c4::opt::SnapshotOccurrence*)(bad.data() + hdr->occurrences);
+        occ[0].name = hdr->size;
+        EXPECT_FALSE(c4::opt::Snapshot(bad.data(), bad.size, snapshot_usage).ok());
+    }
+    {
+        Blob bad = blob;
+        auto *hdr = (c4::opt::SnapshotHeader*)bad.data();
+        auto *occ = (c4::opt::SnapshotOccurrence*)(bad.data() + hdr->occurrences);
+        occ[1].next = 0; // a cycle
+        EXPECT_FALSE(c4::opt::Snapshot(bad.data(), bad.size, snapshot_usage).ok());
+    }
+    {
+        Blob bad = blob;
+        auto *hdr = (c4::opt::SnapshotHeader*)bad.data();
+        hdr->num_occurrences = 1000;
+        EXPECT_FALSE(c4::opt::Snapshot(bad.data(), bad.size, snapshot_usage).ok());
+    }
+}
+
+TEST(snapshot, fingerprint)
+{
+    static const option::Descriptor other[] =
+    {
+        {UNKNOWN, 0, ""  , ""       , c4::opt::unknown , "other help" },
+        {HELP   , 0, "h" , "help"   , c4::opt::none    , "other help" },
+        {LEVEL  , 0, "l" , "level"  , c4::opt::integer , "other help" },
+        {NAME   , 0, "n" , "name"   , c4::opt::required, "other help" },
+        {VERBOSE, 0, "v" , "verbose", c4::opt::none    , "other help" },
+        {RATIO  , 0, "r" , "ratio"  , c4::opt::required, "other help" },
+        {0,0,0,0,0,0}
+    };
+    static const option::Descriptor renamed[] =
+    {
+        {UNKNOWN, 0, ""  , ""       , c4::opt::unknown , "" },
+        {HELP   , 0, "h" , "help"   , c4::opt::none    , "" },
+        {LEVEL  , 0, "l" , "lvl"    , c4::opt::integer , "" },
+        {NAME   , 0, "n" , "name"   , c4::opt::required, "" },
+        {VERBOSE, 0, "v" , "verbose", c4::opt::none    , "" },
+        {RATIO  , 0, "r" , "ratio"  , c4::opt::required, "" },
+        {0,0,0,0,0,0}
+    };
+    // the help is not part of the fingerprint
+    EXPECT_EQ(c4::opt::spec_fingerprint(snapshot_usage), c4::opt::spec_fingerprint(other));
+    EXPECT_NE(c4::opt::spec_fingerprint(snapshot_usage), c4::opt::spec_fingerprint(renamed));
+    c4::opt::RuntimeSpec rs(snapshot_usage);
+    EXPECT_EQ(rs.spec().fingerprint(), c4::opt::spec_fingerprint(snapshot_usage));
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
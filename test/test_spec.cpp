@@ -0,0 +1,255 @@
+#include "test_common.hpp"
+#include <c4/opt/complete.hpp>
+#include <c4/opt/opt.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "test_spec.hpp" // generated from test_spec.opt
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+using namespace test_spec_gen;
+
+void check_same_parse(std::initializer_list<const char*> il)
+{
+    Args a(il), b(il);
+    auto linear = c4::opt::make_parser(usage, a.argc(), a.argv());
+    auto indexed = c4::opt::make_parser(spec, b.argc(), b.argv());
+    ASSERT_EQ(linear.parser.optionsCount(), indexed.parser.optionsCount());
+    for(int i = 0; i < linear.parser.optionsCount(); ++i)
+    {
+        EXPECT_EQ(linear.buffer[i].desc, indexed.buffer[i].desc) << i;
+        EXPECT_EQ(linear.buffer[i].namelen, indexed.buffer[i].namelen) << i;
+        EXPECT_EQ(std::string(linear.buffer[i].name), std::string(indexed.buffer[i].name)) << i;
+        if(linear.buffer[i].arg)
+            EXPECT_STREQ(linear.buffer[i].arg, indexed.buffer[i].arg) << i;
+        else
+            EXPECT_EQ(indexed.buffer[i].arg, nullptr) << i;
+    }
+    for(int i = 0; i < (int)C4_COUNTOF(usage); ++i)
+        EXPECT_EQ(linear[i].count(), indexed[i].count()) << i;
+    ASSERT_EQ(linear.parser.nonOptionsCount(), indexed.parser.nonOptionsCount());
+    for(int i = 0; i < linear.parser.nonOptionsCount(); ++i)
+        EXPECT_STREQ(linear.parser.nonOption(i), indexed.parser.nonOption(i));
+}
+
+TEST(spec, generated_tables_match_runtime)
+{
+    c4::opt::RuntimeSpec rt(usage);
+    option::Index const& g = spec.index;
+    option::Index const& r = rt.spec().index;
+    EXPECT_EQ(g.usage, r.usage);
+    EXPECT_EQ(g.num_usage, r.num_usage);
+    EXPECT_EQ(g.num_usage + 1, C4_COUNTOF(usage));
+    EXPECT_EQ(g.options_max, r.options_max);
+    EXPECT_EQ(g.unknown, r.unknown);
+    EXPECT_EQ(g.unknown, 0u);
+    EXPECT_EQ(g.longopt_mask, r.longopt_mask);
+    EXPECT_EQ(g.seed, r.seed);
+    for(unsigned c = 0; c < 256; ++c)
+        EXPECT_EQ(g.shortopt[c], r.shortopt[c]) << c;
+    for(unsigned i = 0; i <= g.longopt_mask; ++i)
+        EXPECT_EQ(g.longopt[i], r.longopt[i]) << i;
+}
+
+TEST(spec, generated_completion_matches_runtime)
+{
+    c4::opt::CompletionIndex rt(usage);
+    c4::opt::CompletionTable const& r = rt.table();
+    EXPECT_EQ(completion.usage, usage);
+    ASSERT_EQ(completion.num_words, r.num_words);
+    for(size_t i = 0; i < r.num_words; ++i)
+    {
+        EXPECT_STREQ(completion.words[i].str, r.words[i].str) << i;
+        EXPECT_EQ(completion.words[i].len, r.words[i].len) << i;
+        EXPECT_EQ(completion.words[i].desc, r.words[i].desc) << i;
+    }
+    EXPECT_EQ(completion.find("--int"), 7);
+    EXPECT_EQ(completion.find("-V"), 8);
+}
+
+TEST(spec, enum)
+{
+    EXPECT_EQ(UNKNOWN, 0u);
+    EXPECT_EQ(INTEGER, 6u);
+    EXPECT_EQ(VERBOSE, 7u);
+    EXPECT_EQ(usage[7].index, INTEGER);
+    EXPECT_EQ(usage[7].type, 1);
+    EXPECT_EQ(usage[8].index, VERBOSE);
+}
+
+TEST(spec, lookup)
+{
+    option::Index const& ix = spec.index;
+    EXPECT_EQ(ix.findShort('h'), 1u);
+    EXPECT_EQ(ix.findShort('v'), 8u);
+    EXPECT_EQ(ix.findShort('V'), 8u);
+    EXPECT_EQ(ix.findShort('x'), ix.num_usage);
+    EXPECT_EQ(ix.findLong("help"), 1u);
+    EXPECT_EQ(ix.findLong("integer=12"), 6u);
+    EXPECT_EQ(ix.findLong("int=12"), 7u);
+    EXPECT_EQ(ix.findLong("in"), ix.num_usage);
+    EXPECT_EQ(ix.findLong("verbosee"), ix.num_usage);
+}
+
+TEST(spec, parse_matches_linear_scan)
+{
+    check_same_parse({});
+    check_same_parse({"-h"});
+    check_same_parse({"-e", "-o", "val", "-r", "req", "-n", "foo", "-i", "123", "arg0", "arg1"});
+    check_same_parse({"--none", "--optional=val", "--required", "req", "--nonempty=foo", "--integer=1", "--int", "2"});
+    check_same_parse({"-vVe", "-i3", "-vr", "x", "--verbose", "--", "-h"});
+    check_same_parse({"-e", "pos", "-v"});
+}
+
+TEST(spec, help_is_prerendered)
+{
+    ASSERT_EQ(spec.num_help, 3u);
+    for(size_t i = 0; i < spec.num_help; ++i)
+    {
+        int w = spec.help[i].width;
+        c4::csubstr rendered = c4::opt::help_text(usage, w);
+        c4::csubstr pre = spec.help_text(w);
+        EXPECT_EQ(pre.str, spec.help[i].str);
+        EXPECT_EQ(std::string(pre.str, pre.len), std::string(rendered.str, rendered.len)) << w;
+    }
+    // widths which were not pre-rendered are rendered on demand
+    c4::csubstr txt = spec.help_text(33);
+    c4::csubstr rendered = c4::opt::help_text(usage, 33);
+    EXPECT_EQ(txt.str, rendered.str);
+}
+
+TEST(spec, runtime_spec_many_options)
+{
+    const size_t num = 1500;
+    std::vector<std::string> names;
+    for(size_t i = 0; i < num; ++i)
+        names.push_back("option-" + std::to_string(i));
+    std::vector<option::Descriptor> descs;
+    descs.push_back({0, 0, "", "", c4::opt::unknown, ""});
+    for(size_t i = 0; i < num; ++i)
+        descs.push_back({(unsigned)i+1, 0, "", names[i].c_str(), c4::opt::none, ""});
+    descs.push_back({0, 0, 0, 0, 0, 0});
+    c4::opt::RuntimeSpec rt(descs.data());
+    option::Index const& ix = rt.spec().index;
+    EXPECT_EQ(ix.num_usage, num + 1);
+    EXPECT_EQ(ix.options_max, num + 2);
+    EXPECT_GE(rt.num_longopt_slots(), 2 * (num + 1));
+    for(size_t i = 0; i < num; ++i)
+        EXPECT_EQ(ix.findLong(names[i].c_str()), i + 1);
+    EXPECT_EQ(ix.findLong("option-"), ix.num_usage);
+    EXPECT_EQ(ix.findLong("option-1500"), ix.num_usage);
+    // the empty long option of the dummy descriptor is also found
+    EXPECT_EQ(ix.findLong(""), 0u);
+}
+
+TEST(spec, runtime_spec_move)
+{
+    c4::opt::RuntimeSpec rt(usage);
+    unsigned const* tables = rt.spec().index.shortopt;
+    c4::opt::RuntimeSpec moved(std::move(rt));
+    EXPECT_EQ(moved.spec().index.shortopt, tables);
+    EXPECT_EQ(moved.spec().index.findLong("help"), 1u);
+}
+
+
+//-----------------------------------------------------------------------------
+
+#if C4_CPP >= 14
+
+namespace {
+constexpr const option::Descriptor cusage[] = {
+    {0, 0, ""  , ""       , c4::opt::unknown , "USAGE: app [options]\n\nOptions:"},
+    {1, 0, "h" , "help"   , c4::opt::none    , "  -h, --help  \tPrint usage and exit."},
+    {2, 0, "vV", "verbose", c4::opt::none    , "  -v, --verbose  \tBe verbose."},
+    {3, 0, "l" , "level"  , c4::opt::integer , "  -l <val>, --level=<val>  \tSet the level."},
+    {3, 1, ""  , "lvl"    , c4::opt::integer , "  --lvl=<val>  \tSame as --level."},
+    {0, 0, 0, 0, 0, 0}
+};
+C4OPT_COMPILE_SPEC(cspec, cusage);
+
+constexpr const option::Descriptor no_sentinel[] = {
+    {0, 0, "a", "aaa", c4::opt::none, ""},
+};
+constexpr const option::Descriptor early_sentinel[] = {
+    {0, 0, "a", "aaa", c4::opt::none, ""},
+    {0, 0, 0, 0, 0, 0},
+    {1, 0, "b", "bbb", c4::opt::none, ""},
+    {0, 0, 0, 0, 0, 0}
+};
+constexpr const option::Descriptor null_longopt[] = {
+    {0, 0, "a", nullptr, c4::opt::none, ""},
+    {0, 0, 0, 0, 0, 0}
+};
+constexpr const option::Descriptor minus_shortopt[] = {
+    {0, 0, "a-", "aaa", c4::opt::none, ""},
+    {0, 0, 0, 0, 0, 0}
+};
+constexpr const option::Descriptor dup_shortopt[] = {
+    {0, 0, "a", "aaa", c4::opt::none, ""},
+    {1, 0, "ba", "bbb", c4::opt::none, ""},
+    {0, 0, 0, 0, 0, 0}
+};
+constexpr const option::Descriptor dup_longopt[] = {
+    {0, 0, "a", "aaa", c4::opt::none, ""},
+    {1, 0, "b", "aaa", c4::opt::none, ""},
+    {0, 0, 0, 0, 0, 0}
+};
+constexpr const option::Descriptor bad_index[] = {
+    {0, 0, "a", "aaa", c4::opt::none, ""},
+    {2, 0, "b", "bbb", c4::opt::none, ""},
+    {0, 0, 0, 0, 0, 0}
+};
+static_assert(c4::opt::compile(no_sentinel).status == c4::opt::SPEC_MISSING_SENTINEL, "");
+static_assert(c4::opt::compile(early_sentinel).status == c4::opt::SPEC_MISSING_SENTINEL, "");
+static_assert(c4::opt::compile(early_sentinel).bad_entry == 1, "");
+static_assert(c4::opt::compile(null_longopt).status == c4::opt::SPEC_NULL_LONGOPT, "");
+static_assert(c4::opt::compile(minus_shortopt).status == c4::opt::SPEC_MINUS_SHORTOPT, "");
+static_assert(c4::opt::compile(dup_shortopt).status == c4::opt::SPEC_DUPLICATE_SHORTOPT, "");
+static_assert(c4::opt::compile(dup_shortopt).bad_entry == 1, "");
+static_assert(c4::opt::compile(dup_longopt).status == c4::opt::SPEC_DUPLICATE_LONGOPT, "");
+static_assert(c4::opt::compile(bad_index).status == c4::opt::SPEC_INDEX_OUT_OF_RANGE, "");
+// the derived values are available at compile time
+static_assert(cspec.ok(), "");
+static_assert(cspec.options_max == 5, "");
+static_assert(cspec.unknown == 0, "");
+static_assert(cspec.shortopt['v'] == 2 && cspec.shortopt['V'] == 2, "");
+static_assert(cspec.shortopt['l'] == 3, "");
+static_assert(cspec.shortopt['x'] == 5, "");
+} // anon
+
+TEST(compile, matches_runtime_spec)
+{
+    c4::opt::RuntimeSpec rt(cusage);
+    c4::opt::Spec cs = cspec.spec();
+    option::Index const& r = rt.spec().index;
+    EXPECT_EQ(cs.index.usage, r.usage);
+    EXPECT_EQ(cs.index.num_usage, r.num_usage);
+    EXPECT_EQ(cs.index.options_max, r.options_max);
+    EXPECT_EQ(cs.index.unknown, r.unknown);
+    for(unsigned c = 0; c < 256; ++c)
+        EXPECT_EQ(cs.index.shortopt[c], r.shortopt[c]) << c;
+    for(unsigned pos = 0; pos < r.num_usage; ++pos)
+        EXPECT_EQ(cs.index.findLong(cusage[pos].longopt), r.findLong(cusage[pos].longopt)) << pos;
+    EXPECT_EQ(cs.index.findLong("lvl=3"), 4u);
+    EXPECT_EQ(cs.index.findLong("le"), 5u);
+}
+
+TEST(compile, parse)
+{
+    Args a({"-vV", "--lvl=3", "-l", "4", "--verbose", "pos"});
+    auto p = c4::opt::make_parser(cspec, a.argc(), a.argv());
+    EXPECT_EQ(p[2].count(), 3);
+    EXPECT_EQ(p[3].count(), 2);
+    EXPECT_STREQ(p[3].arg, "3");
+    EXPECT_EQ(p[3].type(), 1);
+    EXPECT_STREQ(p[3].last()->arg, "4");
+    EXPECT_EQ(p[3].last()->type(), 0);
+    ASSERT_EQ(p.parser.nonOptionsCount(), 1);
+    EXPECT_STREQ(p.parser.nonOption(0), "pos");
+}
+
+#endif // C4_CPP >= 14
+
+C4_SUPPRESS_WARNING_GCC_POP
@@ -0,0 +1,224 @@
+#include <c4/opt/spec_cache.hpp>
+#include <c4/opt/opt.hpp>
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+typedef enum {
+    UNKNOWN,
+    HELP,
+    LEVEL,
+    VERBOSE,
+    PLUGIN0,
+} SpecCacheIndex_e;
+
+/** a usage assembled at runtime, as from plugins */
+struct PluginUsage
+{
+    std::vector<std::string> names, helps;
+    std::vector<option::Descriptor> usage;
+    explicit PluginUsage(unsigned num_plugins, const char *name_suffix="", const char *help_suffix="")
+    {
+        names.reserve(num_plugins);
+        helps.reserve(num_plugins);
+        usage.push_back({UNKNOWN, 0, "" , ""       , c4::opt::unknown , "USAGE: app [options]\n\nOptions:"});
+        usage.push_back({HELP   , 0, "h", "help"   , c4::opt::none    , "  -h, --help  \tPrint usage and exit."});
+        usage.push_back({LEVEL  , 0, "l", "level"  , c4::opt::integer , "  -l <val>, --level=<val>  \tSet the level."});
+        usage.push_back({VERBOSE, 0, "v", "verbose", c4::opt::none    , "  -v, --verbose  \tBe verbose."});
+        for(unsigned i = 0; i < num_plugins; ++i)
+        {
+            names.emplace_back("plugin" + std::to_string(i) + "-opt" + name_suffix);
+            helps.emplace_back("  --" + names.back() + "=<val>  \tAn option of plugin " + std::to_string(i) + "." + help_suffix);
+        }
+        for(unsigned i = 0; i < num_plugins; ++i)
+            usage.push_back({PLUGIN0 + i, 0, "", names[i].c_str(), c4::opt::required, helps[i].c_str()});
+        usage.push_back({0, 0, 0, 0, 0, 0});
+    }
+    option::Descriptor const* data() const { return usage.data(); }
+};
+
+struct TmpFile
+{
+    std::string path;
+    explicit TmpFile(const char *name) : path(testing::TempDir() + name) { remove(path.c_str()); }
+    ~TmpFile() { remove(path.c_str()); }
+    const char *c_str() const { return path.c_str(); }
+    std::string contents() const
+    {
+        std::string s;
+        FILE *f = fopen(path.c_str(), "rb");
+        if( ! f)
+            return s;
+        char buf[4096];
+        size_t n;
+        while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+            s.append(buf, n);
+        fclose(f);
+        return s;
+    }
+    void write(std::string const& s) const
+    {
+        FILE *f = fopen(path.c_str(), "wb");
+        fwrite(s.data(), 1, s.size(), f);
+        fclose(f);
+    }
+};
+
+void check_parse(c4::opt::Spec const& spec)
+{
+    std::vector<const char*> args = {"-v", "--plugin17-opt=x", "--level", "3", "--plugin999-opt", "y", "file"};
+    auto p = c4::opt::make_parser(spec, (int)args.size(), args.data());
+    EXPECT_EQ(p[VERBOSE].count(), 1);
+    EXPECT_STREQ(p(LEVEL), "3");
+    EXPECT_STREQ(p(PLUGIN0 + 17), "x");
+    EXPECT_STREQ(p(PLUGIN0 + 999), "y");
+    EXPECT_EQ(p[PLUGIN0 + 18].count(), 0);
+}
+
+TEST(spec_cache, build_then_load)
+{
+    TmpFile file("c4opt_spec_cache_build_then_load.bin");
+    PluginUsage u(1000);
+    std::string first_help;
+    {
+        c4::opt::SpecCache cache(file.c_str(), u.data(), {80, 120});
+        EXPECT_FALSE(cache.loaded());
+        EXPECT_TRUE(cache.written());
+        check_parse(cache.spec());
+        first_help = std::string(cache.spec().help_text(120).str, cache.spec().help_text(120).len);
+    }
+    std::string contents = file.contents();
+    ASSERT_FALSE(contents.empty());
+    {
+        c4::opt::SpecCache cache(file.c_str(), u.data(), {80, 120});
+        EXPECT_TRUE(cache.loaded());
+        EXPECT_FALSE(cache.written());
+        check_parse(cache.spec());
+        ASSERT_EQ(cache.spec().num_help, 2u);
+        c4::csubstr h = cache.spec().help_text(120);
+        EXPECT_EQ(std::string(h.str, h.len), first_help);
+        c4::csubstr h80 = cache.spec().help_text(80);
+        c4::csubstr expected = c4::opt::help_text(u.data(), 80);
+        EXPECT_EQ(std::string(h80.str, h80.len), std::string(expected.str, expected.len));
+    }
+    // the file was not rewritten
+    EXPECT_EQ(file.contents(), contents);
+}
+
+TEST(spec_cache, rebuilt_when_descriptors_change)
+{
+    TmpFile file("c4opt_spec_cache_rebuilt.bin");
+    PluginUsage u(1000), renamed(1000, "x"), rehelped(1000, "", " Changed."), same(1000);
+    {
+        c4::opt::SpecCache cache(file.c_str(), u.data());
+        EXPECT_FALSE(cache.loaded());
+    }
+    {
+        // same contents, different memory
+        c4::opt::SpecCache cache(file.c_str(), same.data());
+        EXPECT_TRUE(cache.loaded());
+        check_parse(cache.spec());
+    }
+    {
+        c4::opt::SpecCache cache(file.c_str(), renamed.data());
+        EXPECT_FALSE(cache.loaded());
+        EXPECT_TRUE(cache.written());
+    }
+    {
+        // the help is part of the key
+        c4::opt::SpecCache cache(file.c_str(), rehelped.data());
+        EXPECT_FALSE(cache.loaded());
+    }
+}
+
+TEST(spec_cache, rebuilt_when_widths_change)
+{
+    TmpFile file("c4opt_spec_cache_widths.bin");
+    PluginUsage u(100);
+    {
+        c4::opt::SpecCache cache(file.c_str(), u.data(), {80});
+        EXPECT_FALSE(cache.loaded());
+    }
+    {
+        c4::opt::SpecCache cache(file.c_str(), u.data(), {80, 120});
+        EXPECT_FALSE(cache.loaded());
+        EXPECT_TRUE(cache.written());
+        ASSERT_EQ(cache.spec().num_help, 2u);
+        c4::csubstr h = cache.spec().help_text(120);
+        c4::csubstr expected = c4::opt::help_text(u.data(), 120);
+        EXPECT_EQ(std::string(h.str, h.len), std::string(expected.str, expected.len));
+    }
+    {
+        c4::opt::SpecCache cache(file.c_str(), u.data(), {80, 120});
+        EXPECT_TRUE(cache.loaded());
+    }
+    {
+        c4::opt::SpecCache cache(file.c_str(), u.data(), {120, 80});
+        EXPECT_FALSE(cache.loaded());
+    }
+    {
+        c4::opt::SpecCache cache(file.c_str(), u.data(), {});
+        EXPECT_FALSE(cache.loaded());
+        EXPECT_EQ(cache.spec().num_help, 0u);
+    }
+}
+
+TEST(spec_cache, rebuilt_when_corrupted)
+{
+    TmpFile file("c4opt_spec_cache_corrupted.bin");
+    PluginUsage u(200);
+    {
+        c4::opt::SpecCache cache(file.c_str(), u.data());
+    }
+    std::string good = file.contents();
+    ASSERT_GT(good.size(), sizeof(c4::opt::SpecCacheHeader));
+    auto check_rebuilt = [&](std::string const& bad){
+        file.write(bad);
+        c4::opt::SpecCache cache(file.c_str(), u.data());
+        EXPECT_FALSE(cache.loaded());
+        {
+            std::vector<const char*> args = {"-v", "--plugin17-opt=x"};
+            auto p = c4::opt::make_parser(cache.spec(), (int)args.size(), args.data());
+            EXPECT_STREQ(p(PLUGIN0 + 17), "x");
+        }
+        EXPECT_EQ(file.contents(), good);
+    };
+    check_rebuilt(good.substr(0, good.size() / 2)); // truncated
+    check_rebuilt("");
+    {
+        std::string bad = good;
+        bad[0] = 'x'; // magic
+        check_rebuilt(bad);
+    }
+    {
+        std::string bad = good;
+        auto *hdr = (c4::opt::SpecCacheHeader*)&bad[0];
+        uint32_t *longopt = (uint32_t*)&bad[hdr->longopt];
+        for(uint32_t s = 0; s <= hdr->longopt_mask; ++s)
+            if(longopt[s] == hdr->num_usage)
+                longopt[s] = 0; // no empty slots: lookups would not terminate
+        check_rebuilt(bad);
+    }
+    {
+        std::string bad = good;
+        auto *hdr = (c4::opt::SpecCacheHeader*)&bad[0];
+        uint32_t *shortopt = (uint32_t*)&bad[hdr->shortopt];
+        shortopt[(unsigned char)'v'] = hdr->num_usage; // -v would not be found
+        check_rebuilt(bad);
+    }
+}
+
+TEST(spec_cache, serialized_size)
+{
+    PluginUsage u(10);
+    c4::opt::RuntimeSpec rs(u.data());
+    size_t sz = c4::opt::write_spec_cache({}, rs.spec());
+    EXPECT_EQ(sz % 8, 0u);
+    EXPECT_EQ(sz, sizeof(c4::opt::SpecCacheHeader) + 256 * 4 + rs.num_longopt_slots() * 4);
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
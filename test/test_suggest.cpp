@@ -0,0 +1,234 @@
+#include "test_common.hpp"
+#include <c4/opt/suggest.hpp>
+#include <c4/opt/compact.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+using namespace test_common;
+
+typedef enum {
+    VERSION = NUM_COMMON_OPTIONS,
+    VERBOSITY,
+} SuggestIndex_e;
+static const option::Descriptor suggest_usage[] =
+{
+    C4OPT_TEST_COMMON_DESCRIPTORS,
+    {VERSION, 0, ""  , "version", c4::opt::none    , "  --version  \tPrint the version and exit." },
+    {VERBOSITY, 0, "", "verbosity", c4::opt::integer, "  --verbosity=<val>  \tSet the verbosity." },
+    {0,0,0,0,0,0}
+};
+
+std::string suggestions(const char *arg)
+{
+    Args args({arg});
+    c4::opt::ParseError err;
+    c4::opt::CompactParser p(suggest_usage, C4_COUNTOF(suggest_usage), args.argc(), args.argv(), &err);
+    size_t len = c4::opt::format_suggestions({}, err, suggest_usage, args.argc(), args.argv());
+    std::string s(len + 1, '\0');
+    EXPECT_EQ(c4::opt::format_suggestions({&s[0], s.size()}, err, suggest_usage, args.argc(), args.argv()), len);
+    s.resize(len);
+    return s;
+}
+
+size_t levenshtein(std::string const& a, std::string const& b)
+{
+    std::vector<size_t> row(b.size() + 1);
+    for(size_t j = 0; j <= b.size(); ++j)
+        row[j] = j;
+    for(size_t i = 1; i <= a.size(); ++i)
+    {
+        size_t diag = row[0];
+        row[0] = i;
+        for(size_t j = 1; j <= b.size(); ++j)
+        {
+            size_t up = row[j];
+            row[j] = std::min({row[j] + 1, row[j-1] + 1, diag + (a[i-1] != b[j-1])});
+            diag = up;
+        }
+    }
+    return row[b.size()];
+}
+
+TEST(suggest, index_by_length)
+{
+    c4::opt::SuggestIndex ix(suggest_usage);
+    EXPECT_EQ(ix.num_names(), 6u);
+    EXPECT_EQ(ix.usage(), suggest_usage);
+    c4::opt::Suggestion out[4];
+    ASSERT_EQ(ix.suggest("verbos", out), 1u);
+    EXPECT_EQ(out[0].desc, 4);
+    EXPECT_EQ(out[0].distance, 1u);
+    // ties are in the order of the usage
+    ASSERT_EQ(ix.suggest("verbosion", out), 3u);
+    EXPECT_EQ(out[0].desc, 5); // version
+    EXPECT_EQ(out[0].distance, 2u);
+    EXPECT_EQ(out[1].desc, 6); // verbosity
+    EXPECT_EQ(out[1].distance, 2u);
+    EXPECT_EQ(out[2].desc, 4); // verbose
+    EXPECT_EQ(out[2].distance, 3u);
+    // the exact name is at distance 0
+    ASSERT_EQ(ix.suggest("name", out), 1u);
+    EXPECT_EQ(out[0].desc, 3);
+    EXPECT_EQ(out[0].distance, 0u);
+    // nothing close enough
+    EXPECT_EQ(ix.suggest("xyzzy", out), 0u);
+    EXPECT_EQ(ix.suggest("", out), 0u);
+    EXPECT_EQ(ix.suggest(c4::csubstr(std::string(65, 'a').c_str(), 65), out), 0u);
+}
+
+TEST(suggest, limits)
+{
+    c4::opt::SuggestIndex ix(suggest_usage);
+    c4::opt::Suggestion out[4];
+    c4::opt::SuggestLimits limits;
+    limits.max_distance = 2;
+    ASSERT_EQ(ix.suggest("verbosion", out, limits), 2u);
+    EXPECT_EQ(out[0].desc, 5);
+    EXPECT_EQ(out[1].desc, 6);
+    limits.max_distance = 4;
+    ASSERT_EQ(ix.suggest("lvl", out, limits), 3u);
+    EXPECT_EQ(out[0].desc, 2); // level
+    EXPECT_EQ(out[0].distance, 2u);
+    EXPECT_EQ(out[1].desc, 1); // help
+    EXPECT_EQ(out[1].distance, 3u);
+    EXPECT_EQ(out[2].desc, 3); // name
+    EXPECT_EQ(out[2].distance, 4u);
+    // the k best
+    ASSERT_EQ(ix.suggest("lvl", c4::span<c4::opt::Suggestion>(out, 1), limits), 1u);
+    EXPECT_EQ(out[0].desc, 2);
+}
+
+TEST(suggest, matches_the_edit_distance)
+{
+    // many similar names, and typos of them
+    std::mt19937 rng(12345);
+    const char alphabet[] = "abcde-";
+    std::vector<std::string> names;
+    for(int i = 0; i < 2000; ++i)
+    {
+        std::string s(3 + rng() % 10, 'a');
+        for(char &c : s)
+            c = alphabet[rng() % 5];
+        names.push_back(s);
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    std::vector<option::Descriptor> usage;
+    usage.push_back(suggest_usage[0]);
+    for(size_t i = 0; i < names.size(); ++i)
+        usage.push_back({(unsigned)i + 1, 0, "", names[i].c_str(), c4::opt::none, ""});
+    usage.push_back({0, 0, 0, 0, 0, 0});
+    c4::opt::SuggestIndex ix(usage.data());
+    c4::opt::SuggestLimits limits;
+    limits.max_ns = uint64_t(-1);
+    for(int t = 0; t < 200; ++t)
+    {
+        std::string typo = names[rng() % names.size()];
+        typo[rng() % typo.size()] = alphabet[rng() % 6];
+        if(rng() % 2)
+            typo.erase(rng() % typo.size(), 1);
+        if(typo.empty())
+            continue;
+        c4::opt::Suggestion out[5];
+        size_t num = ix.suggest(c4::csubstr(typo.data(), typo.size()), out, limits);
+        // the same as sorting all the names by (distance, position)
+        std::vector<std::pair<size_t, int32_t>> expected;
+        const size_t bound = (typo.size() + 2) / 3;
+        for(size_t i = 0; i < names.size(); ++i)
+        {
+            size_t dist = levenshtein(typo, names[i]);
+            if(dist <= bound)
+                expected.emplace_back(dist, (int32_t)i + 1);
+        }
+        std::sort(expected.begin(), expected.end());
+        ASSERT_EQ(num, std::min(expected.size(), (size_t)5)) << typo;
+        for(size_t i = 0; i < num; ++i)
+        {
+            EXPECT_EQ(out[i].distance, expected[i].first) << typo << " " << i;
+            EXPECT_EQ(out[i].desc, expected[i].second) << typo << " " << i;
+        }
+    }
+}
+
+TEST(suggest, time_budget)
+{
+    std::vector<std::string> names;
+    for(int i = 0; i < 1000; ++i)
+        names.push_back("option" + std::to_string(1000 + i));
+    std::vector<option::Descriptor> usage;
+    usage.push_back(suggest_usage[0]);
+    for(size_t i = 0; i < names.size(); ++i)
+        usage.push_back({(unsigned)i + 1, 0, "", names[i].c_str(), c4::opt::none, ""});
+    usage.push_back({0, 0, 0, 0, 0, 0});
+    c4::opt::SuggestIndex ix(usage.data());
+    c4::opt::Suggestion out[3];
+    c4::opt::SuggestLimits limits;
+    ASSERT_EQ(ix.suggest("option1999x", out, limits), 3u);
+    EXPECT_EQ(out[0].desc, 1000);
+    EXPECT_EQ(out[0].distance, 1u);
+    // no time at all: the search stops at the first look at the clock
+    limits.max_ns = 0;
+    size_t num = ix.suggest("option1999x", out, limits);
+    EXPECT_LE(num, 3u);
+    for(size_t i = 1; i < num; ++i)
+        EXPECT_LE(out[i-1].distance, out[i].distance);
+}
+
+TEST(suggest, cache)
+{
+    c4::opt::Suggestion out[3];
+    ASSERT_EQ(c4::opt::suggest(suggest_usage, "helpp", out), 1u);
+    EXPECT_EQ(out[0].desc, 1);
+    c4::opt::clear_suggest_cache();
+    ASSERT_EQ(c4::opt::suggest(suggest_usage, "hlp", out), 1u);
+    EXPECT_EQ(out[0].desc, 1);
+}
+
+TEST(suggest, is_cached_by_contents)
+{
+    c4::opt::Suggestion out[3];
+    {
+        // the index of a copy which is gone is used with the original
+        std::vector<option::Descriptor> copy(suggest_usage, suggest_usage + C4_COUNTOF(suggest_usage));
+        ASSERT_EQ(c4::opt::suggest(copy.data(), "helpp", out), 1u);
+        EXPECT_EQ(out[0].desc, HELP);
+    }
+    ASSERT_EQ(c4::opt::suggest(suggest_usage, "nmae", out), 1u);
+    EXPECT_EQ(out[0].desc, NAME);
+    // other long options at the same address do not get the old index
+    std::vector<option::Descriptor> copy(suggest_usage, suggest_usage + C4_COUNTOF(suggest_usage));
+    EXPECT_EQ(c4::opt::suggest(copy.data(), "verbatimlx", out), 0u);
+    new (&copy[VERBOSE]) option::Descriptor{VERBOSE, 0, "v", "verbatimly", c4::opt::none, "  -v, --verbatimly  \tBe verbatim."};
+    ASSERT_EQ(c4::opt::suggest(copy.data(), "verbatimlx", out), 1u);
+    EXPECT_EQ(out[0].desc, VERBOSE);
+    EXPECT_EQ(out[0].distance, 1u);
+}
+
+TEST(suggest, message)
+{
+    EXPECT_EQ(suggestions("--verbos"), "Did you mean '--verbose'?");
+    EXPECT_EQ(suggestions("--nmae=foo"), "Did you mean '--name'?");
+    EXPECT_EQ(suggestions("--verbosio"), "Did you mean '--verbose', '--verbosity' or '--version'?");
+    EXPECT_EQ(suggestions("--verbosion"), "Did you mean '--version', '--verbosity' or '--verbose'?");
+    EXPECT_EQ(suggestions("--xyzzy"), "");
+    // not for short options, nor for other errors
+    EXPECT_EQ(suggestions("-x"), "");
+    EXPECT_EQ(suggestions("--level=abc"), "");
+    EXPECT_EQ(suggestions("--verbose"), "");
+    // snprintf-style
+    Args args({"--verbosion"});
+    c4::opt::ParseError err;
+    c4::opt::CompactParser p(suggest_usage, C4_COUNTOF(suggest_usage), args.argc(), args.argv(), &err);
+    char buf[8];
+    EXPECT_EQ(c4::opt::format_suggestions({buf, sizeof(buf)}, err, suggest_usage, args.argc(), args.argv()), strlen("Did you mean '--version', '--verbosity' or '--verbose'?"));
+    EXPECT_STREQ(buf, "Did you");
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
@@ -0,0 +1,116 @@
+#include "test_common.hpp"
+#include <c4/opt/tokenizer.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+using namespace test_common;
+
+std::string describe(c4::opt::Token const& t)
+{
+    switch(t.kind)
+    {
+    case c4::opt::TOKEN_OPTION:
+        return std::string(t.option.name, t.option.namelen) + "=" + (t.option.arg ? t.option.arg : "(null)");
+    case c4::opt::TOKEN_POSITIONAL:
+        return std::string("posn:") + t.arg;
+    case c4::opt::TOKEN_ERROR:
+        return std::string("error:") + std::string(t.option.name, t.option.namelen);
+    default:
+        return "end";
+    }
+}
+
+TEST(tokenizer, same_results_as_parser)
+{
+    Args args({"-vv", "-l1", "--level=2", "-l", "3", "--level", "4", "-n=", "--name=foo", "-vn", "bar", "-hvl5", "file0", "-v", "file1"});
+    auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv());
+    std::vector<std::string> expected, actual;
+    for(option::Option const& o : p.opts_args())
+        expected.emplace_back(std::string(o.name, o.namelen) + "=" + (o.arg ? o.arg : "(null)"));
+    for(const char *a : p.posn_args())
+        expected.emplace_back(std::string("posn:") + a);
+    c4::opt::Tokenizer tk(common_usage, args.argc(), args.argv());
+    for(c4::opt::Token const& t : tk)
+        actual.emplace_back(describe(t));
+    EXPECT_EQ(actual, expected);
+    EXPECT_FALSE(tk.error());
+    // with the spec
+    c4::opt::RuntimeSpec rs(common_usage);
+    c4::opt::Tokenizer tks(rs.spec(), args.argc(), args.argv());
+    actual.clear();
+    for(c4::opt::Token const& t : tks)
+        actual.emplace_back(describe(t));
+    EXPECT_EQ(actual, expected);
+}
+
+TEST(tokenizer, stop_early)
+{
+    Args args({"-v", "--help", "--level=notanumber", "file"});
+    c4::opt::Tokenizer tk(common_usage, args.argc(), args.argv());
+    c4::opt::Token t;
+    ASSERT_TRUE(tk.next(&t));
+    EXPECT_EQ(t.option.index(), VERBOSE);
+    ASSERT_TRUE(tk.next(&t));
+    EXPECT_EQ(t.option.index(), HELP);
+    EXPECT_EQ(t.argi, 1);
+    // the rest of argv was not looked at
+    EXPECT_EQ(tk.position(), 2);
+    EXPECT_FALSE(tk.error());
+}
+
+TEST(tokenizer, error_ends_the_iteration)
+{
+    Args args({"-v", "-vl", "x", "--name", "foo"});
+    c4::opt::Tokenizer tk(common_usage, args.argc(), args.argv());
+    std::vector<std::string> actual;
+    for(c4::opt::Token const& t : tk)
+        actual.emplace_back(describe(t));
+    EXPECT_EQ(actual, (std::vector<std::string>{"v=(null)", "v=(null)", "error:l"}));
+    ASSERT_TRUE(tk.error());
+    EXPECT_EQ(tk.error().code, c4::opt::PARSE_ILLEGAL_ARGUMENT);
+    EXPECT_EQ(tk.error().argi, 1);
+    EXPECT_EQ(tk.error().offset, 2);
+    c4::opt::Token t;
+    EXPECT_FALSE(tk.next(&t));
+    EXPECT_EQ(t.kind, c4::opt::TOKEN_END);
+}
+
+TEST(tokenizer, gnu_mode)
+{
+    Args args({"file0", "-v", "-", "--level", "3", "file1", "--", "-n"});
+    const std::vector<const char*> orig = args.cbuf;
+    c4::opt::Tokenizer tk(common_usage, args.argc(), args.argv(), c4::opt::PARSE_GNU);
+    std::vector<std::string> actual;
+    for(c4::opt::Token const& t : tk)
+        actual.emplace_back(describe(t));
+    EXPECT_EQ(actual, (std::vector<std::string>{"posn:file0", "v=(null)", "posn:-", "--level=3", "posn:file1", "posn:-n"}));
+    EXPECT_EQ(args.cbuf, orig);
+}
+
+TEST(tokenizer, null_terminated_argv)
+{
+    Args args({"-v", "file"});
+    ASSERT_EQ(args.argv()[args.argc()], nullptr);
+    c4::opt::Tokenizer tk(common_usage, -1, args.argv());
+    std::vector<std::string> actual;
+    for(c4::opt::Token const& t : tk)
+        actual.emplace_back(describe(t));
+    EXPECT_EQ(actual, (std::vector<std::string>{"v=(null)", "posn:file"}));
+}
+
+#ifdef C4OPT_HAS_COROUTINES
+TEST(tokenizer, coroutine)
+{
+    Args args({"-vl3", "--name", "foo", "file"});
+    std::vector<std::string> actual;
+    for(c4::opt::Token const& t : c4::opt::tokens(c4::opt::Tokenizer(common_usage, args.argc(), args.argv())))
+        actual.emplace_back(describe(t));
+    EXPECT_EQ(actual, (std::vector<std::string>{"v=(null)", "l=3", "--name=foo", "posn:file"}));
+}
+#endif
+
+C4_SUPPRESS_WARNING_GCC_POP
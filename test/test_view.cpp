@@ -0,0 +1,120 @@
+#include "test_common.hpp"
+#include <c4/opt/view.hpp>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+C4_SUPPRESS_WARNING_GCC_PUSH
+C4_SUPPRESS_WARNING_GCC("-Wsign-conversion")
+
+using namespace test_common;
+
+std::string str(c4::csubstr s)
+{
+    return std::string(s.str, s.len);
+}
+
+TEST(view, same_results_as_parser)
+{
+    Args args({"-vv", "-l1", "--level=2", "-l", "3", "--level", "4", "-n=", "--name=foo", "-vn", "bar", "--name", "", "file0", "file1"});
+    auto p = c4::opt::make_parser(common_usage, args.argc(), args.argv());
+    auto vp = c4::opt::make_parser(common_usage, args.tokens());
+    ASSERT_EQ(vp.num_occurrences(), (size_t)p.parser.optionsCount());
+    for(int i : {HELP, LEVEL, NAME, VERBOSE})
+    {
+        EXPECT_EQ(vp.count(i), p[i].count()) << i;
+        EXPECT_EQ((bool)vp[i], (bool)p[i]) << i;
+        std::vector<std::string> expected, actual;
+        for(auto const& o : p.opts(i))
+            expected.emplace_back(std::string(o.name, o.namelen) + "=" + (o.arg ? o.arg : "(null)"));
+        for(c4::opt::ViewOption const& o : vp.opts(i))
+        {
+            actual.emplace_back(str(o.name) + "=" + (o.has_arg() ? str(o.arg) : "(null)"));
+            EXPECT_TRUE(args.in_tokens(o.name));
+            if(o.has_arg())
+            {
+                EXPECT_TRUE(args.in_tokens(o.arg) || o.arg.len == 0);
+            }
+        }
+        EXPECT_EQ(actual, expected) << i;
+    }
+    size_t k = 0;
+    for(c4::opt::ViewOption const& o : vp.opts_args())
+    {
+        ASSERT_LT(k, (size_t)p.parser.optionsCount());
+        EXPECT_EQ(o.desc, p.buffer[k].desc) << k;
+        ++k;
+    }
+    std::vector<std::string> posn;
+    for(c4::csubstr s : vp.posn_args())
+        posn.emplace_back(str(s));
+    EXPECT_EQ(posn, (std::vector<std::string>{"file0", "file1"}));
+    EXPECT_EQ(str(vp(LEVEL)), "1");
+    EXPECT_EQ(str(vp(NAME)), "=");
+}
+
+TEST(view, spec)
+{
+    c4::opt::RuntimeSpec rs(common_usage);
+    Args args({"--verbose", "--level=12", "--name", "foo", "--namefoo", "x"});
+    c4::opt::ParseError err;
+    auto vp = c4::opt::make_parser(rs.spec(), args.tokens(), &err);
+    // --namefoo is not --name
+    ASSERT_TRUE(err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_UNKNOWN_OPTION);
+    EXPECT_EQ(err.argi, 4);
+    char buf[64];
+    c4::opt::format_error(c4::substr(buf, sizeof(buf)), err, common_usage, args.tokens());
+    EXPECT_STREQ(buf, "Unknown option '--namefoo'");
+    EXPECT_EQ(vp.count(VERBOSE), 1);
+    EXPECT_EQ(str(vp(LEVEL)), "12");
+    EXPECT_EQ(str(vp(NAME)), "foo");
+}
+
+TEST(view, errors_name_the_token)
+{
+    Args args({"-vl", "x12", "rest"});
+    c4::opt::ParseError err;
+    auto vp = c4::opt::make_parser(common_usage, args.tokens(), &err);
+    ASSERT_TRUE(err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_ILLEGAL_ARGUMENT);
+    EXPECT_EQ(err.argi, 0);
+    EXPECT_EQ(err.offset, 2);
+    char buf[64];
+    c4::opt::format_error(c4::substr(buf, sizeof(buf)), err, common_usage, args.tokens());
+    EXPECT_STREQ(buf, "Option '-l': illegal argument");
+    EXPECT_EQ(vp.count(VERBOSE), 1);
+}
+
+TEST(view, mandatory)
+{
+    Args args({"-v"});
+    c4::opt::ParseError err;
+    c4::opt::make_parser(common_usage, args.tokens(), &err, {VERBOSE, NAME});
+    ASSERT_TRUE(err);
+    EXPECT_EQ(err.code, c4::opt::PARSE_MISSING_MANDATORY);
+    char buf[64];
+    c4::opt::format_error(c4::substr(buf, sizeof(buf)), err, common_usage, args.tokens());
+    EXPECT_STREQ(buf, "Option '--name' is mandatory and was not given");
+}
+
+TEST(view, gnu_mode)
+{
+    Args args({"file0", "-v", "-", "--level", "3", "file1", "--", "-n"});
+    c4::opt::ViewParser vp(common_usage, C4_COUNTOF(common_usage), args.tokens(), c4::opt::PARSE_GNU);
+    EXPECT_EQ(vp.count(VERBOSE), 1);
+    EXPECT_EQ(str(vp(LEVEL)), "3");
+    EXPECT_EQ(vp.count(NAME), 0);
+    std::vector<std::string> posn;
+    for(c4::csubstr s : vp.posn_args())
+        posn.emplace_back(str(s));
+    EXPECT_EQ(posn, (std::vector<std::string>{"file0", "-", "file1", "-n"}));
+    std::vector<uint32_t> indices(vp.posn_indices(), vp.posn_indices() + vp.num_posn());
+    EXPECT_EQ(indices, (std::vector<uint32_t>{0, 2, 5, 7}));
+    // POSIX mode stops at the first positional argument
+    c4::opt::ViewParser pp(common_usage, C4_COUNTOF(common_usage), args.tokens());
+    EXPECT_EQ(pp.num_occurrences(), 0u);
+    EXPECT_EQ(pp.num_posn(), args.tbuf.size());
+}
+
+C4_SUPPRESS_WARNING_GCC_POP
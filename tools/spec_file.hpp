@@ -0,0 +1,164 @@
+#ifndef _C4_OPT_TOOLS_SPEC_FILE_HPP_
+#define _C4_OPT_TOOLS_SPEC_FILE_HPP_
+
+/** @file spec_file.hpp reader of the declarative spec files; see
+ * specgen.cpp for the format. Errors are fatal: they are reported on
+ * stderr with the file and line, and the program exits. */
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace c4 {
+namespace opt {
+namespace tools {
+
+struct Entry
+{
+    std::string index;
+    std::string type;
+    std::string shortopt;
+    std::string longopt;
+    std::string check;
+    std::string help;
+    bool has_help;
+};
+
+struct SpecFile
+{
+    std::vector<std::string> includes;
+    std::vector<Entry> entries;
+};
+
+[[noreturn]] inline void fail(const char *file, int line, const char *msg)
+{
+    fprintf(stderr, "%s:%d: error: %s\n", file, line, msg);
+    exit(1);
+}
+
+inline const char* skip_ws(const char *s)
+{
+    while(*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')
+        ++s;
+    return s;
+}
+
+/** read a bare word or a quoted string, with C escapes */
+inline const char* read_token(const char *s, std::string *tok, bool *quoted, const char *file, int line)
+{
+    tok->clear();
+    *quoted = (*s == '"');
+    if( ! *quoted)
+    {
+        while(*s != 0 && *s != ' ' && *s != '\t' && *s != '\r' && *s != '\n')
+            tok->push_back(*s++);
+        return s;
+    }
+    for(++s; *s != '"'; ++s)
+    {
+        if(*s == 0 || *s == '\n')
+            fail(file, line, "unterminated string");
+        if(*s != '\\')
+        {
+            tok->push_back(*s);
+            continue;
+        }
+        switch(*++s)
+        {
+        case 'n': tok->push_back('\n'); break;
+        case 't': tok->push_back('\t'); break;
+        case 'r': tok->push_back('\r'); break;
+        case '\\': tok->push_back('\\'); break;
+        case '"': tok->push_back('"'); break;
+        default: fail(file, line, "unknown escape sequence");
+        }
+    }
+    return s + 1;
+}
+
+inline SpecFile read_spec(const char *file)
+{
+    FILE *f = fopen(file, "rb");
+    if( ! f)
+        fail(file, 0, "could not open file");
+    SpecFile spec;
+    char buf[4096];
+    int line = 0;
+    std::string tok;
+    bool quoted;
+    while(fgets(buf, sizeof(buf), f))
+    {
+        ++line;
+        if(strlen(buf) == sizeof(buf) - 1 && buf[sizeof(buf) - 2] != '\n')
+            fail(file, line, "line too long");
+        const char *s = skip_ws(buf);
+        if(*s == 0 || *s == '#')
+            continue;
+        if(*s == '"')
+        {
+            if(spec.entries.empty() || ! spec.entries.back().has_help)
+                fail(file, line, "help continuation line without a previous help");
+            while(*s == '"')
+            {
+                s = read_token(s, &tok, &quoted, file, line);
+                spec.entries.back().help += tok;
+                s = skip_ws(s);
+            }
+            if(*s != 0)
+                fail(file, line, "unexpected trailing characters");
+            continue;
+        }
+        if(strncmp(s, "%include", 8) == 0)
+        {
+            std::string inc(skip_ws(s + 8));
+            while( ! inc.empty() && (inc.back() == '\n' || inc.back() == '\r' || inc.back() == ' '))
+                inc.pop_back();
+            spec.includes.push_back(inc);
+            continue;
+        }
+        Entry e;
+        std::string *fields[] = {&e.index, &e.type, &e.shortopt, &e.longopt, &e.check};
+        for(std::string *field : fields)
+        {
+            s = skip_ws(s);
+            if(*s == 0)
+                fail(file, line, "expected 6 fields: index type short long check help");
+            s = read_token(s, field, &quoted, file, line);
+        }
+        s = skip_ws(s);
+        e.has_help = true;
+        if(strncmp(s, "null", 4) == 0)
+        {
+            e.has_help = false;
+            s = skip_ws(s + 4);
+        }
+        else
+        {
+            if(*s != '"')
+                fail(file, line, "the help must be one or more quoted strings, or null");
+            while(*s == '"')
+            {
+                s = read_token(s, &tok, &quoted, file, line);
+                e.help += tok;
+                s = skip_ws(s);
+            }
+        }
+        if(*s != 0)
+            fail(file, line, "unexpected trailing characters");
+        if(e.check.find("::") == std::string::npos)
+            e.check = "c4::opt::" + e.check;
+        spec.entries.push_back(e);
+    }
+    fclose(f);
+    if(spec.entries.empty())
+        fail(file, line, "no descriptors in spec");
+    return spec;
+}
+
+} // namespace tools
+} // namespace opt
+} // namespace c4
+
+#endif /* _C4_OPT_TOOLS_SPEC_FILE_HPP_ */
@@ -0,0 +1,198 @@
+// c4opt-specgen: compiles a declarative option spec into a C++ header.
+//
+// usage: c4opt-specgen <spec-file> <output-header> <namespace> [<width>...]
+//
+// The spec file has one descriptor per line, with the same fields as
+// option::Descriptor, in the same order:
+//
+//     # index    type  short  long      check     help
+//     UNKNOWN    0     ""     ""        unknown   "USAGE: app [options]\n\nOptions:"
+//     HELP       0     h      help      none      "  -h, --help  \tPrint usage and exit."
+//
+// - index: an identifier. The generated enum has one enumerator for
+//   each distinct name, in order of first appearance. Aliases reuse
+//   the same name.
+// - type: emitted verbatim.
+// - short, long: bare words or quoted strings. Use "" for none.
+// - check: the checker function. Names without a namespace refer to
+//   the c4::opt checkers.
+// - help: the remainder of the line, as one or more quoted strings
+//   which are concatenated, or null. A line starting with a quoted
+//   string continues the help of the previous line.
+//
+// Lines starting with # are comments. Lines starting with %include are
+// emitted verbatim as #include directives, eg for custom checkers.
+//
+// The generated header contains the descriptors, the lookup tables of
+// c4::opt::RuntimeSpec, the sorted spellings of c4::opt::CompletionIndex,
+// and the help text rendered for each of the given widths, all as
+// constexpr data.
+
+#include "spec_file.hpp"
+#include <c4/opt/complete.hpp>
+#include <c4/opt/opt.hpp>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+using namespace c4::opt::tools;
+
+/** emit a string as a C string literal, breaking it at newlines */
+void emit_str(FILE *out, const char *s, size_t len, const char *indent)
+{
+    fputc('"', out);
+    for(size_t i = 0; i < len; ++i)
+    {
+        unsigned char c = (unsigned char)s[i];
+        switch(c)
+        {
+        case '\n':
+            fputs("\\n\"", out);
+            if(i + 1 < len)
+                fprintf(out, "\n%s\"", indent);
+            else
+                return;
+            break;
+        case '\t': fputs("\\t", out); break;
+        case '\r': fputs("\\r", out); break;
+        case '\\': fputs("\\\\", out); break;
+        case '"': fputs("\\\"", out); break;
+        default:
+            if(c < 0x20 || c == 0x7f)
+                fprintf(out, "\\%03o", c); // 3 digits: never ambiguous
+            else
+                fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+void emit_table(FILE *out, const char *name, unsigned const* table, size_t num)
+{
+    fprintf(out, "constexpr const unsigned %s[%zu] = {", name, num);
+    for(size_t i = 0; i < num; ++i)
+        fprintf(out, "%s%u,", (i % 16 == 0) ? "\n    " : " ", table[i]);
+    fputs("\n};\n\n", out);
+}
+
+} // anon
+
+
+int main(int argc, const char *argv[])
+{
+    if(argc < 4)
+    {
+        fprintf(stderr, "usage: %s <spec-file> <output-header> <namespace> [<width>...]\n", argv[0]);
+        return 1;
+    }
+    const char *spec_file = argv[1];
+    const char *out_file = argv[2];
+    const char *ns = argv[3];
+    std::vector<int> widths;
+    for(int i = 4; i < argc; ++i)
+        widths.push_back(atoi(argv[i]));
+
+    SpecFile spec = read_spec(spec_file);
+
+    // assign the enum values
+    std::vector<std::string> names;
+    std::vector<unsigned> indices;
+    for(Entry const& e : spec.entries)
+    {
+        unsigned idx = 0;
+        while(idx < names.size() && names[idx] != e.index)
+            ++idx;
+        if(idx == names.size())
+            names.push_back(e.index);
+        indices.push_back(idx);
+    }
+
+    // build the descriptors, to compile the tables and render the help
+    std::vector<option::Descriptor> usage;
+    for(size_t i = 0; i < spec.entries.size(); ++i)
+    {
+        Entry const& e = spec.entries[i];
+        usage.push_back(option::Descriptor{indices[i], 0, e.shortopt.c_str(), e.longopt.c_str(), nullptr, e.has_help ? e.help.c_str() : nullptr});
+    }
+    usage.push_back(option::Descriptor{0, 0, 0, 0, 0, 0});
+    c4::opt::RuntimeSpec rt(usage.data());
+    option::Index const& ix = rt.spec().index;
+
+    FILE *out = fopen(out_file, "wb");
+    if( ! out)
+        fail(out_file, 0, "could not open output file");
+    fprintf(out, "// generated by c4opt-specgen from %s\n// DO NOT EDIT.\n\n", spec_file);
+    fprintf(out, "#ifndef _C4OPT_GEN_%s_HPP_\n#define _C4OPT_GEN_%s_HPP_\n\n", ns, ns);
+    fputs("#include <c4/opt/complete.hpp>\n#include <c4/opt/opt.hpp>\n", out);
+    for(std::string const& inc : spec.includes)
+        fprintf(out, "#include %s\n", inc.c_str());
+    fprintf(out, "\nnamespace %s {\n\n", ns);
+
+    fputs("enum : unsigned {\n", out);
+    for(size_t i = 0; i < names.size(); ++i)
+        fprintf(out, "    %s = %zu,\n", names[i].c_str(), i);
+    fputs("};\n\n", out);
+
+    fputs("constexpr const option::Descriptor usage[] = {\n", out);
+    for(size_t i = 0; i < spec.entries.size(); ++i)
+    {
+        Entry const& e = spec.entries[i];
+        fprintf(out, "    {%s, %s, ", e.index.c_str(), e.type.c_str());
+        emit_str(out, e.shortopt.data(), e.shortopt.size(), "");
+        fputs(", ", out);
+        emit_str(out, e.longopt.data(), e.longopt.size(), "");
+        fprintf(out, ", %s,\n        ", e.check.c_str());
+        if(e.has_help)
+            emit_str(out, e.help.data(), e.help.size(), "        ");
+        else
+            fputs("nullptr", out);
+        fputs("},\n", out);
+    }
+    fputs("    {0, 0, 0, 0, 0, 0}\n};\n\n", out);
+
+    emit_table(out, "shortopt_table", ix.shortopt, 256);
+    emit_table(out, "longopt_table", ix.longopt, rt.num_longopt_slots());
+
+    // the spellings, sorted, for shell completion
+    c4::opt::CompletionIndex cix(usage.data());
+    c4::opt::CompletionTable const& ct = cix.table();
+    fprintf(out, "constexpr const c4::opt::CompletionWord completion_words[%zu] = {\n", ct.num_words ? ct.num_words : 1u);
+    for(size_t i = 0; i < ct.num_words; ++i)
+    {
+        fputs("    {", out);
+        emit_str(out, ct.words[i].str, ct.words[i].len, "");
+        fprintf(out, ", %uu, %uu},\n", ct.words[i].len, ct.words[i].desc);
+    }
+    if( ! ct.num_words)
+        fputs("    {\"\", 0u, 0u},\n", out);
+    fprintf(out, "};\n\nconstexpr const c4::opt::CompletionTable completion = {usage, completion_words, %zu};\n\n", ct.num_words);
+
+    if( ! widths.empty())
+    {
+        for(int w : widths)
+        {
+            c4::csubstr txt = c4::opt::help_text(usage.data(), w);
+            fprintf(out, "constexpr const char help_%d[] =\n    ", w);
+            emit_str(out, txt.str, txt.len, "    ");
+            fputs(";\n\n", out);
+        }
+        fputs("constexpr const c4::opt::HelpText help_texts[] = {\n", out);
+        for(int w : widths)
+            fprintf(out, "    {%d, help_%d, sizeof(help_%d) - 1},\n", w, w, w);
+        fputs("};\n\n", out);
+    }
+
+    fprintf(out, "constexpr const c4::opt::Spec spec = {\n"
+            "    {usage, %uu, %uu, %uu, shortopt_table, longopt_table, %uu, %uu},\n"
+            "    %s, %zu\n};\n\n",
+            ix.num_usage, ix.options_max, ix.unknown, ix.longopt_mask, ix.seed,
+            widths.empty() ? "nullptr" : "help_texts", widths.size());
+
+    fprintf(out, "} // namespace %s\n\n#endif /* _C4OPT_GEN_%s_HPP_ */\n", ns, ns);
+    fclose(out);
+    return 0;
+}